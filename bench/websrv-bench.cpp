@@ -0,0 +1,965 @@
+// websrv-bench.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+//
+// Load generator and benchmark for the ws1, ws2 and REST interfaces.
+//
+// The driver is opened in process through VSCPOpen with a normal driver
+// configuration file. Events are injected with VSCPWrite at a fixed rate
+// and N ws1, ws2 and REST clients connected over loopback receive them.
+// Each event carries its injection time so delivery latency can be
+// measured. Nothing outside the local machine is needed.
+//
+// Usage: vscpl2drv-websrv-bench -c websrv.json -u user -p password [options]
+//
+
+#include <dirent.h>
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <canal.h>
+#include <civetweb.h>
+#include <vscp.h>
+
+#include <json.hpp> // Needs C++11  -std=c++11
+
+using json = nlohmann::json;
+
+// Driver API (vscpl2drv-websrv.cpp)
+extern "C" long
+VSCPOpen(const char *pPathConfig, const char *pguid);
+extern "C" int
+VSCPClose(long handle);
+extern "C" int
+VSCPWrite(long handle, const vscpEvent *pEvent, unsigned long timeout);
+extern "C" int
+VSCPRead(long handle, vscpEvent *pEvent, unsigned long timeout);
+
+// Default driver key (webobj.h)
+#define BENCH_DEFAULT_KEY "2DBB079A38985AF00EBEEFE22F9FFA0E7F72DF06EBE44563EDF4A1073CABC7D4"
+
+// Payload: 8 byte injection time (ns, monotonic) + 4 byte sequence number
+#define BENCH_PAYLOAD_SIZE 12
+
+// Protocols
+#define BENCH_WS1  0
+#define BENCH_WS2  1
+#define BENCH_REST 2
+#define BENCH_COUNT 3
+
+static const char *bench_names[BENCH_COUNT] = { "ws1", "ws2", "rest" };
+
+// Options
+struct bench_options {
+  std::string m_config;
+  std::string m_guid;
+  std::string m_host;
+  int m_port;
+  std::string m_user;
+  std::string m_password;
+  std::string m_key;
+  int m_clients[BENCH_COUNT];
+  uint32_t m_rate;
+  uint32_t m_duration;
+  uint32_t m_warmup;
+  uint16_t m_class;
+  uint16_t m_type;
+  uint16_t m_typeSpread;
+  std::string m_ws1Filter;
+  std::string m_ws2Filter;
+  uint32_t m_restPollMs;
+  uint32_t m_restCount;
+};
+
+static bench_options bench_opt;
+
+// Set when measurements should be recorded
+static std::atomic<bool> bench_bRecord(false);
+
+// Set when clients should stop
+static std::atomic<bool> bench_bQuit(false);
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_now
+//
+// Monotonic time in nanoseconds
+//
+
+static uint64_t
+bench_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_client
+//
+// Per client state. Latencies are kept per client so the receive
+// threads never share a lock.
+//
+
+struct bench_client {
+  int m_protocol;
+  int m_idx;
+  struct mg_connection *m_conn;
+  std::atomic<bool> m_bReady;
+  std::atomic<bool> m_bFailed;
+  std::string m_session; // REST
+  pthread_t m_thread;    // REST
+  pthread_mutex_t m_mutex;
+  std::vector<uint32_t> m_latency; // us
+  uint64_t m_received;
+
+  bench_client(void) : m_protocol(0), m_idx(0), m_conn(NULL), m_bReady(false), m_bFailed(false), m_thread(0), m_received(0)
+  {
+    pthread_mutex_init(&m_mutex, NULL);
+  };
+
+  ~bench_client() { pthread_mutex_destroy(&m_mutex); };
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_record
+//
+
+static void
+bench_record(bench_client *pClient, const std::vector<uint8_t> &data)
+{
+  if (data.size() < BENCH_PAYLOAD_SIZE) {
+    return;
+  }
+
+  uint64_t sent = 0;
+  for (int i = 0; i < 8; i++) {
+    sent = (sent << 8) | data[i];
+  }
+
+  uint64_t now = bench_now();
+  if (!bench_bRecord || (now < sent)) {
+    return;
+  }
+
+  pthread_mutex_lock(&pClient->m_mutex);
+  pClient->m_latency.push_back((uint32_t) std::min<uint64_t>((now - sent) / 1000, UINT32_MAX));
+  pClient->m_received++;
+  pthread_mutex_unlock(&pClient->m_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_getAuth
+//
+// AES128(user:password) with the driver key as ws1/ws2 expects it
+//
+
+static bool
+bench_getAuth(std::string &strIV, std::string &strCrypto)
+{
+  uint8_t key[32];
+  uint8_t iv[16];
+  uint8_t out[512];
+  int len = 0, lenFinal = 0;
+  char hex[3];
+
+  if (64 != bench_opt.m_key.length()) {
+    return false;
+  }
+
+  for (int i = 0; i < 32; i++) {
+    key[i] = (uint8_t) strtoul(bench_opt.m_key.substr(i * 2, 2).c_str(), NULL, 16);
+  }
+
+  if (1 != RAND_bytes(iv, sizeof(iv))) {
+    return false;
+  }
+
+  // Null padded to the block size, the driver does not use PKCS padding
+  std::string plain = bench_opt.m_user + ":" + bench_opt.m_password;
+  plain.append(16 - (plain.length() % 16), '\0');
+  if (plain.length() > (sizeof(out) - 16)) {
+    return false;
+  }
+
+  EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+  EVP_EncryptInit_ex(ctx, EVP_aes_128_cbc(), NULL, key, iv);
+  EVP_CIPHER_CTX_set_padding(ctx, 0);
+  EVP_EncryptUpdate(ctx, out, &len, (const uint8_t *) plain.data(), (int) plain.length());
+  EVP_EncryptFinal_ex(ctx, out + len, &lenFinal);
+  EVP_CIPHER_CTX_free(ctx);
+
+  strIV.clear();
+  for (int i = 0; i < 16; i++) {
+    snprintf(hex, sizeof(hex), "%02X", iv[i]);
+    strIV += hex;
+  }
+
+  strCrypto.clear();
+  for (int i = 0; i < (len + lenFinal); i++) {
+    snprintf(hex, sizeof(hex), "%02X", out[i]);
+    strCrypto += hex;
+  }
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_wsWrite
+//
+
+static void
+bench_wsWrite(bench_client *pClient, const std::string &str)
+{
+  mg_websocket_client_write(pClient->m_conn, MG_WEBSOCKET_OPCODE_TEXT, str.c_str(), str.length());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_ws1Data
+//
+
+static int
+bench_ws1Data(struct mg_connection *conn, int bits, char *data, size_t len, void *user_data)
+{
+  bench_client *pClient = (bench_client *) user_data;
+
+  if (MG_WEBSOCKET_OPCODE_TEXT != (bits & 0x0f)) {
+    return 1;
+  }
+
+  std::string str(data, len);
+
+  // E;head,class,type,obid,datetime,timestamp,GUID,data...
+  if (0 == str.compare(0, 2, "E;")) {
+    std::vector<uint8_t> payload;
+    size_t pos = 2;
+    for (int field = 0; pos != std::string::npos; field++) {
+      size_t next = str.find(',', pos);
+      if (field >= 7) {
+        payload.push_back((uint8_t) strtoul(str.substr(pos, next - pos).c_str(), NULL, 0));
+      }
+      pos = (std::string::npos == next) ? next : next + 1;
+    }
+    bench_record(pClient, payload);
+  }
+  else if (0 == str.compare(0, 7, "+;AUTH0")) {
+    std::string strIV, strCrypto;
+    if (!bench_getAuth(strIV, strCrypto)) {
+      pClient->m_bFailed = true;
+      return 0;
+    }
+    bench_wsWrite(pClient, "C;AUTH;" + strIV + ";" + strCrypto);
+  }
+  else if (0 == str.compare(0, 7, "+;AUTH1")) {
+    if (bench_opt.m_ws1Filter.length()) {
+      bench_wsWrite(pClient, "C;SF;" + bench_opt.m_ws1Filter);
+    }
+    else {
+      bench_wsWrite(pClient, "C;OPEN");
+    }
+  }
+  else if (0 == str.compare(0, 4, "+;SF")) {
+    bench_wsWrite(pClient, "C;OPEN");
+  }
+  else if (0 == str.compare(0, 6, "+;OPEN")) {
+    pClient->m_bReady = true;
+  }
+  else if (0 == str.compare(0, 2, "-;")) {
+    fprintf(stderr, "ws1 client %d: %s\n", pClient->m_idx, str.c_str());
+    pClient->m_bFailed = true;
+  }
+
+  return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_ws2Data
+//
+
+static int
+bench_ws2Data(struct mg_connection *conn, int bits, char *data, size_t len, void *user_data)
+{
+  bench_client *pClient = (bench_client *) user_data;
+
+  if (MG_WEBSOCKET_OPCODE_TEXT != (bits & 0x0f)) {
+    return 1;
+  }
+
+  try {
+    json j           = json::parse(std::string(data, len));
+    std::string type = j.value("type", "");
+
+    if (("EVENT" == type) || ("event" == type)) {
+      std::vector<uint8_t> payload;
+      json ev = j["event"];
+      json jdata = ev.contains("vscpData") ? ev["vscpData"] : ev["data"];
+      if (jdata.is_array()) {
+        for (size_t i = 0; i < jdata.size(); i++) {
+          payload.push_back(jdata[i].get<uint8_t>());
+        }
+      }
+      bench_record(pClient, payload);
+    }
+    else if ("+" == type) {
+      std::string cmd = j.value("command", "");
+      if ("AUTH" == cmd) {
+        if (bench_opt.m_ws2Filter.length()) {
+          json cmdobj;
+          cmdobj["type"]    = "cmd";
+          cmdobj["command"] = "SETFILTER";
+          cmdobj["args"]    = json::parse(bench_opt.m_ws2Filter);
+          bench_wsWrite(pClient, cmdobj.dump());
+        }
+        else {
+          bench_wsWrite(pClient, "{\"type\":\"cmd\",\"command\":\"OPEN\",\"args\":{}}");
+        }
+      }
+      else if (("SETFILTER" == cmd) || ("SF" == cmd)) {
+        bench_wsWrite(pClient, "{\"type\":\"cmd\",\"command\":\"OPEN\",\"args\":{}}");
+      }
+      else if ("OPEN" == cmd) {
+        pClient->m_bReady = true;
+      }
+      else if (j.contains("args") && j["args"].is_array() && j["args"].size() &&
+               ("AUTH0" == j["args"][0].get<std::string>())) {
+        std::string strIV, strCrypto;
+        if (!bench_getAuth(strIV, strCrypto)) {
+          pClient->m_bFailed = true;
+          return 0;
+        }
+        json cmdobj;
+        cmdobj["type"]           = "cmd";
+        cmdobj["command"]        = "AUTH";
+        cmdobj["args"]["iv"]     = strIV;
+        cmdobj["args"]["crypto"] = strCrypto;
+        bench_wsWrite(pClient, cmdobj.dump());
+      }
+    }
+    else if ("-" == type) {
+      fprintf(stderr, "ws2 client %d: %.*s\n", pClient->m_idx, (int) len, data);
+      pClient->m_bFailed = true;
+    }
+  }
+  catch (...) {
+    fprintf(stderr, "ws2 client %d: unable to parse %.*s\n", pClient->m_idx, (int) len, data);
+  }
+
+  return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_wsClose
+//
+
+static void
+bench_wsClose(const struct mg_connection *conn, void *user_data)
+{
+  bench_client *pClient = (bench_client *) user_data;
+  if (!bench_bQuit) {
+    fprintf(stderr, "%s client %d: connection closed\n", bench_names[pClient->m_protocol], pClient->m_idx);
+    pClient->m_bFailed = true;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_restRequest
+//
+// Do a GET on the REST interface and return the body
+//
+
+static bool
+bench_restRequest(const std::string &query, std::string &body)
+{
+  char ebuf[256];
+  char buf[8192];
+  int n;
+
+  struct mg_connection *conn = mg_download(bench_opt.m_host.c_str(),
+                                           bench_opt.m_port,
+                                           0,
+                                           ebuf,
+                                           sizeof(ebuf),
+                                           "GET /vscp/rest?%s HTTP/1.1\r\n"
+                                           "Host: %s\r\n"
+                                           "Connection: close\r\n\r\n",
+                                           query.c_str(),
+                                           bench_opt.m_host.c_str());
+  if (NULL == conn) {
+    fprintf(stderr, "rest: %s\n", ebuf);
+    return false;
+  }
+
+  body.clear();
+  while ((n = mg_read(conn, buf, sizeof(buf))) > 0) {
+    body.append(buf, n);
+  }
+
+  mg_close_connection(conn);
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_restThread
+//
+
+static void *
+bench_restThread(void *pData)
+{
+  bench_client *pClient = (bench_client *) pData;
+  std::string body;
+
+  // Open session
+  std::string query = "op=open&format=json&vscpuser=" + bench_opt.m_user + "&vscpsecret=" + bench_opt.m_password;
+  try {
+    if (!bench_restRequest(query, body)) {
+      pClient->m_bFailed = true;
+      return NULL;
+    }
+    json j = json::parse(body);
+    pClient->m_session = j.value("vscpsession", "");
+  }
+  catch (...) {
+  }
+
+  if (pClient->m_session.empty()) {
+    fprintf(stderr, "rest client %d: open failed %s\n", pClient->m_idx, body.c_str());
+    pClient->m_bFailed = true;
+    return NULL;
+  }
+
+  pClient->m_bReady = true;
+
+  // Poll for events
+  query = "op=readevent&format=json&count=" + std::to_string(bench_opt.m_restCount) +
+          "&vscpsession=" + pClient->m_session;
+
+  while (!bench_bQuit) {
+
+    size_t cnt = 0;
+    try {
+      if (bench_restRequest(query, body)) {
+        json j = json::parse(body);
+        if (j.contains("event") && j["event"].is_array()) {
+          for (size_t i = 0; i < j["event"].size(); i++) {
+            std::vector<uint8_t> payload;
+            json jdata = j["event"][i]["data"];
+            for (size_t k = 0; k < jdata.size(); k++) {
+              payload.push_back(jdata[k].get<uint8_t>());
+            }
+            bench_record(pClient, payload);
+            cnt++;
+          }
+        }
+      }
+    }
+    catch (...) {
+    }
+
+    if (!cnt) {
+      usleep(bench_opt.m_restPollMs * 1000);
+    }
+  }
+
+  bench_restRequest("op=close&format=json&vscpsession=" + pClient->m_session, body);
+
+  return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_drainThread
+//
+// Keep the driver receive queue empty
+//
+
+static void *
+bench_drainThread(void *pData)
+{
+  long h = *((long *) pData);
+
+  while (!bench_bQuit) {
+    vscpEvent ev;
+    memset(&ev, 0, sizeof(ev));
+    if (CANAL_ERROR_SUCCESS == VSCPRead(h, &ev, 100)) {
+      delete[] ev.pdata;
+    }
+  }
+
+  return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_getRSS
+//
+// Resident set size in kB
+//
+
+static long
+bench_getRSS(void)
+{
+  long rss = 0;
+  char line[256];
+
+  FILE *fp = fopen("/proc/self/status", "r");
+  if (NULL == fp) {
+    return 0;
+  }
+
+  while (NULL != fgets(line, sizeof(line), fp)) {
+    if (0 == strncmp(line, "VmRSS:", 6)) {
+      rss = atol(line + 6);
+      break;
+    }
+  }
+
+  fclose(fp);
+  return rss;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_cpuTime
+//
+// User + system CPU time for the process in microseconds
+//
+
+static uint64_t
+bench_cpuTime(void)
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return (uint64_t) (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000 + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_driverCpuTime
+//
+// User + system CPU time in microseconds for the driver threads only. The
+// load generator runs in the same process so the driver's share is the
+// sum over the threads it names "wsrv-*". Resolution is one clock tick and
+// the time of threads that exit during the run is not counted.
+//
+
+static uint64_t
+bench_driverCpuTime(void)
+{
+  uint64_t ticks = 0;
+  char path[300];
+  char buf[512];
+
+  DIR *dir = opendir("/proc/self/task");
+  if (NULL == dir) {
+    return 0;
+  }
+
+  struct dirent *pEntry;
+  while (NULL != (pEntry = readdir(dir))) {
+
+    if ('.' == pEntry->d_name[0]) {
+      continue;
+    }
+
+    snprintf(path, sizeof(path), "/proc/self/task/%s/stat", pEntry->d_name);
+    FILE *fp = fopen(path, "r");
+    if (NULL == fp) {
+      continue; // Thread exited
+    }
+
+    size_t len = fread(buf, 1, sizeof(buf) - 1, fp);
+    fclose(fp);
+    buf[len] = '\0';
+
+    // pid (comm) state ... utime is field 14 and stime field 15
+    char *pName = strchr(buf, '(');
+    char *pEnd  = strrchr(buf, ')');
+    if ((NULL == pName) || (NULL == pEnd) || (0 != strncmp(pName + 1, "wsrv-", 5))) {
+      continue;
+    }
+
+    unsigned long utime, stime;
+    if (2 == sscanf(pEnd + 2,
+                    "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                    &utime,
+                    &stime)) {
+      ticks += utime + stime;
+    }
+  }
+
+  closedir(dir);
+
+  long hz = sysconf(_SC_CLK_TCK);
+  return (hz > 0) ? ticks * 1000000 / hz : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_percentile
+//
+
+static uint32_t
+bench_percentile(const std::vector<uint32_t> &sorted, double q)
+{
+  if (sorted.empty()) {
+    return 0;
+  }
+
+  size_t idx = (size_t) (q * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_usage
+//
+
+static void
+bench_usage(const char *name)
+{
+  printf("Usage: %s -c config [options]\n\n"
+         "  -c, --config=PATH       Driver configuration file (required)\n"
+         "  -g, --guid=GUID         Driver GUID\n"
+         "  -H, --host=HOST         Host the driver listens on (127.0.0.1)\n"
+         "  -P, --port=PORT         Port the driver listens on (8884)\n"
+         "  -u, --user=USER         User for the clients (admin)\n"
+         "  -p, --password=PASS     Password for the clients (secret)\n"
+         "  -k, --key=HEX           Driver key as 64 hex characters (driver default key)\n"
+         "      --ws1=N             Number of ws1 clients (1)\n"
+         "      --ws2=N             Number of ws2 clients (1)\n"
+         "      --rest=N            Number of REST clients (1)\n"
+         "  -r, --rate=N            Events per second to inject (1000)\n"
+         "  -d, --duration=S        Seconds to measure (10)\n"
+         "  -w, --warmup=S          Seconds to run before measuring (2)\n"
+         "      --class=N           VSCP class of injected events (20)\n"
+         "      --type=N            First VSCP type of injected events (3)\n"
+         "      --type-spread=N     Rotate over this many types (1)\n"
+         "      --ws1-filter=F;M    ws1 filter and mask strings\n"
+         "      --ws2-filter=JSON   ws2 SETFILTER args object\n"
+         "      --rest-poll-ms=N    REST poll interval when idle (10)\n"
+         "      --rest-count=N      Max events per REST read (100)\n"
+         "  -h, --help              This help\n",
+         name);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// main
+//
+
+int
+main(int argc, char **argv)
+{
+  enum { OPT_WS1 = 256, OPT_WS2, OPT_REST, OPT_CLASS, OPT_TYPE, OPT_SPREAD, OPT_WS1F, OPT_WS2F, OPT_POLL, OPT_COUNT };
+
+  static struct option long_options[] = { { "config", required_argument, 0, 'c' },
+                                          { "guid", required_argument, 0, 'g' },
+                                          { "host", required_argument, 0, 'H' },
+                                          { "port", required_argument, 0, 'P' },
+                                          { "user", required_argument, 0, 'u' },
+                                          { "password", required_argument, 0, 'p' },
+                                          { "key", required_argument, 0, 'k' },
+                                          { "ws1", required_argument, 0, OPT_WS1 },
+                                          { "ws2", required_argument, 0, OPT_WS2 },
+                                          { "rest", required_argument, 0, OPT_REST },
+                                          { "rate", required_argument, 0, 'r' },
+                                          { "duration", required_argument, 0, 'd' },
+                                          { "warmup", required_argument, 0, 'w' },
+                                          { "class", required_argument, 0, OPT_CLASS },
+                                          { "type", required_argument, 0, OPT_TYPE },
+                                          { "type-spread", required_argument, 0, OPT_SPREAD },
+                                          { "ws1-filter", required_argument, 0, OPT_WS1F },
+                                          { "ws2-filter", required_argument, 0, OPT_WS2F },
+                                          { "rest-poll-ms", required_argument, 0, OPT_POLL },
+                                          { "rest-count", required_argument, 0, OPT_COUNT },
+                                          { "help", no_argument, 0, 'h' },
+                                          { 0, 0, 0, 0 } };
+
+  bench_opt.m_guid                  = "FF:FF:FF:FF:FF:FF:FF:FF:FF:FF:FF:FF:FF:FF:FF:00";
+  bench_opt.m_host                  = "127.0.0.1";
+  bench_opt.m_port                  = 8884;
+  bench_opt.m_user                  = "admin";
+  bench_opt.m_password              = "secret";
+  bench_opt.m_key                   = BENCH_DEFAULT_KEY;
+  bench_opt.m_clients[BENCH_WS1]    = 1;
+  bench_opt.m_clients[BENCH_WS2]    = 1;
+  bench_opt.m_clients[BENCH_REST]   = 1;
+  bench_opt.m_rate                  = 1000;
+  bench_opt.m_duration              = 10;
+  bench_opt.m_warmup                = 2;
+  bench_opt.m_class                 = 20;
+  bench_opt.m_type                  = 3;
+  bench_opt.m_typeSpread            = 1;
+  bench_opt.m_restPollMs            = 10;
+  bench_opt.m_restCount             = 100;
+
+  int c;
+  while (-1 != (c = getopt_long(argc, argv, "c:g:H:P:u:p:k:r:d:w:h", long_options, NULL))) {
+    switch (c) {
+      case 'c': bench_opt.m_config = optarg; break;
+      case 'g': bench_opt.m_guid = optarg; break;
+      case 'H': bench_opt.m_host = optarg; break;
+      case 'P': bench_opt.m_port = atoi(optarg); break;
+      case 'u': bench_opt.m_user = optarg; break;
+      case 'p': bench_opt.m_password = optarg; break;
+      case 'k': bench_opt.m_key = optarg; break;
+      case OPT_WS1: bench_opt.m_clients[BENCH_WS1] = atoi(optarg); break;
+      case OPT_WS2: bench_opt.m_clients[BENCH_WS2] = atoi(optarg); break;
+      case OPT_REST: bench_opt.m_clients[BENCH_REST] = atoi(optarg); break;
+      case 'r': bench_opt.m_rate = (uint32_t) strtoul(optarg, NULL, 0); break;
+      case 'd': bench_opt.m_duration = (uint32_t) strtoul(optarg, NULL, 0); break;
+      case 'w': bench_opt.m_warmup = (uint32_t) strtoul(optarg, NULL, 0); break;
+      case OPT_CLASS: bench_opt.m_class = (uint16_t) strtoul(optarg, NULL, 0); break;
+      case OPT_TYPE: bench_opt.m_type = (uint16_t) strtoul(optarg, NULL, 0); break;
+      case OPT_SPREAD: bench_opt.m_typeSpread = (uint16_t) strtoul(optarg, NULL, 0); break;
+      case OPT_WS1F: bench_opt.m_ws1Filter = optarg; break;
+      case OPT_WS2F: bench_opt.m_ws2Filter = optarg; break;
+      case OPT_POLL: bench_opt.m_restPollMs = (uint32_t) strtoul(optarg, NULL, 0); break;
+      case OPT_COUNT: bench_opt.m_restCount = (uint32_t) strtoul(optarg, NULL, 0); break;
+      case 'h': bench_usage(argv[0]); return 0;
+      default: bench_usage(argv[0]); return 1;
+    }
+  }
+
+  if (bench_opt.m_config.empty() || !bench_opt.m_rate) {
+    bench_usage(argv[0]);
+    return 1;
+  }
+
+  if (!bench_opt.m_typeSpread) {
+    bench_opt.m_typeSpread = 1;
+  }
+
+  long rssStart = bench_getRSS();
+
+  // Open the driver. This starts the web server.
+  long h = VSCPOpen(bench_opt.m_config.c_str(), bench_opt.m_guid.c_str());
+  if (!h) {
+    fprintf(stderr, "Failed to open driver with configuration %s\n", bench_opt.m_config.c_str());
+    return 1;
+  }
+
+  // Before any client connects, so this is the driver's own footprint
+  long rssOpen = bench_getRSS();
+
+  pthread_t drainThread;
+  pthread_create(&drainThread, NULL, bench_drainThread, &h);
+
+  // Connect clients
+  std::vector<bench_client *> clients;
+  for (int protocol = 0; protocol < BENCH_COUNT; protocol++) {
+    for (int i = 0; i < bench_opt.m_clients[protocol]; i++) {
+
+      bench_client *pClient = new bench_client;
+      pClient->m_protocol   = protocol;
+      pClient->m_idx        = i;
+      clients.push_back(pClient);
+
+      if (BENCH_REST == protocol) {
+        pthread_create(&pClient->m_thread, NULL, bench_restThread, pClient);
+        continue;
+      }
+
+      char ebuf[256];
+      pClient->m_conn = mg_connect_websocket_client(bench_opt.m_host.c_str(),
+                                                    bench_opt.m_port,
+                                                    0,
+                                                    ebuf,
+                                                    sizeof(ebuf),
+                                                    (BENCH_WS1 == protocol) ? "/ws1" : "/ws2",
+                                                    NULL,
+                                                    (BENCH_WS1 == protocol) ? bench_ws1Data : bench_ws2Data,
+                                                    bench_wsClose,
+                                                    pClient);
+      if (NULL == pClient->m_conn) {
+        fprintf(stderr, "%s client %d: %s\n", bench_names[protocol], i, ebuf);
+        pClient->m_bFailed = true;
+      }
+    }
+  }
+
+  // Wait for all clients to be ready
+  uint64_t deadline = bench_now() + 10000000000ULL;
+  size_t nReady     = 0;
+  while (bench_now() < deadline) {
+    nReady = 0;
+    for (size_t i = 0; i < clients.size(); i++) {
+      if (clients[i]->m_bReady || clients[i]->m_bFailed) {
+        nReady++;
+      }
+    }
+    if (nReady == clients.size()) {
+      break;
+    }
+    usleep(10000);
+  }
+
+  for (size_t i = 0; i < clients.size(); i++) {
+    if (!clients[i]->m_bReady) {
+      fprintf(stderr, "%s client %d did not get ready\n", bench_names[clients[i]->m_protocol], clients[i]->m_idx);
+    }
+  }
+
+  // Inject events at the requested rate
+  vscpEvent ev;
+  uint8_t payload[BENCH_PAYLOAD_SIZE];
+  memset(&ev, 0, sizeof(ev));
+  ev.head       = VSCP_PRIORITY_NORMAL;
+  ev.vscp_class = bench_opt.m_class;
+  ev.sizeData   = BENCH_PAYLOAD_SIZE;
+  ev.pdata      = payload;
+
+  uint64_t start       = bench_now();
+  uint64_t measure     = start + (uint64_t) bench_opt.m_warmup * 1000000000ULL;
+  uint64_t end         = measure + (uint64_t) bench_opt.m_duration * 1000000000ULL;
+  uint64_t nSent       = 0;
+  uint64_t nMeasured   = 0;
+  uint64_t cpuStart    = 0;
+  uint64_t drvStart    = 0;
+  uint32_t seq         = 0;
+
+  for (uint64_t now = start; now < end; now = bench_now()) {
+
+    if (!bench_bRecord && (now >= measure)) {
+      cpuStart      = bench_cpuTime();
+      drvStart      = bench_driverCpuTime();
+      bench_bRecord = true;
+    }
+
+    // Events that should have been sent by now
+    uint64_t due = ((now - start) / 1000) * bench_opt.m_rate / 1000000;
+    while (nSent < due) {
+      uint64_t t = bench_now();
+      for (int i = 0; i < 8; i++) {
+        payload[i] = (uint8_t) (t >> (56 - i * 8));
+      }
+      for (int i = 0; i < 4; i++) {
+        payload[8 + i] = (uint8_t) (seq >> (24 - i * 8));
+      }
+      ev.vscp_type = (uint16_t) (bench_opt.m_type + (seq % bench_opt.m_typeSpread));
+      ev.timestamp = (uint32_t) (t / 1000);
+      VSCPWrite(h, &ev, 0);
+      nSent++;
+      seq++;
+      if (bench_bRecord) {
+        nMeasured++;
+      }
+    }
+
+    usleep(500);
+  }
+
+  bench_bRecord       = false;
+  uint64_t cpuUsed    = bench_cpuTime() - cpuStart;
+  uint64_t drvUsed    = bench_driverCpuTime() - drvStart;
+  long rssEnd         = bench_getRSS();
+
+  // Let clients see the last events, then stop
+  usleep(500000);
+  bench_bQuit = true;
+
+  for (size_t i = 0; i < clients.size(); i++) {
+    if (BENCH_REST == clients[i]->m_protocol) {
+      if (clients[i]->m_thread) {
+        pthread_join(clients[i]->m_thread, NULL);
+      }
+    }
+    else if (NULL != clients[i]->m_conn) {
+      mg_close_connection(clients[i]->m_conn);
+    }
+  }
+
+  pthread_join(drainThread, NULL);
+
+  // Report
+  printf("\nInjected %" PRIu64 " events in %u s (%u/s), %" PRIu64 " measured\n",
+         nSent,
+         bench_opt.m_warmup + bench_opt.m_duration,
+         bench_opt.m_rate,
+         nMeasured);
+  printf("%-6s %8s %12s %12s %10s %10s %10s %10s\n", "proto", "clients", "received", "events/s", "p50 us", "p99 us", "p999 us", "max us");
+
+  uint64_t totalReceived = 0;
+  for (int protocol = 0; protocol < BENCH_COUNT; protocol++) {
+
+    std::vector<uint32_t> latency;
+    uint64_t received = 0;
+    int nClients      = 0;
+
+    for (size_t i = 0; i < clients.size(); i++) {
+      if (protocol == clients[i]->m_protocol) {
+        latency.insert(latency.end(), clients[i]->m_latency.begin(), clients[i]->m_latency.end());
+        received += clients[i]->m_received;
+        nClients++;
+      }
+    }
+
+    if (!nClients) {
+      continue;
+    }
+
+    std::sort(latency.begin(), latency.end());
+    totalReceived += received;
+
+    printf("%-6s %8d %12" PRIu64 " %12.0f %10u %10u %10u %10u\n",
+           bench_names[protocol],
+           nClients,
+           received,
+           (double) received / bench_opt.m_duration,
+           bench_percentile(latency, 0.5),
+           bench_percentile(latency, 0.99),
+           bench_percentile(latency, 0.999),
+           latency.empty() ? 0 : latency.back());
+  }
+
+  printf("\nCPU %.3f s total, driver and load generator\n", (double) cpuUsed / 1000000);
+  printf("CPU %.3f s driver, wsrv-* threads (%.2f us per injected event, %.2f us per delivered event)\n",
+         (double) drvUsed / 1000000,
+         nMeasured ? (double) drvUsed / nMeasured : 0.0,
+         totalReceived ? (double) drvUsed / totalReceived : 0.0);
+  printf("RSS %ld kB at start, %ld kB after open, %ld kB at end (end includes the load generator)\n",
+         rssStart,
+         rssOpen,
+         rssEnd);
+
+  for (size_t i = 0; i < clients.size(); i++) {
+    delete clients[i];
+  }
+
+  VSCPClose(h);
+
+  return 0;
+}
@@ -0,0 +1,442 @@
+// websrv-microbench.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+//
+// Microbenchmarks for the event conversion and filter functions on the
+// ws1, ws2 and REST paths. Each case is run until it has used at least
+// the minimum time and the time per call is reported.
+//
+// The REST event object is also encoded in each JSON based REST format
+// (JSON, CBOR, MessagePack). The encoded sizes are listed and each
+// encoding is decoded and compared with the original before the timed
+// cases run.
+//
+// The log cases time the per event log calls of the send path against
+// an async logger at info level with a null sink, set up like the
+// driver logger. A debug call is dropped by the level check, an info
+// call is formatted and queued.
+//
+// Usage: vscpl2drv-websrv-microbench [name-filter] [min-time-ms]
+//
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <restsrv.h>
+#include <vscp.h>
+#include <vscphelper.h>
+#include <webbuf.h>
+
+#include <json.hpp> // Needs C++11  -std=c++11
+
+#include <spdlog/async.h>
+#include <spdlog/sinks/null_sink.h>
+#include <spdlog/spdlog.h>
+
+using json = nlohmann::json;
+
+// Keeps results alive so the compiler can not remove the work
+static volatile size_t bench_sink;
+
+// Logger for the log cases
+static std::shared_ptr<spdlog::logger> bench_logger;
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_now
+//
+// Monotonic time in nanoseconds
+//
+
+static uint64_t
+bench_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_mix
+//
+// A test event in the different forms the conversions start from
+//
+
+struct bench_mix {
+  const char *m_name;
+  vscpEvent m_ev;
+  std::vector<uint8_t> m_data;
+  std::string m_str;  // ws1 string form
+  std::string m_json; // ws2 JSON form
+
+  json m_rest;                    // REST event object
+  std::string m_restJson;         // REST JSON form
+  std::vector<uint8_t> m_cbor;    // REST CBOR form
+  std::vector<uint8_t> m_msgpack; // REST MessagePack form
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_initMix
+//
+
+static void
+bench_initMix(bench_mix &mix, const char *name, uint16_t vscp_class, uint16_t vscp_type, const uint8_t *pdata, uint16_t size)
+{
+  mix.m_name = name;
+  mix.m_data.assign(pdata, pdata + size);
+
+  memset(&mix.m_ev, 0, sizeof(mix.m_ev));
+  mix.m_ev.head       = VSCP_PRIORITY_NORMAL;
+  mix.m_ev.vscp_class = vscp_class;
+  mix.m_ev.vscp_type  = vscp_type;
+  mix.m_ev.obid       = 1234;
+  mix.m_ev.timestamp  = 0x12345678;
+  mix.m_ev.year       = 2021;
+  mix.m_ev.month      = 6;
+  mix.m_ev.day        = 15;
+  mix.m_ev.hour       = 12;
+  mix.m_ev.minute     = 30;
+  mix.m_ev.second     = 15;
+  for (int i = 0; i < 16; i++) {
+    mix.m_ev.GUID[i] = (uint8_t) (0xF0 + i);
+  }
+  mix.m_ev.sizeData = size;
+  mix.m_ev.pdata    = mix.m_data.data();
+
+  vscp_convertEventToString(mix.m_str, &mix.m_ev);
+  vscp_convertEventToJSON(mix.m_json, &mix.m_ev);
+
+  restsrv_getEventJSON(mix.m_rest, &mix.m_ev);
+  mix.m_restJson = mix.m_rest.dump();
+  mix.m_cbor     = json::to_cbor(mix.m_rest);
+  mix.m_msgpack  = json::to_msgpack(mix.m_rest);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_case
+//
+
+typedef size_t (*bench_func)(bench_mix &mix);
+
+struct bench_case {
+  const char *m_name;
+  bench_func m_func;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Cases
+//
+
+static size_t
+bench_stringToEventEx(bench_mix &mix)
+{
+  vscpEventEx ex;
+  vscp_convertStringToEventEx(&ex, mix.m_str);
+  return ex.sizeData;
+}
+
+static size_t
+bench_jsonToEventEx(bench_mix &mix)
+{
+  vscpEventEx ex;
+  vscp_convertJSONToEventEx(&ex, mix.m_json);
+  return ex.sizeData;
+}
+
+static size_t
+bench_eventToString(bench_mix &mix)
+{
+  std::string str;
+  vscp_convertEventToString(str, &mix.m_ev);
+  return str.length();
+}
+
+static size_t
+bench_eventToJSON(bench_mix &mix)
+{
+  std::string str;
+  vscp_convertEventToJSON(str, &mix.m_ev);
+  return str.length();
+}
+
+static size_t
+bench_filterPass(bench_mix &mix)
+{
+  vscpEventFilter filter;
+  vscp_clearVSCPFilter(&filter);
+  filter.filter_class = mix.m_ev.vscp_class;
+  filter.mask_class   = 0xffff;
+  filter.filter_type  = mix.m_ev.vscp_type;
+  filter.mask_type    = 0xffff;
+  return vscp_doLevel2Filter(&mix.m_ev, &filter);
+}
+
+static size_t
+bench_filterReject(bench_mix &mix)
+{
+  vscpEventFilter filter;
+  vscp_clearVSCPFilter(&filter);
+  filter.filter_class = (uint16_t) (mix.m_ev.vscp_class + 1);
+  filter.mask_class   = 0xffff;
+  return vscp_doLevel2Filter(&mix.m_ev, &filter);
+}
+
+static size_t
+bench_restXML(bench_mix &mix)
+{
+  CWebBuffer buf;
+  restsrv_appendEventXML(buf, &mix.m_ev);
+  return buf.size();
+}
+
+static size_t
+bench_restCSV(bench_mix &mix)
+{
+  CWebBuffer buf;
+  restsrv_appendEventCSV(buf, &mix.m_ev);
+  return buf.size();
+}
+
+static size_t
+bench_restJSON(bench_mix &mix)
+{
+  json ev;
+  restsrv_getEventJSON(ev, &mix.m_ev);
+  return ev.dump().length();
+}
+
+static size_t
+bench_restJSONEncode(bench_mix &mix)
+{
+  return mix.m_rest.dump().length();
+}
+
+static size_t
+bench_restCBOREncode(bench_mix &mix)
+{
+  return json::to_cbor(mix.m_rest).size();
+}
+
+static size_t
+bench_restMsgpackEncode(bench_mix &mix)
+{
+  return json::to_msgpack(mix.m_rest).size();
+}
+
+static size_t
+bench_restJSONDecode(bench_mix &mix)
+{
+  return json::parse(mix.m_restJson).size();
+}
+
+static size_t
+bench_restCBORDecode(bench_mix &mix)
+{
+  return json::from_cbor(mix.m_cbor).size();
+}
+
+static size_t
+bench_restMsgpackDecode(bench_mix &mix)
+{
+  return json::from_msgpack(mix.m_msgpack).size();
+}
+
+static size_t
+bench_logDebug(bench_mix &mix)
+{
+  bench_logger->debug("[ws] Received ws event {}", mix.m_str);
+  return 1;
+}
+
+static size_t
+bench_logInfo(bench_mix &mix)
+{
+  bench_logger->info("[ws] Received ws event {}", mix.m_str);
+  return 1;
+}
+
+static bench_case bench_cases[] = { { "ws1_string_to_eventex", bench_stringToEventEx },
+                                    { "ws2_json_to_eventex", bench_jsonToEventEx },
+                                    { "event_to_string", bench_eventToString },
+                                    { "event_to_json", bench_eventToJSON },
+                                    { "level2_filter_pass", bench_filterPass },
+                                    { "level2_filter_reject", bench_filterReject },
+                                    { "rest_xml", bench_restXML },
+                                    { "rest_csv", bench_restCSV },
+                                    { "rest_json", bench_restJSON },
+                                    { "rest_json_encode", bench_restJSONEncode },
+                                    { "rest_cbor_encode", bench_restCBOREncode },
+                                    { "rest_msgpack_encode", bench_restMsgpackEncode },
+                                    { "rest_json_decode", bench_restJSONDecode },
+                                    { "rest_cbor_decode", bench_restCBORDecode },
+                                    { "rest_msgpack_decode", bench_restMsgpackDecode },
+                                    { "log_debug_at_info", bench_logDebug },
+                                    { "log_info_at_info", bench_logInfo } };
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_checkFormats
+//
+// List the size of the REST event object in each format and check that
+// each decodes back to the same object. Returns false on a mismatch.
+//
+
+static bool
+bench_checkFormats(bench_mix *mixes, size_t cnt)
+{
+  bool rv = true;
+
+  printf("%-40s %10s %10s %10s\n", "REST event size (bytes)", "JSON", "CBOR", "MsgPack");
+  printf("------------------------------------------------------------------------\n");
+
+  for (size_t m = 0; m < cnt; m++) {
+
+    bench_mix &mix = mixes[m];
+    printf("%-40s %10zu %10zu %10zu\n", mix.m_name, mix.m_restJson.length(), mix.m_cbor.size(), mix.m_msgpack.size());
+
+    if (json::parse(mix.m_restJson) != mix.m_rest) {
+      printf("  JSON round trip failed for %s\n", mix.m_name);
+      rv = false;
+    }
+
+    if (json::from_cbor(mix.m_cbor) != mix.m_rest) {
+      printf("  CBOR round trip failed for %s\n", mix.m_name);
+      rv = false;
+    }
+
+    if (json::from_msgpack(mix.m_msgpack) != mix.m_rest) {
+      printf("  MessagePack round trip failed for %s\n", mix.m_name);
+      rv = false;
+    }
+  }
+
+  printf("\n");
+
+  return rv;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// bench_run
+//
+// Run a case with an increasing number of iterations until it has used
+// at least minTime ns. Returns ns per call.
+//
+
+static double
+bench_run(bench_case &bc, bench_mix &mix, uint64_t minTime, uint64_t &iterations)
+{
+  uint64_t elapsed = 0;
+  size_t sink      = 0;
+
+  iterations = 1;
+  for (;;) {
+
+    uint64_t start = bench_now();
+    for (uint64_t i = 0; i < iterations; i++) {
+      sink += bc.m_func(mix);
+    }
+    elapsed = bench_now() - start;
+
+    if ((elapsed >= minTime) || (iterations >= (1ULL << 40))) {
+      break;
+    }
+
+    // Aim a bit above the minimum time on the next run
+    uint64_t next = elapsed ? (iterations * minTime * 14 / 10 / elapsed) : (iterations * 10);
+    iterations    = std::max(next, iterations * 2);
+  }
+
+  bench_sink = sink;
+  return (double) elapsed / iterations;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// main
+//
+
+int
+main(int argc, char **argv)
+{
+  const char *pfilter = (argc > 1) ? argv[1] : NULL;
+  uint64_t minTime    = (uint64_t) ((argc > 2) ? strtoul(argv[2], NULL, 0) : 500) * 1000000;
+
+  // Measurement: CLASS1.MEASUREMENT temperature, normalized integer
+  const uint8_t measurement[] = { 0x89, 0x82, 0x10, 0x47 };
+
+  // HLO: CLASS2.HLO with a short JSON command
+  const char *hlo = "{\"op\":\"set\",\"name\":\"relay1\",\"value\":true}";
+
+  // Max size level II payload in a (made up) level II class
+  uint8_t maxsize[VSCP_LEVEL2_MAXDATA];
+  for (int i = 0; i < VSCP_LEVEL2_MAXDATA; i++) {
+    maxsize[i] = (uint8_t) i;
+  }
+
+  bench_mix mixes[3];
+  bench_initMix(mixes[0], "measurement", VSCP_CLASS1_MEASUREMENT, 6, measurement, sizeof(measurement));
+  bench_initMix(mixes[1], "hlo", VSCP_CLASS2_HLO, 1, (const uint8_t *) hlo, (uint16_t) strlen(hlo));
+  bench_initMix(mixes[2], "maxsize", 2000, 1, maxsize, sizeof(maxsize));
+
+  if (!bench_checkFormats(mixes, sizeof(mixes) / sizeof(mixes[0]))) {
+    return 1;
+  }
+
+  // Same kind of logger as the driver uses. Overrun so a sink that can
+  // not keep up never blocks the timed calls.
+  spdlog::init_thread_pool(8192, 1);
+  std::shared_ptr<spdlog::sinks::null_sink_mt> null_sink = std::make_shared<spdlog::sinks::null_sink_mt>();
+  bench_logger = std::make_shared<spdlog::async_logger>("bench",
+                                                        null_sink,
+                                                        spdlog::thread_pool(),
+                                                        spdlog::async_overflow_policy::overrun_oldest);
+  bench_logger->set_level(spdlog::level::info);
+
+  printf("%-40s %14s %12s\n", "Benchmark", "Iterations", "ns/call");
+  printf("------------------------------------------------------------------------\n");
+
+  for (size_t i = 0; i < sizeof(bench_cases) / sizeof(bench_cases[0]); i++) {
+    for (size_t m = 0; m < sizeof(mixes) / sizeof(mixes[0]); m++) {
+
+      std::string name = std::string(bench_cases[i].m_name) + "/" + mixes[m].m_name;
+      if ((NULL != pfilter) && (std::string::npos == name.find(pfilter))) {
+        continue;
+      }
+
+      uint64_t iterations;
+      double ns = bench_run(bench_cases[i], mixes[m], minTime, iterations);
+      printf("%-40s %14" PRIu64 " %12.1f\n", name.c_str(), iterations, ns);
+    }
+  }
+
+  return 0;
+}
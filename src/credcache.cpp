@@ -0,0 +1,220 @@
+// credcache.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <string.h>
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+#include "credcache.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// CCredentialCache
+//
+
+CCredentialCache::CCredentialCache(void)
+{
+  m_ttl        = CREDCACHE_DEFAULT_TTL;
+  m_maxEntries = CREDCACHE_DEFAULT_MAX_ENTRIES;
+
+  // Without a random key the cache is not used
+  if (1 != RAND_bytes(m_key, sizeof(m_key))) {
+    m_ttl = 0;
+  }
+
+  pthread_mutex_init(&m_mutex, NULL);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CCredentialCache
+//
+
+CCredentialCache::~CCredentialCache()
+{
+  memset(m_key, 0, sizeof(m_key));
+  pthread_mutex_destroy(&m_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setParameters
+//
+
+void
+CCredentialCache::setParameters(uint32_t ttl, size_t maxEntries)
+{
+  pthread_mutex_lock(&m_mutex);
+  m_ttl        = ttl;
+  m_maxEntries = maxEntries;
+  m_cache.clear();
+  pthread_mutex_unlock(&m_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getDigest
+//
+
+bool
+CCredentialCache::getDigest(std::string &digest,
+                            const std::string &user,
+                            const std::string &credentials,
+                            const std::string &storedHash)
+{
+  uint8_t mac[EVP_MAX_MD_SIZE];
+  unsigned int maclen = 0;
+
+  // Fields are separated with a null so they can't be shifted into
+  // each other
+  std::string data = user;
+  data += '\0';
+  data += credentials;
+  data += '\0';
+  data += storedHash;
+
+  if (NULL == HMAC(EVP_sha256(),
+                   m_key,
+                   sizeof(m_key),
+                   (const unsigned char *) data.c_str(),
+                   data.length(),
+                   mac,
+                   &maclen)) {
+    return false;
+  }
+
+  digest.assign((const char *) mac, maclen);
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// isValid
+//
+
+bool
+CCredentialCache::isValid(const std::string &user,
+                          const std::string &credentials,
+                          const std::string &storedHash)
+{
+  std::string digest;
+  bool rv = false;
+
+  if (!m_ttl || !getDigest(digest, user, credentials, storedHash)) {
+    return false;
+  }
+
+  pthread_mutex_lock(&m_mutex);
+
+  std::map<std::string, time_t>::iterator it = m_cache.find(digest);
+  if (it != m_cache.end()) {
+    if (time(NULL) < it->second) {
+      rv = true;
+    }
+    else {
+      m_cache.erase(it);
+    }
+  }
+
+  pthread_mutex_unlock(&m_mutex);
+
+  return rv;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// add
+//
+
+void
+CCredentialCache::add(const std::string &user,
+                      const std::string &credentials,
+                      const std::string &storedHash)
+{
+  std::string digest;
+
+  if (!m_ttl || !m_maxEntries ||
+      !getDigest(digest, user, credentials, storedHash)) {
+    return;
+  }
+
+  time_t now = time(NULL);
+
+  pthread_mutex_lock(&m_mutex);
+
+  if ((m_cache.size() >= m_maxEntries) && (m_cache.end() == m_cache.find(digest))) {
+
+    // Remove expired entries and find the one that expires first
+    std::map<std::string, time_t>::iterator oldest = m_cache.end();
+    std::map<std::string, time_t>::iterator it     = m_cache.begin();
+    while (it != m_cache.end()) {
+      if (now >= it->second) {
+        m_cache.erase(it++);
+      }
+      else {
+        if ((m_cache.end() == oldest) || (it->second < oldest->second)) {
+          oldest = it;
+        }
+        ++it;
+      }
+    }
+
+    // Still full, make room
+    if ((m_cache.size() >= m_maxEntries) && (m_cache.end() != oldest)) {
+      m_cache.erase(oldest);
+    }
+  }
+
+  m_cache[digest] = now + m_ttl;
+
+  pthread_mutex_unlock(&m_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// clear
+//
+
+void
+CCredentialCache::clear(void)
+{
+  pthread_mutex_lock(&m_mutex);
+  m_cache.clear();
+  pthread_mutex_unlock(&m_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// size
+//
+
+size_t
+CCredentialCache::size(void)
+{
+  size_t cnt;
+
+  pthread_mutex_lock(&m_mutex);
+  cnt = m_cache.size();
+  pthread_mutex_unlock(&m_mutex);
+
+  return cnt;
+}
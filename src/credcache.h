@@ -0,0 +1,134 @@
+// credcache.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(CREDCACHE_H__INCLUDED_)
+#define CREDCACHE_H__INCLUDED_
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <map>
+#include <string>
+
+// Default number of seconds a successful verification is remembered
+#define CREDCACHE_DEFAULT_TTL 300
+
+// Default max number of cached verifications
+#define CREDCACHE_DEFAULT_MAX_ENTRIES 256
+
+/*!
+  Cache for successful credential verifications.
+
+  Password verification uses a deliberately slow key derivation. A
+  client that logs in again and again with the same credentials
+  only pays for it once every ttl seconds.
+
+  Only a keyed digest of user, credentials and the stored password
+  hash is kept, never the credentials themselves. A changed password
+  therefore never matches an old entry. Failed verifications are
+  never cached.
+*/
+
+class CCredentialCache {
+
+public:
+  CCredentialCache(void);
+  ~CCredentialCache();
+
+  /*!
+    Set cache parameters. Clears the cache.
+    @param ttl Seconds a verification is remembered. Zero disables the cache.
+    @param maxEntries Max number of entries held.
+  */
+  void setParameters(uint32_t ttl, size_t maxEntries);
+
+  /*!
+    Check if a verification of these credentials is cached
+    @param user User name
+    @param credentials Credentials as given to the password check
+    @param storedHash Stored password hash for the user
+    @return true if a valid (not expired) entry is found.
+  */
+  bool isValid(const std::string &user,
+               const std::string &credentials,
+               const std::string &storedHash);
+
+  /*!
+    Remember a successful verification
+    @param user User name
+    @param credentials Credentials as given to the password check
+    @param storedHash Stored password hash for the user
+  */
+  void add(const std::string &user,
+           const std::string &credentials,
+           const std::string &storedHash);
+
+  /*!
+    Forget all cached verifications. Must be called when the
+    user list changes.
+  */
+  void clear(void);
+
+  /*!
+    Number of entries in the cache
+  */
+  size_t size(void);
+
+private:
+  // Disable copy
+  CCredentialCache(const CCredentialCache &);
+  CCredentialCache &operator=(const CCredentialCache &);
+
+  /*!
+    Calculate the cache key for a set of credentials
+    @return false if the digest could not be calculated.
+  */
+  bool getDigest(std::string &digest,
+                 const std::string &user,
+                 const std::string &credentials,
+                 const std::string &storedHash);
+
+  /// Protects the cache
+  pthread_mutex_t m_mutex;
+
+  /// Seconds an entry is valid (zero disables the cache)
+  uint32_t m_ttl;
+
+  /// Max number of entries
+  size_t m_maxEntries;
+
+  /// Random per process key for the digest
+  uint8_t m_key[32];
+
+  /// digest -> expiry time
+  std::map<std::string, time_t> m_cache;
+};
+
+#endif
@@ -32,6 +32,8 @@
 #include <winsock2.h>
 #endif
 
+#include <algorithm>
+#include <deque>
 #include <list>
 #include <string>
 
@@ -54,6 +56,8 @@
 #include <vscphelper.h>
 #include <vscpremotetcpif.h>
 #include <webdefs.h>
+#include <webmeasure.h>
+#include <webobj.h>
 
 #include <json.hpp> // Needs C++11  -std=c++11
 #include <mustache.hpp>
@@ -67,10 +71,30 @@
 using json = nlohmann::json;
 using namespace kainjow::mustache;
 
+///////////////////////////////////////////////////////////////////////////////
+// get_js_Prop
+//
+// Push a property of the object on top of the stack. Events from
+// vscp_getEvent(s) use the vscp_convertEventToJSON names (vscpClass,
+// vscpData, ...), events built by a script the short names (class,
+// data, ...). The first name that is defined is used.
+//
+
+static void
+get_js_Prop(duk_context* ctx, const char* name, const char* altname)
+{
+  duk_get_prop_string(ctx, -1, name);
+  if (duk_is_undefined(ctx, -1)) {
+    duk_pop(ctx);
+    duk_get_prop_string(ctx, -1, altname);
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // get_js_Event
 //
-// Make event from JSON data object on stack
+// Make event from JSON data object on stack. Date/time is taken from
+// the event and is set to now only if the event has none.
 //
 
 bool
@@ -89,8 +113,7 @@ get_js_Event(duk_context* ctx, vscpEventEx* pex)
 
   // get Head
   pex->head = 0;
-  duk_push_string(ctx, "head");
-  duk_get_prop(ctx, -2);
+  get_js_Prop(ctx, "vscpHead", "head");
   if (duk_is_number(ctx, -1)) {
     pex->head = (uint16_t)duk_get_int_default(ctx, -1, VSCP_PRIORITY_NORMAL);
   }
@@ -98,8 +121,7 @@ get_js_Event(duk_context* ctx, vscpEventEx* pex)
 
   // get timestamp
   pex->timestamp = 0;
-  duk_push_string(ctx, "timestamp");
-  duk_get_prop(ctx, -2);
+  get_js_Prop(ctx, "vscpTimeStamp", "timestamp");
   if (duk_is_number(ctx, -1)) {
     pex->timestamp = (uint32_t)duk_get_number_default(ctx, -1, 0);
   }
@@ -107,8 +129,7 @@ get_js_Event(duk_context* ctx, vscpEventEx* pex)
 
   // get obid
   pex->obid = 0;
-  duk_push_string(ctx, "obid");
-  duk_get_prop(ctx, -2);
+  get_js_Prop(ctx, "vscpObId", "obid");
   if (duk_is_number(ctx, -1)) {
     pex->obid = (uint32_t)duk_get_number_default(ctx, -1, 0);
   }
@@ -116,8 +137,7 @@ get_js_Event(duk_context* ctx, vscpEventEx* pex)
 
   // get VSCP class
   pex->vscp_class = 0;
-  duk_push_string(ctx, "class");
-  duk_get_prop(ctx, -2);
+  get_js_Prop(ctx, "vscpClass", "class");
   if (duk_is_number(ctx, -1)) {
     pex->vscp_class = (uint16_t)duk_get_int_default(ctx, -1, 0);
   }
@@ -125,8 +145,7 @@ get_js_Event(duk_context* ctx, vscpEventEx* pex)
 
   // get VSCP type
   pex->vscp_type = 0;
-  duk_push_string(ctx, "type");
-  duk_get_prop(ctx, -2);
+  get_js_Prop(ctx, "vscpType", "type");
   if (duk_is_number(ctx, -1)) {
     pex->vscp_type = (uint16_t)duk_get_int_default(ctx, -1, 0);
   }
@@ -134,8 +153,7 @@ get_js_Event(duk_context* ctx, vscpEventEx* pex)
 
   // GUID
   memset(pex->GUID, 0, 16);
-  duk_push_string(ctx, "guid");
-  duk_get_prop(ctx, -2);
+  get_js_Prop(ctx, "vscpGuid", "guid");
   if (duk_is_string(ctx, -1)) {
     const char* pGUID =
       duk_get_string_default(ctx,
@@ -148,8 +166,7 @@ get_js_Event(duk_context* ctx, vscpEventEx* pex)
   // get time(block)
   vscpdatetime dt;
   vscp_setEventExDateTimeBlockToNow(pex);
-  duk_push_string(ctx, "time");
-  duk_get_prop(ctx, -2);
+  get_js_Prop(ctx, "vscpDateTime", "time");
   if (duk_is_string(ctx, -1)) {
     const char* pTime = duk_get_string_default(ctx, -1, "");
     if (dt.set(pTime)) {
@@ -174,8 +191,7 @@ get_js_Event(duk_context* ctx, vscpEventEx* pex)
   // get data
   pex->sizeData = 0;
   memset(pex->data, 0, VSCP_MAX_DATA);
-  duk_push_string(ctx, "data");
-  duk_get_prop(ctx, -2);
+  get_js_Prop(ctx, "vscpData", "data");
 
   if (duk_is_array(ctx, -1)) {
     int lengthArray = duk_get_length(ctx, -1);
@@ -327,6 +343,32 @@ js_vscp_sleep(duk_context* ctx)
   return JAVASCRIPT_OK;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// js_vscp_getScriptClient
+//
+// Client item and web object of the running script
+//
+
+static CClientItem*
+js_vscp_getScriptClient(duk_context* ctx, CWebObj** ppObj)
+{
+  duk_push_global_object(ctx); /* -> stack: [ global ] */
+  duk_push_string(
+    ctx,
+    "vscp_clientitem");  /* -> stack: [ global "vscp_clientItem" ] */
+  duk_get_prop(ctx, -2); /* -> stack: [ global vscp_clientItem ] */
+  CClientItem* pClientItem = (CClientItem*)duk_get_pointer(ctx, -1);
+  duk_pop_n(ctx, 2);
+
+  duk_push_global_object(ctx);         /* -> stack: [ global ] */
+  duk_push_string(ctx, "vscp_webobj"); /* -> stack: [ global "vscp_webobj" ] */
+  duk_get_prop(ctx, -2);               /* -> stack: [ global vscp_webobj ] */
+  *ppObj = (CWebObj*)duk_get_pointer(ctx, -1);
+  duk_pop_n(ctx, 2);
+
+  return pClientItem;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // js_vscp_sendEvent
 //
@@ -372,40 +414,42 @@ js_vscp_sendEvent(duk_context* ctx)
   pEvent->pdata = NULL;
   vscp_convertEventExToEvent(pEvent, &ex);
 
-  duk_push_global_object(ctx); /* -> stack: [ global ] */
-  duk_push_string(
-    ctx,
-    "vscp_clientitem");  /* -> stack: [ global "vscp_clientItem" ] */
-  duk_get_prop(ctx, -2); /* -> stack: [ global vscp_clientItem ] */
-  CClientItem* pClientItem = (CClientItem*)duk_get_pointer(ctx, -1);
-  if (NULL == pClientItem) {
+  CWebObj* pObj;
+  CClientItem* pClientItem = js_vscp_getScriptClient(ctx, &pObj);
+  if ((NULL == pClientItem) || (NULL == pObj)) {
+    vscp_deleteEvent_v2(&pEvent);
     duk_push_boolean(ctx, 0); // return code false
     return JAVASCRIPT_OK;
   }
-  duk_pop_n(ctx, 2);
 
-    // duk_push_global_object(ctx); /* -> stack: [ global ]   TODO: Check */
-    // duk_push_string(ctx, "vscp_webobj"); /* -> stack: [ global "web object" ] */
-    // duk_get_prop(ctx, -2);     /* -> stack: [ global vscp_webobj ] */
-    // CWebObj* pObj= (CWebObj*)duk_get_pointer(ctx, -1);
-    // if (NULL == pObj) {
-    //     duk_push_boolean(ctx, 0); // return code false
-    //     return JAVASCRIPT_OK;
-    // }
+  // Mark the event as coming from the script client.
+  // The receive queue owns the event from here.
+  pEvent->obid = pClientItem->m_clientID;
+  if (!pObj->eventToReceiveQueue(pEvent)) {
+    // Failed to send event
+    duk_push_boolean(ctx, 0); // return code false
+    return JAVASCRIPT_OK;
+  }
 
-    // duk_pop_n(ctx, 2);
+  duk_push_boolean(ctx, 1); // return code success
+  return JAVASCRIPT_OK;
+}
 
-//   if (!pObj->sendEvent(pEvent)) {
-//     // Failed to send event
-//     vscp_deleteEvent_v2(&pEvent);
-//     duk_push_boolean(ctx, 0); // return code false
-//     return JAVASCRIPT_OK;
-//   }
+///////////////////////////////////////////////////////////////////////////////
+// js_vscp_pushEvent
+//
+// Push event as a JSON object and delete it
+//
 
+static void
+js_vscp_pushEvent(duk_context* ctx, vscpEvent* pEvent)
+{
+  std::string strResult;
+  vscp_convertEventToJSON(strResult, pEvent);
   vscp_deleteEvent_v2(&pEvent);
 
-  duk_push_boolean(ctx, 1); // return code success
-  return JAVASCRIPT_OK;
+  duk_push_string(ctx, (const char*)strResult.c_str());
+  duk_json_decode(ctx, -1);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -415,76 +459,55 @@ js_vscp_sendEvent(duk_context* ctx)
 duk_ret_t
 js_vscp_getEvent(duk_context* ctx)
 {
-  duk_push_global_object(ctx); /* -> stack: [ global ] */
-  duk_push_string(
-    ctx,
-    "vscp_clientitem");  /* -> stack: [ global "vscp_clientItem" ] */
-  duk_get_prop(ctx, -2); /* -> stack: [ global vscp_clientItem ] */
-  CClientItem* pClientItem = (CClientItem*)duk_get_pointer(ctx, -1);
-  if (NULL == pClientItem) {
+  CWebObj* pObj;
+  CClientItem* pClientItem = js_vscp_getScriptClient(ctx, &pObj);
+  if ((NULL == pClientItem) || (NULL == pObj)) {
     duk_push_boolean(ctx, 0); // return code false
     return JAVASCRIPT_OK;
   }
-  duk_pop_n(ctx, 2);
 
-try_again:
-
-  // Check the client queue
-  if (pClientItem->m_bOpen && pClientItem->m_clientInputQueue.size()) {
-
-    vscpEvent* pEvent;
-
-    pthread_mutex_lock(&pClientItem->m_mutexClientInputQueue);
-    pEvent = pClientItem->m_clientInputQueue.front();
-    pClientItem->m_clientInputQueue.pop_front();
-
-    if (NULL == pEvent) {
-
-      // Exception
-      duk_push_null(ctx); // return code failure
-      return JAVASCRIPT_OK;
-    }
-
-    pthread_mutex_unlock(&pClientItem->m_mutexClientInputQueue);
-
-    if (NULL != pEvent) {
-
-      if (vscp_doLevel2Filter(pEvent, &pClientItem->m_filter)) {
-
-        // Write it out
+  std::deque<vscpEvent*> events;
+  if (!pObj->getClientEvents(pClientItem, events, 1, 0)) {
+    duk_push_null(ctx); // No event available
+    return JAVASCRIPT_OK;
+  }
 
-        std::string strResult;
-        vscp_convertEventToJSON(strResult, pEvent);
-        // Event is not needed anymore
-        vscp_deleteEvent(pEvent);
-        duk_push_string(ctx, (const char*)strResult.c_str());
-        duk_json_decode(ctx, -1);
+  js_vscp_pushEvent(ctx, events.front());
+  return JAVASCRIPT_OK;
+}
 
-        // All OK return event
-        return JAVASCRIPT_OK;
-      }
-      else {
-        // Filtered out
-        vscp_deleteEvent(pEvent);
-        goto try_again;
-      }
+///////////////////////////////////////////////////////////////////////////////
+// js_vscp_getEvents
+//
+// vscp_getEvents(max, timeout)
+//
 
-      // Remove the event
-      vscp_deleteEvent(pEvent);
+duk_ret_t
+js_vscp_getEvents(duk_context* ctx)
+{
+  CWebObj* pObj;
+  CClientItem* pClientItem = js_vscp_getScriptClient(ctx, &pObj);
+  if ((NULL == pClientItem) || (NULL == pObj)) {
+    duk_push_boolean(ctx, 0); // return code false
+    return JAVASCRIPT_OK;
+  }
 
-    } // Valid pEvent pointer
-    else {
-      // NULL event
-      duk_push_null(ctx); // return code failure
-      return JAVASCRIPT_OK;
-    }
+  size_t max       = duk_get_uint_default(ctx, 0, 1);
+  uint32_t timeout = duk_get_uint_default(ctx, 1, 0);
+  max              = std::max((size_t)1, std::min(max, (size_t)WEBFLOW_SCRIPT_MAX_EVENTS));
+  timeout          = std::min(timeout, (uint32_t)WEBFLOW_SCRIPT_MAX_WAIT);
 
-  } // events available
+  std::deque<vscpEvent*> events;
+  pObj->getClientEvents(pClientItem, events, max, timeout);
 
-  // int nArgs = duk_get_top(ctx);
+  duk_idx_t arr = duk_push_array(ctx);
+  duk_uarridx_t idx = 0;
+  while (!events.empty()) {
+    js_vscp_pushEvent(ctx, events.front());
+    events.pop_front();
+    duk_put_prop_index(ctx, arr, idx++);
+  }
 
-  // Fail
-  duk_push_null(ctx); // return code failure
   return JAVASCRIPT_OK;
 }
 
@@ -498,24 +521,18 @@ js_vscp_getCountEvent(duk_context* ctx)
 {
   int count = 0;
 
-  duk_push_global_object(ctx); /* -> stack: [ global ] */
-  duk_push_string(
-    ctx,
-    "vscp_clientitem");  /* -> stack: [ global "vscp_clientItem" ] */
-  duk_get_prop(ctx, -2); /* -> stack: [ global vscp_clientItem ] */
-  CClientItem* pClientItem = (CClientItem*)duk_get_pointer(ctx, -1);
+  CWebObj* pObj;
+  CClientItem* pClientItem = js_vscp_getScriptClient(ctx, &pObj);
   if (NULL == pClientItem) {
     duk_push_boolean(ctx, 0); // return code false
     return JAVASCRIPT_OK;
   }
-  duk_pop_n(ctx, 2);
 
+  pthread_mutex_lock(&pClientItem->m_mutexClientInputQueue);
   if (pClientItem->m_bOpen) {
     count = pClientItem->m_clientInputQueue.size();
   }
-  else {
-    count = 0;
-  }
+  pthread_mutex_unlock(&pClientItem->m_mutexClientInputQueue);
 
   duk_push_number(ctx, count); // return count
   return JAVASCRIPT_OK;
@@ -633,7 +650,9 @@ js_vscp_setFilter(duk_context* ctx)
   duk_pop(ctx);
 
   // Set the filter
+  pthread_mutex_lock(&pClientItem->m_mutexClientInputQueue);
   vscp_copyVSCPFilter(&pClientItem->m_filter, &filter);
+  pthread_mutex_unlock(&pClientItem->m_mutexClientInputQueue);
 
   duk_push_boolean(ctx, 1); // return code success
   return JAVASCRIPT_OK;
@@ -1101,6 +1120,72 @@ js_get_MeasurementSubZone(duk_context* ctx)
   return JAVASCRIPT_OK;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// js_vscp_decodeMeasurements
+//
+// vscp_decodeMeasurements(events)
+//
+// events is an array of event objects as returned by vscp_getEvents.
+// A record is returned for each event that is a measurement. Its
+// index is the position of the event in the events array.
+//
+
+duk_ret_t
+js_vscp_decodeMeasurements(duk_context* ctx)
+{
+  if (!duk_is_array(ctx, 0)) {
+    duk_push_null(ctx); // return code false
+    return JAVASCRIPT_OK;
+  }
+
+  duk_size_t cnt = duk_get_length(ctx, 0);
+  if (cnt > WEBMEASURE_MAX_EVENTS) {
+    duk_push_null(ctx); // return code false
+    return JAVASCRIPT_OK;
+  }
+
+  duk_idx_t arr     = duk_push_array(ctx);
+  duk_uarridx_t idx = 0;
+
+  vscpEventEx ex;
+  webmeasure_record rec;
+  for (duk_size_t i = 0; i < cnt; i++) {
+
+    duk_get_prop_index(ctx, 0, (duk_uarridx_t)i);
+    bool bOk = get_js_Event(ctx, &ex) && webmeasure_decodeEx(ex, rec);
+    duk_pop(ctx);
+
+    if (!bOk) {
+      continue;
+    }
+
+    duk_push_object(ctx);
+    duk_push_number(ctx, (double)i);
+    duk_put_prop_string(ctx, -2, "index");
+    duk_push_int(ctx, rec.m_class);
+    duk_put_prop_string(ctx, -2, "class");
+    duk_push_int(ctx, rec.m_type);
+    duk_put_prop_string(ctx, -2, "type");
+    duk_push_number(ctx, rec.m_value);
+    duk_put_prop_string(ctx, -2, "value");
+    duk_push_int(ctx, rec.m_unit);
+    duk_put_prop_string(ctx, -2, "unit");
+    duk_push_int(ctx, rec.m_sensorIndex);
+    duk_put_prop_string(ctx, -2, "sensorindex");
+    duk_push_int(ctx, rec.m_zone);
+    duk_put_prop_string(ctx, -2, "zone");
+    duk_push_int(ctx, rec.m_subZone);
+    duk_put_prop_string(ctx, -2, "subzone");
+    duk_push_number(ctx, rec.m_timestamp);
+    duk_put_prop_string(ctx, -2, "timestamp");
+    duk_push_string(ctx, rec.m_datetime);
+    duk_put_prop_string(ctx, -2, "datetime");
+    duk_put_prop_index(ctx, arr, idx++);
+  }
+
+  return JAVASCRIPT_OK;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // js_tcpip_connect
 //
@@ -135,6 +135,17 @@ js_vscp_sendEvent(duk_context *ctx);
 duk_ret_t
 js_vscp_getEvent(duk_context *ctx);
 
+/*!
+ * Fetch events from the local client queue. Waits for events if
+ * the queue is empty.
+ *
+ *  JavaScript Parameter 0: Max number of events (default 1)
+ *  JavaScript Parameter 1: Max time to wait in milliseconds (default 0)
+ *  JavaScript: Return: Array of events as JSON objects, empty on timeout
+ */
+duk_ret_t
+js_vscp_getEvents(duk_context *ctx);
+
 /*!
  * Return number of events in the local client queue
  *
@@ -205,4 +216,15 @@ js_get_MeasurementZone(duk_context *ctx);
 duk_ret_t
 js_get_MeasurementSubZone(duk_context *ctx);
 
+/*!
+ * Decode a batch of measurement events in one call
+ *
+ *  JavaScript Parameter 0: Array of events as JSON objects
+ *  JavaScript: Return: Array with a record for each measurement event
+ *              with index, class, type, value, unit, sensorindex, zone,
+ *              subzone, timestamp and datetime. NULL on error.
+ */
+duk_ret_t
+js_vscp_decodeMeasurements(duk_context *ctx);
+
 #endif
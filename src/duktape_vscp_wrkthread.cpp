@@ -58,6 +58,8 @@ actionJavascriptObj::actionJavascriptObj(std::string &strScript)
 {
     // OutputDebugString( "actionThreadURL: Create");
     m_strScript = strScript; // Script to execute
+    m_pClientItem = NULL;
+    pParent       = NULL;
 }
 
 actionJavascriptObj::~actionJavascriptObj() {}
@@ -83,136 +85,64 @@ actionJavascriptThread(void *pData)
 
     pActionObj->m_start = vscpdatetime::Now(); // Mark start time
 
-    // Create new JavaScript context
-    duk_context *ctx = duk_create_heap_default();
+    // Get a heap from the pool and a fresh global environment
+    // in it with the VSCP methods already set
+    duk_context *heap = pObj->m_jsPool.acquire();
 
     // Check if OK
-    if (!ctx) {
+    if (!heap) {
         // Failure
         return NULL;
     }
 
-    // Helpers
-    duk_push_c_function(ctx, js_vscp_print, 1);
-    duk_put_global_string(ctx, "print");
-
-    // External module support
-    duk_push_object(ctx);
-    duk_push_c_function(ctx, js_resolve_module, DUK_VARARGS);
-    duk_put_prop_string(ctx, -2, "resolve");
-    duk_push_c_function(ctx, js_load_module, DUK_VARARGS);
-    duk_put_prop_string(ctx, -2, "load");
-    //duk_module_node_init(ctx);  // TODO: external module support
-
-    // Add VSCP methods
-    duk_push_c_function(ctx, js_vscp_log, DUK_VARARGS);
-    duk_put_global_string(ctx, "vscp_log");
-
-    duk_push_c_function(ctx, js_vscp_sleep, 1);
-    duk_put_global_string(ctx, "vscp_sleep");
-
-    duk_push_c_function(ctx, js_vscp_sendEvent, 1);
-    duk_put_global_string(ctx, "vscp_sendEvent");
-
-    duk_push_c_function(ctx, js_vscp_getEvent, 1);
-    duk_put_global_string(ctx, "vscp_receiveEvent");
-
-    duk_push_c_function(ctx, js_vscp_getCountEvent, 1);
-    duk_put_global_string(ctx, "vscp_countEvent");
-
-    duk_push_c_function(ctx, js_vscp_setFilter, 1);
-    duk_put_global_string(ctx, "vscp_setFilter");
-
-    duk_push_c_function(ctx, js_is_Measurement, 1);
-    duk_put_global_string(ctx, "vscp_isMeasurement");
-
-    duk_push_c_function(ctx, js_send_Measurement, 1);
-    duk_put_global_string(ctx, "vscp_sendMeasurement");
-
-    duk_push_c_function(ctx, js_get_MeasurementValue, 1);
-    duk_put_global_string(ctx, "vscp_getMeasurementValue");
-
-    duk_push_c_function(ctx, js_get_MeasurementUnit, 1);
-    duk_put_global_string(ctx, "vscp_getMeasurementUnit");
-
-    duk_push_c_function(ctx, js_get_MeasurementSensorIndex, 1);
-    duk_put_global_string(ctx, "vscp_getMeasurementSensorIndex");
-
-    duk_push_c_function(ctx, js_get_MeasurementZone, 1);
-    duk_put_global_string(ctx, "vscp_getMeasurementZone");
-
-    duk_push_c_function(ctx, js_get_MeasurementSubZone, 1);
-    duk_put_global_string(ctx, "vscp_getMeasurementSubZone");
+    duk_context *ctx = pObj->m_jsPool.pushRunContext(heap);
 
     // Save client object as a global pointer
     duk_push_pointer(ctx, (void *)pObj);
     duk_put_global_string(ctx, "vscp_webobj");
 
-    // Create VSCP client
-    pActionObj->m_pClientItem = new CClientItem();
-    vscp_clearVSCPFilter(&pActionObj->m_pClientItem->m_filter);
-
-    // Save the client object as a global pointer
-    duk_push_pointer(ctx, (void *)pActionObj->m_pClientItem);
-    duk_put_global_string(ctx, "vscp_clientitem");
-
-    // reading [global object].vscp_clientItem
-    duk_push_global_object(ctx); // -> stack: [ global ]
-    duk_push_string(
-      ctx, "vscp_clientitem"); // -> stack: [ global "vscp_clientItem" ]
-    duk_get_prop(ctx, -2);     // -> stack: [ global vscp_clientItem ]
-    CClientItem *pItem = (CClientItem *)duk_get_pointer(ctx, -1);
-    std::string user   = pItem->m_UserName;
-
-    //duk_bool_t rc;
-
-    // This is an active client
-    pActionObj->m_pClientItem->m_bOpen = false;
-    pActionObj->m_pClientItem->m_type  = CLIENT_ITEM_INTERFACE_TYPE_CLIENT_JAVASCRIPT;
-    pActionObj->m_pClientItem->setDeviceName(
-      std::string("Internal daemon JavaScript client."));
-
-    // Add the client to the Client List
-    pthread_mutex_lock(&pObj->m_mutex_clientList);
-    if (!pObj->m_clientList.addClient(pActionObj->m_pClientItem)) {
+    // Create the VSCP client of the script. Events for it are
+    // copied to its own queue by the fan-out.
+    pActionObj->m_pClientItem =
+      pObj->addScriptClient(CLIENT_ITEM_INTERFACE_TYPE_CLIENT_JAVASCRIPT,
+                            std::string("Internal daemon JavaScript client."));
+    if (NULL == pActionObj->m_pClientItem) {
         // Failed to add client
-        delete pActionObj->m_pClientItem;
-        pActionObj->m_pClientItem = NULL;
-        pthread_mutex_unlock(&pObj->m_mutex_clientList);
+        duk_pop(heap);
+        pObj->m_jsPool.release(heap);
         spdlog::get("logger")->error(
                "[Javascript execution] - Failed to add client. "
                "Terminating thread.");
         return NULL;
     }
-    pthread_mutex_unlock(&pObj->m_mutex_clientList);
 
-    // Open the channel
-    pActionObj->m_pClientItem->m_bOpen = true;
+    // Save the client object as a global pointer
+    duk_push_pointer(ctx, (void *)pActionObj->m_pClientItem);
+    duk_put_global_string(ctx, "vscp_clientitem");
 
-    // Execute the JavaScript
-    duk_push_string(ctx, (const char *)pActionObj->m_strScript.c_str());
-    if (0 != duk_peval(ctx)) {
+    // Execute the JavaScript. Compiled bytecode is reused if the
+    // script has been run before.
+    bool bLoaded = pActionObj->m_strPath.length()
+                     ? pObj->m_jsPool.loadFile(ctx, pActionObj->m_strPath)
+                     : pObj->m_jsPool.loadSource(ctx, "action", pActionObj->m_strScript);
+    if (!bLoaded || (0 != duk_pcall(ctx, 0))) {
         spdlog::get("logger")->error(
-               "[Javascript execution] - JavaScript failed to execute: %s",
+               "[Javascript execution] - JavaScript failed to execute: {}",
                duk_safe_to_string(ctx, -1));
     }
 
     // If the script wants to log results it can do so
     // by itself with the log function
 
-    duk_pop(ctx); // pop eval. result
-
-    // Close the channel
-    pActionObj->m_pClientItem->m_bOpen = false;
+    duk_pop(ctx); // pop call result
 
-    // Remove client and session item
-    pthread_mutex_lock(&pObj->m_mutex_clientList);
-    pObj->m_clientList.removeClient(pActionObj->m_pClientItem);
+    // Close the channel and remove the client
+    pObj->removeScriptClient(pActionObj->m_pClientItem);
     pActionObj->m_pClientItem = NULL;
-    pthread_mutex_unlock(&pObj->m_mutex_clientList);
 
-    // Destroy the JavaScript context
-    duk_destroy_heap(ctx);
+    // Drop the run context and give the heap back to the pool
+    duk_pop(heap);
+    pObj->m_jsPool.release(heap);
 
     pActionObj->m_stop = vscpdatetime::Now(); // Mark stop time
 
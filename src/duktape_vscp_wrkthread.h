@@ -56,6 +56,12 @@ public:
    */
   std::string m_strScript;
 
+  /*!
+   * Script file. If set the script is read from this file
+   * instead of from m_strScript.
+   */
+  std::string m_strPath;
+
   /// JavaScript executing id
   uint64_t m_id;
 
@@ -28,6 +28,8 @@
 // wxJSON - http://wxcode.sourceforge.net/docs/wxjson/wxjson_tutorial.html
 //
 
+#include <algorithm>
+#include <deque>
 #include <list>
 #include <string>
 
@@ -43,6 +45,7 @@
 #include <vscp.h>
 #include <webdefs.h>
 #include <vscphelper.h>
+#include <webmeasure.h>
 #include <webobj.h>
 //#include <vscpremotetcpif.h>
 
@@ -1067,7 +1070,7 @@ lua_vscp_sendEvent(struct lua_State* L)
     int nArgs = lua_gettop(L);
 
     // Get the client item
-    lua_pushlstring(L, "vscp_webobj", 15);
+    lua_pushlstring(L, "vscp_webobj", 11);
     lua_gettable(L, LUA_REGISTRYINDEX);
     pObj = (CWebObj*)lua_touserdata(L, -1);
 
@@ -1145,16 +1148,129 @@ lua_vscp_sendEvent(struct lua_State* L)
     pEvent->pdata = NULL;
     vscp_convertEventExToEvent(pEvent, &ex);
 
+    // The receive queue owns the event from here
     if (!pObj->eventToReceiveQueue(pEvent)) {
         // Failed to send event
-        vscp_deleteEvent_v2(&pEvent);
         return luaL_error(L, "vscp.sendEvent: Failed to send event!");
     }
 
-    vscp_deleteEvent_v2(&pEvent);
+    lua_pushboolean(L, 1);
     return 1;
 }
 
+// Per script client. Lives in the registry of the Lua state and is
+// removed from the client list when the state is closed.
+struct lua_vscp_client {
+    CWebObj* m_pObj;
+    CClientItem* m_pClientItem;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// lua_vscp_clientGc
+//
+
+static int
+lua_vscp_clientGc(struct lua_State* L)
+{
+    struct lua_vscp_client* pClient =
+      (struct lua_vscp_client*)luaL_checkudata(L, 1, "vscp.client");
+
+    pClient->m_pObj->removeScriptClient(pClient->m_pClientItem);
+    pClient->m_pClientItem = NULL;
+
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// lua_vscp_getScriptClient
+//
+// Client item of the running script. Made on first use so scripts
+// that never read events don't get events copied to them.
+//
+
+static CClientItem*
+lua_vscp_getScriptClient(struct lua_State* L, CWebObj** ppObj)
+{
+    lua_pushlstring(L, "vscp_webobj", 11);
+    lua_gettable(L, LUA_REGISTRYINDEX);
+    *ppObj = (CWebObj*)lua_touserdata(L, -1);
+    lua_pop(L, 1);
+
+    if (NULL == *ppObj) {
+        return NULL;
+    }
+
+    lua_pushlstring(L, "vscp_client", 11);
+    lua_gettable(L, LUA_REGISTRYINDEX);
+    struct lua_vscp_client* pClient = (struct lua_vscp_client*)lua_touserdata(L, -1);
+    lua_pop(L, 1);
+
+    if (NULL != pClient) {
+        return pClient->m_pClientItem;
+    }
+
+    CClientItem* pClientItem =
+      (*ppObj)->addScriptClient(CLIENT_ITEM_INTERFACE_TYPE_CLIENT_LUA,
+                                std::string("Internal daemon Lua client."));
+    if (NULL == pClientItem) {
+        return NULL;
+    }
+
+    // Owner that removes the client again when the state is closed
+    pClient = (struct lua_vscp_client*)lua_newuserdata(L, sizeof(struct lua_vscp_client));
+    pClient->m_pObj        = *ppObj;
+    pClient->m_pClientItem = pClientItem;
+    if (luaL_newmetatable(L, "vscp.client")) {
+        lua_pushcfunction(L, lua_vscp_clientGc);
+        lua_setfield(L, -2, "__gc");
+    }
+    lua_setmetatable(L, -2);
+
+    lua_pushlstring(L, "vscp_client", 11);
+    lua_insert(L, -2);
+    lua_settable(L, LUA_REGISTRYINDEX);
+
+    return pClientItem;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// lua_vscp_pushEvent
+//
+// Push event in string (0), XML (1) or JSON (2) form and delete it
+//
+
+static bool
+lua_vscp_pushEvent(struct lua_State* L, vscpEvent* pEvent, int format)
+{
+    bool rv;
+    std::string strResult;
+
+    switch (format) {
+
+        case 1: // XML
+            rv = vscp_convertEventToXML(strResult, pEvent);
+            break;
+
+        case 2: // JSON
+            rv = vscp_convertEventToJSON(strResult, pEvent);
+            break;
+
+        default: // String
+            rv = vscp_convertEventToString(strResult, pEvent);
+            break;
+    }
+
+    // Event is not needed anymore
+    vscp_deleteEvent_v2(&pEvent);
+
+    if (!rv) {
+        return false;
+    }
+
+    lua_pushlstring(L, (const char*)strResult.c_str(), strResult.length());
+    return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // lua_vscp_getEvent
 //
@@ -1165,8 +1281,6 @@ int
 lua_vscp_getEvent(struct lua_State* L)
 {
     int format = 0;
-    //vscpEventEx ex;
-    std::string strEvent;
     CWebObj* pObj = NULL;
 
     int nArgs = lua_gettop(L);
@@ -1174,88 +1288,81 @@ lua_vscp_getEvent(struct lua_State* L)
     // Get format - if given
     if (0 != nArgs) {
 
-        if (!lua_isnumber(L, 1)) {
+        if (lua_isnumber(L, 1)) {
             format = (int)lua_tointeger(L, 1);
         }
     }
 
     // Get the client item
-    lua_pushlstring(L, "vscp_webobj", 15);
-    lua_gettable(L, LUA_REGISTRYINDEX);
-    pObj = (CWebObj*)lua_touserdata(L, -1);
-
-    if (NULL == pObj) {
+    CClientItem* pClientItem = lua_vscp_getScriptClient(L, &pObj);
+    if (NULL == pClientItem) {
         return luaL_error(L, "vscp.getEvent: VSCP server client not found.");
     }
 
-//try_again:
+    std::deque<vscpEvent*> events;
+    if (!pObj->getClientEvents(pClientItem, events, 1, 0)) {
+        // No events available
+        lua_pushnil(L);
+        return 1;
+    }
 
-    // Check the client queue
-    if (/*pObj->m_bOpen && TODO */pObj->m_receiveList.size()) {
+    if (!lua_vscp_pushEvent(L, events.front(), format)) {
+        return luaL_error(L, "vscp.getEvent: Failed to convert event.");
+    }
 
-        std::deque<vscpEvent*>::iterator it;
-        vscpEvent* pEvent;
+    // All OK return event
+    return 1;
+}
 
-        pthread_mutex_lock(&pObj->m_mutexReceiveQueue);
-        pEvent = pObj->m_receiveList.front();
-        pObj->m_receiveList.pop_front();
-        if (NULL == pEvent) {
-            return luaL_error(L, "vscp.getEvent: Failed to get event.");
-        }
-        pthread_mutex_unlock(&pObj->m_mutexReceiveQueue);
+///////////////////////////////////////////////////////////////////////////////
+// lua_vscp_getEvents
+//
+// events = vscp.getevents(max, timeout[, format])
+//
 
-        if (NULL == pEvent) {
-            return luaL_error(L,
-                              "vscp.getEvent: Allocation error when "
-                              "getting event from client!");
+int
+lua_vscp_getEvents(struct lua_State* L)
+{
+    int format = 0;
+    size_t max = 1;
+    uint32_t timeout = 0;
+    CWebObj* pObj = NULL;
+
+    int nArgs = lua_gettop(L);
+
+    if ((nArgs >= 1) && lua_isnumber(L, 1)) {
+        lua_Integer n = lua_tointeger(L, 1);
+        max = (n < 1) ? 1 : std::min((size_t)n, (size_t)WEBFLOW_SCRIPT_MAX_EVENTS);
+    }
+
+    if ((nArgs >= 2) && lua_isnumber(L, 2)) {
+        lua_Integer n = lua_tointeger(L, 2);
+        timeout = (n < 0) ? 0 : (uint32_t)std::min(n, (lua_Integer)WEBFLOW_SCRIPT_MAX_WAIT);
+    }
+
+    if ((nArgs >= 3) && lua_isnumber(L, 3)) {
+        format = (int)lua_tointeger(L, 3);
+    }
+
+    // Get the client item
+    CClientItem* pClientItem = lua_vscp_getScriptClient(L, &pObj);
+    if (NULL == pClientItem) {
+        return luaL_error(L, "vscp.getEvents: VSCP server client not found.");
+    }
+
+    std::deque<vscpEvent*> events;
+    pObj->getClientEvents(pClientItem, events, max, timeout);
+
+    lua_createtable(L, (int)events.size(), 0);
+    lua_Integer idx = 1;
+    while (!events.empty()) {
+        vscpEvent* pEvent = events.front();
+        events.pop_front();
+        if (lua_vscp_pushEvent(L, pEvent, format)) {
+            lua_rawseti(L, -2, idx++);
         }
+    }
 
-        // TODO
-        // if (vscp_doLevel2Filter(pEvent, &pObj->m_filter)) {
-
-        //     // Write it out   
-        //     std::string strResult;
-        //     switch (format) {
-        //         case 0: // String
-        //             if (!vscp_convertEventToString(strResult, pEvent)) {
-        //                 return luaL_error(L,
-        //                                   "vscp.getEvent: Failed to "
-        //                                   "convert event to string form.");
-        //             }
-        //             break;
-
-        //         case 1: // XML
-        //             if (!vscp_convertEventToXML(strResult, pEvent)) {
-        //                 return luaL_error(L,
-        //                                   "vscp.getEvent: Failed to "
-        //                                   "convert event to XML form.");
-        //             }
-        //             break;
-
-        //         case 2: // JSON
-        //             if (!vscp_convertEventToJSON(strResult, pEvent)) {
-        //                 return luaL_error(L,
-        //                                   "vscp.getEvent: Failed to "
-        //                                   "convert event to JSON form.");
-        //             }
-        //             break;
-        //     }
-
-        //     // Event is not needed anymore
-        //     vscp_deleteEvent(pEvent);
-
-        //     lua_pushlstring(
-        //       L, (const char*)strResult.c_str(), strResult.length());
-
-        //     // All OK return event
-        //     return 1;
-
-        // } // Valid pEvent pointer
-
-    } // events available
-
-    // No events available
-    lua_pushnil(L);
     return 1;
 }
 
@@ -1272,19 +1379,16 @@ lua_vscp_getCountEvent(struct lua_State* L)
     CWebObj* pObj = NULL;
 
     // Get the client item
-    lua_pushlstring(L, "vscp_webobj", 15);
-    lua_gettable(L, LUA_REGISTRYINDEX);
-    pObj = (CWebObj*)lua_touserdata(L, -1);
-
-    if (NULL == pObj) {
+    CClientItem* pClientItem = lua_vscp_getScriptClient(L, &pObj);
+    if (NULL == pClientItem) {
         return luaL_error(L, "vscp.getCountEvent: VSCP server client not found.");
     }
 
-    // if (pObj->m_bOpen) {     TODO:
-    //     count = pObj->m_receiveList.size();
-    // } else {
-    //     count = 0;
-    // }
+    pthread_mutex_lock(&pClientItem->m_mutexClientInputQueue);
+    if (pClientItem->m_bOpen) {
+        count = pClientItem->m_clientInputQueue.size();
+    }
+    pthread_mutex_unlock(&pClientItem->m_mutexClientInputQueue);
 
     lua_pushinteger(L, count); // return count
 
@@ -1321,11 +1425,8 @@ lua_vscp_setFilter(struct lua_State* L)
     int nArgs = lua_gettop(L);
 
     // Get the client item
-    lua_pushlstring(L, "vscp_webobj", 15);
-    lua_gettable(L, LUA_REGISTRYINDEX);
-    pObj = (CWebObj*)lua_touserdata(L, -1);
-
-    if (NULL == pObj) {
+    CClientItem* pClientItem = lua_vscp_getScriptClient(L, &pObj);
+    if (NULL == pClientItem) {
         return luaL_error(L, "vscp.setFilter: VSCP server client not found.");
     }
 
@@ -1381,8 +1482,11 @@ lua_vscp_setFilter(struct lua_State* L)
     }
 
     // Set the filter
-    //vscp_copyVSCPFilter(&pObj->m_filter, &filter);  TODO:
+    pthread_mutex_lock(&pClientItem->m_mutexClientInputQueue);
+    vscp_copyVSCPFilter(&pClientItem->m_filter, &filter);
+    pthread_mutex_unlock(&pClientItem->m_mutexClientInputQueue);
 
+    lua_pushboolean(L, 1);
     return 1;
 }
 
@@ -1418,7 +1522,7 @@ lua_send_Measurement(struct lua_State* L)
     int nArgs = lua_gettop(L);
 
     // Get the client item
-    lua_pushlstring(L, "vscp_webobj", 15);
+    lua_pushlstring(L, "vscp_webobj", 11);
     lua_gettable(L, LUA_REGISTRYINDEX);
     pObj = (CWebObj*)lua_touserdata(L, -1);
 
@@ -2106,6 +2210,106 @@ lua_get_MeasurementSubZone(struct lua_State* L)
     return 1;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// lua_vscp_decodeMeasurements
+//
+// records = vscp.decodemeasurements(events[, format])
+//
+// events is a table of events as returned by vscp.getevents. A record
+// is returned for each event that is a measurement. Its index field
+// is the position of the event in the events table.
+//
+
+int
+lua_vscp_decodeMeasurements(struct lua_State* L)
+{
+    int format = 0;
+    int nArgs = lua_gettop(L);
+
+    if (!lua_istable(L, 1)) {
+        return luaL_error(L,
+                          "vscp.decodeMeasurements: Argument error, "
+                          "table expected: "
+                          "vscp.decodeMeasurements( events[,format] ) ");
+    }
+
+    if ((nArgs >= 2) && lua_isnumber(L, 2)) {
+        format = (int)lua_tointeger(L, 2);
+    }
+
+    lua_Integer cnt = (lua_Integer)lua_rawlen(L, 1);
+    if (cnt > WEBMEASURE_MAX_EVENTS) {
+        return luaL_error(L,
+                          "vscp.decodeMeasurements: Too many events, "
+                          "max is %d.",
+                          WEBMEASURE_MAX_EVENTS);
+    }
+
+    lua_createtable(L, (int)cnt, 0);
+    lua_Integer idx = 1;
+
+    vscpEventEx ex;
+    webmeasure_record rec;
+    std::string strEvent;
+    for (lua_Integer i = 1; i <= cnt; i++) {
+
+        lua_rawgeti(L, 1, i);
+        size_t len;
+        const char* pstr = lua_tolstring(L, -1, &len);
+        if (NULL == pstr) {
+            lua_pop(L, 1);
+            continue;
+        }
+        strEvent.assign(pstr, len);
+        lua_pop(L, 1);
+
+        bool bOk;
+        switch (format) {
+
+            case 1: // XML
+                bOk = vscp_convertXMLToEventEx(&ex, strEvent);
+                break;
+
+            case 2: // JSON
+                bOk = vscp_convertJSONToEventEx(&ex, strEvent);
+                break;
+
+            default: // String
+                bOk = vscp_convertStringToEventEx(&ex, strEvent);
+                break;
+        }
+
+        if (!bOk || !webmeasure_decodeEx(ex, rec)) {
+            continue;
+        }
+
+        lua_createtable(L, 0, 10);
+        lua_pushinteger(L, i);
+        lua_setfield(L, -2, "index");
+        lua_pushinteger(L, rec.m_class);
+        lua_setfield(L, -2, "class");
+        lua_pushinteger(L, rec.m_type);
+        lua_setfield(L, -2, "type");
+        lua_pushnumber(L, rec.m_value);
+        lua_setfield(L, -2, "value");
+        lua_pushinteger(L, rec.m_unit);
+        lua_setfield(L, -2, "unit");
+        lua_pushinteger(L, rec.m_sensorIndex);
+        lua_setfield(L, -2, "sensorindex");
+        lua_pushinteger(L, rec.m_zone);
+        lua_setfield(L, -2, "zone");
+        lua_pushinteger(L, rec.m_subZone);
+        lua_setfield(L, -2, "subzone");
+        lua_pushinteger(L, rec.m_timestamp);
+        lua_setfield(L, -2, "timestamp");
+        lua_pushstring(L, rec.m_datetime);
+        lua_setfield(L, -2, "datetime");
+        lua_rawseti(L, -2, idx++);
+    }
+
+    return 1;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // lua_connect
 //
@@ -2315,4 +2519,159 @@ int
 js_md5(struct lua_State* L)
 {
     return 1;
-}
\ No newline at end of file
+}
+
+// ----------------------------------------------------------------------------
+
+// The vscp.* functions available to Lua server pages and websockets
+static const luaL_Reg lua_vscp_lib[] = {
+    { "print", lua_vscp_print },
+    { "log", lua_vscp_log },
+    { "sleep", lua_vscp_sleep },
+    { "base64encode", lua_vscp_base64_encode },
+    { "base64decode", lua_vscp_base64_decode },
+    { "escapexml", lua_vscp_escapexml },
+    { "readvariable", lua_vscp_readVariable },
+    { "writevariable", lua_vscp_writeVariable },
+    { "writevariablevalue", lua_vscp_writeVariableValue },
+    { "writevariablenote", lua_vscp_writeVariableNote },
+    { "deletevariable", lua_vscp_deleteVariable },
+    { "isVariableBase64Encoded", lua_vscp_isVariableBase64Encoded },
+    { "isVariablePersistent", lua_vscp_isVariablePersistent },
+    { "isVariableNumerical", lua_vscp_isVariableNumerical },
+    { "isStockVariable", lua_vscp_isStockVariable },
+    { "sendevent", lua_vscp_sendEvent },
+    { "receiveevent", lua_vscp_getEvent },
+    { "getevents", lua_vscp_getEvents },
+    { "countevent", lua_vscp_getCountEvent },
+    { "setfilter", lua_vscp_setFilter },
+    { "ismeasurement", lua_is_Measurement },
+    { "sendmeasurement", lua_send_Measurement },
+    { "getmeasurementvalue", lua_get_MeasurementValue },
+    { "getmeasurementunit", lua_get_MeasurementUnit },
+    { "getmeasurementsensorindex", lua_get_MeasurementSensorIndex },
+    { "getmeasurementzone", lua_get_MeasurementZone },
+    { "getmeasurementsubzone", lua_get_MeasurementSubZone },
+    { "decodemeasurements", lua_vscp_decodeMeasurements },
+    { NULL, NULL }
+};
+
+// Preload file compiled to Lua bytecode. Written once at startup.
+static std::string lua_vscp_preloadName;
+static std::string lua_vscp_preloadChunk;
+
+///////////////////////////////////////////////////////////////////////////////
+// lua_vscp_openlib
+//
+
+void
+lua_vscp_openlib(struct lua_State* L, void* pObj)
+{
+    if (NULL == L) {
+        return;
+    }
+
+    // Driver object for the functions
+    lua_pushlstring(L, "vscp_webobj", 11);
+    lua_pushlightuserdata(L, pObj);
+    lua_settable(L, LUA_REGISTRYINDEX);
+
+    luaL_newlib(L, lua_vscp_lib);
+    lua_setglobal(L, "vscp");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// lua_vscp_preloadWriter
+//
+// lua_dump writer that appends to a string
+//
+
+static int
+lua_vscp_preloadWriter(lua_State* L, const void* p, size_t sz, void* ud)
+{
+    (void)L;
+    ((std::string*)ud)->append((const char*)p, sz);
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// lua_vscp_compilePreload
+//
+
+bool
+lua_vscp_compilePreload(const std::string& path)
+{
+    lua_vscp_preloadName.clear();
+    lua_vscp_preloadChunk.clear();
+
+    if (path.empty()) {
+        return true;
+    }
+
+    lua_State* L = luaL_newstate();
+    if (NULL == L) {
+        return false;
+    }
+
+    if (LUA_OK != luaL_loadfile(L, path.c_str())) {
+        spdlog::get("logger")->error("Failed to compile Lua preload file [{}]: {}",
+                                     path,
+                                     lua_tostring(L, -1));
+        lua_close(L);
+        return false;
+    }
+
+    // Keep debug info so errors point into the file
+    std::string chunk;
+    lua_dump(L, lua_vscp_preloadWriter, &chunk, 0);
+    lua_close(L);
+
+    lua_vscp_preloadName  = "@" + path;
+    lua_vscp_preloadChunk = chunk;
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// lua_vscp_runPreload
+//
+
+bool
+lua_vscp_runPreload(struct lua_State* L)
+{
+    if ((NULL == L) || lua_vscp_preloadChunk.empty()) {
+        return true;
+    }
+
+    if ((LUA_OK != luaL_loadbufferx(L,
+                                    lua_vscp_preloadChunk.data(),
+                                    lua_vscp_preloadChunk.length(),
+                                    lua_vscp_preloadName.c_str(),
+                                    "b")) ||
+        (LUA_OK != lua_pcall(L, 0, 0, 0))) {
+        spdlog::get("logger")->error("Lua preload file failed: {}", lua_tostring(L, -1));
+        lua_pop(L, 1);
+        return false;
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// lua_vscp_resetState
+//
+
+void
+lua_vscp_resetState(struct lua_State* L)
+{
+    if (NULL == L) {
+        return;
+    }
+
+    // Dropping the owner removes the script client in its __gc
+    lua_pushlstring(L, "vscp_client", 11);
+    lua_pushnil(L);
+    lua_settable(L, LUA_REGISTRYINDEX);
+
+    lua_gc(L, LUA_GCCOLLECT, 0);
+}
@@ -169,6 +169,18 @@ lua_vscp_sendEvent(struct lua_State *L);
 int
 lua_vscp_getEvent(struct lua_State *L);
 
+/*!
+ * Fetch events from the local client queue. Waits for events if
+ * the queue is empty.
+ *
+ *  Lua Parameter 0: Max number of events (default 1)
+ *  Lua Parameter 1: Max time to wait in milliseconds (default 0)
+ *  Lua Parameter 2: Format 0=string, 1=XML, 2=JSON (default 0)
+ *  Lua: Return: Table with the events, empty on timeout
+ */
+int
+lua_vscp_getEvents(struct lua_State *L);
+
 /*!
  * Return number of events in the local client queue
  *
@@ -239,4 +251,56 @@ lua_get_MeasurementZone(struct lua_State *L);
 int
 lua_get_MeasurementSubZone(struct lua_State *L);
 
+/*!
+ * Decode a batch of measurement events in one call
+ *
+ *  Lua Parameter 0: Table with events
+ *  Lua Parameter 1: Format 0=string, 1=XML, 2=JSON (default 0)
+ *  Lua: Return: Table with a record for each measurement event with
+ *               index, class, type, value, unit, sensorindex, zone,
+ *               subzone, timestamp and datetime.
+ */
+int
+lua_vscp_decodeMeasurements(struct lua_State *L);
+
+/*!
+ * Register the vscp.* functions in a Lua state and make the
+ * driver object available to them.
+ *
+ * @param L Lua state
+ * @param pObj Driver object (CWebObj)
+ */
+void
+lua_vscp_openlib(struct lua_State *L, void *pObj);
+
+/*!
+ * Compile the preload file once. Every new Lua state then runs the
+ * compiled chunk instead of reading and compiling the file again.
+ *
+ * Call before the web server is started.
+ *
+ * @param path Path to preload file
+ * @return true on success.
+ */
+bool
+lua_vscp_compilePreload(const std::string &path);
+
+/*!
+ * Run the compiled preload file in a Lua state
+ *
+ * @param L Lua state
+ * @return true on success or if there is no preload file.
+ */
+bool
+lua_vscp_runPreload(struct lua_State *L);
+
+/*!
+ * Make a state ready for the next script. The client the last script
+ * used for events is removed and its garbage is collected.
+ *
+ * @param L Lua state
+ */
+void
+lua_vscp_resetState(struct lua_State *L);
+
 #endif
@@ -30,6 +30,7 @@
 #define VSCP_LUA__INCLUDED_
 
 #include <vscpdatetime.h>
+#include <webobj.h>
 
 ////////////////////////////////////////////////////////////////////////////////
 // actionLuaObj
@@ -63,8 +64,8 @@ public:
   /// Time when script was stopped
   vscpdatetime m_stop;
 
-  /// Client item for script
-  // CClientItem *m_pClientItem;
+  /// Pointer to owner
+  CWebObj* pParent;
 
   /// Feed event
   vscpEventEx m_feedEvent;
@@ -52,6 +52,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/ioctl.h>
 #include <sys/msg.h>
 #include <sys/socket.h>
@@ -59,6 +60,10 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
 #include "web_css.h"
 #include "web_js.h"
 #include "web_template.h"
@@ -96,6 +101,13 @@ using namespace kainjow::mustache;
 
 // Prototypes
 
+static void
+restsrv_sendStatus(struct mg_connection* conn,
+                   int format,
+                   const char* sid,
+                   size_t nEvents,
+                   CWebObj* pObj);
+
 void
 restsrv_doStatus(struct mg_connection* conn,
                  struct restsrv_session* pSession,
@@ -353,6 +365,101 @@ const char* rest_errors[][REST_FORMAT_COUNT + 1] = {
 //                                   REST
 //-----------------------------------------------------------------------------
 
+///////////////////////////////////////////////////////////////////////////////
+// restsrv_getMimeType
+//
+
+const char*
+restsrv_getMimeType(int format)
+{
+  switch (format) {
+    case REST_FORMAT_CSV:
+      return REST_MIME_TYPE_CSV;
+    case REST_FORMAT_XML:
+      return REST_MIME_TYPE_XML;
+    case REST_FORMAT_JSON:
+      return REST_MIME_TYPE_JSON;
+    case REST_FORMAT_JSONP:
+      return REST_MIME_TYPE_JSONP;
+    case REST_FORMAT_CBOR:
+      return REST_MIME_TYPE_CBOR;
+    case REST_FORMAT_MSGPACK:
+      return REST_MIME_TYPE_MSGPACK;
+    case REST_FORMAT_PLAIN:
+    default:
+      return REST_MIME_TYPE_PLAIN;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// restsrv_sendBuffer
+//
+
+void
+restsrv_sendBuffer(struct mg_connection* conn,
+                   int format,
+                   int returncode,
+                   const CWebBuffer& buf)
+{
+  websrv_sendBuffer(conn, returncode, restsrv_getMimeType(format), buf);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// restsrv_appendJSON
+//
+// Serialize a JSON object in one of the JSON based formats
+//
+
+void
+restsrv_appendJSON(CWebBuffer& buf, int format, const json& j)
+{
+  if (REST_FORMAT_CBOR == format) {
+    std::vector<uint8_t> v = json::to_cbor(j);
+    buf.append((const char*)v.data(), v.size());
+  }
+  else if (REST_FORMAT_MSGPACK == format) {
+    std::vector<uint8_t> v = json::to_msgpack(j);
+    buf.append((const char*)v.data(), v.size());
+  }
+  else if (REST_FORMAT_JSONP == format) {
+    buf.append(REST_JSONP_START);
+    buf.append(j.dump());
+    buf.append(REST_JSONP_END);
+  }
+  else {
+    buf.append(j.dump());
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// restsrv_appendError
+//
+// Binary formats use the same fields as the JSON error replies
+//
+
+static void
+restsrv_appendError(CWebBuffer& buf, int format, int errorcode)
+{
+  if (REST_FORMAT_IS_BINARY(format)) {
+    try {
+      restsrv_appendJSON(buf,
+                         format,
+                         json::parse(rest_errors[errorcode][REST_FORMAT_JSON]));
+    }
+    catch (...) {
+      spdlog::get("logger")->error("[REST] Failed to encode error {}",
+                                   errorcode);
+    }
+    return;
+  }
+
+  if (REST_FORMAT_XML == format) {
+    buf.append(XML_HEADER);
+  }
+
+  buf.append(rest_errors[errorcode][format]);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // restsrv_error
 //
@@ -365,71 +472,27 @@ restsrv_error(struct mg_connection* conn,
               void* cbdata)
 {
   int returncode = 200;
+  CWebBuffer buf(1024);
 
   CWebObj* pObj = (CWebObj*)cbdata;
   if (NULL == pObj) {
     return;
   }
 
+  pObj->m_metrics.m_restErrors.inc();
+
   spdlog::get("logger")->debug("[REST] error format={} errorcode={}",
                                format,
                                errorcode);
 
-  if (REST_FORMAT_PLAIN == format) {
-
-    websrv_sendheader(conn, returncode, REST_MIME_TYPE_PLAIN);
-    mg_write(conn,
-             rest_errors[errorcode][REST_FORMAT_PLAIN],
-             strlen(rest_errors[errorcode][REST_FORMAT_PLAIN]));
-    mg_write(conn, "", 0); // Terminator
+  if ((format < REST_FORMAT_PLAIN) || (format >= REST_FORMAT_COUNT)) {
+    buf.append(REST_PLAIN_ERROR_UNSUPPORTED_FORMAT);
+    restsrv_sendBuffer(conn, REST_FORMAT_PLAIN, returncode, buf);
     return;
   }
-  else if (REST_FORMAT_CSV == format) {
 
-    websrv_sendheader(conn, returncode, REST_MIME_TYPE_CSV);
-    mg_write(conn,
-             rest_errors[errorcode][REST_FORMAT_CSV],
-             strlen(rest_errors[errorcode][REST_FORMAT_CSV]));
-    mg_write(conn, "", 0); // Terminator
-    return;
-  }
-  else if (REST_FORMAT_XML == format) {
-
-    websrv_sendheader(conn, returncode, REST_MIME_TYPE_XML);
-    mg_write(conn, XML_HEADER, strlen(XML_HEADER));
-    mg_write(conn,
-             rest_errors[errorcode][REST_FORMAT_XML],
-             strlen(rest_errors[errorcode][REST_FORMAT_XML]));
-    mg_write(conn, "", 0); // Terminator
-    return;
-  }
-  else if (REST_FORMAT_JSON == format) {
-
-    websrv_sendheader(conn, returncode, REST_MIME_TYPE_JSON);
-    mg_write(conn,
-             rest_errors[errorcode][REST_FORMAT_JSON],
-             strlen(rest_errors[errorcode][REST_FORMAT_JSON]));
-    mg_write(conn, "", 0); // Terminator
-    return;
-  }
-  else if (REST_FORMAT_JSONP == format) {
-
-    websrv_sendheader(conn, returncode, REST_MIME_TYPE_JSONP);
-    mg_write(conn,
-             rest_errors[errorcode][REST_FORMAT_JSONP],
-             strlen(rest_errors[errorcode][REST_FORMAT_JSONP]));
-    mg_write(conn, "", 0); // Terminator
-    return;
-  }
-  else {
-
-    websrv_sendheader(conn, returncode, REST_MIME_TYPE_PLAIN);
-    mg_write(conn,
-             REST_PLAIN_ERROR_UNSUPPORTED_FORMAT,
-             strlen(REST_PLAIN_ERROR_UNSUPPORTED_FORMAT));
-    mg_write(conn, "", 0); // Terminator
-    return;
-  }
+  restsrv_appendError(buf, format, errorcode);
+  restsrv_sendBuffer(conn, format, returncode, buf);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -454,6 +517,9 @@ restsrv_sendHeader(struct mg_connection* conn, int format, int returncode)
   else if (REST_FORMAT_JSONP == format) {
     websrv_sendheader(conn, returncode, REST_MIME_TYPE_JSONP);
   }
+  else if (REST_FORMAT_IS_BINARY(format)) {
+    websrv_sendheader(conn, returncode, restsrv_getMimeType(format));
+  }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -602,12 +668,13 @@ restsrv_add_session(struct mg_connection* conn,
   pthread_mutex_lock(&pObj->m_mutex_restSession);
   pObj->m_rest_sessions.push_back(pSession);
   pthread_mutex_unlock(&pObj->m_mutex_restSession);
+  pObj->m_memory.m_restSessions.add(sizeof(struct restsrv_session) + sizeof(CClientItem));
 
   return pSession;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// websrv_expire_sessions
+// restsrv_expire_sessions
 //
 
 void
@@ -633,6 +700,15 @@ restsrv_expire_sessions(struct mg_connection* conn, void* cbdata)
       if ((now - pSession->m_lastActiveTime) > (60 * 60)) {
         it = pObj->m_rest_sessions.erase(it);
         spdlog::get("logger")->debug("[REST] Session expired");
+        if (NULL != pSession->m_pClientItem) {
+          pthread_mutex_lock(&pObj->m_mutex_clientList);
+          pthread_mutex_lock(&pObj->m_clientList.m_mutexItemList);
+          pObj->releaseClientQueue(pSession->m_pClientItem);
+          pObj->m_clientList.removeClient(pSession->m_pClientItem);
+          pthread_mutex_unlock(&pObj->m_clientList.m_mutexItemList);
+          pthread_mutex_unlock(&pObj->m_mutex_clientList);
+        }
+        pObj->m_memory.m_restSessions.sub(sizeof(struct restsrv_session) + sizeof(CClientItem));
         delete pSession;
       }
       else {
@@ -647,12 +723,356 @@ restsrv_expire_sessions(struct mg_connection* conn, void* cbdata)
   pthread_mutex_unlock(&pObj->m_mutex_restSession);
 }
 
+//-----------------------------------------------------------------------------
+//                              Bearer tokens
+//-----------------------------------------------------------------------------
+
+// A token is base64url(payload) "." base64url(HMAC-SHA256(payload))
+// where payload is "version;rights;expires;user". The key is the
+// 256-bit VSCP key so a token can be checked without any lookups.
+
 ///////////////////////////////////////////////////////////////////////////////
-// websrv_restapi
+// restsrv_base64url_encode
 //
 
-int
-websrv_restapi(struct mg_connection* conn, void* cbdata)
+static std::string
+restsrv_base64url_encode(const uint8_t* pdata, size_t len)
+{
+  std::string out;
+  std::vector<unsigned char> buf(4 * ((len + 2) / 3) + 1);
+
+  int n = EVP_EncodeBlock(buf.data(), pdata, (int)len);
+  for (int i = 0; i < n; i++) {
+    char c = (char)buf[i];
+    if ('+' == c) {
+      out += '-';
+    }
+    else if ('/' == c) {
+      out += '_';
+    }
+    else if ('=' != c) {
+      out += c;
+    }
+  }
+
+  return out;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// restsrv_base64url_decode
+//
+
+static bool
+restsrv_base64url_decode(const std::string& str, std::string& out)
+{
+  std::string b64 = str;
+  for (size_t i = 0; i < b64.length(); i++) {
+    if ('-' == b64[i]) {
+      b64[i] = '+';
+    }
+    else if ('_' == b64[i]) {
+      b64[i] = '/';
+    }
+  }
+
+  // Restore padding
+  size_t pad = (4 - (b64.length() % 4)) % 4;
+  if (3 == pad) {
+    return false;
+  }
+  b64.append(pad, '=');
+
+  std::vector<unsigned char> buf(3 * (b64.length() / 4) + 1);
+  int n = EVP_DecodeBlock(buf.data(),
+                          (const unsigned char*)b64.c_str(),
+                          (int)b64.length());
+  if (n < 0) {
+    return false;
+  }
+
+  // EVP_DecodeBlock does not remove padding
+  out.assign((const char*)buf.data(), n - pad);
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// restsrv_getTokenTag
+//
+// First 8 bytes of a MAC over the stored password hash. The hash itself
+// never goes into the token.
+//
+
+std::string
+restsrv_getTokenTag(const uint8_t* pkey, const std::string& passwordHash)
+{
+  uint8_t mac[EVP_MAX_MD_SIZE];
+  unsigned int maclen = 0;
+  std::string data    = "password;" + passwordHash;
+
+  if ((NULL == pkey) ||
+      (NULL == HMAC(EVP_sha256(),
+                    pkey,
+                    32,
+                    (const unsigned char*)data.c_str(),
+                    data.length(),
+                    mac,
+                    &maclen)) ||
+      (maclen < 8)) {
+    return "";
+  }
+
+  std::string tag;
+  for (int i = 0; i < 8; i++) {
+    tag += vscp_str_format("%02x", mac[i]);
+  }
+
+  return tag;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// restsrv_createToken
+//
+
+bool
+restsrv_createToken(const uint8_t* pkey,
+                    const std::string& user,
+                    const std::string& passwordHash,
+                    time_t expires,
+                    std::string& token)
+{
+  uint8_t mac[EVP_MAX_MD_SIZE];
+  unsigned int maclen = 0;
+
+  if ((NULL == pkey) || !user.length()) {
+    return false;
+  }
+
+  std::string tag = restsrv_getTokenTag(pkey, passwordHash);
+  if (!tag.length()) {
+    return false;
+  }
+
+  std::string payload = vscp_str_format("%s;%ld;%s;",
+                                        REST_TOKEN_VERSION,
+                                        (long)expires,
+                                        tag.c_str()) +
+                        user;
+
+  if (NULL == HMAC(EVP_sha256(),
+                   pkey,
+                   32,
+                   (const unsigned char*)payload.c_str(),
+                   payload.length(),
+                   mac,
+                   &maclen)) {
+    return false;
+  }
+
+  token = restsrv_base64url_encode((const uint8_t*)payload.c_str(),
+                                   payload.length()) +
+          "." + restsrv_base64url_encode(mac, maclen);
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// restsrv_validateToken
+//
+
+bool
+restsrv_validateToken(const uint8_t* pkey,
+                      const std::string& token,
+                      std::string& user,
+                      std::string& tag,
+                      time_t& expires)
+{
+  uint8_t mac[EVP_MAX_MD_SIZE];
+  unsigned int maclen = 0;
+  std::string payload;
+  std::string signature;
+
+  if ((NULL == pkey) || (token.length() > REST_TOKEN_MAX_LENGTH)) {
+    return false;
+  }
+
+  size_t pos = token.find('.');
+  if (std::string::npos == pos) {
+    return false;
+  }
+
+  if (!restsrv_base64url_decode(token.substr(0, pos), payload) ||
+      !restsrv_base64url_decode(token.substr(pos + 1), signature)) {
+    return false;
+  }
+
+  if (NULL == HMAC(EVP_sha256(),
+                   pkey,
+                   32,
+                   (const unsigned char*)payload.c_str(),
+                   payload.length(),
+                   mac,
+                   &maclen)) {
+    return false;
+  }
+
+  // Constant time compare
+  if ((signature.length() != maclen) ||
+      (0 != CRYPTO_memcmp(mac, signature.c_str(), maclen))) {
+    return false;
+  }
+
+  // version;expires;tag;user
+  std::deque<std::string> tokens;
+  vscp_split(tokens, payload, ";");
+  if ((tokens.size() < 4) || (REST_TOKEN_VERSION != tokens[0])) {
+    return false;
+  }
+
+  expires = (time_t)strtol(tokens[1].c_str(), NULL, 10);
+  tag     = tokens[2];
+
+  // User name is the rest of the payload
+  size_t posUser = tokens[0].length() + tokens[1].length() +
+                   tokens[2].length() + 3;
+  user = payload.substr(posUser);
+
+  // Expired?
+  if (time(NULL) > expires) {
+    return false;
+  }
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// restsrv_getAcceptFormat
+//
+// Binary format asked for with an Accept header. Each media range is
+// weighed by its q-value, so "application/cbor;q=0" rules CBOR out. A
+// binary format is only chosen if it weighs at least as much as JSON.
+// Returns REST_FORMAT_CBOR, REST_FORMAT_MSGPACK or -1 for none.
+//
+
+static int
+restsrv_getAcceptFormat(const char* pAccept)
+{
+  double qCbor    = 0;
+  double qMsgpack = 0;
+  double qJson    = 0;
+
+  std::deque<std::string> ranges;
+  vscp_split(ranges, std::string(pAccept), ",");
+  while (!ranges.empty()) {
+
+    std::deque<std::string> params;
+    vscp_split(params, ranges.front(), ";");
+    ranges.pop_front();
+    if (params.empty()) {
+      continue;
+    }
+
+    std::string type = params.front();
+    vscp_trim(type);
+    params.pop_front();
+
+    double q = 1.0;
+    while (!params.empty()) {
+      std::string param = params.front();
+      vscp_trim(param);
+      params.pop_front();
+      if ((param.length() > 2) && (0 == vscp_strncasecmp(param.c_str(), "q=", 2))) {
+        q = std::min(std::max(atof(param.c_str() + 2), 0.0), 1.0);
+      }
+    }
+
+    if (0 == vscp_strcasecmp(type.c_str(), REST_MIME_TYPE_CBOR)) {
+      qCbor = std::max(qCbor, q);
+    }
+    else if ((0 == vscp_strcasecmp(type.c_str(), REST_MIME_TYPE_MSGPACK)) ||
+             (0 == vscp_strcasecmp(type.c_str(), "application/x-msgpack"))) {
+      qMsgpack = std::max(qMsgpack, q);
+    }
+    else if (0 == vscp_strcasecmp(type.c_str(), REST_MIME_TYPE_JSON)) {
+      qJson = std::max(qJson, q);
+    }
+  }
+
+  if ((qCbor > 0) && (qCbor >= qMsgpack) && (qCbor >= qJson)) {
+    return REST_FORMAT_CBOR;
+  }
+
+  if ((qMsgpack > 0) && (qMsgpack >= qJson)) {
+    return REST_FORMAT_MSGPACK;
+  }
+
+  return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// restsrv_doGetToken
+//
+// Reply with a newly issued token.
+//
+
+void
+restsrv_doGetToken(struct mg_connection* conn,
+                   int format,
+                   const std::string& strToken,
+                   const std::string& strUser,
+                   time_t expires)
+{
+  CWebBuffer buf(1024);
+
+  if (REST_FORMAT_PLAIN == format) {
+    buf.append("1 1 Success");
+    if (strToken.length()) {
+      buf.appendf(" vscptoken=%s", strToken.c_str());
+    }
+    buf.appendf(" user=%s expires=%ld", strUser.c_str(), (long)expires);
+  }
+  else if (REST_FORMAT_CSV == format) {
+    buf.appendf("success-code,error-code,message,description,"
+                "vscptoken,user,expires\r\n1,1,Success,Success.,%s,%s,%ld",
+                strToken.c_str(),
+                strUser.c_str(),
+                (long)expires);
+  }
+  else if (REST_FORMAT_XML == format) {
+    buf.append("<vscp-rest success = \"true\" code = \"1\" "
+               "message = \"Success.\" description = \"Success.\" >");
+    if (strToken.length()) {
+      buf.appendf("<vscptoken>%s</vscptoken>", strToken.c_str());
+    }
+    buf.appendf("<user>%s</user><expires>%ld</expires></vscp-rest>",
+                strUser.c_str(),
+                (long)expires);
+  }
+  else if (REST_FORMAT_IS_JSON_BASED(format)) {
+
+    json output;
+
+    output["success"]     = true;
+    output["code"]        = 1;
+    output["message"]     = "success";
+    output["description"] = "Success";
+    if (strToken.length()) {
+      output["vscptoken"] = strToken;
+    }
+    output["user"]    = strUser;
+    output["expires"] = (long)expires;
+
+    restsrv_appendJSON(buf, format, output);
+  }
+
+  restsrv_sendBuffer(conn, format, 200, buf);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// restsrv_handleRequest
+//
+
+static int
+restsrv_handleRequest(struct mg_connection* conn, void* cbdata)
 {
   char bufBody[32000]; // Buffer for body (POST) data
   int len_post_data;
@@ -679,7 +1099,7 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
   // Check pointer
   if (!conn || !(ctx = mg_get_context(conn)) ||
       !(reqinfo = mg_get_request_info(conn))) {
-    spdlog::get("logger")->error("[REST] - invalid pointers");
+    pObj->m_logger->error("[REST] - invalid pointers");
     return WEB_ERROR;
   }
 
@@ -694,7 +1114,7 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
   vscp_getTimeString(date, sizeof(date), &curtime);
 
   // Set defaults
-  keypairs["FORMAT"] = "plain";
+  keypairs["FORMAT"] = "PLAIN";
   keypairs["OP"]     = "open";
 
   if (NULL != strstr(method, "POST")) {
@@ -725,6 +1145,13 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
       keypairs["VSCPSESSION"] = std::string(buf);
     }
 
+    // token
+    if (NULL != (pHeader = mg_get_header(conn, "vscptoken"))) {
+      memset(buf, 0, sizeof(buf));
+      strncpy(buf, pHeader, std::min(sizeof(buf) - 1, strlen(pHeader)));
+      keypairs["VSCPTOKEN"] = std::string(buf);
+    }
+
     pParams  = bufBody; // Parameters is in the body
     lenParam = len_post_data;
   }
@@ -757,15 +1184,47 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
         keypairs["VSCPSESSION"] = std::string(buf);
       }
 
+      if (0 < mg_get_var(reqinfo->query_string,
+                         strlen(reqinfo->query_string),
+                         "vscptoken",
+                         buf,
+                         sizeof(buf))) {
+        keypairs["VSCPTOKEN"] = std::string(buf);
+      }
+
       pParams  = reqinfo->query_string; // Parameters is in query string
       lenParam = strlen(reqinfo->query_string);
     }
   }
 
+  // Bearer token in Authorization header
+  {
+    const char* pAuth = mg_get_header(conn, "Authorization");
+    if ((NULL != pAuth) && (0 == strncasecmp(pAuth, "Bearer ", 7))) {
+      std::string strToken = std::string(pAuth + 7);
+      vscp_trim(strToken);
+      keypairs["VSCPTOKEN"] = strToken;
+    }
+  }
+
   // format
   if (0 < mg_get_var(pParams, lenParam, "format", buf, sizeof(buf))) {
     keypairs["FORMAT"] = vscp_upper(std::string(buf));
   }
+  else {
+    // No explicit format - a binary format can be requested
+    // with the Accept header
+    const char* pAccept = mg_get_header(conn, "Accept");
+    if (NULL != pAccept) {
+      int acceptFormat = restsrv_getAcceptFormat(pAccept);
+      if (REST_FORMAT_CBOR == acceptFormat) {
+        keypairs["FORMAT"] = "CBOR";
+      }
+      else if (REST_FORMAT_MSGPACK == acceptFormat) {
+        keypairs["FORMAT"] = "MSGPACK";
+      }
+    }
+  }
 
   // op
   if (0 < mg_get_var(pParams, lenParam, "op", buf, sizeof(buf))) {
@@ -908,14 +1367,19 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
   else if ("JSONP" == keypairs["FORMAT"]) {
     format = REST_FORMAT_JSONP;
   }
+  else if ("CBOR" == keypairs["FORMAT"]) {
+    format = REST_FORMAT_CBOR;
+  }
+  else if (("MSGPACK" == keypairs["FORMAT"]) ||
+           ("MESSAGEPACK" == keypairs["FORMAT"])) {
+    format = REST_FORMAT_MSGPACK;
+  }
   else {
 
-    websrv_sendheader(conn, 400, "text/plain");
-    mg_write(conn,
-             REST_PLAIN_ERROR_UNSUPPORTED_FORMAT,
-             strlen(REST_PLAIN_ERROR_UNSUPPORTED_FORMAT));
-    mg_write(conn, "", 0); // Terminator
-    spdlog::get("logger")->debug("[REST] - invalid format ");
+    CWebBuffer buf(256);
+    buf.append(REST_PLAIN_ERROR_UNSUPPORTED_FORMAT);
+    websrv_sendBuffer(conn, 400, REST_MIME_TYPE_PLAIN, buf);
+    pObj->m_logger->debug("[REST] - invalid format ");
     return WEB_ERROR;
   }
 
@@ -926,6 +1390,79 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
     pSession = restsrv_get_session(conn, keypairs["VSCPSESSION"], cbdata);
   }
 
+  // A signed token authenticates without a password check. Status is
+  // answered without a session and open creates one. A new token always
+  // needs the password, so a leaked token can not be renewed.
+  bool bToken = false;
+  if ((NULL == pSession) && ("" != keypairs["VSCPTOKEN"]) &&
+      ("TOKEN" != keypairs["OP"]) && pObj->m_rest_token_lifetime &&
+      pObj->m_bKeyFromFile) {
+
+    std::string strUser;
+    std::string strTag;
+    time_t expires;
+
+    bool bValid = restsrv_validateToken(pObj->m_vscp_key,
+                                        keypairs["VSCPTOKEN"],
+                                        strUser,
+                                        strTag,
+                                        expires);
+
+    // The token is bound to the password the user had when it was
+    // issued, so a password change revokes it. The host check is the
+    // same as for a password login.
+    if (bValid) {
+      bValid = false;
+      pthread_mutex_lock(&pObj->m_mutex_UserList);
+      CUserItem* pTokenUser = pObj->m_userList.getUser(strUser);
+      if (NULL != pTokenUser) {
+        std::string strCurrent =
+          restsrv_getTokenTag(pObj->m_vscp_key, pTokenUser->getPassword());
+        bValid = (strCurrent.length() == strTag.length()) &&
+                 (0 == CRYPTO_memcmp(strCurrent.c_str(),
+                                     strTag.c_str(),
+                                     strTag.length())) &&
+                 (1 == pTokenUser->isAllowedToConnect(
+                         inet_addr(reqinfo->remote_addr)));
+      }
+      pthread_mutex_unlock(&pObj->m_mutex_UserList);
+    }
+
+    if (!bValid) {
+
+      pObj->m_logger->error(
+        "[REST] Invalid or expired token. Client [{}]",
+        reqinfo->remote_addr);
+
+      restsrv_error(conn,
+                    pSession,
+                    format,
+                    REST_ERROR_CODE_INVALID_SESSION,
+                    cbdata);
+
+      return WEB_ERROR;
+    }
+
+    if (("0" == keypairs["OP"]) || ("STATUS" == keypairs["OP"])) {
+      restsrv_sendStatus(conn, format, "", 0, pObj);
+      return WEB_OK;
+    }
+    else if (("1" == keypairs["OP"]) || ("OPEN" == keypairs["OP"])) {
+      // Open a session for the token user. Password check is not needed.
+      keypairs["VSCPUSER"] = strUser;
+      bToken                = true;
+    }
+    else {
+      // Other operations need a session
+      restsrv_error(conn,
+                    pSession,
+                    format,
+                    REST_ERROR_CODE_INVALID_SESSION,
+                    cbdata);
+      return WEB_ERROR;
+    }
+  }
+
   if (NULL == pSession) {
 
     // Get user
@@ -939,7 +1476,7 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
                         std::string(reqinfo->remote_addr).c_str(),
                         (const char*)keypairs[("VSCPUSER")].c_str());
 
-      spdlog::get("logger")->error("[REST] {}", strErr);
+      pObj->m_logger->error("[REST] {}", strErr);
 
       restsrv_error(conn,
                     pSession,
@@ -953,9 +1490,13 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
     // Check if remote ip is valid
     bool bValidHost;
 
+    // The password hash is copied while the user list is locked as a
+    // reload of the configuration can free the user item
+    std::string strPasswordHash;
     pthread_mutex_lock(&pObj->m_mutex_UserList);
     bValidHost =
       (1 == pUserItem->isAllowedToConnect(inet_addr(reqinfo->remote_addr)));
+    strPasswordHash = pUserItem->getPassword();
     pthread_mutex_unlock(&pObj->m_mutex_UserList);
     if (!bValidHost) {
 
@@ -964,7 +1505,7 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
         reqinfo->remote_addr,
         (const char*)keypairs["VSCPUSER"].c_str());
 
-      spdlog::get("logger")->error("[REST] {}", strErr);
+      pObj->m_logger->error("[REST] {}", strErr);
 
       restsrv_error(conn,
                     pSession,
@@ -975,21 +1516,44 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
       return WEB_ERROR;
     }
 
-    // Is this an authorised user?
-    pthread_mutex_lock(&pObj->m_mutex_UserList);
-    CUserItem* pValidUser =
-      pObj->m_userList.validateUser(keypairs["VSCPUSER"],
-                                    keypairs["VSCPSECRET"]);
-    pthread_mutex_unlock(&pObj->m_mutex_UserList);
+    // Is this an authorised user? Already done if we got here with a
+    // valid token.
+    // A recent successful verification of the same credentials saves
+    // the expensive password check.
+    CUserItem* pValidUser = pUserItem;
+    if (bToken) {
+      // Token already checked
+    }
+    else if (pObj->m_credentialCache.isValid(keypairs["VSCPUSER"],
+                                             keypairs["VSCPSECRET"],
+                                             strPasswordHash)) {
+      pObj->m_metrics.m_authCacheHits.inc();
+    }
+    else {
+      struct timespec start = webmetrics_now();
+      pthread_mutex_lock(&pObj->m_mutex_UserList);
+      pValidUser = pObj->m_userList.validateUser(keypairs["VSCPUSER"],
+                                                 keypairs["VSCPSECRET"]);
+      pthread_mutex_unlock(&pObj->m_mutex_UserList);
+      pObj->m_metrics.m_authLatency.recordSince(start);
+
+      if (NULL != pValidUser) {
+        pObj->m_credentialCache.add(keypairs["VSCPUSER"],
+                                    keypairs["VSCPSECRET"],
+                                    strPasswordHash);
+      }
+    }
 
     if (NULL == pValidUser) {
 
+      pObj->m_metrics.m_authFailure.inc();
+
       std::string strErr = vscp_str_format(
         "[REST Client] User [%s] NOT allowed to connect. Client [%s]",
         (const char*)keypairs["VSCPUSER"].c_str(),
         reqinfo->remote_addr);
 
-      spdlog::get("logger")->error("[REST] {}", strErr);
+      pObj->m_logger->error("[REST] {}", strErr);
 
       restsrv_error(conn,
                     pSession,
@@ -1000,6 +1564,43 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
       return WEB_ERROR;
     }
 
+    pObj->m_metrics.m_authSuccess.inc();
+
+    // Get a signed token. No session is created.
+    if ("TOKEN" == keypairs["OP"]) {
+
+      std::string strToken;
+      time_t expires = time(NULL) + pObj->m_rest_token_lifetime;
+
+      if (!pObj->m_rest_token_lifetime || !pObj->m_bKeyFromFile ||
+          !restsrv_createToken(pObj->m_vscp_key,
+                               pUserItem->getUserName(),
+                               strPasswordHash,
+                               expires,
+                               strToken)) {
+
+        pObj->m_logger->error(
+          "[REST] Unable to create token for user [{}]. Tokens need "
+          "a key file and a non zero token lifetime.",
+          keypairs["VSCPUSER"]);
+
+        restsrv_error(conn,
+                      pSession,
+                      format,
+                      REST_ERROR_CODE_GENERAL_FAILURE,
+                      cbdata);
+
+        return WEB_ERROR;
+      }
+
+      restsrv_doGetToken(conn,
+                         format,
+                         strToken,
+                         pUserItem->getUserName(),
+                         expires);
+      return WEB_OK;
+    }
+
     if (NULL == (pSession = restsrv_add_session(conn, pUserItem, cbdata))) {
 
       // Hm,,, did not work out well...
@@ -1008,7 +1609,7 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
         ("[REST Client] Unable to create new session for user [%s]\n"),
         (const char*)keypairs[("VSCPUSER")].c_str());
 
-      spdlog::get("logger")->error("[REST] {}", strErr);
+      pObj->m_logger->error("[REST] {}", strErr);
 
       restsrv_error(conn,
                     pSession,
@@ -1021,7 +1622,7 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
 
     // Only the "open" command is allowed here
     if (("1" == keypairs["OP"]) || ("OPEN" == keypairs["OP"])) {
-      spdlog::get("logger")->debug("[REST] - doOpen format={}", format);
+      pObj->m_logger->debug("[REST] - doOpen format={}", format);
       restsrv_doOpen(conn, pSession, format, cbdata);
       return WEB_OK;
     }
@@ -1032,7 +1633,7 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
       "[REST Client] Unable to create new session for user [%s]",
       (const char*)keypairs[("VSCPUSER")].c_str());
 
-    spdlog::get("logger")->error("[REST] {}", strErr);
+    pObj->m_logger->error("[REST] {}", strErr);
 
     restsrv_error(conn,
                   pSession,
@@ -1056,7 +1657,7 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
       std::string(reqinfo->remote_addr).c_str(),
       (const char*)keypairs[("VSCPUSER")].c_str());
 
-    spdlog::get("logger")->error("[REST] {}", strErr);
+    pObj->m_logger->error("[REST] {}", strErr);
 
     restsrv_error(conn,
                   pSession,
@@ -1071,11 +1672,12 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
   //                  * * * User is validated * * *
   // ------------------------------------------------------------------------
 
-  std::string strErr = vscp_str_format(
-    ("[REST Client] User [%s] Host [%s] allowed to connect. \n"),
-    (const char*)keypairs[("VSCPUSER")].c_str(),
-    std::string(reqinfo->remote_addr).c_str());
-  spdlog::get("logger")->debug("[REST] {}", strErr);
+  if (pObj->m_logger->should_log(spdlog::level::debug)) {
+    pObj->m_logger->debug(
+      "[REST] [REST Client] User [{}] Host [{}] allowed to connect.",
+      keypairs["VSCPUSER"],
+      reqinfo->remote_addr);
+  }
 
   //   *************************************************************
   //   * * * * * * * *  Status (hold session open)   * * * * * * * *
@@ -1085,7 +1687,7 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
       restsrv_doStatus(conn, pSession, format, cbdata);
     }
     catch (...) {
-      spdlog::get("logger")->error(
+      pObj->m_logger->error(
         "[REST] Exception occurred doing restsrv_doStatus");
     }
   }
@@ -1098,7 +1700,7 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
       restsrv_doOpen(conn, pSession, format, cbdata);
     }
     catch (...) {
-      spdlog::get("logger")->error(
+      pObj->m_logger->error(
         "[REST] Exception occurred doing restsrv_doOpen");
     }
   }
@@ -1111,7 +1713,7 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
       restsrv_doClose(conn, pSession, format, cbdata);
     }
     catch (...) {
-      spdlog::get("logger")->error(
+      pObj->m_logger->error(
         "[REST] Exception occurred doing restsrv_doClose");
     }
   }
@@ -1127,7 +1729,7 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
         restsrv_doSendEvent(conn, pSession, format, &vscpevent, cbdata);
       }
       catch (...) {
-        spdlog::get("logger")->error(
+        pObj->m_logger->error(
           "[REST] Exception occurred doing restsrv_doSendEvent");
       }
     }
@@ -1153,7 +1755,7 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
       restsrv_doReceiveEvent(conn, pSession, format, count, cbdata);
     }
     catch (...) {
-      spdlog::get("logger")->error(
+      pObj->m_logger->error(
         "[REST] Exception occurred doing restsrv_doReceiveEvent");
     }
   }
@@ -1192,7 +1794,7 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
       restsrv_doSetFilter(conn, pSession, format, vscpfilter, cbdata);
     }
     catch (...) {
-      spdlog::get("logger")->error(
+      pObj->m_logger->error(
         "[REST] Exception occurred doing restsrv_doSetFilter");
     }
   }
@@ -1206,7 +1808,7 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
       restsrv_doClearQueue(conn, pSession, format, cbdata);
     }
     catch (...) {
-      spdlog::get("logger")->error(
+      pObj->m_logger->error(
         "[REST] Exception occurred doing restsrv_doClearQueue");
     }
   }
@@ -1238,7 +1840,7 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
                                    cbdata);
       }
       catch (...) {
-        spdlog::get("logger")->error(
+        pObj->m_logger->error(
           "[REST] Exception occurred doing restsrv_doWriteMeasurement");
       }
     }
@@ -1261,7 +1863,7 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
         restsrv_doFetchMDF(conn, pSession, format, keypairs[("URL")], cbdata);
       }
       catch (...) {
-        spdlog::get("logger")->error(
+        pObj->m_logger->error(
           "[REST] Exception occurred doing restsrv_doFetchMDF");
       }
     }
@@ -1277,13 +1879,34 @@ websrv_restapi(struct mg_connection* conn, void* cbdata)
   // Unrecognised operation
 
   else {
-    spdlog::get("logger")->error("[REST] restapi - Missing data.");
+    pObj->m_logger->error("[REST] restapi - Missing data.");
     restsrv_error(conn, pSession, format, REST_ERROR_CODE_MISSING_DATA, cbdata);
   }
 
   return WEB_OK;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// websrv_restapi
+//
+
+int
+websrv_restapi(struct mg_connection* conn, void* cbdata)
+{
+  CWebObj* pObj = (CWebObj*)cbdata;
+  if (NULL == pObj) {
+    return WEB_ERROR;
+  }
+
+  struct timespec start = webmetrics_now();
+  int rv                = restsrv_handleRequest(conn, cbdata);
+
+  pObj->m_metrics.m_restRequests.inc();
+  pObj->m_metrics.m_restLatency.recordSince(start);
+
+  return rv;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // restsrv_doOpen
 //
@@ -1294,7 +1917,7 @@ restsrv_doOpen(struct mg_connection* conn,
                int format,
                void* cbdata)
 {
-  char wrkbuf[256];
+  CWebBuffer buf(1024);
 
   CWebObj* pObj = (CWebObj*)cbdata;
   if (NULL == pObj) {
@@ -1312,139 +1935,49 @@ restsrv_doOpen(struct mg_connection* conn,
     pSession->m_pClientItem->m_bOpen = true;
 
     if (REST_FORMAT_PLAIN == format) {
-
-      websrv_sendSetCookieHeader(conn,
-                                 200,
-                                 REST_MIME_TYPE_PLAIN,
-                                 pSession->m_sid);
-
-#ifdef WIN32
-      int n = _snprintf(wrkbuf,
-                        sizeof(wrkbuf),
-                        "1 1 Success vscpsession=%s nEvents=%zd",
-                        pSession->sid,
-                        pSession->pClientItem->m_clientInputQueue.size());
-#else
-      int n = snprintf(wrkbuf,
-                       sizeof(wrkbuf),
-                       "1 1 Success vscpsession=%s nEvents=%zu",
-                       pSession->m_sid,
-                       pSession->m_pClientItem->m_clientInputQueue.size());
-#endif
-      mg_write(conn, wrkbuf, n);
-      mg_write(conn, "", 0); // Terminator
-      return;
+      buf.appendf("1 1 Success vscpsession=%s nEvents=%zu",
+                  pSession->m_sid,
+                  pSession->m_pClientItem->m_clientInputQueue.size());
     }
     else if (REST_FORMAT_CSV == format) {
-
-      websrv_sendSetCookieHeader(conn,
-                                 200,
-                                 REST_MIME_TYPE_CSV,
-                                 pSession->m_sid);
-
-#ifdef WIN32
-      _snprintf(wrkbuf,
-                sizeof(wrkbuf),
-                "success-code,error-code,message,description,"
-                "vscpsession,nEvents\r\n1,1,Success,Success. 1,1"
-                ",Success,Success,%s,%zd",
-                pSession->sid,
-                pSession->pClientItem->m_clientInputQueue.size());
-#else
-      snprintf(wrkbuf,
-               sizeof(wrkbuf),
-               "success-code,error-code,message,description,"
-               "vscpsession,nEvents\r\n1,1,Success,Success. 1,1,"
-               "Success,Success,%s,%zu",
-               pSession->m_sid,
-               pSession->m_pClientItem->m_clientInputQueue.size());
-#endif
-      mg_write(conn, wrkbuf, strlen(wrkbuf));
-      mg_write(conn, "", 0); // Terminator
-      return;
+      buf.appendf("success-code,error-code,message,description,"
+                  "vscpsession,nEvents\r\n1,1,Success,Success. 1,1,"
+                  "Success,Success,%s,%zu",
+                  pSession->m_sid,
+                  pSession->m_pClientItem->m_clientInputQueue.size());
     }
     else if (REST_FORMAT_XML == format) {
-
-      websrv_sendSetCookieHeader(conn,
-                                 200,
-                                 REST_MIME_TYPE_XML,
-                                 pSession->m_sid);
-
-#ifdef WIN32
-      nprintf(wrkbuf,
-              sizeof(wrkbuf),
-              "<vscp-rest success = \"true\" code = "
-              "\"1\" message = \"Success.\" description = "
-              "\"Success.\" ><vscpsession>%s</vscpsession>"
-              "<nEvents>%zd</nEvents></vscp-rest>",
-              pSession->sid,
-              pSession->pClientItem->m_clientInputQueue.size());
-#else
-      snprintf(wrkbuf,
-               sizeof(wrkbuf),
-               "<vscp-rest success = \"true\" code = \"1\" "
-               "message = \"Success.\" description = \"Success.\" "
-               "><vscpsession>%s</vscpsession><nEvents>%zu"
-               "</nEvents></vscp-rest>",
-               pSession->m_sid,
-               pSession->m_pClientItem->m_clientInputQueue.size());
-#endif
-      mg_write(conn, wrkbuf, strlen(wrkbuf));
-      mg_write(conn, "", 0); // Terminator
-      return;
-    }
-    else if (REST_FORMAT_JSON == format) {
-
-      json output;
-
-      websrv_sendSetCookieHeader(conn,
-                                 200,
-                                 REST_MIME_TYPE_JSON,
-                                 pSession->m_sid);
-
-      output["success"]     = true;
-      output["code"]        = 1;
-      output["message"]     = "success";
-      output["description"] = "Success";
-      output["vscpsession"] = pSession->m_sid;
-      output["nEvents"] = pSession->m_pClientItem->m_clientInputQueue.size();
-      std::string s     = output.dump();
-      mg_write(conn, s.c_str(), s.length());
-
-      return;
+      buf.appendf("<vscp-rest success = \"true\" code = \"1\" "
+                  "message = \"Success.\" description = \"Success.\" "
+                  "><vscpsession>%s</vscpsession><nEvents>%zu"
+                  "</nEvents></vscp-rest>",
+                  pSession->m_sid,
+                  pSession->m_pClientItem->m_clientInputQueue.size());
     }
-    else if (REST_FORMAT_JSONP == format) {
+    else if (REST_FORMAT_IS_JSON_BASED(format)) {
 
       json output;
 
-      websrv_sendSetCookieHeader(conn,
-                                 200,
-                                 REST_MIME_TYPE_JSONP,
-                                 pSession->m_sid);
-
-      // Write JSONP start block
-      mg_write(conn, REST_JSONP_START, strlen(REST_JSONP_START));
-
       output["success"]     = true;
       output["code"]        = 1;
       output["message"]     = "success";
       output["description"] = "Success";
       output["vscpsession"] = pSession->m_sid;
       output["nEvents"] = pSession->m_pClientItem->m_clientInputQueue.size();
-      std::string s     = output.dump();
-      mg_write(conn, s.c_str(), s.length());
 
-      // Write JSONP end block
-      mg_write(conn, REST_JSONP_END, strlen(REST_JSONP_END));
-      return;
+      restsrv_appendJSON(buf, format, output);
     }
     else {
-      websrv_sendheader(conn, 400, REST_MIME_TYPE_PLAIN);
-      mg_write(conn,
-               REST_PLAIN_ERROR_UNSUPPORTED_FORMAT,
-               strlen(REST_PLAIN_ERROR_UNSUPPORTED_FORMAT));
+      buf.append(REST_PLAIN_ERROR_UNSUPPORTED_FORMAT);
+      websrv_sendBuffer(conn, 400, REST_MIME_TYPE_PLAIN, buf);
       return;
     }
+
+    websrv_sendBuffer(conn,
+                      200,
+                      restsrv_getMimeType(format),
+                      buf,
+                      pSession->m_sid);
   }
   else { // Unable to create session
     restsrv_error(conn,
@@ -1467,7 +2000,7 @@ restsrv_doClose(struct mg_connection* conn,
                 int format,
                 void* cbdata)
 {
-  char wrkbuf[256];
+  CWebBuffer buf(1024);
 
   CWebObj* pObj = (CWebObj*)cbdata;
   if (NULL == pObj) {
@@ -1476,10 +2009,6 @@ restsrv_doClose(struct mg_connection* conn,
 
   if (NULL != pSession) {
 
-    char sid[32 + 1];
-    memset(sid, 0, sizeof(sid));
-    memcpy(sid, pSession->m_sid, sizeof(sid));
-
     // We should close the session
 
     // Mark as closed
@@ -1488,71 +2017,14 @@ restsrv_doClose(struct mg_connection* conn,
     // Note activity
     pSession->m_lastActiveTime = time(NULL);
 
-    if (REST_FORMAT_PLAIN == format) {
-
-      websrv_sendheader(conn, 200, REST_MIME_TYPE_PLAIN);
-      mg_write(conn,
-               REST_PLAIN_ERROR_SUCCESS,
-               strlen(REST_PLAIN_ERROR_SUCCESS));
-      mg_write(conn, "", 0); // Terminator
-      return;
-    }
-    else if (REST_FORMAT_CSV == format) {
-
-      websrv_sendheader(conn, 200, REST_MIME_TYPE_CSV);
-#ifdef WIN32
-      _snprintf(wrkbuf, sizeof(wrkbuf), REST_CSV_ERROR_SUCCESS);
-#else
-      snprintf(wrkbuf, sizeof(wrkbuf), REST_CSV_ERROR_SUCCESS);
-#endif
-      mg_write(conn, wrkbuf, strlen(wrkbuf));
-      mg_write(conn, "", 0); // Terminator
-      return;
-    }
-    else if (REST_FORMAT_XML == format) {
-
-      websrv_sendheader(conn, 200, REST_MIME_TYPE_XML);
-#ifdef WIN32
-      _snprintf(wrkbuf, sizeof(wrkbuf), REST_XML_ERROR_SUCCESS);
-#else
-      snprintf(wrkbuf, sizeof(wrkbuf), REST_XML_ERROR_SUCCESS);
-#endif
-      mg_write(conn, wrkbuf, strlen(wrkbuf));
-      mg_write(conn, "", 0); // Terminator
-      return;
-    }
-    else if (REST_FORMAT_JSON == format) {
-
-      websrv_sendheader(conn, 200, REST_MIME_TYPE_JSON);
-#ifdef WIN32
-      _snprintf(wrkbuf, sizeof(wrkbuf), REST_JSON_ERROR_SUCCESS);
-#else
-      snprintf(wrkbuf, sizeof(wrkbuf), REST_JSON_ERROR_SUCCESS);
-#endif
-      mg_write(conn, wrkbuf, strlen(wrkbuf));
-      mg_write(conn, "", 0); // Terminator
+    if ((format < REST_FORMAT_PLAIN) || (format >= REST_FORMAT_COUNT)) {
+      buf.append(REST_PLAIN_ERROR_UNSUPPORTED_FORMAT);
+      websrv_sendBuffer(conn, 400, REST_MIME_TYPE_PLAIN, buf);
       return;
     }
-    else if (REST_FORMAT_JSONP == format) {
 
-      websrv_sendheader(conn, 200, REST_MIME_TYPE_JSONP);
-#ifdef WIN32
-      _snprintf(wrkbuf, sizeof(wrkbuf), REST_JSONP_ERROR_SUCCESS);
-#else
-      snprintf(wrkbuf, sizeof(wrkbuf), REST_JSONP_ERROR_SUCCESS);
-#endif
-      mg_write(conn, wrkbuf, strlen(wrkbuf));
-      mg_write(conn, "", 0); // Terminator
-      return;
-    }
-    else {
-      websrv_sendheader(conn, 400, REST_MIME_TYPE_PLAIN);
-      mg_write(conn,
-               REST_PLAIN_ERROR_UNSUPPORTED_FORMAT,
-               strlen(REST_PLAIN_ERROR_UNSUPPORTED_FORMAT));
-      mg_write(conn, "", 0); // Terminator
-      return;
-    }
+    restsrv_appendError(buf, format, REST_ERROR_CODE_SUCCESS);
+    restsrv_sendBuffer(conn, format, 200, buf);
   }
   else { // session not found
     restsrv_error(conn,
@@ -1565,6 +2037,67 @@ restsrv_doClose(struct mg_connection* conn,
   return;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// restsrv_sendStatus
+//
+// Status reply. A status call made with a token has no session, so sid
+// is empty and there are no events.
+//
+
+static void
+restsrv_sendStatus(struct mg_connection* conn,
+                   int format,
+                   const char* sid,
+                   size_t nEvents,
+                   CWebObj* pObj)
+{
+  CWebBuffer buf(1024);
+
+  if (REST_FORMAT_PLAIN == format) {
+    buf.append(REST_PLAIN_ERROR_SUCCESS);
+    buf.appendf("1 1 Success vscpsession=%s nEvents=%zu", sid, nEvents);
+  }
+  else if (REST_FORMAT_CSV == format) {
+    buf.appendf("success-code,error-code,message,description,vscpsession,"
+                "nEvents\r\n1,1,Success,Success. 1,1,Success,Sucess,%s,%zu",
+                sid,
+                nEvents);
+  }
+  else if (REST_FORMAT_XML == format) {
+    buf.appendf("<vscp-rest success = \"true\" code = \"1\" message = "
+                "\"Success.\" description = \"Success.\" "
+                "><vscpsession>%s</vscpsession><nEvents>%zu</nEvents></"
+                "vscp-rest>",
+                sid,
+                nEvents);
+  }
+  else if (REST_FORMAT_IS_JSON_BASED(format)) {
+
+    json output;
+
+    output["success"]     = true;
+    output["code"]        = 1;
+    output["message"]     = "success";
+    output["description"] = "Success";
+    output["vscpsession"] = sid;
+    output["nEvents"]     = nEvents;
+
+    // Memory used by queues and sessions
+    json memory;
+    pObj->m_memory.toJSON(memory);
+    output["memory"] = memory;
+
+    restsrv_appendJSON(buf, format, output);
+  }
+  else {
+    buf.append(REST_PLAIN_ERROR_UNSUPPORTED_FORMAT);
+    websrv_sendBuffer(conn, 400, REST_MIME_TYPE_PLAIN, buf);
+    return;
+  }
+
+  restsrv_sendBuffer(conn, format, 200, buf);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // restsrv_doStatus
 //
@@ -1575,9 +2108,6 @@ restsrv_doStatus(struct mg_connection* conn,
                  int format,
                  void* cbdata)
 {
-  char buf[2048];
-  char wrkbuf[256];
-
   CWebObj* pObj = (CWebObj*)cbdata;
   if (NULL == pObj) {
     return;
@@ -1588,114 +2118,11 @@ restsrv_doStatus(struct mg_connection* conn,
     // Note activity
     pSession->m_lastActiveTime = time(NULL);
 
-    if (REST_FORMAT_PLAIN == format) {
-      websrv_sendheader(conn, 200, REST_MIME_TYPE_PLAIN);
-      mg_write(conn,
-               REST_PLAIN_ERROR_SUCCESS,
-               strlen(REST_PLAIN_ERROR_SUCCESS));
-      memset(buf, 0, sizeof(buf));
-#ifdef WIN32
-      _snprintf(wrkbuf,
-                sizeof(wrkbuf),
-                "vscpsession=%s nEvents=%zd",
-                pSession->sid,
-                pSession->pClientItem->m_clientInputQueue.size());
-#else
-      snprintf(wrkbuf,
-               sizeof(wrkbuf),
-               "1 1 Success vscpsession=%s nEvents=%zu",
-               pSession->m_sid,
-               pSession->m_pClientItem->m_clientInputQueue.size());
-#endif
-      mg_write(conn, wrkbuf, strlen(wrkbuf));
-      mg_write(conn, "", 0); // Terminator
-      return;
-    }
-    else if (REST_FORMAT_CSV == format) {
-      websrv_sendheader(conn, 200, REST_MIME_TYPE_CSV);
-#ifdef WIN32
-      _snprintf(wrkbuf,
-                sizeof(wrkbuf),
-                "success-code,error-code,message,description,vscpsession,"
-                "nEvents\r\n1,1,Success,Success. 1,1,Success,Sucess,%s,%zd",
-                pSession->sid,
-                pSession->pClientItem->m_clientInputQueue.size());
-#else
-      snprintf(wrkbuf,
-               sizeof(wrkbuf),
-               "success-code,error-code,message,description,vscpsession,"
-               "nEvents\r\n1,1,Success,Success. 1,1,Success,Sucess,%s,%zu",
-               pSession->m_sid,
-               pSession->m_pClientItem->m_clientInputQueue.size());
-#endif
-      mg_write(conn, wrkbuf, strlen(wrkbuf));
-      mg_write(conn, "", 0); // Terminator
-      return;
-    }
-    else if (REST_FORMAT_XML == format) {
-      websrv_sendheader(conn, 200, REST_MIME_TYPE_XML);
-#ifdef WIN32
-      _snprintf(wrkbuf,
-                sizeof(wrkbuf),
-                "<vscp-rest success = \"true\" code = \"1\" message = "
-                "\"Success.\" description = \"Success.\" "
-                "><vscpsession>%s</vscpsession><nEvents>%zd</nEvents></"
-                "vscp-rest>",
-                pSession->sid,
-                pSession->pClientItem->m_clientInputQueue.size());
-#else
-      snprintf(wrkbuf,
-               sizeof(wrkbuf),
-               "<vscp-rest success = \"true\" code = \"1\" message = "
-               "\"Success.\" description = \"Success.\" "
-               "><vscpsession>%s</vscpsession><nEvents>%zu</nEvents></"
-               "vscp-rest>",
-               pSession->m_sid,
-               pSession->m_pClientItem->m_clientInputQueue.size());
-#endif
-      mg_write(conn, wrkbuf, strlen(wrkbuf));
-      mg_write(conn, "", 0); // Terminator
-      return;
-    }
-    else if ((REST_FORMAT_JSON == format) || (REST_FORMAT_JSONP == format)) {
-
-      json output;
-
-      if (REST_FORMAT_JSON == format) {
-        websrv_sendheader(conn, 200, REST_MIME_TYPE_JSON);
-      }
-      else {
-
-        websrv_sendheader(conn, 200, REST_MIME_TYPE_JSONP);
-
-        // Write JSONP start block
-        mg_write(conn, REST_JSONP_START, strlen(REST_JSONP_START));
-      }
-
-      output["success"]     = true;
-      output["code"]        = 1;
-      output["message"]     = "success";
-      output["description"] = "Success";
-      output["vscpsession"] = pSession->m_sid;
-      output["nEvents"] = pSession->m_pClientItem->m_clientInputQueue.size();
-      std::string s     = output.dump();
-      mg_write(conn, s.c_str(), s.length());
-
-      if (REST_FORMAT_JSONP == format) {
-        // Write JSONP end block
-        mg_write(conn, REST_JSONP_END, strlen(REST_JSONP_END));
-      }
-
-      return;
-    }
-    else {
-      websrv_sendheader(conn, 400, REST_MIME_TYPE_PLAIN);
-      mg_write(conn,
-               REST_PLAIN_ERROR_UNSUPPORTED_FORMAT,
-               strlen(REST_PLAIN_ERROR_UNSUPPORTED_FORMAT));
-      mg_write(conn, "", 0); // Terminator
-      return;
-    }
+    restsrv_sendStatus(conn,
+                       format,
+                       pSession->m_sid,
+                       pSession->m_pClientItem->m_clientInputQueue.size(),
+                       pObj);
 
   } // No session
   else {
@@ -1869,9 +2296,101 @@ restsrv_doSendEvent(struct mg_connection* conn,
   return;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// restsrv_appendEventXML
+//
+
+void
+restsrv_appendEventXML(CWebBuffer& buf, const vscpEvent* pEvent)
+{
+  std::string str;
+
+  buf.append("<event>");
+  buf.appendf("<head>%d</head>", pEvent->head);
+  buf.appendf("<vscpclass>%d</vscpclass>", pEvent->vscp_class);
+  buf.appendf("<vscptype>%d</vscptype>", pEvent->vscp_type);
+  buf.appendf("<obid>%lu</obid>", (unsigned long)pEvent->obid);
+
+  vscp_getDateStringFromEvent(str, pEvent);
+  buf.append("<datetime>");
+  buf.append(str);
+  buf.append("</datetime>");
+
+  buf.appendf("<timestamp>%lu</timestamp>", (unsigned long)pEvent->timestamp);
+
+  vscp_writeGuidToString(str, pEvent);
+  buf.append("<guid>");
+  buf.append(str);
+  buf.append("</guid>");
+
+  buf.appendf("<sizedata>%d</sizedata>", pEvent->sizeData);
+
+  vscp_writeDataToString(str, pEvent);
+  buf.append("<data>");
+  buf.append(str);
+  buf.append("</data>");
+
+  if (vscp_convertEventToString(str, pEvent)) {
+    buf.append("<raw>");
+    buf.append(str);
+    buf.append("</raw>");
+  }
+
+  buf.append("</event>");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// restsrv_appendEventCSV
+//
+
+bool
+restsrv_appendEventCSV(CWebBuffer& buf, const vscpEvent* pEvent)
+{
+  std::string str;
+
+  if (!vscp_convertEventToString(str, pEvent)) {
+    return false;
+  }
+
+  buf.append("1,3,Data,Event,");
+  buf.append(str);
+  buf.append("\r\n");
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// restsrv_getEventJSON
+//
+
+void
+restsrv_getEventJSON(json& ev, const vscpEvent* pEvent)
+{
+  std::string str;
+
+  ev["head"]      = pEvent->head;
+  ev["vscpclass"] = pEvent->vscp_class;
+  ev["vscptype"]  = pEvent->vscp_type;
+  vscp_getDateStringFromEvent(str, pEvent);
+  ev["datetime"]  = (const char*)str.c_str();
+  ev["timestamp"] = pEvent->timestamp;
+  ev["obid"]      = pEvent->obid;
+  vscp_writeGuidToString(str, pEvent);
+  ev["guid"]     = (const char*)str.c_str();
+  ev["sizedata"] = pEvent->sizeData;
+  ev["data"]     = json::array();
+  for (uint16_t j = 0; j < pEvent->sizeData; j++) {
+    ev["data"].push_back(pEvent->pdata[j]);
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // restsrv_doReceiveEvent
 //
+// The whole response is built in a buffer and sent with Content-Length
+// in one go. Events to send are taken from the client queue in one lock
+// operation.
+//
 
 void
 restsrv_doReceiveEvent(struct mg_connection* conn,
@@ -1880,6 +2399,8 @@ restsrv_doReceiveEvent(struct mg_connection* conn,
                        size_t count,
                        void* cbdata)
 {
+  CWebObj* pObj = (CWebObj*)cbdata;
+
   // Check pointer
   if (NULL == conn)
     return;
@@ -1888,44 +2409,50 @@ restsrv_doReceiveEvent(struct mg_connection* conn,
 
     if (!pSession->m_pClientItem->m_clientInputQueue.empty()) {
 
-      char wrkbuf[32000];
-      std::string out;
+      CWebBuffer buf;
+      std::deque<vscpEvent*> events;
+
+      // Fetch the events we should deliver
+      pthread_mutex_lock(&pSession->m_pClientItem->m_mutexClientInputQueue);
       size_t cntAvailable = pSession->m_pClientItem->m_clientInputQueue.size();
+      size_t cntFetch     = std::min(count, cntAvailable);
+      if (pSession->m_pClientItem->m_bOpen) {
+        for (size_t i = 0; i < cntFetch; i++) {
+          events.push_back(pSession->m_pClientItem->m_clientInputQueue.front());
+          pSession->m_pClientItem->m_clientInputQueue.pop_front();
+        }
+        if (NULL != pObj) {
+          pObj->m_memory.m_clientQueues.subEvents(events);
+          pObj->m_trace.forgetIngress(events);
+          for (size_t i = 0; i < events.size(); i++) {
+            pObj->m_flowControl.subClientBytes(pSession->m_pClientItem, CWebFlowControl::eventBytes(events[i]));
+          }
+        }
+      }
+      pthread_mutex_unlock(&pSession->m_pClientItem->m_mutexClientInputQueue);
+
+      // Queue has room again
+      if (NULL != pObj) {
+        pObj->m_flowControl.notify();
+      }
 
       // Plain
       if (REST_FORMAT_PLAIN == format) {
 
-        // Send header
-        websrv_sendheader(conn, 200, REST_MIME_TYPE_PLAIN);
-
         if (pSession->m_pClientItem->m_bOpen && cntAvailable) {
 
-          sprintf(wrkbuf, "1 1 Success \r\n");
-          mg_write(conn, wrkbuf, strlen(wrkbuf));
-          sprintf(wrkbuf,
-#if WIN32
-                  "%zd events requested of %zd available "
-                  "(unfiltered) %zu will be retrieved\r\n",
-#else
-                  "%zd events requested of %zd available "
-                  "(unfiltered) %zu will be retrieved\r\n",
-#endif
-                  count,
-                  pSession->m_pClientItem->m_clientInputQueue.size(),
-                  std::min(count, cntAvailable));
-
-          mg_write(conn, wrkbuf, strlen(wrkbuf));
-
-          for (unsigned int i = 0; i < std::min(count, cntAvailable); i++) {
+          buf.append("1 1 Success \r\n");
+          buf.appendf("%zd events requested of %zd available "
+                      "(unfiltered) %zu will be retrieved\r\n",
+                      count,
+                      cntAvailable,
+                      cntFetch);
 
-            vscpEvent* pEvent;
+          for (std::deque<vscpEvent*>::iterator it = events.begin();
+               it != events.end();
+               ++it) {
 
-            pthread_mutex_lock(
-              &pSession->m_pClientItem->m_mutexClientInputQueue);
-            pEvent = pSession->m_pClientItem->m_clientInputQueue.front();
-            pSession->m_pClientItem->m_clientInputQueue.pop_front();
-            pthread_mutex_unlock(
-              &pSession->m_pClientItem->m_mutexClientInputQueue);
+            vscpEvent* pEvent = *it;
 
             if (NULL != pEvent) {
 
@@ -1934,22 +2461,16 @@ restsrv_doReceiveEvent(struct mg_connection* conn,
 
                 std::string str;
                 if (vscp_convertEventToString(str, pEvent)) {
-
-                  // Write it out
-                  strcpy((char*)wrkbuf, (const char*)"- ");
-                  strcat((char*)wrkbuf, (const char*)str.c_str());
-                  strcat((char*)wrkbuf, "\r\n");
-                  mg_write(conn, wrkbuf, strlen(wrkbuf));
+                  buf.append("- ");
+                  buf.append(str);
+                  buf.append("\r\n");
                 }
                 else {
-                  strcpy((char*)wrkbuf,
-                         "- Malformed event (internal error)\r\n");
-                  mg_write(conn, wrkbuf, strlen(wrkbuf));
+                  buf.append("- Malformed event (internal error)\r\n");
                 }
               }
               else {
-                strcpy((char*)wrkbuf, "- Event filtered out\r\n");
-                mg_write(conn, wrkbuf, strlen(wrkbuf));
+                buf.append("- Event filtered out\r\n");
               }
 
               // Remove the event
@@ -1957,87 +2478,51 @@ restsrv_doReceiveEvent(struct mg_connection* conn,
 
             } // Valid pEvent pointer
             else {
-              strcpy((char*)wrkbuf,
-                     "- Event could not be fetched (internal "
-                     "error)\r\n");
-              mg_write(conn, wrkbuf, strlen(wrkbuf));
+              buf.append("- Event could not be fetched (internal "
+                         "error)\r\n");
             }
           } // for
         }
         else { // no events available
-          sprintf(wrkbuf, REST_PLAIN_ERROR_INPUT_QUEUE_EMPTY "\r\n");
-          mg_write(conn, wrkbuf, strlen(wrkbuf));
+          buf.append(REST_PLAIN_ERROR_INPUT_QUEUE_EMPTY "\r\n");
         }
+
+        websrv_sendBuffer(conn, 200, REST_MIME_TYPE_PLAIN, buf);
       }
 
       // CSV
       else if (REST_FORMAT_CSV == format) {
 
-        // Send header
-        websrv_sendheader(conn,
-                          200,
-                          /*REST_MIME_TYPE_CSV*/ REST_MIME_TYPE_PLAIN);
-
         if (pSession->m_pClientItem->m_bOpen && cntAvailable) {
 
-          sprintf(wrkbuf,
-                  "success-code,error-code,message,"
-                  "description,Event\r\n1,1,Success,Success."
-                  ",NULL\r\n");
-          mg_write(conn, wrkbuf, strlen(wrkbuf));
-          sprintf(wrkbuf,
-#if WIN32
-                  "1,2,Info,%zd events requested of %d available "
-                  "(unfiltered) %zu will be retrieved,NULL\r\n",
-#else
-                  "1,2,Info,%zd events requested of %lu available "
-                  "(unfiltered) %lu will be retrieved,NULL\r\n",
-#endif
-                  count,
-                  (unsigned long)cntAvailable,
-                  (unsigned long)std::min(count, cntAvailable));
-          mg_write(conn, wrkbuf, strlen(wrkbuf));
-          sprintf(wrkbuf,
-                  "1,4,Count,%zu,NULL\r\n",
-                  std::min(count, cntAvailable));
-          mg_write(conn, wrkbuf, strlen(wrkbuf));
-
-          for (unsigned int i = 0; i < std::min(count, cntAvailable); i++) {
-
-            vscpEvent* pEvent;
-
-            pthread_mutex_lock(
-              &pSession->m_pClientItem->m_mutexClientInputQueue);
-            pEvent = pSession->m_pClientItem->m_clientInputQueue.front();
-            pSession->m_pClientItem->m_clientInputQueue.pop_front();
-            pthread_mutex_unlock(
-              &pSession->m_pClientItem->m_mutexClientInputQueue);
+          buf.append("success-code,error-code,message,"
+                     "description,Event\r\n1,1,Success,Success."
+                     ",NULL\r\n");
+          buf.appendf("1,2,Info,%zd events requested of %lu available "
+                      "(unfiltered) %lu will be retrieved,NULL\r\n",
+                      count,
+                      (unsigned long)cntAvailable,
+                      (unsigned long)cntFetch);
+          buf.appendf("1,4,Count,%zu,NULL\r\n", cntFetch);
+
+          for (std::deque<vscpEvent*>::iterator it = events.begin();
+               it != events.end();
+               ++it) {
+
+            vscpEvent* pEvent = *it;
 
             if (NULL != pEvent) {
 
               if (vscp_doLevel2Filter(pEvent,
                                       &pSession->m_pClientItem->m_filter)) {
 
-                std::string str;
-                if (vscp_convertEventToString(str, pEvent)) {
-
-                  // Write it out
-                  memset((char*)wrkbuf, 0, sizeof(wrkbuf));
-                  strcpy((char*)wrkbuf, (const char*)"1,3,Data,Event,");
-                  strcat((char*)wrkbuf, (const char*)str.c_str());
-                  strcat((char*)wrkbuf, "\r\n");
-                  mg_write(conn, wrkbuf, strlen(wrkbuf));
-                }
-                else {
-                  strcpy((char*)wrkbuf,
-                         "1,2,Info,Malformed event (internal "
-                         "error)\r\n");
-                  mg_write(conn, wrkbuf, strlen(wrkbuf));
+                if (!restsrv_appendEventCSV(buf, pEvent)) {
+                  buf.append("1,2,Info,Malformed event (internal "
+                             "error)\r\n");
                 }
               }
               else {
-                strcpy((char*)wrkbuf, "1,2,Info,Event filtered out\r\n");
-                mg_write(conn, wrkbuf, strlen(wrkbuf));
+                buf.append("1,2,Info,Event filtered out\r\n");
               }
 
               // Remove the event
@@ -2045,17 +2530,19 @@ restsrv_doReceiveEvent(struct mg_connection* conn,
 
             } // Valid pEvent pointer
             else {
-              strcpy((char*)wrkbuf,
-                     "1,2,Info,Event could not be fetched "
-                     "(internal error)\r\n");
-              mg_write(conn, wrkbuf, strlen(wrkbuf));
+              buf.append("1,2,Info,Event could not be fetched "
+                         "(internal error)\r\n");
             }
           } // for
         }
         else { // no events available
-          sprintf(wrkbuf, REST_CSV_ERROR_INPUT_QUEUE_EMPTY "\r\n");
-          mg_write(conn, wrkbuf, strlen(wrkbuf));
+          buf.append(REST_CSV_ERROR_INPUT_QUEUE_EMPTY "\r\n");
         }
+
+        websrv_sendBuffer(conn,
+                          200,
+                          /*REST_MIME_TYPE_CSV*/ REST_MIME_TYPE_PLAIN,
+                          buf);
       }
 
       // XML
@@ -2064,112 +2551,29 @@ restsrv_doReceiveEvent(struct mg_connection* conn,
         int filtered = 0;
         int errors   = 0;
 
-        // Send header
-        websrv_sendheader(conn, 200, REST_MIME_TYPE_XML);
-
         if (pSession->m_pClientItem->m_bOpen && cntAvailable) {
 
-          sprintf(wrkbuf,
-                  XML_HEADER "<vscp-rest success = \"true\" "
-                             "code = \"1\" message = \"Success\" "
-                             "description = \"Success.\" >");
-          mg_write(conn, wrkbuf, strlen(wrkbuf));
-          sprintf(wrkbuf,
-                  "<info>%zd events requested of %zu available "
-                  "(unfiltered) %zu will be retrieved</info>",
-                  count,
-                  cntAvailable,
-                  std::min(count, cntAvailable));
-          mg_write(conn, wrkbuf, strlen(wrkbuf));
-
-          sprintf(wrkbuf, "<count>%zu</count>", std::min(count, cntAvailable));
-          mg_write(conn, wrkbuf, strlen(wrkbuf));
-
-          for (unsigned int i = 0; i < std::min(count, cntAvailable); i++) {
-
-            vscpEvent* pEvent;
-
-            pthread_mutex_lock(
-              &pSession->m_pClientItem->m_mutexClientInputQueue);
-            pEvent = pSession->m_pClientItem->m_clientInputQueue.front();
-            pSession->m_pClientItem->m_clientInputQueue.pop_front();
-            pthread_mutex_unlock(
-              &pSession->m_pClientItem->m_mutexClientInputQueue);
+          buf.append(XML_HEADER "<vscp-rest success = \"true\" "
+                                "code = \"1\" message = \"Success\" "
+                                "description = \"Success.\" >");
+          buf.appendf("<info>%zd events requested of %zu available "
+                      "(unfiltered) %zu will be retrieved</info>",
+                      count,
+                      cntAvailable,
+                      cntFetch);
+          buf.appendf("<count>%zu</count>", cntFetch);
+
+          for (std::deque<vscpEvent*>::iterator it = events.begin();
+               it != events.end();
+               ++it) {
+
+            vscpEvent* pEvent = *it;
 
             if (NULL != pEvent) {
 
               if (vscp_doLevel2Filter(pEvent,
                                       &pSession->m_pClientItem->m_filter)) {
-
-                std::string str;
-
-                // Write it out
-                strcpy((char*)wrkbuf, (const char*)"<event>");
-
-                // head
-                strcat((char*)wrkbuf, (const char*)"<head>");
-                strcat((char*)wrkbuf,
-                       vscp_str_format(("%d"), pEvent->head).c_str());
-                strcat((char*)wrkbuf, (const char*)"</head>");
-
-                // class
-                strcat((char*)wrkbuf, (const char*)"<vscpclass>");
-                strcat((char*)wrkbuf,
-                       vscp_str_format(("%d"), pEvent->vscp_class).c_str());
-                strcat((char*)wrkbuf, (const char*)"</vscpclass>");
-
-                // type
-                strcat((char*)wrkbuf, (const char*)"<vscptype>");
-                strcat((char*)wrkbuf,
-                       vscp_str_format(("%d"), pEvent->vscp_type).c_str());
-                strcat((char*)wrkbuf, (const char*)"</vscptype>");
-
-                // obid
-                strcat((char*)wrkbuf, (const char*)"<obid>");
-                strcat((char*)wrkbuf,
-                       vscp_str_format(("%lu"), pEvent->obid).c_str());
-                strcat((char*)wrkbuf, (const char*)"</obid>");
-
-                // datetime
-                strcat((char*)wrkbuf, (const char*)"<datetime>");
-                std::string dt;
-                vscp_getDateStringFromEvent(dt, pEvent);
-                strcat((char*)wrkbuf,
-                       vscp_str_format("%s", dt.c_str()).c_str());
-                strcat((char*)wrkbuf, (const char*)"</datetime>");
-
-                // timestamp
-                strcat((char*)wrkbuf, (const char*)"<timestamp>");
-                strcat((char*)wrkbuf,
-                       vscp_str_format(("%lu"), pEvent->timestamp).c_str());
-                strcat((char*)wrkbuf, (const char*)"</timestamp>");
-
-                // guid
-                strcat((char*)wrkbuf, (const char*)"<guid>");
-                vscp_writeGuidToString(str, pEvent);
-                strcat((char*)wrkbuf, (const char*)str.c_str());
-                strcat((char*)wrkbuf, (const char*)"</guid>");
-
-                // sizedate
-                strcat((char*)wrkbuf, (const char*)"<sizedata>");
-                strcat((char*)wrkbuf,
-                       vscp_str_format(("%d"), pEvent->sizeData).c_str());
-                strcat((char*)wrkbuf, (const char*)"</sizedata>");
-
-                // data
-                strcat((char*)wrkbuf, (const char*)"<data>");
-                vscp_writeDataToString(str, pEvent);
-                strcat((char*)wrkbuf, (const char*)str.c_str());
-                strcat((char*)wrkbuf, (const char*)"</data>");
-
-                if (vscp_convertEventToString(str, pEvent)) {
-                  strcat((char*)wrkbuf, (const char*)"<raw>");
-                  strcat((char*)wrkbuf, (const char*)str.c_str());
-                  strcat((char*)wrkbuf, (const char*)"</raw>");
-                }
-
-                strcat((char*)wrkbuf, "</event>");
-                mg_write(conn, wrkbuf, strlen(wrkbuf));
+                restsrv_appendEventXML(buf, pEvent);
               }
               else {
                 filtered++;
@@ -2184,51 +2588,29 @@ restsrv_doReceiveEvent(struct mg_connection* conn,
             }
           } // for
 
-          strcpy((char*)wrkbuf, (const char*)"<filtered>");
-          strcat((char*)wrkbuf, vscp_str_format(("%d"), filtered).c_str());
-          strcat((char*)wrkbuf, (const char*)"</filtered>");
-
-          strcat((char*)wrkbuf, (const char*)"<errors>");
-          strcat((char*)wrkbuf, vscp_str_format(("%d"), errors).c_str());
-          strcat((char*)wrkbuf, (const char*)"</errors>");
-
-          mg_write(conn, wrkbuf, strlen(wrkbuf));
+          buf.appendf("<filtered>%d</filtered>", filtered);
+          buf.appendf("<errors>%d</errors>", errors);
 
           // End tag
-          strcpy((char*)wrkbuf, "</vscp-rest>");
-          mg_write(conn, wrkbuf, strlen(wrkbuf));
+          buf.append("</vscp-rest>");
         }
         else { // no events available
-
-          sprintf(wrkbuf, REST_XML_ERROR_INPUT_QUEUE_EMPTY "\r\n");
-          mg_write(conn, wrkbuf, strlen(wrkbuf));
+          buf.append(REST_XML_ERROR_INPUT_QUEUE_EMPTY "\r\n");
         }
+
+        websrv_sendBuffer(conn, 200, REST_MIME_TYPE_XML, buf);
       }
 
-      // JSON / JSONP
-      else if ((REST_FORMAT_JSON == format) || (REST_FORMAT_JSONP == format)) {
+      // JSON / JSONP / CBOR / MessagePack
+      else if (REST_FORMAT_IS_JSON_BASED(format)) {
 
         int sentEvents = 0;
         int filtered   = 0;
         int errors     = 0;
         json output;
 
-        // Send header
-        if (REST_FORMAT_JSONP == format) {
-          websrv_sendheader(conn, 200, REST_MIME_TYPE_JSONP);
-        }
-        else {
-          websrv_sendheader(conn, 200, REST_MIME_TYPE_JSON);
-        }
-
         if (pSession->m_pClientItem->m_bOpen && cntAvailable) {
 
-          // typeof handler === 'function' &&
-          if (REST_FORMAT_JSONP == format) {
-            std::string str = ("typeof handler === 'function' && handler(");
-            mg_write(conn, (const char*)str.c_str(), str.length());
-          }
-
           output["success"]     = true;
           output["code"]        = 1;
           output["message"]     = "success";
@@ -2238,41 +2620,22 @@ restsrv_doReceiveEvent(struct mg_connection* conn,
                              "(unfiltered) %zd will be retrieved",
                              count,
                              cntAvailable,
-                             std::min(count, cntAvailable))
+                             cntFetch)
                              .c_str();
 
-          for (unsigned int i = 0; i < std::min(count, cntAvailable); i++) {
+          for (std::deque<vscpEvent*>::iterator it = events.begin();
+               it != events.end();
+               ++it) {
 
-            vscpEvent* pEvent;
-
-            pthread_mutex_lock(
-              &pSession->m_pClientItem->m_mutexClientInputQueue);
-            pEvent = pSession->m_pClientItem->m_clientInputQueue.front();
-            pSession->m_pClientItem->m_clientInputQueue.pop_front();
-            pthread_mutex_unlock(
-              &pSession->m_pClientItem->m_mutexClientInputQueue);
+            vscpEvent* pEvent = *it;
 
             if (NULL != pEvent) {
 
               if (vscp_doLevel2Filter(pEvent,
                                       &pSession->m_pClientItem->m_filter)) {
 
-                std::string str;
                 json ev;
-                ev["head"]      = pEvent->head;
-                ev["vscpclass"] = pEvent->vscp_class;
-                ev["vscptype"]  = pEvent->vscp_type;
-                vscp_getDateStringFromEvent(str, pEvent);
-                ev["datetime"]  = (const char*)str.c_str();
-                ev["timestamp"] = pEvent->timestamp;
-                ev["obid"]      = pEvent->obid;
-                vscp_writeGuidToString(str, pEvent);
-                ev["guid"]     = (const char*)str.c_str();
-                ev["sizedata"] = pEvent->sizeData;
-                ev["data"]     = json::array();
-                for (uint16_t j = 0; j < pEvent->sizeData; j++) {
-                  ev["data"].push_back(pEvent->pdata[j]);
-                }
+                restsrv_getEventJSON(ev, pEvent);
 
                 // Add event to event array
                 output["event"].push_back(ev);
@@ -2298,29 +2661,45 @@ restsrv_doReceiveEvent(struct mg_connection* conn,
           output["filtered"] = filtered;
           output["errors"]   = errors;
 
-          std::string s = output.dump();
-          mg_write(conn, s.c_str(), s.length());
-
-          if (REST_FORMAT_JSONP == format) {
-            mg_write(conn, ");", 2);
-          }
+          restsrv_appendJSON(buf, format, output);
 
         }      // if open and data
         else { // no events available
 
           if (REST_FORMAT_JSON == format) {
-            sprintf(wrkbuf, REST_JSON_ERROR_INPUT_QUEUE_EMPTY "\r\n");
+            buf.append(REST_JSON_ERROR_INPUT_QUEUE_EMPTY "\r\n");
+          }
+          else if (REST_FORMAT_JSONP == format) {
+            buf.append(REST_JSONP_ERROR_INPUT_QUEUE_EMPTY "\r\n");
           }
           else {
-            sprintf(wrkbuf, REST_JSONP_ERROR_INPUT_QUEUE_EMPTY "\r\n");
+            restsrv_appendError(buf, format, REST_ERROR_CODE_INPUT_QUEUE_EMPTY);
           }
-
-          mg_write(conn, wrkbuf, strlen(wrkbuf));
         }
 
+        restsrv_sendBuffer(conn, format, 200, buf);
+
       } // format
+      else {
+
+        // Unknown format - put events back so they are not lost
+        pthread_mutex_lock(&pSession->m_pClientItem->m_mutexClientInputQueue);
+        while (!events.empty()) {
+          pSession->m_pClientItem->m_clientInputQueue.push_front(events.back());
+          if (NULL != pObj) {
+            pObj->m_memory.m_clientQueues.addEvent(events.back());
+            pObj->m_flowControl.addClientBytes(pSession->m_pClientItem, CWebFlowControl::eventBytes(events.back()));
+          }
+          events.pop_back();
+        }
+        pthread_mutex_unlock(&pSession->m_pClientItem->m_mutexClientInputQueue);
 
-      mg_write(conn, "", 0);
+        restsrv_error(conn,
+                      pSession,
+                      format,
+                      REST_ERROR_CODE_UNSUPPORTED_FORMAT,
+                      cbdata);
+      }
     }
     else { // Queue is empty
       restsrv_error(conn,
@@ -2386,11 +2765,18 @@ restsrv_doClearQueue(struct mg_connection* conn,
   if (NULL == conn)
     return;
 
+  CWebObj* pObj = (CWebObj*)cbdata;
+  if (NULL == pObj) {
+    return;
+  }
+
   if (NULL != pSession) {
 
     std::deque<vscpEvent*>::iterator it;
 
     pthread_mutex_lock(&pSession->m_pClientItem->m_mutexClientInputQueue);
+    pObj->m_memory.m_clientQueues.subEvents(pSession->m_pClientItem->m_clientInputQueue);
+    pObj->m_trace.forgetIngress(pSession->m_pClientItem->m_clientInputQueue);
     for (it = pSession->m_pClientItem->m_clientInputQueue.begin();
          it != pSession->m_pClientItem->m_clientInputQueue.end();
          ++it) {
@@ -2398,6 +2784,7 @@ restsrv_doClearQueue(struct mg_connection* conn,
       vscp_deleteEvent_v2(&pEvent);
     }
     pSession->m_pClientItem->m_clientInputQueue.clear();
+    pObj->m_flowControl.clearClientBytes(pSession->m_pClientItem);
     pthread_mutex_unlock(&pSession->m_pClientItem->m_mutexClientInputQueue);
 
     restsrv_error(conn, pSession, format, REST_ERROR_CODE_SUCCESS, cbdata);
@@ -2696,25 +3083,17 @@ restsrv_doFetchMDF(struct mg_connection* conn,
     }
     else if (REST_FORMAT_XML == format) {
 
-      // Send header
-      websrv_sendheader(conn, 200, REST_MIME_TYPE_XML);
-
-      std::string line;
-      std::ifstream file(mdf.getTempFilePath());
-
-      if (file.is_open()) {
-        while (!file.fail() && !file.eof() && getline(file, line)) {
-          line += "\n";
-          mg_write(conn, line.c_str(), line.length());
-        }
-        file.close();
+      // The MDF can be large so it is streamed in chunks
+      // instead of being read into memory
+      if (!websrv_sendFile(conn, 200, REST_MIME_TYPE_XML, mdf.getTempFilePath())) {
+        restsrv_error(conn,
+                      pSession,
+                      format,
+                      REST_ERROR_CODE_GENERAL_FAILURE,
+                      cbdata);
       }
-
-      file.close();
-
-      mg_write(conn, "", 0); // Terminator
     }
-    else if ((REST_FORMAT_JSON == format) || (REST_FORMAT_JSONP == format)) {
+    else if (REST_FORMAT_IS_JSON_BASED(format)) {
       restsrv_error(conn,
                     pSession,
                     format,
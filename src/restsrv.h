@@ -30,6 +30,11 @@
 #define REST_H__INCLUDED_
 
 #include <clientlist.h>
+#include <webbuf.h>
+
+#include <string>
+
+#include <json.hpp> // Needs C++11  -std=c++11
 
 //******************************************************************************
 //                                   REST
@@ -52,6 +57,11 @@ struct restsrv_session {
   char m_remote_addr[48];
 };
 
+// Signed bearer tokens
+#define REST_TOKEN_VERSION          "2"
+#define REST_TOKEN_MAX_LENGTH       1024
+#define REST_DEFAULT_TOKEN_LIFETIME 3600 // seconds
+
 // Encapsulate a JSON block to make it JSONP
 #define REST_JSONP_START "typeof handler === 'function' && handler("
 #define REST_JSONP_END   ");"
@@ -85,6 +95,8 @@ enum {
   REST_FORMAT_XML,
   REST_FORMAT_JSON,
   REST_FORMAT_JSONP,
+  REST_FORMAT_CBOR,    // https://tools.ietf.org/html/rfc8949
+  REST_FORMAT_MSGPACK, // https://msgpack.org
   REST_FORMAT_COUNT
 };
 
@@ -100,6 +112,17 @@ enum {
 #define REST_MIME_TYPE_XML   "application/xml"
 #define REST_MIME_TYPE_JSON  "application/json"
 #define REST_MIME_TYPE_JSONP "application/javascript"
+#define REST_MIME_TYPE_CBOR    "application/cbor"
+#define REST_MIME_TYPE_MSGPACK "application/msgpack"
+
+// Formats that are rendered from a JSON object
+#define REST_FORMAT_IS_JSON_BASED(f)                                           \
+  ((REST_FORMAT_JSON == (f)) || (REST_FORMAT_JSONP == (f)) ||                  \
+   (REST_FORMAT_CBOR == (f)) || (REST_FORMAT_MSGPACK == (f)))
+
+// Binary formats
+#define REST_FORMAT_IS_BINARY(f)                                               \
+  ((REST_FORMAT_CBOR == (f)) || (REST_FORMAT_MSGPACK == (f)))
 
 // Clear text Error messages
 #define REST_PLAIN_ERROR_SUCCESS "1 1 Success \r\n\r\nEverything is fine.\r\n"
@@ -398,4 +421,113 @@ enum {
 int
 websrv_restapi(struct mg_connection* conn, void* cbdata);
 
+/*!
+  Get the password tag a token is bound to. Changing the password
+  changes the tag, which revokes all tokens issued before.
+  @param pkey Pointer to 32 byte (256-bit) key
+  @param passwordHash Stored password hash for the user
+  @return Tag as hex string
+*/
+std::string
+restsrv_getTokenTag(const uint8_t* pkey, const std::string& passwordHash);
+
+/*!
+  Create a signed bearer token
+  @param pkey Pointer to 32 byte (256-bit) key
+  @param user Username
+  @param passwordHash Stored password hash for the user
+  @param expires Unix time when the token expires
+  @param token Resulting token
+  @return true on success
+*/
+bool
+restsrv_createToken(const uint8_t* pkey,
+                    const std::string& user,
+                    const std::string& passwordHash,
+                    time_t expires,
+                    std::string& token);
+
+/*!
+  Validate a signed bearer token. The caller must also check that the
+  password tag matches restsrv_getTokenTag for the user's current
+  password hash.
+  @param pkey Pointer to 32 byte (256-bit) key
+  @param token Token to validate
+  @param user Username from token
+  @param tag Password tag from token
+  @param expires Unix time when the token expires
+  @return true if the signature is valid and the token has not expired.
+*/
+bool
+restsrv_validateToken(const uint8_t* pkey,
+                      const std::string& token,
+                      std::string& user,
+                      std::string& tag,
+                      time_t& expires);
+
+/*!
+  Remove REST sessions that have been idle for more than an hour
+  together with their client
+  @param conn Not used, can be NULL
+  @param cbdata Pointer to the CWebObj
+*/
+void
+restsrv_expire_sessions(struct mg_connection* conn, void* cbdata);
+
+/*!
+  Get mime type for a REST format
+  @param format REST_FORMAT_xxx
+  @return Mime type string. Plain text for unknown formats.
+*/
+const char*
+restsrv_getMimeType(int format);
+
+/*!
+  Send a buffered REST response with Content-Length
+  @param conn Civetweb connection
+  @param format REST_FORMAT_xxx
+  @param returncode HTTP return code
+  @param buf Response body
+*/
+void
+restsrv_sendBuffer(struct mg_connection* conn,
+                   int format,
+                   int returncode,
+                   const CWebBuffer& buf);
+
+/*!
+  Append an event as an XML <event> element
+  @param buf Buffer to append to
+  @param pEvent Event to format
+*/
+void
+restsrv_appendEventXML(CWebBuffer& buf, const vscpEvent* pEvent);
+
+/*!
+  Append an event as a CSV data line
+  @param buf Buffer to append to
+  @param pEvent Event to format
+  @return true on success, false if the event could not be converted.
+*/
+bool
+restsrv_appendEventCSV(CWebBuffer& buf, const vscpEvent* pEvent);
+
+/*!
+  Fill in a JSON object for an event as returned by readevent
+  @param ev JSON object to fill in
+  @param pEvent Event to format
+*/
+void
+restsrv_getEventJSON(nlohmann::json& ev, const vscpEvent* pEvent);
+
+/*!
+  Serialize a JSON object in one of the JSON based REST formats
+  @param buf Buffer to append to
+  @param format REST_FORMAT_xxx. JSON is used for formats that are
+                not JSON based.
+  @param j JSON object to serialize
+*/
+void
+restsrv_appendJSON(CWebBuffer& buf, int format, const nlohmann::json& j);
+
 #endif // REST_H__INCLUDED_
\ No newline at end of file
@@ -251,9 +251,7 @@ VSCPWrite(long handle, const vscpEvent *pEvent, unsigned long timeout)
     return CANAL_ERROR_MEMORY;
   }
 
-  pdrvObj->addEvent2SendQueue(pEvent);
-
-  return CANAL_ERROR_SUCCESS;
+  return pdrvObj->addEvent2SendQueue(pEvent, timeout);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -300,6 +298,7 @@ VSCPRead(long handle, vscpEvent *pEvent, unsigned long timeout)
   pthread_mutex_lock(&pdrvObj->m_mutexReceiveQueue);
   vscpEvent *pLocalEvent = pdrvObj->m_receiveList.front();
   pdrvObj->m_receiveList.pop_front();
+  pdrvObj->m_memory.m_receiveQueue.subEvent(pLocalEvent);
   pthread_mutex_unlock(&pdrvObj->m_mutexReceiveQueue);
   if (NULL == pLocalEvent)
     return CANAL_ERROR_MEMORY;
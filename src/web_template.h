@@ -41,6 +41,9 @@
                            "        <li>"\
                            "            <a href=\"/vscp/configure\">List configuration</a>"\
                            "        </li>"\
+                           "        <li>"\
+                           "            <a href=\"/vscp/memory\">Memory</a>"\
+                           "        </li>"\
                            "    </ul>"\
                            " </li>"\
                            " <li>"\
@@ -166,14 +169,42 @@ content-type\" /><title>%s</title>"
 
 #define WEB_IFLIST_TD_GUID "<td id=\"tdguid\">"
 
+// Row template. Fields: id, type, guid1, guid2, name, started
+#define WEB_IFLIST_ROW WEB_IFLIST_TR \
+                       WEB_IFLIST_TD_CENTERED "{{id}}</td>" \
+                       WEB_IFLIST_TD_CENTERED "{{type}}</td>" \
+                       WEB_IFLIST_TD_GUID "{{guid1}}<br>{{guid2}}</td>" \
+                       "<td>{{name}}</td><td>{{started}}</td></tr>"
+
 
 
 // * * * Logfile * * *
 
 // Place after menus
 #define WEB_LOGLIST_BODY_START "<br><div id=\"content\"><div id=\"header\">\
-                                <h1 id=\"header\">Log file</h1></div>\
-                                <table><tbody>"
+                                <h1 id=\"header\">Log file</h1></div>"
+
+// Filter form. Fields: lines, level, match
+#define WEB_LOGLIST_FILTER "<form action=\"" WEB_LOG_URI "\">\
+                            Lines <input type=\"text\" name=\"lines\" value=\"{{lines}}\" size=\"5\"> \
+                            Level <input type=\"text\" name=\"level\" value=\"{{level}}\" size=\"8\"> \
+                            Match <input type=\"text\" name=\"match\" value=\"{{match}}\" size=\"30\"> \
+                            <input type=\"submit\" value=\"Show\"> \
+                            <input type=\"button\" value=\"Live\" onclick=\"LogLive()\"></form>\
+                            <table><tbody id=\"loglines\">"
+
+// Live tail. New lines from the websocket are added to the table.
+#define WEB_LOGLIST_LIVE_SCRIPT "<script type=\"text/javascript\">\
+function LogLive() {\
+  var ws = new WebSocket((location.protocol == 'https:' ? 'wss://' : 'ws://') +\
+                         location.host + '" WEB_LOG_WS_URI "' + location.search);\
+  var tbody = document.getElementById('loglines');\
+  ws.onmessage = function(e) {\
+    tbody.insertRow(-1).insertCell(0).textContent = e.data;\
+    window.scrollTo(0, document.body.scrollHeight);\
+  };\
+}\
+</script>"
 
 // Table head
 #define WEB_LOGLIST_TR_HEAD "<tr><th>Line</th></tr>"
@@ -184,6 +215,86 @@ content-type\" /><title>%s</title>"
 
 
 
+// * * * Event monitor * * *
+
+// Place after menus
+#define WEB_MONITOR_BODY_START "<br><div id=\"content\"><div id=\"header\">\
+                                <h1 id=\"header\">Event monitor</h1></div>\
+                                <p id=\"monstatus\">Connecting...</p>"
+
+// Counters and events. Rows are filled in by the script.
+#define WEB_MONITOR_TABLES "<h4>Most seen class/type</h4>\
+                            <table><tbody id=\"monclasstype\"></tbody></table>\
+                            <h4>Most seen GUID</h4>\
+                            <table><tbody id=\"monguid\"></tbody></table>\
+                            <h4>Events</h4>\
+                            <table><thead><tr><th>Time</th><th>Dir</th><th>Class</th>\
+                            <th>Type</th><th>GUID</th><th>Size</th><th>Data</th></tr></thead>\
+                            <tbody id=\"monevents\"></tbody></table>"
+
+// Live feed. Newest event first, at most 200 rows.
+#define WEB_MONITOR_SCRIPT "<script type=\"text/javascript\">\
+function MonRow(tbody, cells, top) {\
+  var row = tbody.insertRow(top ? 0 : -1);\
+  for (var i = 0; i < cells.length; i++) {\
+    row.insertCell(-1).textContent = cells[i];\
+  }\
+}\
+function MonCounters(id, list, other, key) {\
+  var tbody = document.getElementById(id);\
+  tbody.innerHTML = '';\
+  for (var i = 0; i < list.length; i++) {\
+    MonRow(tbody, key(list[i]).concat([list[i].count]), false);\
+  }\
+  if (other) {\
+    MonRow(tbody, ['other', other], false);\
+  }\
+}\
+window.onload = function() {\
+  var ws = new WebSocket((location.protocol == 'https:' ? 'wss://' : 'ws://') +\
+                         location.host + '" WEB_MONITOR_WS_URI "');\
+  var status = document.getElementById('monstatus');\
+  var events = document.getElementById('monevents');\
+  var dropped = 0;\
+  ws.onclose = function() { status.textContent = 'Disconnected'; };\
+  ws.onmessage = function(e) {\
+    var f = JSON.parse(e.data);\
+    dropped += f.dropped;\
+    status.textContent = 'Last event ' + f.seq + ', not shown ' + dropped;\
+    for (var i = 0; i < f.events.length; i++) {\
+      var ev = f.events[i];\
+      MonRow(events, [new Date(ev.time).toISOString(), ev.dir, ev['class'], ev.type,\
+                      ev.guid, ev.size, ev.data.join(',')], true);\
+    }\
+    while (events.rows.length > 200) {\
+      events.deleteRow(-1);\
+    }\
+    if (f.counters) {\
+      MonCounters('monclasstype', f.counters['class-type'], f.counters['class-type-other'],\
+                  function(c) { return [c['class'], c.type]; });\
+      MonCounters('monguid', f.counters.guid, f.counters['guid-other'],\
+                  function(c) { return [c.guid]; });\
+    }\
+  };\
+};\
+</script>"
+
+// * * * Memory * * *
+
+// Place after menus
+#define WEB_MEMORY_BODY_START "<br><div id=\"content\"><div id=\"header\">\
+                                <h1 id=\"header\">Memory</h1></div>\
+                                <table><tbody>"
+
+// Table head
+#define WEB_MEMORY_TR_HEAD "<tr><th>Subsystem</th><th>Bytes</th><th>Peak bytes</th>\
+                            <th>Items</th><th>Peak items</th></tr>"
+
+// Place before common end
+#define WEB_MEMORY_TABLE_END "</tbody></table>"
+
+
+
 
 
 
@@ -0,0 +1,189 @@
+// webbuf.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "webbuf.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// CWebBuffer
+//
+
+CWebBuffer::CWebBuffer(size_t initsize)
+{
+  m_pbuf     = NULL;
+  m_size     = 0;
+  m_capacity = 0;
+
+  reserve(initsize);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CWebBuffer
+//
+
+CWebBuffer::~CWebBuffer()
+{
+  if (NULL != m_pbuf) {
+    free(m_pbuf);
+    m_pbuf = NULL;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// reserve
+//
+
+bool
+CWebBuffer::reserve(size_t size)
+{
+  // Room for terminating null
+  if ((size + 1) <= m_capacity) {
+    return true;
+  }
+
+  // Grow geometrically to keep the number of reallocations low
+  size_t newcap = (0 == m_capacity) ? WEBBUF_DEFAULT_SIZE : m_capacity;
+  while (newcap < (size + 1)) {
+    newcap *= 2;
+  }
+
+  char *p = (char *) realloc(m_pbuf, newcap);
+  if (NULL == p) {
+    return false;
+  }
+
+  m_pbuf     = p;
+  m_capacity = newcap;
+  m_pbuf[m_size] = '\0';
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// append
+//
+
+bool
+CWebBuffer::append(const char *pdata, size_t len)
+{
+  if ((NULL == pdata) || !len) {
+    return true;
+  }
+
+  if (!reserve(m_size + len)) {
+    return false;
+  }
+
+  memcpy(m_pbuf + m_size, pdata, len);
+  m_size += len;
+  m_pbuf[m_size] = '\0';
+
+  return true;
+}
+
+bool
+CWebBuffer::append(const char *pstr)
+{
+  if (NULL == pstr) {
+    return true;
+  }
+
+  return append(pstr, strlen(pstr));
+}
+
+bool
+CWebBuffer::append(const std::string &str)
+{
+  return append(str.c_str(), str.length());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// vappendf
+//
+
+bool
+CWebBuffer::vappendf(const char *fmt, va_list args)
+{
+  va_list argscopy;
+
+  if (NULL == fmt) {
+    return false;
+  }
+
+  if (!reserve(m_size + 128)) {
+    return false;
+  }
+
+  // First try to format into the space we already have
+  va_copy(argscopy, args);
+  int n = vsnprintf(m_pbuf + m_size, m_capacity - m_size, fmt, argscopy);
+  va_end(argscopy);
+
+  if (n < 0) {
+    m_pbuf[m_size] = '\0';
+    return false;
+  }
+
+  // Did not fit - grow and format again
+  if ((size_t) n >= (m_capacity - m_size)) {
+
+    if (!reserve(m_size + n)) {
+      m_pbuf[m_size] = '\0';
+      return false;
+    }
+
+    va_copy(argscopy, args);
+    vsnprintf(m_pbuf + m_size, m_capacity - m_size, fmt, argscopy);
+    va_end(argscopy);
+  }
+
+  m_size += n;
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// appendf
+//
+
+bool
+CWebBuffer::appendf(const char *fmt, ...)
+{
+  bool rv;
+  va_list args;
+
+  va_start(args, fmt);
+  rv = vappendf(fmt, args);
+  va_end(args);
+
+  return rv;
+}
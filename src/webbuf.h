@@ -0,0 +1,136 @@
+// webbuf.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(WEBBUF_H__INCLUDED_)
+#define WEBBUF_H__INCLUDED_
+
+#include <stdarg.h>
+#include <stddef.h>
+
+#include <string>
+
+// Initial size for a response buffer
+#define WEBBUF_DEFAULT_SIZE 4096
+
+/*!
+  Growable output buffer used to build a complete HTTP response
+  body before it is sent. Appending never truncates, the buffer
+  grows as needed.
+*/
+
+class CWebBuffer {
+
+public:
+  /*!
+    Constructor
+    @param initsize Number of bytes to allocate up front.
+  */
+  CWebBuffer(size_t initsize = WEBBUF_DEFAULT_SIZE);
+  ~CWebBuffer();
+
+  /*!
+    Append data to the buffer
+    @param pdata Pointer to data to append
+    @param len Number of bytes to append
+    @return true on success, false on allocation failure.
+  */
+  bool append(const char *pdata, size_t len);
+
+  /*!
+    Append a null terminated string
+  */
+  bool append(const char *pstr);
+
+  /*!
+    Append a string
+  */
+  bool append(const std::string &str);
+
+  /*!
+    Append printf formatted data
+    @param fmt printf style format string
+    @return true on success, false on allocation failure or format error.
+  */
+  bool appendf(const char *fmt, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 2, 3)))
+#endif
+    ;
+
+  /*!
+    Append printf formatted data (va_list version)
+  */
+  bool vappendf(const char *fmt, va_list args);
+
+  /*!
+    Make sure there is room for at least size bytes
+    @return true on success, false on allocation failure.
+  */
+  bool reserve(size_t size);
+
+  /*!
+    Empty the buffer. Allocated memory is kept.
+  */
+  void clear(void) { m_size = 0; };
+
+  /*!
+    Pointer to buffer data. Always null terminated.
+  */
+  const char *data(void) const { return (NULL != m_pbuf) ? m_pbuf : ""; };
+
+  /*!
+    Number of bytes in the buffer (terminating null not included)
+  */
+  size_t size(void) const { return m_size; };
+
+  /*!
+    Number of bytes allocated
+  */
+  size_t capacity(void) const { return m_capacity; };
+
+  /*!
+    True if the buffer is empty
+  */
+  bool empty(void) const { return (0 == m_size); };
+
+private:
+  // Disable copy
+  CWebBuffer(const CWebBuffer &);
+  CWebBuffer &operator=(const CWebBuffer &);
+
+  /// Buffer
+  char *m_pbuf;
+
+  /// Number of bytes used
+  size_t m_size;
+
+  /// Number of bytes allocated
+  size_t m_capacity;
+};
+
+#endif
@@ -0,0 +1,214 @@
+// webcompress.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "webcompress.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// webcompress_getEncodingName
+//
+
+const char *
+webcompress_getEncodingName(int encoding)
+{
+  switch (encoding) {
+    case WEB_ENCODING_GZIP:
+      return "gzip";
+    case WEB_ENCODING_DEFLATE:
+      return "deflate";
+    default:
+      return "identity";
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// webcompress_negotiate
+//
+// Accept-Encoding: gzip, deflate;q=0.5, br
+//
+
+int
+webcompress_negotiate(const char *pAcceptEncoding)
+{
+  bool bGzip    = false;
+  bool bDeflate = false;
+
+  if (NULL == pAcceptEncoding) {
+    return WEB_ENCODING_IDENTITY;
+  }
+
+  const char *p = pAcceptEncoding;
+  while (*p) {
+
+    // Skip separators and white space
+    while (*p && (isspace((unsigned char) *p) || (',' == *p))) {
+      p++;
+    }
+
+    // Coding name
+    const char *pname = p;
+    while (*p && (',' != *p) && (';' != *p) && !isspace((unsigned char) *p)) {
+      p++;
+    }
+    std::string name(pname, p - pname);
+
+    // Parameters - only q is of interest
+    double q = 1.0;
+    while (*p && (',' != *p)) {
+      if (('q' == *p) && ('=' == *(p + 1))) {
+        q = atof(p + 2);
+      }
+      p++;
+    }
+
+    if (q > 0) {
+      if ((0 == strcasecmp(name.c_str(), "gzip")) || (0 == strcasecmp(name.c_str(), "x-gzip"))) {
+        bGzip = true;
+      }
+      else if (0 == strcasecmp(name.c_str(), "deflate")) {
+        bDeflate = true;
+      }
+    }
+  }
+
+  if (bGzip) {
+    return WEB_ENCODING_GZIP;
+  }
+
+  if (bDeflate) {
+    return WEB_ENCODING_DEFLATE;
+  }
+
+  return WEB_ENCODING_IDENTITY;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CWebCompressor
+//
+
+CWebCompressor::CWebCompressor()
+{
+  memset(&m_zs, 0, sizeof(m_zs));
+  m_bInit = false;
+}
+
+CWebCompressor::~CWebCompressor()
+{
+  if (m_bInit) {
+    deflateEnd(&m_zs);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// init
+//
+
+bool
+CWebCompressor::init(int encoding, int level)
+{
+  if (m_bInit) {
+    deflateEnd(&m_zs);
+    m_bInit = false;
+  }
+
+  memset(&m_zs, 0, sizeof(m_zs));
+
+  // Window bits + 16 gives a gzip wrapper. HTTP "deflate" is
+  // the zlib format (RFC 1950) so the plain window bits are used.
+  int windowBits = (WEB_ENCODING_GZIP == encoding) ? (MAX_WBITS + 16) : MAX_WBITS;
+
+  if ((level < 1) || (level > 9)) {
+    level = Z_DEFAULT_COMPRESSION;
+  }
+
+  if (Z_OK != deflateInit2(&m_zs, level, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY)) {
+    return false;
+  }
+
+  m_bInit = true;
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// compress
+//
+
+bool
+CWebCompressor::compress(const char *pdata, size_t len, CWebBuffer &out, bool bFinish)
+{
+  char wrkbuf[16384];
+  int rv;
+
+  if (!m_bInit) {
+    return false;
+  }
+
+  m_zs.next_in  = (Bytef *) pdata;
+  m_zs.avail_in = (uInt) len;
+
+  do {
+    m_zs.next_out  = (Bytef *) wrkbuf;
+    m_zs.avail_out = sizeof(wrkbuf);
+
+    rv = deflate(&m_zs, bFinish ? Z_FINISH : Z_NO_FLUSH);
+    if (Z_STREAM_ERROR == rv) {
+      return false;
+    }
+
+    if (!out.append(wrkbuf, sizeof(wrkbuf) - m_zs.avail_out)) {
+      return false;
+    }
+
+  } while ((0 == m_zs.avail_out) || (bFinish && (Z_STREAM_END != rv)));
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// webcompress_buffer
+//
+
+bool
+webcompress_buffer(const char *pdata, size_t len, CWebBuffer &out, int encoding, int level)
+{
+  CWebCompressor compressor;
+
+  if (!compressor.init(encoding, level)) {
+    return false;
+  }
+
+  // Compressed text is typically a fraction of the original
+  out.reserve(out.size() + len / 3 + 64);
+
+  return compressor.compress(pdata, len, out, true);
+}
@@ -0,0 +1,117 @@
+// webcompress.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(WEBCOMPRESS_H__INCLUDED_)
+#define WEBCOMPRESS_H__INCLUDED_
+
+#include <zlib.h>
+
+#include <webbuf.h>
+
+// HTTP content encodings
+#define WEB_ENCODING_IDENTITY 0
+#define WEB_ENCODING_GZIP     1
+#define WEB_ENCODING_DEFLATE  2
+
+// Defaults for response compression
+#define WEB_COMPRESSION_DEFAULT_THRESHOLD 1024
+#define WEB_COMPRESSION_DEFAULT_LEVEL     6
+
+/*!
+  Get the HTTP token for a content encoding
+  @param encoding WEB_ENCODING_xxx
+  @return "gzip", "deflate" or "identity"
+*/
+const char *
+webcompress_getEncodingName(int encoding);
+
+/*!
+  Get the best encoding we support from an Accept-Encoding header.
+  gzip is preferred over deflate. Encodings with q=0 are not used.
+  @param pAcceptEncoding Accept-Encoding header value or NULL
+  @return WEB_ENCODING_xxx
+*/
+int
+webcompress_negotiate(const char *pAcceptEncoding);
+
+/*!
+  Streaming gzip/deflate compressor. Compressed data is
+  appended to a CWebBuffer.
+*/
+
+class CWebCompressor {
+
+public:
+  CWebCompressor();
+  ~CWebCompressor();
+
+  /*!
+    Initialize the compressor
+    @param encoding WEB_ENCODING_GZIP or WEB_ENCODING_DEFLATE
+    @param level zlib compression level 1-9
+    @return true on success
+  */
+  bool init(int encoding, int level = WEB_COMPRESSION_DEFAULT_LEVEL);
+
+  /*!
+    Compress data
+    @param pdata Data to compress
+    @param len Size of data
+    @param out Buffer compressed data is appended to
+    @param bFinish Set to true for the last block of data
+    @return true on success
+  */
+  bool compress(const char *pdata, size_t len, CWebBuffer &out, bool bFinish = false);
+
+  /*!
+    Finish the stream, appending the trailer to out
+  */
+  bool finish(CWebBuffer &out) { return compress(NULL, 0, out, true); };
+
+private:
+  z_stream m_zs;
+  bool m_bInit;
+};
+
+/*!
+  Compress a block of data in one go
+  @param pdata Data to compress
+  @param len Size of data
+  @param out Buffer compressed data is appended to
+  @param encoding WEB_ENCODING_GZIP or WEB_ENCODING_DEFLATE
+  @param level zlib compression level 1-9
+  @return true on success
+*/
+bool
+webcompress_buffer(const char *pdata,
+                   size_t len,
+                   CWebBuffer &out,
+                   int encoding,
+                   int level = WEB_COMPRESSION_DEFAULT_LEVEL);
+
+#endif
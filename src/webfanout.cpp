@@ -0,0 +1,268 @@
+// webfanout.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <websocketsrv.h>
+
+#include "webfanout.h"
+#include "webobj.h"
+
+#include <spdlog/spdlog.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// webfanout_thread
+//
+
+static void *
+webfanout_thread(void *pData)
+{
+  webfanout_shard *pShard = (webfanout_shard *) pData;
+  CWebFanout *pFanout     = pShard->m_pParent;
+  CWebObj *pObj           = pFanout->m_pObj;
+
+  char name[16];
+  snprintf(name, sizeof(name), "wsrv-fanout-%d", pShard->m_idx);
+  pObj->m_threadsEvent.apply(name);
+
+  while (!pFanout->m_bQuit) {
+
+    if (-1 == sem_wait(&pShard->m_sem)) {
+      continue; // EINTR
+    }
+
+    if (pFanout->m_bQuit) {
+      break;
+    }
+
+    // Events posted from now on wakes us again
+    pShard->m_bPending = false;
+
+    pObj->m_trace.markWakeup();
+
+    struct timespec start = webmetrics_now();
+
+    // The lock is dropped for each write. The busy session stays in
+    // the list, so the iterator to it is still valid after the write.
+    pthread_mutex_lock(&pShard->m_mutex);
+    std::list<CWebsockSession *>::iterator it;
+    for (it = pShard->m_sessions.begin(); it != pShard->m_sessions.end(); ++it) {
+      pShard->m_pBusy = *it;
+      pthread_mutex_unlock(&pShard->m_mutex);
+
+      websock_post_sessionEvents(pObj, *it);
+
+      pthread_mutex_lock(&pShard->m_mutex);
+      pShard->m_pBusy = NULL;
+      pthread_cond_broadcast(&pShard->m_condIdle);
+    }
+    pthread_mutex_unlock(&pShard->m_mutex);
+
+    // Queues have room again
+    pObj->m_flowControl.notify();
+
+    pObj->m_metrics.m_fanoutLatency.recordSince(start);
+  }
+
+  return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CWebFanout
+//
+
+CWebFanout::CWebFanout(void)
+{
+  m_pObj    = NULL;
+  m_bQuit   = false;
+  m_shards  = NULL;
+  m_nShards = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CWebFanout
+//
+
+CWebFanout::~CWebFanout()
+{
+  stop();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// start
+//
+
+bool
+CWebFanout::start(CWebObj *pObj, int nThreads)
+{
+  if ((NULL == pObj) || (NULL != m_shards)) {
+    return false;
+  }
+
+  if (nThreads <= 0) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    nThreads  = (ncpu > 0) ? (int) ncpu : 1;
+  }
+
+  if (nThreads > WEBFANOUT_MAX_THREADS) {
+    nThreads = WEBFANOUT_MAX_THREADS;
+  }
+
+  m_pObj    = pObj;
+  m_bQuit   = false;
+  m_shards  = new webfanout_shard[nThreads];
+  m_nShards = nThreads;
+
+  for (int i = 0; i < m_nShards; i++) {
+    m_shards[i].m_pParent  = this;
+    m_shards[i].m_idx      = i;
+    m_shards[i].m_bStarted = false;
+    m_shards[i].m_bPending    = false;
+    m_shards[i].m_cntSessions = 0;
+    m_shards[i].m_pBusy       = NULL;
+    sem_init(&m_shards[i].m_sem, 0, 0);
+    pthread_mutex_init(&m_shards[i].m_mutex, NULL);
+    pthread_cond_init(&m_shards[i].m_condIdle, NULL);
+  }
+
+  for (int i = 0; i < m_nShards; i++) {
+    if (pthread_create(&m_shards[i].m_thread, NULL, webfanout_thread, &m_shards[i])) {
+      m_pObj->m_logger->error("Unable to start websocket fan-out thread {}.", i);
+      stop();
+      return false;
+    }
+    m_shards[i].m_bStarted = true;
+  }
+
+  m_pObj->m_logger->debug("Started {} websocket fan-out threads", m_nShards);
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// stop
+//
+
+void
+CWebFanout::stop(void)
+{
+  if (NULL == m_shards) {
+    return;
+  }
+
+  m_bQuit = true;
+
+  for (int i = 0; i < m_nShards; i++) {
+    sem_post(&m_shards[i].m_sem);
+  }
+
+  for (int i = 0; i < m_nShards; i++) {
+    if (m_shards[i].m_bStarted) {
+      pthread_join(m_shards[i].m_thread, NULL);
+    }
+    sem_destroy(&m_shards[i].m_sem);
+    pthread_cond_destroy(&m_shards[i].m_condIdle);
+    pthread_mutex_destroy(&m_shards[i].m_mutex);
+  }
+
+  delete[] m_shards;
+  m_shards  = NULL;
+  m_nShards = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// addSession
+//
+
+void
+CWebFanout::addSession(CWebsockSession *pSession)
+{
+  if ((NULL == pSession) || (NULL == m_shards)) {
+    return;
+  }
+
+  // Pick the shard with the fewest sessions
+  int idx     = 0;
+  size_t best = (size_t) -1;
+  for (int i = 0; i < m_nShards; i++) {
+    size_t cnt = m_shards[i].m_cntSessions.load(std::memory_order_relaxed);
+    if (cnt < best) {
+      best = cnt;
+      idx  = i;
+    }
+  }
+
+  pthread_mutex_lock(&m_shards[idx].m_mutex);
+  m_shards[idx].m_sessions.push_back(pSession);
+  m_shards[idx].m_cntSessions = m_shards[idx].m_sessions.size();
+  pSession->m_fanoutShard     = idx;
+  pthread_mutex_unlock(&m_shards[idx].m_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// removeSession
+//
+
+void
+CWebFanout::removeSession(CWebsockSession *pSession)
+{
+  if ((NULL == pSession) || (NULL == m_shards)) {
+    return;
+  }
+
+  int idx = pSession->m_fanoutShard;
+  if ((idx < 0) || (idx >= m_nShards)) {
+    return;
+  }
+
+  // Wait for the shard thread to finish a write to the session
+  pthread_mutex_lock(&m_shards[idx].m_mutex);
+  while (m_shards[idx].m_pBusy == pSession) {
+    pthread_cond_wait(&m_shards[idx].m_condIdle, &m_shards[idx].m_mutex);
+  }
+  m_shards[idx].m_sessions.remove(pSession);
+  m_shards[idx].m_cntSessions = m_shards[idx].m_sessions.size();
+  pSession->m_fanoutShard     = -1;
+  pthread_mutex_unlock(&m_shards[idx].m_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// wakeup
+//
+
+void
+CWebFanout::wakeup(void)
+{
+  for (int i = 0; i < m_nShards; i++) {
+    if (!m_shards[i].m_bPending.exchange(true)) {
+      sem_post(&m_shards[i].m_sem);
+    }
+  }
+}
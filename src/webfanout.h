@@ -0,0 +1,155 @@
+// webfanout.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(WEBFANOUT_H__INCLUDED_)
+#define WEBFANOUT_H__INCLUDED_
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <list>
+
+// Max number of fan-out threads
+#define WEBFANOUT_MAX_THREADS 16
+
+class CWebObj;
+class CWebsockSession;
+
+/*!
+  One fan-out thread and the websocket sessions it owns
+*/
+
+struct webfanout_shard {
+  /// Owner
+  class CWebFanout *m_pParent;
+
+  /// Shard number
+  int m_idx;
+
+  /// Worker thread
+  pthread_t m_thread;
+  bool m_bStarted;
+
+  /// Posted when there may be events to deliver
+  sem_t m_sem;
+
+  /// True when the thread has been woken but not started draining yet
+  std::atomic<bool> m_bPending;
+
+  /// Protects m_sessions and m_pBusy. Not held while writing to a session.
+  pthread_mutex_t m_mutex;
+
+  /// Signalled when the thread is done with m_pBusy
+  pthread_cond_t m_condIdle;
+
+  /// Sessions owned by this shard
+  std::list<CWebsockSession *> m_sessions;
+
+  /// Number of sessions, read without the lock when sessions are assigned
+  std::atomic<size_t> m_cntSessions;
+
+  /// Session the thread is writing to, NULL for none. A session is not
+  /// taken out of m_sessions while it is busy.
+  CWebsockSession *m_pBusy;
+
+  // Keep shards written by different threads on different cache lines
+  char m_pad[64];
+};
+
+/*!
+  Delivers outgoing events to websocket sessions from a pool of threads.
+
+  Each websocket session is owned by one shard (thread) for its
+  lifetime. Events are already copied to the client queue of each
+  session when they are posted, so a shard only has to drain the
+  queues of its own sessions and never shares a lock with the other
+  shards while doing so. The shard lock is released while a session
+  is written to, so a slow websocket does not hold up connects and
+  disconnects on the same shard.
+*/
+
+class CWebFanout {
+
+public:
+  CWebFanout(void);
+  ~CWebFanout();
+
+  /*!
+    Start the fan-out threads
+    @param pObj Driver object
+    @param nThreads Number of threads. Zero selects one per online CPU.
+    @return true on success.
+  */
+  bool start(CWebObj *pObj, int nThreads);
+
+  /*!
+    Stop and join the fan-out threads
+  */
+  void stop(void);
+
+  /*!
+    Assign a session to the shard with the fewest sessions
+  */
+  void addSession(CWebsockSession *pSession);
+
+  /*!
+    Remove a session from its shard. Waits if the shard thread is
+    writing to the session. When this returns the shard thread no
+    longer touches the session.
+  */
+  void removeSession(CWebsockSession *pSession);
+
+  /*!
+    Wake all shards that are not already about to drain
+  */
+  void wakeup(void);
+
+  /*!
+    Number of fan-out threads
+  */
+  int getThreadCount(void) const { return m_nShards; };
+
+  /// Driver object
+  CWebObj *m_pObj;
+
+  /// Set to terminate the threads
+  std::atomic<bool> m_bQuit;
+
+private:
+  // Disable copy
+  CWebFanout(const CWebFanout &);
+  CWebFanout &operator=(const CWebFanout &);
+
+  /// Shards
+  webfanout_shard *m_shards;
+  int m_nShards;
+};
+
+#endif
@@ -0,0 +1,314 @@
+// webflow.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <errno.h>
+#include <time.h>
+
+#include <algorithm>
+
+#include "webflow.h"
+
+// Longest a producer sleeps before it checks the queues again (ms)
+#define WEBFLOW_RECHECK_INTERVAL 5
+
+///////////////////////////////////////////////////////////////////////////////
+// CWebFlowControl
+//
+
+CWebFlowControl::CWebFlowControl(void)
+{
+  m_policy          = WEBFLOW_POLICY_DROP_OLDEST;
+  m_blockTimeout    = WEBFLOW_DEFAULT_BLOCK_TIMEOUT;
+  m_clientMaxEvents = WEBFLOW_DEFAULT_CLIENT_MAX_EVENTS;
+  m_clientMaxBytes  = WEBFLOW_DEFAULT_CLIENT_MAX_BYTES;
+  m_globalMaxEvents = WEBFLOW_DEFAULT_GLOBAL_MAX_EVENTS;
+  m_globalMaxBytes  = WEBFLOW_DEFAULT_GLOBAL_MAX_BYTES;
+  m_waiters         = 0;
+
+  pthread_mutex_init(&m_mutex, NULL);
+  pthread_cond_init(&m_cond, NULL);
+  pthread_mutex_init(&m_mutexClientBytes, NULL);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CWebFlowControl
+//
+
+CWebFlowControl::~CWebFlowControl()
+{
+  pthread_mutex_destroy(&m_mutexClientBytes);
+  pthread_cond_destroy(&m_cond);
+  pthread_mutex_destroy(&m_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setPolicy
+//
+
+bool
+CWebFlowControl::setPolicy(const std::string &policy)
+{
+  if ("drop-oldest" == policy) {
+    m_policy = WEBFLOW_POLICY_DROP_OLDEST;
+  }
+  else if ("block" == policy) {
+    m_policy = WEBFLOW_POLICY_BLOCK;
+  }
+  else if ("reject" == policy) {
+    m_policy = WEBFLOW_POLICY_REJECT;
+  }
+  else {
+    return false;
+  }
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getPolicyName
+//
+
+const char *
+CWebFlowControl::getPolicyName(void) const
+{
+  switch (m_policy) {
+    case WEBFLOW_POLICY_BLOCK:
+      return "block";
+    case WEBFLOW_POLICY_REJECT:
+      return "reject";
+    default:
+      return "drop-oldest";
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// wait
+//
+
+void
+CWebFlowControl::wait(uint32_t maxwait)
+{
+  struct timespec ts;
+
+  if (maxwait > WEBFLOW_RECHECK_INTERVAL) {
+    maxwait = WEBFLOW_RECHECK_INTERVAL;
+  }
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ts.tv_nsec += (long) maxwait * 1000000;
+  if (ts.tv_nsec >= 1000000000) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000;
+  }
+
+  pthread_mutex_lock(&m_mutex);
+  m_waiters++;
+  pthread_cond_timedwait(&m_cond, &m_mutex, &ts);
+  m_waiters--;
+  pthread_mutex_unlock(&m_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// notify
+//
+
+void
+CWebFlowControl::notify(void)
+{
+  if (!m_waiters.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  pthread_mutex_lock(&m_mutex);
+  pthread_cond_broadcast(&m_cond);
+  pthread_mutex_unlock(&m_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// eventBytes
+//
+
+size_t
+CWebFlowControl::eventBytes(const vscpEvent *pEvent)
+{
+  return sizeof(vscpEvent) + ((NULL != pEvent) ? pEvent->sizeData : 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// isCountingClientBytes
+//
+
+bool
+CWebFlowControl::isCountingClientBytes(void) const
+{
+  const size_t maxEventBytes = sizeof(vscpEvent) + VSCP_LEVEL2_MAXDATA;
+  return m_clientMaxBytes &&
+         (!m_clientMaxEvents || (((size_t) m_clientMaxEvents * maxEventBytes) > m_clientMaxBytes));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// addClientBytes
+//
+
+void
+CWebFlowControl::addClientBytes(const CClientItem *pClientItem, size_t bytes)
+{
+  if (!isCountingClientBytes()) {
+    return;
+  }
+
+  pthread_mutex_lock(&m_mutexClientBytes);
+  m_clientBytes[pClientItem] += bytes;
+  pthread_mutex_unlock(&m_mutexClientBytes);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// subClientBytes
+//
+
+void
+CWebFlowControl::subClientBytes(const CClientItem *pClientItem, size_t bytes)
+{
+  if (!isCountingClientBytes()) {
+    return;
+  }
+
+  pthread_mutex_lock(&m_mutexClientBytes);
+  std::map<const CClientItem *, size_t>::iterator it = m_clientBytes.find(pClientItem);
+  if (m_clientBytes.end() != it) {
+    it->second -= std::min(it->second, bytes);
+  }
+  pthread_mutex_unlock(&m_mutexClientBytes);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// clearClientBytes
+//
+
+void
+CWebFlowControl::clearClientBytes(const CClientItem *pClientItem)
+{
+  if (!isCountingClientBytes()) {
+    return;
+  }
+
+  pthread_mutex_lock(&m_mutexClientBytes);
+  m_clientBytes.erase(pClientItem);
+  pthread_mutex_unlock(&m_mutexClientBytes);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getClientBytes
+//
+
+size_t
+CWebFlowControl::getClientBytes(const CClientItem *pClientItem)
+{
+  if (!isCountingClientBytes()) {
+    return 0;
+  }
+
+  size_t bytes = 0;
+  pthread_mutex_lock(&m_mutexClientBytes);
+  std::map<const CClientItem *, size_t>::iterator it = m_clientBytes.find(pClientItem);
+  if (m_clientBytes.end() != it) {
+    bytes = it->second;
+  }
+  pthread_mutex_unlock(&m_mutexClientBytes);
+
+  return bytes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CWebEventSignal
+//
+
+CWebEventSignal::CWebEventSignal(void)
+{
+  m_seq     = 0;
+  m_waiters = 0;
+
+  pthread_mutex_init(&m_mutex, NULL);
+  pthread_cond_init(&m_cond, NULL);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CWebEventSignal
+//
+
+CWebEventSignal::~CWebEventSignal()
+{
+  pthread_cond_destroy(&m_cond);
+  pthread_mutex_destroy(&m_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// wait
+//
+
+void
+CWebEventSignal::wait(uint64_t seq, uint32_t maxwait)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ts.tv_sec += maxwait / 1000;
+  ts.tv_nsec += (long) (maxwait % 1000) * 1000000;
+  if (ts.tv_nsec >= 1000000000) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000;
+  }
+
+  pthread_mutex_lock(&m_mutex);
+  m_waiters++;
+  while (seq == m_seq.load()) {
+    if (ETIMEDOUT == pthread_cond_timedwait(&m_cond, &m_mutex, &ts)) {
+      break;
+    }
+  }
+  m_waiters--;
+  pthread_mutex_unlock(&m_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// notify
+//
+
+void
+CWebEventSignal::notify(void)
+{
+  m_seq++;
+
+  if (!m_waiters.load()) {
+    return;
+  }
+
+  pthread_mutex_lock(&m_mutex);
+  pthread_cond_broadcast(&m_cond);
+  pthread_mutex_unlock(&m_mutex);
+}
@@ -0,0 +1,209 @@
+// webflow.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(WEBFLOW_H__INCLUDED_)
+#define WEBFLOW_H__INCLUDED_
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <string>
+
+#include <vscp.h>
+
+class CClientItem;
+
+// What to do when an event does not fit in the client queue budgets
+#define WEBFLOW_POLICY_DROP_OLDEST 0 // Make room by dropping the oldest queued events
+#define WEBFLOW_POLICY_BLOCK       1 // Wait for room, fail the write on timeout
+#define WEBFLOW_POLICY_REJECT      2 // Fail the write at once
+
+// Defaults. Zero means no limit.
+#define WEBFLOW_DEFAULT_CLIENT_MAX_EVENTS 1024
+#define WEBFLOW_DEFAULT_CLIENT_MAX_BYTES  (1024 * 1024)
+#define WEBFLOW_DEFAULT_GLOBAL_MAX_EVENTS (64 * 1024)
+#define WEBFLOW_DEFAULT_GLOBAL_MAX_BYTES  (64 * 1024 * 1024)
+#define WEBFLOW_DEFAULT_BLOCK_TIMEOUT     100 // ms
+
+// Limits for one batched event read from a script
+#define WEBFLOW_SCRIPT_MAX_EVENTS 1000  // Events returned
+#define WEBFLOW_SCRIPT_MAX_WAIT   10000 // ms
+
+/*!
+  Budgets and policy for the client queues that outgoing events
+  are copied to, and the wait/notify used by the block policy.
+
+  Consumers that take events from a client queue call notify() so a
+  blocked producer can retry at once. A producer that is not notified
+  still retries every few milliseconds.
+*/
+
+class CWebFlowControl {
+
+public:
+  CWebFlowControl(void);
+  ~CWebFlowControl();
+
+  /*!
+    Set policy from its configuration name
+    @param policy "drop-oldest", "block" or "reject"
+    @return true on success, false for an unknown name.
+  */
+  bool setPolicy(const std::string &policy);
+
+  /*!
+    Get policy name
+  */
+  const char *getPolicyName(void) const;
+
+  /*!
+    Wait until notified or for at most maxwait milliseconds
+  */
+  void wait(uint32_t maxwait);
+
+  /*!
+    Wake blocked producers. Cheap when nobody waits.
+  */
+  void notify(void);
+
+  /*!
+    Memory an event takes up in a queue
+  */
+  static size_t eventBytes(const vscpEvent *pEvent);
+
+  /*!
+    True if the bytes in each client queue have to be counted, that
+    is if the client byte budget can be reached before the client
+    event budget is
+  */
+  bool isCountingClientBytes(void) const;
+
+  /*!
+    Account for bytes put in/taken out of a client queue. Does
+    nothing unless isCountingClientBytes() is true. The client queue
+    must be locked by the caller.
+  */
+  void addClientBytes(const CClientItem *pClientItem, size_t bytes);
+  void subClientBytes(const CClientItem *pClientItem, size_t bytes);
+
+  /*!
+    Forget the count for a client queue that is emptied or released.
+    The client queue must be locked by the caller.
+  */
+  void clearClientBytes(const CClientItem *pClientItem);
+
+  /*!
+    Bytes in a client queue. Zero unless isCountingClientBytes()
+    is true.
+  */
+  size_t getClientBytes(const CClientItem *pClientItem);
+
+  /// WEBFLOW_POLICY_xxx
+  int m_policy;
+
+  /// Max time a write waits with the block policy (ms)
+  uint32_t m_blockTimeout;
+
+  /// Per client limits
+  uint32_t m_clientMaxEvents;
+  size_t m_clientMaxBytes;
+
+  /// Limits for all client queues together
+  uint32_t m_globalMaxEvents;
+  size_t m_globalMaxBytes;
+
+private:
+  // Disable copy
+  CWebFlowControl(const CWebFlowControl &);
+  CWebFlowControl &operator=(const CWebFlowControl &);
+
+  /// Number of blocked producers
+  std::atomic<int> m_waiters;
+
+  pthread_mutex_t m_mutex;
+  pthread_cond_t m_cond;
+
+  /// Bytes in each client queue, kept so the budget check does not
+  /// have to walk the queues
+  std::map<const CClientItem *, size_t> m_clientBytes;
+  pthread_mutex_t m_mutexClientBytes;
+};
+
+/*!
+  Wakes script threads that wait for events in their client queue.
+
+  A waiter takes a sequence number with get() before it looks at its
+  queue and waits with that number, so an event put in the queue
+  between the look and the wait is not missed. Producers call
+  notify() after they have put events in client queues. Notifying is
+  a single atomic increment when nobody waits.
+*/
+
+class CWebEventSignal {
+
+public:
+  CWebEventSignal(void);
+  ~CWebEventSignal();
+
+  /*!
+    Get the current sequence number
+  */
+  uint64_t get(void) const { return m_seq.load(); };
+
+  /*!
+    Wait until notified after seq was taken or for at most
+    maxwait milliseconds
+    @param seq Sequence number from get()
+    @param maxwait Max time to wait in milliseconds
+  */
+  void wait(uint64_t seq, uint32_t maxwait);
+
+  /*!
+    Wake all waiters
+  */
+  void notify(void);
+
+private:
+  // Disable copy
+  CWebEventSignal(const CWebEventSignal &);
+  CWebEventSignal &operator=(const CWebEventSignal &);
+
+  /// Bumped on each notify
+  std::atomic<uint64_t> m_seq;
+
+  /// Number of waiting threads
+  std::atomic<int> m_waiters;
+
+  pthread_mutex_t m_mutex;
+  pthread_cond_t m_cond;
+};
+
+#endif
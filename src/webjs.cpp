@@ -0,0 +1,379 @@
+// webjs.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <duktape.h>
+#include <duktape_vscp_func.h>
+
+#include "webjs.h"
+#include "webmetrics.h"
+
+// Heap stash property holding the functions copied to each run
+#define WEBJS_STASH_FUNCTIONS "vscp_functions"
+
+// Functions available to a script
+static const duk_function_list_entry webjs_functions[] = {
+  { "print", js_vscp_print, 1 },
+  { "vscp_log", js_vscp_log, DUK_VARARGS },
+  { "vscp_sleep", js_vscp_sleep, 1 },
+  { "vscp_sendEvent", js_vscp_sendEvent, 1 },
+  { "vscp_receiveEvent", js_vscp_getEvent, 1 },
+  { "vscp_getEvents", js_vscp_getEvents, 2 },
+  { "vscp_countEvent", js_vscp_getCountEvent, 1 },
+  { "vscp_setFilter", js_vscp_setFilter, 1 },
+  { "vscp_isMeasurement", js_is_Measurement, 1 },
+  { "vscp_sendMeasurement", js_send_Measurement, 1 },
+  { "vscp_getMeasurementValue", js_get_MeasurementValue, 1 },
+  { "vscp_getMeasurementUnit", js_get_MeasurementUnit, 1 },
+  { "vscp_getMeasurementSensorIndex", js_get_MeasurementSensorIndex, 1 },
+  { "vscp_getMeasurementZone", js_get_MeasurementZone, 1 },
+  { "vscp_getMeasurementSubZone", js_get_MeasurementSubZone, 1 },
+  { "vscp_decodeMeasurements", js_vscp_decodeMeasurements, 1 },
+  { NULL, NULL, 0 }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// webjs_hashSource
+//
+// 64-bit FNV-1a hash of the source as hex
+//
+
+static std::string
+webjs_hashSource(const std::string &source)
+{
+  char hex[17];
+  uint64_t hash = 0xcbf29ce484222325ULL;
+
+  for (size_t i = 0; i < source.length(); i++) {
+    hash ^= (uint8_t) source[i];
+    hash *= 0x100000001b3ULL;
+  }
+
+  snprintf(hex, sizeof(hex), "%016llx", (unsigned long long) hash);
+  return std::string(hex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CWebJsPool
+//
+
+CWebJsPool::CWebJsPool(void)
+{
+  m_useCounter = 0;
+  m_pmetrics   = NULL;
+  pthread_mutex_init(&m_mutex, NULL);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CWebJsPool
+//
+
+CWebJsPool::~CWebJsPool()
+{
+  clear();
+  pthread_mutex_destroy(&m_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// createHeap
+//
+
+duk_context *
+CWebJsPool::createHeap(void)
+{
+  duk_context *heap = duk_create_heap_default();
+  if (NULL == heap) {
+    return NULL;
+  }
+
+  // The function objects are made once per heap and are copied
+  // to the global object of each run
+  duk_push_heap_stash(heap);
+  duk_push_object(heap);
+  duk_put_function_list(heap, -1, webjs_functions);
+  duk_put_prop_string(heap, -2, WEBJS_STASH_FUNCTIONS);
+  duk_pop(heap);
+
+  if (NULL != m_pmetrics) {
+    m_pmetrics->m_jsHeapsCreated.inc();
+  }
+
+  return heap;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// acquire
+//
+
+duk_context *
+CWebJsPool::acquire(void)
+{
+  duk_context *heap = NULL;
+
+  pthread_mutex_lock(&m_mutex);
+  if (!m_heaps.empty()) {
+    heap = m_heaps.front();
+    m_heaps.pop_front();
+  }
+  pthread_mutex_unlock(&m_mutex);
+
+  if (NULL == heap) {
+    heap = createHeap();
+  }
+
+  return heap;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// release
+//
+
+void
+CWebJsPool::release(duk_context *heap)
+{
+  if (NULL == heap) {
+    return;
+  }
+
+  // Something is left behind, don't reuse
+  if (0 != duk_get_top(heap)) {
+    duk_destroy_heap(heap);
+    return;
+  }
+
+  // Free what the last run left as garbage
+  duk_gc(heap, 0);
+
+  pthread_mutex_lock(&m_mutex);
+  if (m_heaps.size() < WEBJS_MAX_IDLE_HEAPS) {
+    m_heaps.push_back(heap);
+    heap = NULL;
+  }
+  pthread_mutex_unlock(&m_mutex);
+
+  if (NULL != heap) {
+    duk_destroy_heap(heap);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pushRunContext
+//
+
+duk_context *
+CWebJsPool::pushRunContext(duk_context *heap)
+{
+  duk_push_thread_new_globalenv(heap);
+  duk_context *ctx = duk_get_context(heap, -1);
+
+  duk_push_heap_stash(ctx);
+  duk_get_prop_string(ctx, -1, WEBJS_STASH_FUNCTIONS);
+  duk_enum(ctx, -1, DUK_ENUM_OWN_PROPERTIES_ONLY);
+  while (duk_next(ctx, -1, 1)) {
+    // -> stack: [ stash functions enum key value ]
+    duk_put_global_string(ctx, duk_get_string(ctx, -2));
+    duk_pop(ctx);
+  }
+  duk_pop_3(ctx);
+
+  return ctx;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// lookup
+//
+
+bool
+CWebJsPool::lookup(duk_context *ctx, const std::string &key, time_t mtime, off_t size)
+{
+  bool bFound = false;
+
+  pthread_mutex_lock(&m_mutex);
+  std::map<std::string, webjs_script>::iterator it = m_scripts.find(key);
+  if ((it != m_scripts.end()) && (it->second.m_mtime == mtime) && (it->second.m_size == size)) {
+    void *p = duk_push_fixed_buffer(ctx, it->second.m_bytecode.length());
+    memcpy(p, it->second.m_bytecode.data(), it->second.m_bytecode.length());
+    it->second.m_lastUse = ++m_useCounter;
+    bFound               = true;
+  }
+  pthread_mutex_unlock(&m_mutex);
+
+  if (NULL != m_pmetrics) {
+    if (bFound) {
+      m_pmetrics->m_jsCacheHits.inc();
+    }
+    else {
+      m_pmetrics->m_jsCacheMisses.inc();
+    }
+  }
+
+  if (bFound) {
+    duk_load_function(ctx); // buffer -> function
+  }
+
+  return bFound;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// compile
+//
+
+bool
+CWebJsPool::compile(duk_context *ctx,
+                    const std::string &key,
+                    const std::string &name,
+                    time_t mtime,
+                    off_t size,
+                    const std::string &source)
+{
+  duk_push_string(ctx, name.c_str());
+  if (0 != duk_pcompile_lstring_filename(ctx, 0, source.c_str(), source.length())) {
+    return false;
+  }
+
+  // Dump a copy, the function stays on the stack
+  duk_size_t len;
+  duk_dup(ctx, -1);
+  duk_dump_function(ctx);
+  const char *p = (const char *) duk_get_buffer(ctx, -1, &len);
+
+  webjs_script script;
+  script.m_mtime = mtime;
+  script.m_size  = size;
+  script.m_bytecode.assign(p, len);
+  duk_pop(ctx);
+
+  pthread_mutex_lock(&m_mutex);
+
+  // Make room by dropping the least recently used script
+  if ((m_scripts.size() >= WEBJS_MAX_SCRIPTS) && (m_scripts.end() == m_scripts.find(key))) {
+    std::map<std::string, webjs_script>::iterator oldest = m_scripts.begin();
+    std::map<std::string, webjs_script>::iterator it;
+    for (it = m_scripts.begin(); it != m_scripts.end(); ++it) {
+      if (it->second.m_lastUse < oldest->second.m_lastUse) {
+        oldest = it;
+      }
+    }
+    m_scripts.erase(oldest);
+  }
+
+  script.m_lastUse    = ++m_useCounter;
+  webjs_script &entry = m_scripts[key];
+  entry.m_mtime       = script.m_mtime;
+  entry.m_size        = script.m_size;
+  entry.m_lastUse     = script.m_lastUse;
+  entry.m_bytecode.swap(script.m_bytecode);
+
+  pthread_mutex_unlock(&m_mutex);
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// loadFile
+//
+
+bool
+CWebJsPool::loadFile(duk_context *ctx, const std::string &path)
+{
+  struct stat st;
+  if (0 != stat(path.c_str(), &st)) {
+    duk_push_error_object(ctx, DUK_ERR_ERROR, "Can't find script %s", path.c_str());
+    return false;
+  }
+
+  if (lookup(ctx, path, st.st_mtime, st.st_size)) {
+    return true;
+  }
+
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (NULL == fp) {
+    duk_push_error_object(ctx, DUK_ERR_ERROR, "Can't open script %s", path.c_str());
+    return false;
+  }
+
+  std::string source;
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+    source.append(buf, n);
+  }
+  fclose(fp);
+
+  return compile(ctx, path, path, st.st_mtime, st.st_size, source);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// loadSource
+//
+
+bool
+CWebJsPool::loadSource(duk_context *ctx, const std::string &name, const std::string &source)
+{
+  std::string key = name + "#" + webjs_hashSource(source);
+
+  if (lookup(ctx, key, 0, (off_t) source.length())) {
+    return true;
+  }
+
+  return compile(ctx, key, name, 0, (off_t) source.length(), source);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// clear
+//
+
+void
+CWebJsPool::clear(void)
+{
+  pthread_mutex_lock(&m_mutex);
+  while (!m_heaps.empty()) {
+    duk_destroy_heap(m_heaps.front());
+    m_heaps.pop_front();
+  }
+  m_scripts.clear();
+  pthread_mutex_unlock(&m_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getScriptCount
+//
+
+size_t
+CWebJsPool::getScriptCount(void)
+{
+  pthread_mutex_lock(&m_mutex);
+  size_t cnt = m_scripts.size();
+  pthread_mutex_unlock(&m_mutex);
+
+  return cnt;
+}
@@ -0,0 +1,183 @@
+// webjs.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(WEBJS_H__INCLUDED_)
+#define WEBJS_H__INCLUDED_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <deque>
+#include <map>
+#include <string>
+
+// Same as in duktape.h
+typedef struct duk_hthread duk_context;
+
+class CWebMetrics;
+
+// Max number of idle heaps kept for reuse
+#define WEBJS_MAX_IDLE_HEAPS 4
+
+// Max number of compiled scripts kept
+#define WEBJS_MAX_SCRIPTS 64
+
+/*!
+  Compiled bytecode for a script
+*/
+
+struct webjs_script {
+  /// Modification time of the file (0 for inline source)
+  time_t m_mtime;
+
+  /// Size of the file (source length for inline source)
+  off_t m_size;
+
+  /// Output of duk_dump_function
+  std::string m_bytecode;
+
+  /// Use counter value at last use, for eviction
+  uint64_t m_lastUse;
+};
+
+/*!
+  Duktape heaps and compiled scripts for the JavaScript workers.
+
+  Creating a heap and registering all vscp_* functions in it is done
+  once per pooled heap. Each run gets a thread with its own fresh
+  global environment in a pooled heap, so nothing a script defines is
+  seen by the next script. Compiled scripts are kept as bytecode keyed
+  on the file path and modification time, or on a hash of the source
+  for inline scripts, so a hot script is loaded without being parsed
+  and compiled again.
+*/
+
+class CWebJsPool {
+
+public:
+  CWebJsPool(void);
+  ~CWebJsPool();
+
+  /*!
+    Set where hit/miss counters go
+    @param pmetrics Pointer to metrics, can be NULL
+  */
+  void setMetrics(CWebMetrics *pmetrics) { m_pmetrics = pmetrics; };
+
+  /*!
+    Get a heap with the vscp_* functions registered
+    @return Heap or NULL on failure
+  */
+  duk_context *acquire(void);
+
+  /*!
+    Give a heap back to the pool. The heap is destroyed if the pool
+    is full.
+    @param heap Heap from acquire. The value stack must be empty.
+  */
+  void release(duk_context *heap);
+
+  /*!
+    Push a new thread with a fresh global environment that has the
+    vscp_* functions set on it.
+    @param heap Heap from acquire
+    @return Context for the new thread. The thread is at the top of
+            the heap value stack, pop it when done.
+  */
+  duk_context *pushRunContext(duk_context *heap);
+
+  /*!
+    Push a compiled script file on the value stack. The file is only
+    read and compiled if it has changed since last time.
+    @param ctx Context to run the script in
+    @param path Path to the script file
+    @return true on success. On failure the error is on the stack.
+  */
+  bool loadFile(duk_context *ctx, const std::string &path);
+
+  /*!
+    Push a compiled inline script on the value stack
+    @param ctx Context to run the script in
+    @param name Name of the script used in error messages
+    @param source Script source
+    @return true on success. On failure the error is on the stack.
+  */
+  bool loadSource(duk_context *ctx, const std::string &name, const std::string &source);
+
+  /*!
+    Destroy all idle heaps and drop all compiled scripts
+  */
+  void clear(void);
+
+  /*!
+    Number of compiled scripts in the cache
+  */
+  size_t getScriptCount(void);
+
+private:
+  // Disable copy
+  CWebJsPool(const CWebJsPool &);
+  CWebJsPool &operator=(const CWebJsPool &);
+
+  /*!
+    Push a compiled script from the cache if it is there and is
+    for the same mtime and size.
+  */
+  bool lookup(duk_context *ctx, const std::string &key, time_t mtime, off_t size);
+
+  /*!
+    Compile a script, push it and put its bytecode in the cache
+  */
+  bool compile(duk_context *ctx,
+               const std::string &key,
+               const std::string &name,
+               time_t mtime,
+               off_t size,
+               const std::string &source);
+
+  /// Create a heap with the functions in the heap stash
+  duk_context *createHeap(void);
+
+  /// Protects heap list and cache
+  pthread_mutex_t m_mutex;
+
+  /// Idle heaps
+  std::deque<duk_context *> m_heaps;
+
+  /// Compiled scripts
+  std::map<std::string, webjs_script> m_scripts;
+
+  /// Counter for least recently used eviction
+  uint64_t m_useCounter;
+
+  /// Metrics or NULL
+  CWebMetrics *m_pmetrics;
+};
+
+#endif
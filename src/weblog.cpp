@@ -0,0 +1,642 @@
+// weblog.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <civetweb.h>
+
+#include "weblog.h"
+#include "webthread.h"
+
+// Level names as written by spdlog (%l). Index is the level.
+static const char *weblog_levelNames[] = { "trace", "debug", "info", "warning", "error", "critical", NULL };
+
+///////////////////////////////////////////////////////////////////////////////
+// CWebLogFilter
+//
+
+CWebLogFilter::CWebLogFilter(void)
+{
+  m_minLevel = WEBLOG_LEVEL_TRACE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setMatch
+//
+
+bool
+CWebLogFilter::setMatch(const std::string &str)
+{
+  if (str.length() > WEBLOG_MAX_MATCH) {
+    m_match.clear();
+    return false;
+  }
+
+  m_match = str;
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// match
+//
+
+bool
+CWebLogFilter::match(const std::string &line, int level) const
+{
+  if ((WEBLOG_LEVEL_UNKNOWN != level) && (level < m_minLevel)) {
+    return false;
+  }
+
+  if (!m_match.empty() && (std::string::npos == line.find(m_match))) {
+    return false;
+  }
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getLevel
+//
+
+int
+CWebLogFilter::getLevel(const char *pline, size_t len)
+{
+  // The level is the first bracketed field that is a level name
+  const char *p   = pline;
+  const char *end = pline + len;
+  while ((p < end) && (NULL != (p = (const char *) memchr(p, '[', end - p)))) {
+
+    p++;
+    const char *q = (const char *) memchr(p, ']', std::min((size_t)(end - p), (size_t) 10));
+    if (NULL == q) {
+      continue;
+    }
+
+    for (int i = 0; NULL != weblog_levelNames[i]; i++) {
+      size_t n = strlen(weblog_levelNames[i]);
+      if (((size_t)(q - p) == n) && (0 == memcmp(p, weblog_levelNames[i], n))) {
+        return i;
+      }
+    }
+  }
+
+  return WEBLOG_LEVEL_UNKNOWN;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getLevelFromName
+//
+
+int
+CWebLogFilter::getLevelFromName(const std::string &name)
+{
+  for (int i = 0; NULL != weblog_levelNames[i]; i++) {
+    if (0 == strcasecmp(name.c_str(), weblog_levelNames[i])) {
+      return i;
+    }
+  }
+
+  // spdlog accepts these too
+  if (0 == strcasecmp(name.c_str(), "warn")) {
+    return WEBLOG_LEVEL_WARNING;
+  }
+
+  if (0 == strcasecmp(name.c_str(), "err")) {
+    return WEBLOG_LEVEL_ERROR;
+  }
+
+  return WEBLOG_LEVEL_UNKNOWN;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// weblog_addLine
+//
+// Add a line to a page if it passes the filter
+//
+
+static void
+weblog_addLine(const CWebLogFilter &filter,
+               uint64_t offset,
+               const char *pline,
+               size_t len,
+               std::deque<weblog_line> &lines,
+               bool bFront)
+{
+  // Strip CR from CRLF line endings
+  if (len && ('\r' == pline[len - 1])) {
+    len--;
+  }
+
+  weblog_line line;
+  line.m_offset = offset;
+  line.m_level  = CWebLogFilter::getLevel(pline, len);
+  line.m_text.assign(pline, len);
+
+  if (!filter.match(line.m_text, line.m_level)) {
+    return;
+  }
+
+  if (bFront) {
+    lines.push_front(line);
+  }
+  else {
+    lines.push_back(line);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// weblog_readTail
+//
+
+bool
+weblog_readTail(const std::string &path,
+                const CWebLogFilter &filter,
+                uint64_t end,
+                size_t maxlines,
+                weblog_page &page)
+{
+  struct stat st;
+
+  page.m_lines.clear();
+  page.m_start      = 0;
+  page.m_end        = 0;
+  page.m_fileSize   = 0;
+  page.m_bScanLimit = false;
+
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (-1 == fd) {
+    return false;
+  }
+
+  if (-1 == fstat(fd, &st)) {
+    ::close(fd);
+    return false;
+  }
+
+  page.m_fileSize = st.st_size;
+  if (end > page.m_fileSize) {
+    end = page.m_fileSize;
+  }
+  page.m_end = end;
+
+  // Bytes from pos to the end of the lines not yet handled.
+  // Never holds the newline that ends it.
+  std::string data;
+  uint64_t pos = end;
+  bool bFirst  = true;
+  char *pblock = new char[WEBLOG_READ_BLOCK];
+  bool rv      = true;
+
+  while ((page.m_lines.size() < maxlines) && (pos > 0)) {
+
+    if ((end - pos) >= WEBLOG_MAX_SCAN) {
+      page.m_bScanLimit = true;
+      break;
+    }
+
+    size_t n = (size_t) std::min((uint64_t) WEBLOG_READ_BLOCK, pos);
+    pos -= n;
+
+    ssize_t rd = pread(fd, pblock, n, pos);
+    if (rd != (ssize_t) n) {
+      rv = false;
+      break;
+    }
+
+    data.insert(0, pblock, n);
+
+    // The last line of the range ends with a newline
+    if (bFirst && !data.empty() && ('\n' == data[data.length() - 1])) {
+      data.erase(data.length() - 1);
+    }
+    bFirst = false;
+
+    // Every newline found ends the line before the one after it
+    size_t nl;
+    while ((page.m_lines.size() < maxlines) && (std::string::npos != (nl = data.rfind('\n')))) {
+      weblog_addLine(filter, pos + nl + 1, data.c_str() + nl + 1, data.length() - nl - 1, page.m_lines, true);
+      data.erase(nl);
+    }
+  }
+
+  // First line of the file
+  if (rv && (0 == pos) && (page.m_lines.size() < maxlines) && !data.empty()) {
+    weblog_addLine(filter, 0, data.c_str(), data.length(), page.m_lines, true);
+    data.clear();
+  }
+
+  page.m_start = pos + data.length();
+
+  delete[] pblock;
+  ::close(fd);
+
+  return rv;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// weblog_readForward
+//
+
+bool
+weblog_readForward(const std::string &path,
+                   const CWebLogFilter &filter,
+                   uint64_t start,
+                   size_t maxlines,
+                   weblog_page &page)
+{
+  struct stat st;
+
+  page.m_lines.clear();
+  page.m_start      = 0;
+  page.m_end        = 0;
+  page.m_fileSize   = 0;
+  page.m_bScanLimit = false;
+
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (-1 == fd) {
+    return false;
+  }
+
+  if (-1 == fstat(fd, &st)) {
+    ::close(fd);
+    return false;
+  }
+
+  page.m_fileSize = st.st_size;
+  if (start > page.m_fileSize) {
+    start = page.m_fileSize;
+  }
+
+  // Start at a line boundary
+  bool bSkip = false;
+  if (start > 0) {
+    char c;
+    if ((1 == pread(fd, &c, 1, start - 1)) && ('\n' != c)) {
+      bSkip = true;
+    }
+  }
+
+  // Bytes from linestart not yet handled
+  std::string data;
+  uint64_t pos       = start;
+  uint64_t linestart = start;
+  char *pblock       = new char[WEBLOG_READ_BLOCK];
+  bool rv            = true;
+
+  while ((page.m_lines.size() < maxlines) && (pos < page.m_fileSize)) {
+
+    if ((pos - start) >= WEBLOG_MAX_SCAN) {
+      page.m_bScanLimit = true;
+      break;
+    }
+
+    size_t n   = (size_t) std::min((uint64_t) WEBLOG_READ_BLOCK, page.m_fileSize - pos);
+    ssize_t rd = pread(fd, pblock, n, pos);
+    if (rd <= 0) {
+      rv = (0 == rd);
+      break;
+    }
+
+    pos += rd;
+    data.append(pblock, rd);
+
+    size_t from = 0;
+    size_t nl;
+    while ((page.m_lines.size() < maxlines) && (std::string::npos != (nl = data.find('\n', from)))) {
+      if (bSkip) {
+        bSkip = false;
+      }
+      else {
+        weblog_addLine(filter, linestart + from, data.c_str() + from, nl - from, page.m_lines, false);
+      }
+      from = nl + 1;
+    }
+
+    data.erase(0, from);
+    linestart += from;
+  }
+
+  page.m_start = start;
+  page.m_end   = linestart;
+
+  delete[] pblock;
+  ::close(fd);
+
+  return rv;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// weblog_tailThread
+//
+
+static void *
+weblog_tailThread(void *pData)
+{
+  CWebLogTail *pTail = (CWebLogTail *) pData;
+
+  CWebThreadSettings::setName("wsrv-logtail");
+  pTail->run();
+
+  return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CWebLogTail
+//
+
+CWebLogTail::CWebLogTail(void)
+{
+  m_fd       = -1;
+  m_ino      = 0;
+  m_pos      = 0;
+  m_bStarted = false;
+  m_bQuit    = false;
+
+  pthread_mutex_init(&m_mutex, NULL);
+  pthread_cond_init(&m_cond, NULL);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CWebLogTail
+//
+
+CWebLogTail::~CWebLogTail()
+{
+  stop();
+
+  pthread_cond_destroy(&m_cond);
+  pthread_mutex_destroy(&m_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// start
+//
+
+bool
+CWebLogTail::start(const std::string &path)
+{
+  if (m_bStarted) {
+    return false;
+  }
+
+  m_path  = path;
+  m_bQuit = false;
+
+  if (pthread_create(&m_thread, NULL, weblog_tailThread, this)) {
+    return false;
+  }
+
+  m_bStarted = true;
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// stop
+//
+
+void
+CWebLogTail::stop(void)
+{
+  if (!m_bStarted) {
+    return;
+  }
+
+  pthread_mutex_lock(&m_mutex);
+  m_bQuit = true;
+  pthread_cond_signal(&m_cond);
+  pthread_mutex_unlock(&m_mutex);
+
+  pthread_join(m_thread, NULL);
+  m_bStarted = false;
+
+  m_subscribers.clear();
+
+  if (-1 != m_fd) {
+    ::close(m_fd);
+    m_fd = -1;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// subscribe
+//
+
+bool
+CWebLogTail::subscribe(struct mg_connection *conn, const CWebLogFilter &filter)
+{
+  if ((NULL == conn) || !m_bStarted) {
+    return false;
+  }
+
+  pthread_mutex_lock(&m_mutex);
+
+  if (m_subscribers.size() >= WEBLOG_TAIL_MAX_SESSIONS) {
+    pthread_mutex_unlock(&m_mutex);
+    return false;
+  }
+
+  weblog_subscriber sub;
+  sub.m_conn   = conn;
+  sub.m_filter = filter;
+  m_subscribers.push_back(sub);
+
+  pthread_cond_signal(&m_cond);
+  pthread_mutex_unlock(&m_mutex);
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// unsubscribe
+//
+
+void
+CWebLogTail::unsubscribe(const struct mg_connection *conn)
+{
+  pthread_mutex_lock(&m_mutex);
+
+  std::list<weblog_subscriber>::iterator it = m_subscribers.begin();
+  while (it != m_subscribers.end()) {
+    if (it->m_conn == conn) {
+      it = m_subscribers.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+
+  pthread_mutex_unlock(&m_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getSubscriberCount
+//
+
+size_t
+CWebLogTail::getSubscriberCount(void)
+{
+  pthread_mutex_lock(&m_mutex);
+  size_t cnt = m_subscribers.size();
+  pthread_mutex_unlock(&m_mutex);
+
+  return cnt;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// run
+//
+
+void
+CWebLogTail::run(void)
+{
+  pthread_mutex_lock(&m_mutex);
+
+  while (!m_bQuit) {
+
+    // Nothing to do without subscribers. A new subscriber starts at
+    // the end of the file.
+    if (m_subscribers.empty()) {
+      if (-1 != m_fd) {
+        ::close(m_fd);
+        m_fd = -1;
+      }
+      m_partial.clear();
+      pthread_cond_wait(&m_cond, &m_mutex);
+      continue;
+    }
+
+    if (-1 == m_fd) {
+      struct stat st;
+      m_fd  = open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+      m_ino = 0;
+      m_pos = 0;
+      if ((-1 != m_fd) && (0 == fstat(m_fd, &st))) {
+        m_ino = st.st_ino;
+        m_pos = st.st_size;
+      }
+    }
+    else {
+      readNew();
+    }
+
+    struct timeval now;
+    struct timespec ts;
+    gettimeofday(&now, NULL);
+    uint64_t ns = (uint64_t) now.tv_usec * 1000 + (uint64_t) WEBLOG_TAIL_INTERVAL * 1000000;
+    ts.tv_sec   = now.tv_sec + ns / 1000000000;
+    ts.tv_nsec  = ns % 1000000000;
+    pthread_cond_timedwait(&m_cond, &m_mutex, &ts);
+  }
+
+  pthread_mutex_unlock(&m_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// readNew
+//
+
+void
+CWebLogTail::readNew(void)
+{
+  struct stat st;
+  char buf[WEBLOG_READ_BLOCK];
+
+  if (-1 == fstat(m_fd, &st)) {
+    return;
+  }
+
+  // Truncated
+  if ((uint64_t) st.st_size < m_pos) {
+    m_pos = 0;
+    m_partial.clear();
+  }
+
+  // Read what is new, one block at a time
+  uint64_t size = st.st_size;
+  while (m_pos < size) {
+
+    ssize_t rd = pread(m_fd, buf, (size_t) std::min((uint64_t) sizeof(buf), size - m_pos), m_pos);
+    if (rd <= 0) {
+      break;
+    }
+
+    m_pos += rd;
+
+    const char *p   = buf;
+    const char *end = buf + rd;
+    const char *nl;
+    while (NULL != (nl = (const char *) memchr(p, '\n', end - p))) {
+      m_partial.append(p, nl - p);
+      if (!m_partial.empty() && ('\r' == m_partial[m_partial.length() - 1])) {
+        m_partial.erase(m_partial.length() - 1);
+      }
+      sendLine(m_partial);
+      m_partial.clear();
+      p = nl + 1;
+    }
+
+    m_partial.append(p, end - p);
+  }
+
+  // Rotated. The rest of the old file has been read above.
+  struct stat stpath;
+  if ((0 == stat(m_path.c_str(), &stpath)) && (stpath.st_ino != m_ino)) {
+    ::close(m_fd);
+    m_fd  = open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+    m_ino = stpath.st_ino;
+    m_pos = 0;
+    m_partial.clear();
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sendLine
+//
+
+void
+CWebLogTail::sendLine(const std::string &line)
+{
+  int level = CWebLogFilter::getLevel(line.c_str(), line.length());
+
+  std::list<weblog_subscriber>::iterator it;
+  for (it = m_subscribers.begin(); it != m_subscribers.end(); ++it) {
+    if (it->m_filter.match(line, level)) {
+      mg_websocket_write(it->m_conn, MG_WEBSOCKET_OPCODE_TEXT, line.c_str(), line.length());
+    }
+  }
+}
@@ -0,0 +1,306 @@
+// weblog.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(WEBLOG_H__INCLUDED_)
+#define WEBLOG_H__INCLUDED_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <deque>
+#include <list>
+#include <string>
+
+// Bytes read from the log file at a time
+#define WEBLOG_READ_BLOCK 65536
+
+// Max bytes scanned for one page, so a filter that matches
+// nothing can not make a request read the whole file
+#define WEBLOG_MAX_SCAN (4 * 1024 * 1024)
+
+// Lines on a page
+#define WEBLOG_DEFAULT_LINES 200
+
+// Longest match string accepted from a request
+#define WEBLOG_MAX_MATCH 256
+#define WEBLOG_MAX_LINES     5000
+
+// Live tail
+#define WEBLOG_TAIL_INTERVAL     500 // ms between checks of the file
+#define WEBLOG_TAIL_MAX_SESSIONS 8   // Max number of live tail websockets
+
+// Log levels. Same order and values as spdlog.
+#define WEBLOG_LEVEL_UNKNOWN  -1
+#define WEBLOG_LEVEL_TRACE    0
+#define WEBLOG_LEVEL_DEBUG    1
+#define WEBLOG_LEVEL_INFO     2
+#define WEBLOG_LEVEL_WARNING  3
+#define WEBLOG_LEVEL_ERROR    4
+#define WEBLOG_LEVEL_CRITICAL 5
+
+struct mg_connection;
+
+/*!
+  Line filter on minimum log level and a substring
+*/
+
+class CWebLogFilter {
+
+public:
+  CWebLogFilter(void);
+
+  /*!
+    Set lowest level to show
+    @param level WEBLOG_LEVEL_xxx. Lines without a known level are
+                 always shown.
+  */
+  void setLevel(int level) { m_minLevel = level; };
+
+  /*!
+    Set text lines must contain
+    @param str Text to look for. Empty to match all lines.
+    @return true on success, false if the text is longer than
+            WEBLOG_MAX_MATCH.
+  */
+  bool setMatch(const std::string &str);
+
+  /*!
+    Check if a line passes the filter
+    @param line Log line
+    @param level Level of the line
+    @return true if the line should be shown.
+  */
+  bool match(const std::string &line, int level) const;
+
+  /*!
+    True if the filter lets all lines through
+  */
+  bool isEmpty(void) const { return (WEBLOG_LEVEL_TRACE >= m_minLevel) && m_match.empty(); };
+
+  /*!
+    Get the level of a log line from the "[level]" field spdlog writes
+    @return WEBLOG_LEVEL_xxx
+  */
+  static int getLevel(const char *pline, size_t len);
+
+  /*!
+    Get level from a level name ("trace", "debug", "info", "warning",
+    "error", "critical")
+    @return WEBLOG_LEVEL_xxx, WEBLOG_LEVEL_UNKNOWN for an unknown name.
+  */
+  static int getLevelFromName(const std::string &name);
+
+private:
+  /// Lowest level shown
+  int m_minLevel;
+
+  /// Text lines must contain. Empty for all lines.
+  std::string m_match;
+};
+
+/*!
+  A line read from the log file
+*/
+
+struct weblog_line {
+  /// Byte offset of the line in the file
+  uint64_t m_offset;
+
+  /// Log level (WEBLOG_LEVEL_xxx)
+  int m_level;
+
+  /// Text without line ending
+  std::string m_text;
+};
+
+/*!
+  A page of lines read from the log file
+*/
+
+struct weblog_page {
+  /// Matching lines in file order
+  std::deque<weblog_line> m_lines;
+
+  /// Offset of the first byte examined. Use as end for the previous page.
+  uint64_t m_start;
+
+  /// Offset after the last byte examined. Use as start for the next page.
+  uint64_t m_end;
+
+  /// Size of the file when read
+  uint64_t m_fileSize;
+
+  /// True if the scan limit was hit before the page was full
+  bool m_bScanLimit;
+};
+
+/*!
+  Read the last lines before an offset in the log file. The file is
+  read backwards a block at a time, so only the end of it is touched.
+  @param path Path to log file
+  @param filter Lines must pass this filter
+  @param end Read lines that end before this offset. Use UINT64_MAX
+             for the end of the file.
+  @param maxlines Max number of lines to return
+  @param page Filled with the result
+  @return true on success, false if the file could not be read.
+*/
+bool
+weblog_readTail(const std::string &path,
+                const CWebLogFilter &filter,
+                uint64_t end,
+                size_t maxlines,
+                weblog_page &page);
+
+/*!
+  Read lines from an offset in the log file and forward. Only
+  complete lines are returned.
+  @param path Path to log file
+  @param filter Lines must pass this filter
+  @param start Offset to read from. If it is in the middle of a line
+               reading starts at the next line.
+  @param maxlines Max number of lines to return
+  @param page Filled with the result
+  @return true on success, false if the file could not be read.
+*/
+bool
+weblog_readForward(const std::string &path,
+                   const CWebLogFilter &filter,
+                   uint64_t start,
+                   size_t maxlines,
+                   weblog_page &page);
+
+/*!
+  A websocket that gets new log lines
+*/
+
+struct weblog_subscriber {
+  struct mg_connection *m_conn;
+  CWebLogFilter m_filter;
+};
+
+/*!
+  Live tail of the log file.
+
+  One thread follows the end of the file and sends new lines to the
+  websockets that have subscribed, each with its own filter. The file
+  is only read while there are subscribers. Rotation is detected by a
+  change of inode, and the rest of the old file is read before the new
+  one is opened.
+*/
+
+class CWebLogTail {
+
+public:
+  CWebLogTail(void);
+  ~CWebLogTail();
+
+  /*!
+    Start the tail thread
+    @param path Path to log file
+    @return true on success.
+  */
+  bool start(const std::string &path);
+
+  /*!
+    Stop and join the tail thread
+  */
+  void stop(void);
+
+  /*!
+    Add a websocket that should get new lines
+    @return true on success, false if there are too many subscribers
+            or the thread is not running.
+  */
+  bool subscribe(struct mg_connection *conn, const CWebLogFilter &filter);
+
+  /*!
+    Remove a websocket. When this returns the thread no longer
+    writes to the connection.
+  */
+  void unsubscribe(const struct mg_connection *conn);
+
+  /*!
+    Number of subscribers
+  */
+  size_t getSubscriberCount(void);
+
+  /*!
+    Tail thread. Do not call.
+  */
+  void run(void);
+
+private:
+  // Disable copy
+  CWebLogTail(const CWebLogTail &);
+  CWebLogTail &operator=(const CWebLogTail &);
+
+  /*!
+    Read new data from the file and send complete lines to the
+    subscribers
+  */
+  void readNew(void);
+
+  /*!
+    Send a line to the subscribers. m_mutex must be locked.
+  */
+  void sendLine(const std::string &line);
+
+  /// Path to log file
+  std::string m_path;
+
+  /// Open log file, -1 if none
+  int m_fd;
+
+  /// Inode of the open log file
+  ino_t m_ino;
+
+  /// Read position in the open file
+  uint64_t m_pos;
+
+  /// Start of a line that is not complete yet
+  std::string m_partial;
+
+  /// Tail thread
+  pthread_t m_thread;
+  bool m_bStarted;
+
+  /// Set to terminate the thread
+  std::atomic<bool> m_bQuit;
+
+  /// Protects m_subscribers. Signalled on subscribe and stop.
+  pthread_mutex_t m_mutex;
+  pthread_cond_t m_cond;
+
+  /// Websockets that get new lines
+  std::list<weblog_subscriber> m_subscribers;
+};
+
+#endif
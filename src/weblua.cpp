@@ -0,0 +1,180 @@
+// weblua.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+#include <string>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+#include "lauxlib.h"
+#include "lua.h"
+#include "lualib.h"
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#include <lua_vscp_func.h>
+
+#include "weblua.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// CWebLuaPool
+//
+
+CWebLuaPool::CWebLuaPool(void)
+{
+  m_pObj = NULL;
+  pthread_mutex_init(&m_mutex, NULL);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CWebLuaPool
+//
+
+CWebLuaPool::~CWebLuaPool()
+{
+  clear();
+  pthread_mutex_destroy(&m_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// createState
+//
+
+lua_State *
+CWebLuaPool::createState(void)
+{
+  lua_State *L = luaL_newstate();
+  if (NULL == L) {
+    return NULL;
+  }
+
+  luaL_openlibs(L);
+  lua_vscp_openlib(L, m_pObj);
+  lua_vscp_runPreload(L);
+  lua_settop(L, 0);
+
+  return L;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// acquire
+//
+
+lua_State *
+CWebLuaPool::acquire(void)
+{
+  lua_State *L = NULL;
+
+  pthread_mutex_lock(&m_mutex);
+  if (!m_states.empty()) {
+    L = m_states.front();
+    m_states.pop_front();
+  }
+  pthread_mutex_unlock(&m_mutex);
+
+  if (NULL == L) {
+    L = createState();
+  }
+
+  return L;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// release
+//
+
+void
+CWebLuaPool::release(lua_State *L)
+{
+  if (NULL == L) {
+    return;
+  }
+
+  // Remove the script client and free what the last run left as garbage
+  lua_settop(L, 0);
+  lua_vscp_resetState(L);
+
+  pthread_mutex_lock(&m_mutex);
+  if (m_states.size() < WEBLUA_MAX_IDLE_STATES) {
+    m_states.push_back(L);
+    L = NULL;
+  }
+  pthread_mutex_unlock(&m_mutex);
+
+  if (NULL != L) {
+    lua_close(L);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// loadSource
+//
+
+bool
+CWebLuaPool::loadSource(lua_State *L, const std::string &name, const std::string &source)
+{
+  std::string chunkname = "=" + name;
+  if (LUA_OK != luaL_loadbufferx(L, source.c_str(), source.length(), chunkname.c_str(), "t")) {
+    return false;
+  }
+
+  // Globals set by the script go to its own table. Reads fall back to
+  // the shared globals.
+  lua_newtable(L);
+  lua_newtable(L);
+  lua_pushglobaltable(L);
+  lua_setfield(L, -2, "__index");
+  lua_setmetatable(L, -2);
+
+  // The environment is the first upvalue of a main chunk
+  if (NULL == lua_setupvalue(L, -2, 1)) {
+    lua_pop(L, 1);
+  }
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// clear
+//
+
+void
+CWebLuaPool::clear(void)
+{
+  pthread_mutex_lock(&m_mutex);
+  while (!m_states.empty()) {
+    lua_close(m_states.front());
+    m_states.pop_front();
+  }
+  pthread_mutex_unlock(&m_mutex);
+}
@@ -0,0 +1,112 @@
+// weblua.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+#if !defined(WEBLUA_H__INCLUDED_)
+#define WEBLUA_H__INCLUDED_
+
+#include <pthread.h>
+
+#include <deque>
+#include <string>
+
+// Same as in lua.h
+struct lua_State;
+
+// Max number of idle states kept for reuse
+#define WEBLUA_MAX_IDLE_STATES 4
+
+/*!
+  Lua states for the Lua workers.
+
+  Opening the standard libraries, registering the vscp.* functions and
+  running the preload file is done once per pooled state. Each run gets
+  its own global environment table that falls back to the shared
+  globals for reads, so nothing a script defines is seen by the next
+  script. When a state is given back its script client is removed and
+  the garbage is collected before it is reused.
+*/
+
+class CWebLuaPool {
+
+public:
+  CWebLuaPool(void);
+  ~CWebLuaPool();
+
+  /*!
+    Set the driver object the vscp.* functions work on
+    @param pObj Pointer to the CWebObj
+  */
+  void setParent(void *pObj) { m_pObj = pObj; };
+
+  /*!
+    Get a state with the vscp.* functions registered
+    @return State or NULL on failure
+  */
+  struct lua_State *acquire(void);
+
+  /*!
+    Give a state back to the pool. The state is closed if the pool
+    is full.
+    @param L State from acquire
+  */
+  void release(struct lua_State *L);
+
+  /*!
+    Compile a script and push it with a fresh global environment
+    @param L State from acquire
+    @param name Name of the script used in error messages
+    @param source Script source
+    @return true on success. On failure the error is on the stack.
+  */
+  bool loadSource(struct lua_State *L, const std::string &name, const std::string &source);
+
+  /*!
+    Close all idle states
+  */
+  void clear(void);
+
+private:
+  // Disable copy
+  CWebLuaPool(const CWebLuaPool &);
+  CWebLuaPool &operator=(const CWebLuaPool &);
+
+  /// Create a state with the libraries and vscp.* functions
+  struct lua_State *createState(void);
+
+  /// Protects state list
+  pthread_mutex_t m_mutex;
+
+  /// Idle states
+  std::deque<struct lua_State *> m_states;
+
+  /// Driver object (CWebObj)
+  void *m_pObj;
+};
+
+#endif
@@ -0,0 +1,98 @@
+// webmeasure.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vscphelper.h>
+
+#include "webmeasure.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// webmeasure_decode
+//
+
+bool
+webmeasure_decode(const vscpEvent *pEvent, webmeasure_record &rec)
+{
+  if ((NULL == pEvent) || !vscp_isMeasurement(pEvent)) {
+    return false;
+  }
+
+  if (!vscp_getMeasurementAsDouble(&rec.m_value, pEvent)) {
+    return false;
+  }
+
+  rec.m_class       = pEvent->vscp_class;
+  rec.m_type        = pEvent->vscp_type;
+  rec.m_unit        = vscp_getMeasurementUnit(pEvent);
+  rec.m_sensorIndex = vscp_getMeasurementSensorIndex(pEvent);
+  rec.m_zone        = vscp_getMeasurementZone(pEvent);
+  rec.m_subZone     = vscp_getMeasurementSubZone(pEvent);
+  rec.m_timestamp   = pEvent->timestamp;
+  snprintf(rec.m_datetime,
+           sizeof(rec.m_datetime),
+           "%04d-%02d-%02dT%02d:%02d:%02d",
+           (int) pEvent->year % 10000,
+           (int) pEvent->month % 100,
+           (int) pEvent->day % 100,
+           (int) pEvent->hour % 100,
+           (int) pEvent->minute % 100,
+           (int) pEvent->second % 100);
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// webmeasure_decodeEx
+//
+
+bool
+webmeasure_decodeEx(const vscpEventEx &ex, webmeasure_record &rec)
+{
+  // Event that points into the data of the ex
+  vscpEvent ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.head       = ex.head;
+  ev.obid       = ex.obid;
+  ev.year       = ex.year;
+  ev.month      = ex.month;
+  ev.day        = ex.day;
+  ev.hour       = ex.hour;
+  ev.minute     = ex.minute;
+  ev.second     = ex.second;
+  ev.timestamp  = ex.timestamp;
+  ev.vscp_class = ex.vscp_class;
+  ev.vscp_type  = ex.vscp_type;
+  memcpy(ev.GUID, ex.GUID, sizeof(ev.GUID));
+  ev.sizeData = ex.sizeData;
+  ev.pdata    = ex.sizeData ? (uint8_t *) ex.data : NULL;
+
+  return webmeasure_decode(&ev, rec);
+}
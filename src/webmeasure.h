@@ -0,0 +1,76 @@
+// webmeasure.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(WEBMEASURE_H__INCLUDED_)
+#define WEBMEASURE_H__INCLUDED_
+
+#include <stdint.h>
+
+#include <vscp.h>
+
+// Max number of events decoded in one script call
+#define WEBMEASURE_MAX_EVENTS 10000
+
+/*!
+  A measurement event decoded for a script
+*/
+
+struct webmeasure_record {
+  uint16_t m_class;     // VSCP class
+  uint16_t m_type;      // VSCP type
+  double m_value;       // Measurement value
+  int m_unit;           // Unit
+  int m_sensorIndex;    // Sensor index
+  int m_zone;           // Zone
+  int m_subZone;        // Sub zone
+  uint32_t m_timestamp; // Event timestamp (us)
+  char m_datetime[20];  // Event date/time as YYYY-MM-DDTHH:MM:SS
+};
+
+/*!
+  Decode all measurement fields of an event in one go
+  @param pEvent Event to decode
+  @param rec Record to fill in
+  @return true if the event is a measurement and the value could
+          be decoded.
+*/
+bool
+webmeasure_decode(const vscpEvent *pEvent, webmeasure_record &rec);
+
+/*!
+  Decode all measurement fields of an event ex in one go. The data
+  is not copied.
+  @param ex Event to decode
+  @param rec Record to fill in
+  @return true if the event is a measurement and the value could
+          be decoded.
+*/
+bool
+webmeasure_decodeEx(const vscpEventEx &ex, webmeasure_record &rec);
+
+#endif
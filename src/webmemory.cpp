@@ -0,0 +1,232 @@
+// webmemory.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <stdio.h>
+
+#include <webmetrics.h>
+
+#include "webmemory.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// webmemory_peak
+//
+// Raise a high-water mark if value is above it
+//
+
+static void
+webmemory_peak(std::atomic<uint64_t> &peak, int64_t value)
+{
+  if (value <= 0) {
+    return;
+  }
+
+  uint64_t cur = peak.load(std::memory_order_relaxed);
+  while (((uint64_t) value > cur) &&
+         !peak.compare_exchange_weak(cur, (uint64_t) value, std::memory_order_relaxed)) {
+    ;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CWebMemStat
+//
+
+CWebMemStat::CWebMemStat(void)
+  : m_bytes(0)
+  , m_items(0)
+  , m_peakBytes(0)
+  , m_peakItems(0)
+{
+  ;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// add
+//
+
+void
+CWebMemStat::add(size_t bytes, size_t items)
+{
+  int64_t b = m_bytes.fetch_add((int64_t) bytes, std::memory_order_relaxed) + (int64_t) bytes;
+  int64_t n = m_items.fetch_add((int64_t) items, std::memory_order_relaxed) + (int64_t) items;
+
+  webmemory_peak(m_peakBytes, b);
+  webmemory_peak(m_peakItems, n);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sub
+//
+
+void
+CWebMemStat::sub(size_t bytes, size_t items)
+{
+  m_bytes.fetch_sub((int64_t) bytes, std::memory_order_relaxed);
+  m_items.fetch_sub((int64_t) items, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// addEvent
+//
+
+void
+CWebMemStat::addEvent(const vscpEvent *pEvent)
+{
+  add(CWebFlowControl::eventBytes(pEvent));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// subEvent
+//
+
+void
+CWebMemStat::subEvent(const vscpEvent *pEvent)
+{
+  sub(CWebFlowControl::eventBytes(pEvent));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// subEvents
+//
+
+void
+CWebMemStat::subEvents(const std::deque<vscpEvent *> &queue)
+{
+  size_t bytes = 0;
+  for (std::deque<vscpEvent *>::const_iterator it = queue.begin(); it != queue.end(); ++it) {
+    bytes += CWebFlowControl::eventBytes(*it);
+  }
+
+  sub(bytes, queue.size());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getBytes
+//
+
+uint64_t
+CWebMemStat::getBytes(void) const
+{
+  int64_t b = m_bytes.load(std::memory_order_relaxed);
+  return (b > 0) ? (uint64_t) b : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getItems
+//
+
+uint64_t
+CWebMemStat::getItems(void) const
+{
+  int64_t n = m_items.load(std::memory_order_relaxed);
+  return (n > 0) ? (uint64_t) n : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// toJSON
+//
+
+void
+CWebMemStat::toJSON(json &j) const
+{
+  j["bytes"]      = getBytes();
+  j["bytes-peak"] = getPeakBytes();
+  j["items"]      = getItems();
+  j["items-peak"] = getPeakItems();
+}
+
+// ----------------------------------------------------------------------------
+
+struct webmemory_subsystem {
+  const char *m_name;      // Name in JSON
+  const char *m_metric;    // Name in metrics
+  const char *m_help;      // Description
+  const CWebMemStat CWebMemory::*m_pStat;
+};
+
+static const webmemory_subsystem webmemory_subsystems[] = {
+  { "receive-queue", "receive_queue", "events in the receive queue", &CWebMemory::m_receiveQueue },
+  { "client-queues", "client_queues", "events in client input queues", &CWebMemory::m_clientQueues },
+  { "reassembly", "reassembly", "fragmented websocket messages", &CWebMemory::m_reassembly },
+  { "websocket-sessions", "websocket_sessions", "websocket sessions", &CWebMemory::m_websockSessions },
+  { "rest-sessions", "rest_sessions", "REST sessions", &CWebMemory::m_restSessions },
+  { "web-sessions", "web_sessions", "web sessions", &CWebMemory::m_webSessions },
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// CWebMemory::toJSON
+//
+
+void
+CWebMemory::toJSON(json &j) const
+{
+  uint64_t total = 0;
+
+  for (size_t i = 0; i < sizeof(webmemory_subsystems) / sizeof(webmemory_subsystem); i++) {
+    const CWebMemStat &stat = this->*(webmemory_subsystems[i].m_pStat);
+    json js;
+    stat.toJSON(js);
+    j[webmemory_subsystems[i].m_name] = js;
+    total += stat.getBytes();
+  }
+
+  j["total-bytes"] = total;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CWebMemory::render
+//
+
+void
+CWebMemory::render(CWebBuffer &buf) const
+{
+  char name[128];
+  char help[128];
+
+  for (size_t i = 0; i < sizeof(webmemory_subsystems) / sizeof(webmemory_subsystem); i++) {
+
+    const webmemory_subsystem *p = &webmemory_subsystems[i];
+    const CWebMemStat &stat      = this->*(p->m_pStat);
+
+    snprintf(name, sizeof(name), "vscp_websrv_memory_%s_bytes", p->m_metric);
+    snprintf(help, sizeof(help), "Memory used by %s.", p->m_help);
+    webmetrics_renderGauge(buf, name, help, stat.getBytes());
+
+    snprintf(name, sizeof(name), "vscp_websrv_memory_%s_bytes_peak", p->m_metric);
+    snprintf(help, sizeof(help), "High-water mark for memory used by %s.", p->m_help);
+    webmetrics_renderGauge(buf, name, help, stat.getPeakBytes());
+
+    snprintf(name, sizeof(name), "vscp_websrv_memory_%s_items", p->m_metric);
+    snprintf(help, sizeof(help), "Number of %s.", p->m_help);
+    webmetrics_renderGauge(buf, name, help, stat.getItems());
+
+    snprintf(name, sizeof(name), "vscp_websrv_memory_%s_items_peak", p->m_metric);
+    snprintf(help, sizeof(help), "High-water mark for number of %s.", p->m_help);
+    webmetrics_renderGauge(buf, name, help, stat.getPeakItems());
+  }
+}
@@ -0,0 +1,140 @@
+// webmemory.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(WEBMEMORY_H__INCLUDED_)
+#define WEBMEMORY_H__INCLUDED_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+
+#include <vscp.h>
+#include <webbuf.h>
+#include <webflow.h>
+
+#include <json.hpp> // Needs C++11  -std=c++11
+
+using json = nlohmann::json;
+
+/*!
+  Current and high-water memory use of one kind of object
+  (events in a queue, sessions, buffers ...).
+
+  Owners of the objects call add() when one is created or queued
+  and sub() when it is freed or taken out. Lock free.
+*/
+
+class CWebMemStat {
+
+public:
+  CWebMemStat(void);
+
+  /*!
+    Account for new objects
+    @param bytes Memory used by the objects
+    @param items Number of objects
+  */
+  void add(size_t bytes, size_t items = 1);
+
+  /*!
+    Account for objects that are freed
+    @param bytes Memory used by the objects
+    @param items Number of objects
+  */
+  void sub(size_t bytes, size_t items = 1);
+
+  /*!
+    Account for an event put in/taken out of a queue
+  */
+  void addEvent(const vscpEvent *pEvent);
+  void subEvent(const vscpEvent *pEvent);
+
+  /*!
+    Account for all events in a queue that is emptied.
+    Queue must be locked by the caller.
+  */
+  void subEvents(const std::deque<vscpEvent *> &queue);
+
+  uint64_t getBytes(void) const;
+  uint64_t getItems(void) const;
+  uint64_t getPeakBytes(void) const { return m_peakBytes.load(std::memory_order_relaxed); };
+  uint64_t getPeakItems(void) const { return m_peakItems.load(std::memory_order_relaxed); };
+
+  /*!
+    Get as JSON object {bytes, bytes-peak, items, items-peak}
+  */
+  void toJSON(json &j) const;
+
+private:
+  // Signed so a late sub() never wraps
+  std::atomic<int64_t> m_bytes;
+  std::atomic<int64_t> m_items;
+
+  std::atomic<uint64_t> m_peakBytes;
+  std::atomic<uint64_t> m_peakItems;
+};
+
+/*!
+  Memory accounting for the queues and sessions of the driver
+*/
+
+class CWebMemory {
+
+public:
+  /*!
+    Get all subsystems as a JSON object keyed on subsystem name
+  */
+  void toJSON(json &j) const;
+
+  /*!
+    Write all subsystems as gauges in Prometheus text format
+  */
+  void render(CWebBuffer &buf) const;
+
+  /// Events from clients waiting to be read by the host (VSCPRead)
+  CWebMemStat m_receiveQueue;
+
+  /// Events waiting in client input queues
+  CWebMemStat m_clientQueues;
+
+  /// Fragmented websocket messages being put together
+  CWebMemStat m_reassembly;
+
+  /// Websocket sessions
+  CWebMemStat m_websockSessions;
+
+  /// REST sessions
+  CWebMemStat m_restSessions;
+
+  /// Web (admin) sessions
+  CWebMemStat m_webSessions;
+};
+
+#endif
@@ -0,0 +1,238 @@
+// webmetrics.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <inttypes.h>
+#include <math.h>
+#include <time.h>
+
+#include "webmetrics.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// webmetrics_now
+//
+
+struct timespec
+webmetrics_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// webmetrics_renderCounter
+//
+
+static void
+webmetrics_renderCounter(CWebBuffer &buf, const char *name, const char *help, const CWebMetricCounter &counter)
+{
+  buf.appendf("# HELP %s %s\n# TYPE %s counter\n%s %" PRIu64 "\n", name, help, name, name, counter.get());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// webmetrics_renderGauge
+//
+
+void
+webmetrics_renderGauge(CWebBuffer &buf, const char *name, const char *help, uint64_t value)
+{
+  buf.appendf("# HELP %s %s\n# TYPE %s gauge\n%s %" PRIu64 "\n", name, help, name, name, value);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CWebMetricHistogram
+//
+
+CWebMetricHistogram::CWebMetricHistogram(void)
+{
+  for (int i = 0; i < WEB_METRICS_HISTOGRAM_BUCKETS; i++) {
+    m_buckets[i].store(0, std::memory_order_relaxed);
+  }
+  m_sum.store(0, std::memory_order_relaxed);
+  m_count.store(0, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// record
+//
+
+void
+CWebMetricHistogram::record(uint64_t us)
+{
+  // Index is the number of significant bits, so bucket n holds
+  // values < 2^n
+  int idx = 0;
+  uint64_t v = us;
+  while (v && (idx < (WEB_METRICS_HISTOGRAM_BUCKETS - 1))) {
+    v >>= 1;
+    idx++;
+  }
+
+  m_buckets[idx].fetch_add(1, std::memory_order_relaxed);
+  m_sum.fetch_add(us, std::memory_order_relaxed);
+  m_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// recordSince
+//
+
+void
+CWebMetricHistogram::recordSince(const struct timespec &start)
+{
+  struct timespec now = webmetrics_now();
+  int64_t us = (int64_t)(now.tv_sec - start.tv_sec) * 1000000 + (now.tv_nsec - start.tv_nsec) / 1000;
+  record((us > 0) ? (uint64_t) us : 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// render
+//
+
+void
+CWebMetricHistogram::render(CWebBuffer &buf, const char *name, const char *help) const
+{
+  uint64_t cumulative = 0;
+
+  buf.appendf("# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+
+  // Last bucket is the overflow bucket and is covered by +Inf
+  for (int i = 0; i < (WEB_METRICS_HISTOGRAM_BUCKETS - 1); i++) {
+    cumulative += m_buckets[i].load(std::memory_order_relaxed);
+    buf.appendf("%s_bucket{le=\"%g\"} %" PRIu64 "\n", name, (double) (1ULL << i) / 1000000.0, cumulative);
+  }
+
+  // Count is read separately, use the bucket total so +Inf is consistent
+  cumulative += m_buckets[WEB_METRICS_HISTOGRAM_BUCKETS - 1].load(std::memory_order_relaxed);
+  buf.appendf("%s_bucket{le=\"+Inf\"} %" PRIu64 "\n", name, cumulative);
+  buf.appendf("%s_sum %.6f\n", name, (double) m_sum.load(std::memory_order_relaxed) / 1000000.0);
+  buf.appendf("%s_count %" PRIu64 "\n", name, cumulative);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// percentile
+//
+
+double
+CWebMetricHistogram::percentile(double q) const
+{
+  uint64_t counts[WEB_METRICS_HISTOGRAM_BUCKETS];
+  uint64_t total = 0;
+
+  for (int i = 0; i < WEB_METRICS_HISTOGRAM_BUCKETS; i++) {
+    counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+    total += counts[i];
+  }
+
+  if (!total) {
+    return 0;
+  }
+
+  // Rank of the value we look for, at least the first one
+  uint64_t rank = (uint64_t) ceil(q * total);
+  if (!rank) {
+    rank = 1;
+  }
+
+  uint64_t cumulative = 0;
+  for (int i = 0; i < WEB_METRICS_HISTOGRAM_BUCKETS; i++) {
+    cumulative += counts[i];
+    if (cumulative >= rank) {
+      return (double) (1ULL << i) / 1000000.0;
+    }
+  }
+
+  return (double) (1ULL << (WEB_METRICS_HISTOGRAM_BUCKETS - 1)) / 1000000.0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CWebMetrics::render
+//
+
+void
+CWebMetrics::render(CWebBuffer &buf) const
+{
+  webmetrics_renderCounter(buf,
+                           "vscp_websrv_ingress_events_total",
+                           "Events put in the receive queue.",
+                           m_ingressEvents);
+  webmetrics_renderCounter(buf,
+                           "vscp_websrv_ingress_filtered_total",
+                           "Events dropped by the receive filter.",
+                           m_ingressFiltered);
+
+  webmetrics_renderCounter(buf,
+                           "vscp_websrv_fanout_events_total",
+                           "Events sent to the client list.",
+                           m_fanoutEvents);
+  webmetrics_renderCounter(buf,
+                           "vscp_websrv_fanout_websocket_writes_total",
+                           "Events written to websocket clients.",
+                           m_fanoutWebsockWrites);
+  m_fanoutLatency.render(buf,
+                         "vscp_websrv_fanout_duration_seconds",
+                         "Time for one pass over the websocket sessions.");
+
+  webmetrics_renderCounter(buf,
+                           "vscp_websrv_backpressure_dropped_total",
+                           "Queued events dropped to make room for new events.",
+                           m_flowDropped);
+  webmetrics_renderCounter(buf,
+                           "vscp_websrv_backpressure_rejected_total",
+                           "Writes refused because client queues were full.",
+                           m_flowRejected);
+  webmetrics_renderCounter(buf,
+                           "vscp_websrv_backpressure_blocked_total",
+                           "Writes that had to wait for room in client queues.",
+                           m_flowBlocked);
+
+  webmetrics_renderCounter(buf, "vscp_websrv_rest_requests_total", "REST requests served.", m_restRequests);
+  webmetrics_renderCounter(buf, "vscp_websrv_rest_errors_total", "REST requests answered with an error.", m_restErrors);
+  m_restLatency.render(buf, "vscp_websrv_rest_request_duration_seconds", "REST request latency.");
+
+  webmetrics_renderCounter(buf, "vscp_websrv_auth_success_total", "Successful logins.", m_authSuccess);
+  webmetrics_renderCounter(buf, "vscp_websrv_auth_failure_total", "Failed logins.", m_authFailure);
+  webmetrics_renderCounter(buf,
+                           "vscp_websrv_auth_cache_hits_total",
+                           "Logins served from the credential cache.",
+                           m_authCacheHits);
+  m_authLatency.render(buf, "vscp_websrv_auth_duration_seconds", "Time for a full password verification.");
+
+  webmetrics_renderCounter(buf,
+                           "vscp_websrv_js_cache_hits_total",
+                           "JavaScript runs loaded from compiled bytecode.",
+                           m_jsCacheHits);
+  webmetrics_renderCounter(buf,
+                           "vscp_websrv_js_cache_misses_total",
+                           "JavaScript runs that had to compile the script.",
+                           m_jsCacheMisses);
+  webmetrics_renderCounter(buf,
+                           "vscp_websrv_js_heaps_created_total",
+                           "Duktape heaps created for the JavaScript heap pool.",
+                           m_jsHeapsCreated);
+}
@@ -0,0 +1,229 @@
+// webmetrics.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(WEBMETRICS_H__INCLUDED_)
+#define WEBMETRICS_H__INCLUDED_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <atomic>
+
+#include <webbuf.h>
+
+// URI for the metrics endpoint
+#define WEB_METRICS_URI "/metrics"
+
+// Mime type for Prometheus text exposition format
+#define WEB_METRICS_MIME_TYPE "text/plain; version=0.0.4"
+
+// Number of latency buckets. Bucket n holds values < 2^n microseconds,
+// the last bucket holds everything larger (~33 seconds).
+#define WEB_METRICS_HISTOGRAM_BUCKETS 26
+
+/*!
+  Monotonic counter
+
+  Counters are updated from many threads on hot paths. Each one is
+  padded to a cache line and uses relaxed atomics so an update never
+  takes a lock and never bounces a line shared with another counter.
+*/
+
+class CWebMetricCounter {
+
+public:
+  CWebMetricCounter(void) : m_value(0) {};
+
+  /*!
+    Add to the counter
+    @param n Value to add
+  */
+  void inc(uint64_t n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); };
+
+  /*!
+    Get current value
+  */
+  uint64_t get(void) const { return m_value.load(std::memory_order_relaxed); };
+
+private:
+  std::atomic<uint64_t> m_value;
+
+  /// Keep neighbouring counters off this cache line
+  char m_pad[64 - sizeof(std::atomic<uint64_t>)];
+};
+
+/*!
+  Latency histogram
+
+  Log2 spaced buckets (in microseconds) in the spirit of HDR histograms.
+  Recording a value is a couple of relaxed atomic adds.
+*/
+
+class CWebMetricHistogram {
+
+public:
+  CWebMetricHistogram(void);
+
+  /*!
+    Record a value
+    @param us Value in microseconds
+  */
+  void record(uint64_t us);
+
+  /*!
+    Record time elapsed since start
+    @param start Start time from webmetrics_now()
+  */
+  void recordSince(const struct timespec &start);
+
+  /*!
+    Write histogram in Prometheus text format
+    @param buf Buffer to write to
+    @param name Metric name. Values are exported in seconds.
+    @param help Help text
+  */
+  void render(CWebBuffer &buf, const char *name, const char *help) const;
+
+  /*!
+    Estimate a percentile
+    @param q Quantile 0.0 - 1.0
+    @return Upper bound in seconds of the bucket the quantile falls in.
+      Zero if nothing has been recorded.
+  */
+  double percentile(double q) const;
+
+private:
+  /// Per bucket (non cumulative) counts
+  std::atomic<uint64_t> m_buckets[WEB_METRICS_HISTOGRAM_BUCKETS];
+
+  /// Sum of all recorded values in microseconds
+  std::atomic<uint64_t> m_sum;
+
+  /// Number of recorded values
+  std::atomic<uint64_t> m_count;
+};
+
+/*!
+  Counters and latencies for the event pipeline, REST and
+  authentication.
+*/
+
+class CWebMetrics {
+
+public:
+  /*!
+    Write all counters and histograms in Prometheus text format
+    @param buf Buffer to write to
+  */
+  void render(CWebBuffer &buf) const;
+
+  // * * * Ingress * * *
+
+  /// Events put in the receive queue
+  CWebMetricCounter m_ingressEvents;
+
+  /// Events dropped by the receive filter
+  CWebMetricCounter m_ingressFiltered;
+
+  // * * * Fan-out * * *
+
+  /// Events sent to the client list
+  CWebMetricCounter m_fanoutEvents;
+
+  /// Events written to websocket clients
+  CWebMetricCounter m_fanoutWebsockWrites;
+
+  /// Time for one pass over the websocket sessions
+  CWebMetricHistogram m_fanoutLatency;
+
+  // * * * Backpressure * * *
+
+  /// Queued events dropped to make room (drop-oldest policy)
+  CWebMetricCounter m_flowDropped;
+
+  /// Writes refused because a queue was full (reject/block policy)
+  CWebMetricCounter m_flowRejected;
+
+  /// Writes that had to wait for room (block policy)
+  CWebMetricCounter m_flowBlocked;
+
+  // * * * REST * * *
+
+  /// REST requests served
+  CWebMetricCounter m_restRequests;
+
+  /// REST requests that ended with an error reply
+  CWebMetricCounter m_restErrors;
+
+  /// REST request latency
+  CWebMetricHistogram m_restLatency;
+
+  // * * * Authentication * * *
+
+  /// Successful logins
+  CWebMetricCounter m_authSuccess;
+
+  /// Failed logins
+  CWebMetricCounter m_authFailure;
+
+  /// Logins served from the credential cache
+  CWebMetricCounter m_authCacheHits;
+
+  /// Time for a full password verification
+  CWebMetricHistogram m_authLatency;
+
+  // * * * JavaScript * * *
+
+  /// Scripts loaded from compiled bytecode
+  CWebMetricCounter m_jsCacheHits;
+
+  /// Scripts that had to be compiled
+  CWebMetricCounter m_jsCacheMisses;
+
+  /// Duktape heaps created for the heap pool
+  CWebMetricCounter m_jsHeapsCreated;
+};
+
+/*!
+  Get a monotonic start time for latency measurements
+*/
+struct timespec
+webmetrics_now(void);
+
+/*!
+  Write a single gauge in Prometheus text format
+  @param buf Buffer to write to
+  @param name Metric name
+  @param help Help text
+  @param value Current value
+*/
+void
+webmetrics_renderGauge(CWebBuffer &buf, const char *name, const char *help, uint64_t value);
+
+#endif
@@ -0,0 +1,492 @@
+// webmonitor.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <civetweb.h>
+
+#include "webmonitor.h"
+#include "webthread.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// webmonitor_thread
+//
+
+static void *
+webmonitor_thread(void *pData)
+{
+  CWebMonitor *pMonitor = (CWebMonitor *) pData;
+
+  CWebThreadSettings::setName("wsrv-monitor");
+  pMonitor->run();
+
+  return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// webmonitor_guidToString
+//
+
+static std::string
+webmonitor_guidToString(const uint8_t *pguid)
+{
+  char buf[16 * 3];
+
+  for (int i = 0; i < 16; i++) {
+    snprintf(buf + i * 3, 4, (15 == i) ? "%02X" : "%02X:", pguid[i]);
+  }
+
+  return std::string(buf);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CWebMonitor
+//
+
+CWebMonitor::CWebMonitor(void)
+{
+  m_bEnable           = true;
+  m_bufferSize        = WEBMONITOR_DEFAULT_BUFFER_SIZE;
+  m_frameRate         = WEBMONITOR_DEFAULT_FRAME_RATE;
+  m_sampleRate        = WEBMONITOR_DEFAULT_SAMPLE_RATE;
+  m_maxViewers        = WEBMONITOR_DEFAULT_MAX_VIEWERS;
+  m_cntViewers        = 0;
+  m_cntSample         = 0;
+  m_ring              = NULL;
+  m_seq               = 0;
+  m_cntOtherClassType = 0;
+  m_cntOtherGuid      = 0;
+  m_bStarted          = false;
+  m_bQuit             = false;
+
+  pthread_mutex_init(&m_mutexRing, NULL);
+  pthread_mutex_init(&m_mutexViewers, NULL);
+  pthread_cond_init(&m_cond, NULL);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CWebMonitor
+//
+
+CWebMonitor::~CWebMonitor()
+{
+  stop();
+
+  delete[] m_ring;
+  m_ring = NULL;
+
+  pthread_cond_destroy(&m_cond);
+  pthread_mutex_destroy(&m_mutexViewers);
+  pthread_mutex_destroy(&m_mutexRing);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setParameters
+//
+
+void
+CWebMonitor::setParameters(bool bEnable,
+                           uint32_t bufferSize,
+                           uint32_t frameRate,
+                           uint32_t sampleRate,
+                           uint32_t maxViewers)
+{
+  m_bEnable    = bEnable;
+  m_bufferSize = bufferSize ? bufferSize : 1;
+  m_frameRate  = std::min(std::max(frameRate, (uint32_t) 1), (uint32_t) 50);
+  m_sampleRate = sampleRate ? sampleRate : 1;
+  m_maxViewers = maxViewers;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// start
+//
+
+bool
+CWebMonitor::start(void)
+{
+  if (!m_bEnable || m_bStarted) {
+    return false;
+  }
+
+  pthread_mutex_lock(&m_mutexRing);
+  delete[] m_ring;
+  m_ring = new webmonitor_event[m_bufferSize];
+  m_seq  = 0;
+  pthread_mutex_unlock(&m_mutexRing);
+
+  m_bQuit = false;
+
+  if (pthread_create(&m_thread, NULL, webmonitor_thread, this)) {
+    return false;
+  }
+
+  m_bStarted = true;
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// stop
+//
+
+void
+CWebMonitor::stop(void)
+{
+  if (!m_bStarted) {
+    return;
+  }
+
+  pthread_mutex_lock(&m_mutexViewers);
+  m_bQuit = true;
+  pthread_cond_signal(&m_cond);
+  pthread_mutex_unlock(&m_mutexViewers);
+
+  pthread_join(m_thread, NULL);
+  m_bStarted = false;
+
+  m_viewers.clear();
+  m_cntViewers = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// record
+//
+
+void
+CWebMonitor::record(const vscpEvent *pEvent, uint8_t dir)
+{
+  if ((NULL == pEvent) || (NULL == m_ring)) {
+    return;
+  }
+
+  // Keep the event path free of the ring lock when no one is looking
+  if (0 == m_cntViewers.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  bool bSample = (0 == (m_cntSample.fetch_add(1, std::memory_order_relaxed) % m_sampleRate));
+
+  struct timeval now;
+  if (bSample) {
+    gettimeofday(&now, NULL);
+  }
+
+  webmonitor_guid guid;
+  memcpy(guid.data(), pEvent->GUID, 16);
+  uint32_t classtype = ((uint32_t) pEvent->vscp_class << 16) | pEvent->vscp_type;
+
+  pthread_mutex_lock(&m_mutexRing);
+
+  // All events are counted
+  std::map<uint32_t, uint64_t>::iterator itct = m_cntClassType.find(classtype);
+  if (m_cntClassType.end() != itct) {
+    itct->second++;
+  }
+  else if (m_cntClassType.size() < WEBMONITOR_MAX_KEYS) {
+    m_cntClassType[classtype] = 1;
+  }
+  else {
+    m_cntOtherClassType++;
+  }
+
+  std::map<webmonitor_guid, uint64_t>::iterator itguid = m_cntGuid.find(guid);
+  if (m_cntGuid.end() != itguid) {
+    itguid->second++;
+  }
+  else if (m_cntGuid.size() < WEBMONITOR_MAX_KEYS) {
+    m_cntGuid[guid] = 1;
+  }
+  else {
+    m_cntOtherGuid++;
+  }
+
+  // Sampled events are kept
+  if (bSample) {
+    webmonitor_event *pev = &m_ring[m_seq % m_bufferSize];
+    pev->m_seq            = ++m_seq;
+    pev->m_time           = (uint64_t) now.tv_sec * 1000 + now.tv_usec / 1000;
+    pev->m_dir            = dir;
+    pev->m_class          = pEvent->vscp_class;
+    pev->m_type           = pEvent->vscp_type;
+    pev->m_sizeData       = pEvent->sizeData;
+    memcpy(pev->m_guid, pEvent->GUID, 16);
+    if ((NULL != pEvent->pdata) && pEvent->sizeData) {
+      memcpy(pev->m_data, pEvent->pdata, std::min((uint16_t) WEBMONITOR_MAX_DATA, pEvent->sizeData));
+    }
+  }
+
+  pthread_mutex_unlock(&m_mutexRing);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// addViewer
+//
+
+bool
+CWebMonitor::addViewer(struct mg_connection *conn)
+{
+  if ((NULL == conn) || !m_bStarted) {
+    return false;
+  }
+
+  pthread_mutex_lock(&m_mutexViewers);
+
+  if (m_viewers.size() >= m_maxViewers) {
+    pthread_mutex_unlock(&m_mutexViewers);
+    return false;
+  }
+
+  // Start with what is in the ring
+  pthread_mutex_lock(&m_mutexRing);
+  webmonitor_viewer viewer;
+  viewer.m_conn   = conn;
+  viewer.m_cursor = (m_seq > m_bufferSize) ? (m_seq - m_bufferSize) : 0;
+  pthread_mutex_unlock(&m_mutexRing);
+
+  m_viewers.push_back(viewer);
+  m_cntViewers = (uint32_t) m_viewers.size();
+
+  pthread_cond_signal(&m_cond);
+  pthread_mutex_unlock(&m_mutexViewers);
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// removeViewer
+//
+
+void
+CWebMonitor::removeViewer(const struct mg_connection *conn)
+{
+  pthread_mutex_lock(&m_mutexViewers);
+
+  std::list<webmonitor_viewer>::iterator it = m_viewers.begin();
+  while (it != m_viewers.end()) {
+    if (it->m_conn == conn) {
+      it = m_viewers.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+  m_cntViewers = (uint32_t) m_viewers.size();
+
+  pthread_mutex_unlock(&m_mutexViewers);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getViewerCount
+//
+
+size_t
+CWebMonitor::getViewerCount(void)
+{
+  return m_cntViewers;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// buildCounters
+//
+
+void
+CWebMonitor::buildCounters(json &j)
+{
+  std::vector<std::pair<uint64_t, uint32_t>> classtypes;
+  std::vector<std::pair<uint64_t, webmonitor_guid>> guids;
+  uint64_t otherClassType;
+  uint64_t otherGuid;
+
+  // Copy so the event path is held up as little as possible
+  pthread_mutex_lock(&m_mutexRing);
+  classtypes.reserve(m_cntClassType.size());
+  for (std::map<uint32_t, uint64_t>::iterator it = m_cntClassType.begin(); it != m_cntClassType.end(); ++it) {
+    classtypes.push_back(std::make_pair(it->second, it->first));
+  }
+  guids.reserve(m_cntGuid.size());
+  for (std::map<webmonitor_guid, uint64_t>::iterator it = m_cntGuid.begin(); it != m_cntGuid.end(); ++it) {
+    guids.push_back(std::make_pair(it->second, it->first));
+  }
+  otherClassType = m_cntOtherClassType;
+  otherGuid      = m_cntOtherGuid;
+  pthread_mutex_unlock(&m_mutexRing);
+
+  size_t n = std::min(classtypes.size(), (size_t) WEBMONITOR_TOP_KEYS);
+  std::partial_sort(classtypes.begin(),
+                    classtypes.begin() + n,
+                    classtypes.end(),
+                    std::greater<std::pair<uint64_t, uint32_t>>());
+
+  size_t m = std::min(guids.size(), (size_t) WEBMONITOR_TOP_KEYS);
+  std::partial_sort(guids.begin(), guids.begin() + m, guids.end(), std::greater<std::pair<uint64_t, webmonitor_guid>>());
+
+  j               = json::object();
+  j["class-type"] = json::array();
+  for (size_t i = 0; i < n; i++) {
+    json jj;
+    jj["class"] = classtypes[i].second >> 16;
+    jj["type"]  = classtypes[i].second & 0xffff;
+    jj["count"] = classtypes[i].first;
+    j["class-type"].push_back(jj);
+  }
+
+  j["guid"] = json::array();
+  for (size_t i = 0; i < m; i++) {
+    json jj;
+    jj["guid"]  = webmonitor_guidToString(guids[i].second.data());
+    jj["count"] = guids[i].first;
+    j["guid"].push_back(jj);
+  }
+
+  j["class-type-other"] = otherClassType;
+  j["guid-other"]       = otherGuid;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// buildFrame
+//
+
+void
+CWebMonitor::buildFrame(webmonitor_viewer *pViewer, const json *pCounters, std::string &frame)
+{
+  std::vector<webmonitor_event> events;
+  uint64_t dropped = 0;
+
+  frame.clear();
+
+  pthread_mutex_lock(&m_mutexRing);
+
+  uint64_t first = pViewer->m_cursor + 1;
+
+  // Overwritten in the ring
+  if ((m_seq > m_bufferSize) && (first <= (m_seq - m_bufferSize))) {
+    dropped += (m_seq - m_bufferSize + 1) - first;
+    first = m_seq - m_bufferSize + 1;
+  }
+
+  // More than fits in a frame
+  if ((m_seq >= first) && ((m_seq - first + 1) > WEBMONITOR_MAX_EVENTS_PER_FRAME)) {
+    dropped += (m_seq - first + 1) - WEBMONITOR_MAX_EVENTS_PER_FRAME;
+    first = m_seq - WEBMONITOR_MAX_EVENTS_PER_FRAME + 1;
+  }
+
+  if (m_seq >= first) {
+    events.reserve(m_seq - first + 1);
+    for (uint64_t seq = first; seq <= m_seq; seq++) {
+      events.push_back(m_ring[(seq - 1) % m_bufferSize]);
+    }
+  }
+
+  pViewer->m_cursor = m_seq;
+
+  pthread_mutex_unlock(&m_mutexRing);
+
+  if (events.empty() && !dropped && (NULL == pCounters)) {
+    return;
+  }
+
+  json j;
+  j["seq"]     = pViewer->m_cursor;
+  j["dropped"] = dropped;
+  j["events"]  = json::array();
+
+  for (std::vector<webmonitor_event>::iterator it = events.begin(); it != events.end(); ++it) {
+    json jev;
+    jev["seq"]   = it->m_seq;
+    jev["time"]  = it->m_time;
+    jev["dir"]   = (WEBMONITOR_DIR_IN == it->m_dir) ? "in" : "out";
+    jev["class"] = it->m_class;
+    jev["type"]  = it->m_type;
+    jev["guid"]  = webmonitor_guidToString(it->m_guid);
+    jev["size"]  = it->m_sizeData;
+    jev["data"]  = json::array();
+    for (int i = 0; i < std::min((int) it->m_sizeData, WEBMONITOR_MAX_DATA); i++) {
+      jev["data"].push_back(it->m_data[i]);
+    }
+    j["events"].push_back(jev);
+  }
+
+  if (NULL != pCounters) {
+    j["counters"] = *pCounters;
+  }
+
+  frame = j.dump();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// run
+//
+
+void
+CWebMonitor::run(void)
+{
+  uint32_t nframe = 0;
+  json counters;
+  std::string frame;
+
+  pthread_mutex_lock(&m_mutexViewers);
+
+  while (!m_bQuit) {
+
+    if (m_viewers.empty()) {
+      pthread_cond_wait(&m_cond, &m_mutexViewers);
+      continue;
+    }
+
+    // Counters once a second
+    bool bCounters = (0 == (nframe++ % m_frameRate));
+    if (bCounters) {
+      buildCounters(counters);
+    }
+
+    std::list<webmonitor_viewer>::iterator it;
+    for (it = m_viewers.begin(); it != m_viewers.end(); ++it) {
+      buildFrame(&(*it), bCounters ? &counters : NULL, frame);
+      if (!frame.empty()) {
+        mg_websocket_write(it->m_conn, MG_WEBSOCKET_OPCODE_TEXT, frame.c_str(), frame.length());
+      }
+    }
+
+    struct timeval now;
+    struct timespec ts;
+    gettimeofday(&now, NULL);
+    uint64_t ns = (uint64_t) now.tv_usec * 1000 + 1000000000ULL / m_frameRate;
+    ts.tv_sec   = now.tv_sec + ns / 1000000000;
+    ts.tv_nsec  = ns % 1000000000;
+    pthread_cond_timedwait(&m_cond, &m_mutexViewers, &ts);
+  }
+
+  pthread_mutex_unlock(&m_mutexViewers);
+}
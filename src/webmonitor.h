@@ -0,0 +1,253 @@
+// webmonitor.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(WEBMONITOR_H__INCLUDED_)
+#define WEBMONITOR_H__INCLUDED_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <array>
+#include <atomic>
+#include <list>
+#include <map>
+#include <string>
+
+#include <vscp.h>
+
+#include <json.hpp> // Needs C++11  -std=c++11
+
+using json = nlohmann::json;
+
+// Defaults
+#define WEBMONITOR_DEFAULT_BUFFER_SIZE 1024 // Events kept
+#define WEBMONITOR_DEFAULT_FRAME_RATE  4    // Frames per second to a viewer
+#define WEBMONITOR_DEFAULT_SAMPLE_RATE 1    // Keep one event out of this many
+#define WEBMONITOR_DEFAULT_MAX_VIEWERS 4
+
+// Max events sent to a viewer in one frame. Older are skipped.
+#define WEBMONITOR_MAX_EVENTS_PER_FRAME 256
+
+// Max data bytes kept for an event
+#define WEBMONITOR_MAX_DATA 16
+
+// Max number of class/type and GUID counters. Events for
+// new keys after this are counted as "other".
+#define WEBMONITOR_MAX_KEYS 1024
+
+// Counters sent to a viewer (highest counts first)
+#define WEBMONITOR_TOP_KEYS 20
+
+// Direction of an event
+#define WEBMONITOR_DIR_IN  0 // From a client to the driver
+#define WEBMONITOR_DIR_OUT 1 // From the driver to the clients
+
+struct mg_connection;
+
+/// GUID as a map key
+typedef std::array<uint8_t, 16> webmonitor_guid;
+
+/*!
+  Summary of an event kept in the monitor ring buffer
+*/
+
+struct webmonitor_event {
+  uint64_t m_seq;       // Sequence number, first is 1
+  uint64_t m_time;      // Wall clock time when recorded (ms)
+  uint8_t m_dir;        // WEBMONITOR_DIR_xxx
+  uint16_t m_class;     // VSCP class
+  uint16_t m_type;      // VSCP type
+  uint8_t m_guid[16];   // GUID
+  uint16_t m_sizeData;  // Size of data in the event
+  uint8_t m_data[WEBMONITOR_MAX_DATA]; // First data bytes
+};
+
+/*!
+  A websocket viewing the monitor
+*/
+
+struct webmonitor_viewer {
+  /// Connection
+  struct mg_connection *m_conn;
+
+  /// Sequence number of the last event sent
+  uint64_t m_cursor;
+};
+
+/*!
+  Live event monitor for the admin pages.
+
+  While someone is viewing, events in and out of the driver are
+  sampled into a ring buffer of compact summaries and counted per
+  class/type and per GUID. A thread
+  sends what is new to each viewer at a fixed frame rate, so a viewer
+  never gets more than a few frames a second no matter how busy the
+  bus is, and never competes with the real clients for their queues.
+  Each viewer has its own cursor into the ring. A viewer that falls
+  more than a ring behind is told how many events it missed.
+*/
+
+class CWebMonitor {
+
+public:
+  CWebMonitor(void);
+  ~CWebMonitor();
+
+  /*!
+    Set monitor parameters. Call before start.
+    @param bEnable True to enable the monitor
+    @param bufferSize Number of events kept
+    @param frameRate Frames per second to a viewer
+    @param sampleRate Keep one event out of this many
+    @param maxViewers Max number of viewers
+  */
+  void setParameters(bool bEnable,
+                     uint32_t bufferSize,
+                     uint32_t frameRate,
+                     uint32_t sampleRate,
+                     uint32_t maxViewers);
+
+  /*!
+    True if the monitor is enabled
+  */
+  bool isEnabled(void) const { return m_bEnable; };
+
+  /*!
+    Start the frame thread
+    @return true on success.
+  */
+  bool start(void);
+
+  /*!
+    Stop and join the frame thread
+  */
+  void stop(void);
+
+  /*!
+    Record an event. Called on the event path, so this only copies a
+    summary of the event and counts it. Nothing is done when no one
+    is viewing.
+    @param pEvent Event
+    @param dir WEBMONITOR_DIR_xxx
+  */
+  void record(const vscpEvent *pEvent, uint8_t dir);
+
+  /*!
+    Add a websocket viewer. It starts with the events in the ring.
+    @return true on success, false if there are too many viewers or
+            the monitor is not running.
+  */
+  bool addViewer(struct mg_connection *conn);
+
+  /*!
+    Remove a viewer. When this returns the thread no longer writes
+    to the connection.
+  */
+  void removeViewer(const struct mg_connection *conn);
+
+  /*!
+    Number of viewers
+  */
+  size_t getViewerCount(void);
+
+  /*!
+    Get max number of viewers
+  */
+  uint32_t getMaxViewers(void) const { return m_maxViewers; };
+
+  /*!
+    Frame thread. Do not call.
+  */
+  void run(void);
+
+private:
+  // Disable copy
+  CWebMonitor(const CWebMonitor &);
+  CWebMonitor &operator=(const CWebMonitor &);
+
+  /*!
+    Build the frame for a viewer and advance its cursor
+    @param pViewer Viewer
+    @param pCounters Counters to add, NULL for none
+    @param frame Filled with the frame. Empty if there is nothing to send.
+  */
+  void buildFrame(webmonitor_viewer *pViewer, const json *pCounters, std::string &frame);
+
+  /*!
+    Counters as JSON. Highest first, at most WEBMONITOR_TOP_KEYS of each.
+  */
+  void buildCounters(json &j);
+
+  /// Parameters
+  bool m_bEnable;
+  uint32_t m_bufferSize;
+  uint32_t m_frameRate;
+  uint32_t m_sampleRate;
+  uint32_t m_maxViewers;
+
+  /// Number of viewers. Read without a lock on the event path.
+  std::atomic<uint32_t> m_cntViewers;
+
+  /// Events seen, used for sampling
+  std::atomic<uint64_t> m_cntSample;
+
+  /// Protects the ring and the counters. Taken on the event path.
+  pthread_mutex_t m_mutexRing;
+
+  /// Ring of recorded events
+  webmonitor_event *m_ring;
+
+  /// Sequence number of the last recorded event
+  uint64_t m_seq;
+
+  /// Events per class/type (class << 16 | type)
+  std::map<uint32_t, uint64_t> m_cntClassType;
+
+  /// Events per GUID
+  std::map<webmonitor_guid, uint64_t> m_cntGuid;
+
+  /// Events that got no counter of their own
+  uint64_t m_cntOtherClassType;
+  uint64_t m_cntOtherGuid;
+
+  /// Frame thread
+  pthread_t m_thread;
+  bool m_bStarted;
+
+  /// Set to terminate the thread
+  std::atomic<bool> m_bQuit;
+
+  /// Protects m_viewers. Signalled on new viewer and stop.
+  pthread_mutex_t m_mutexViewers;
+  pthread_cond_t m_cond;
+
+  /// Websocket viewers
+  std::list<webmonitor_viewer> m_viewers;
+};
+
+#endif
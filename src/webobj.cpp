@@ -21,6 +21,8 @@
 // Boston, MA 02111-1307, USA.
 //
 
+#include <algorithm>
+
 #include <limits.h>
 #include <net/if.h>
 #include <pthread.h>
@@ -48,11 +50,13 @@
 
 #include <hlo.h>
 #include <remotevariablecodes.h>
+#include <restsrv.h>
 #include <vscp.h>
 #include <vscp_class.h>
 #include <vscp_type.h>
 #include <vscpdatetime.h>
 #include <vscphelper.h>
+#include <webcompress.h>
 #include <webdefs.h>
 #include <websocketsrv.h>
 #include <websrv.h>
@@ -67,6 +71,7 @@
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 
+#include <deque>
 #include <fstream>
 #include <iostream>
 #include <list>
@@ -80,8 +85,6 @@ using namespace kainjow::mustache;
 // Forward declaration
 void *
 workerThreadReceive(void *pData);
-void *
-workerThreadSend(void *pData);
 
 //////////////////////////////////////////////////////////////////////
 // CWebObj
@@ -93,18 +96,27 @@ CWebObj::CWebObj()
   m_bWriteEnable = false;
   m_bQuit        = false;
 
+  m_bReceiveThread = false;
+  pthread_mutex_init(&m_mutexHousekeeping, NULL);
+  pthread_cond_init(&m_condHousekeeping, NULL);
+
   vscp_clearVSCPFilter(&m_filterIn);  // Accept all events
   vscp_clearVSCPFilter(&m_filterOut); // Send all events
   // m_responseTimeout = TCPIP_DEFAULT_INNER_RESPONSE_TIMEOUT;
 
-  sem_init(&m_semSendQueue, 0, 0);
   sem_init(&m_semReceiveQueue, 0, 0);
 
+  m_jsPool.setMetrics(&m_metrics);
+  m_luaPool.setParent(this);
+
   // pthread_mutex_init(&m_mutexSendQueue, NULL);
   pthread_mutex_init(&m_mutexReceiveQueue, NULL);
 
-  // Init pool
-  spdlog::init_thread_pool(8192, 1);
+  pthread_mutex_init(&m_mutex_websrvSession, NULL);
+  pthread_mutex_init(&m_mutex_restSession, NULL);
+  pthread_mutex_init(&m_mutex_websocketSession, NULL);
+  pthread_mutex_init(&m_mutex_UserList, NULL);
+  pthread_mutex_init(&m_mutex_clientList, NULL);
 
   // Flush log every five seconds
   spdlog::flush_every(std::chrono::seconds(5));
@@ -115,6 +127,9 @@ CWebObj::CWebObj()
   console->set_pattern("[vscpl2drv-websrv %c] [%^%l%$] %v");
   spdlog::set_default_logger(console);
 
+  // Until the configured logger is set up
+  m_logger = console;
+
   console->debug("Starting the vscpl2drv-websrv...");
 
   m_bConsoleLogEnable = true;
@@ -128,6 +143,9 @@ CWebObj::CWebObj()
   m_max_log_size     = 5242880;
   m_max_log_files    = 7;
 
+  m_log_queue_size      = 8192;
+  m_bLogBlockOnOverflow = false;
+
   // Set defaults (WEB)
   m_bEnableWebServer    = true;
   m_bEnableHttp2        = false;
@@ -137,6 +155,7 @@ CWebObj::CWebObj()
                       "index.lsp, index.lua, index.cgi, index.shtml, index.php";
   m_web_authentication_domain = "mydomain.com";
   m_enable_auth_domain_check  = false;
+  m_admin_user                = "admin";
 
   m_access_log_file = "/var/log/vscp/vscpl2drv-websrv-access.log";
   m_error_log_file  = "/var/log/vscp/vscpl2drv-websrv-error.log";
@@ -153,47 +172,51 @@ CWebObj::CWebObj()
   m_web_ssl_short_trust          = false;
   m_web_ssl_cache_timeout        = -1;
 
-  std::string m_web_cgi_interpreter = "";
-  std::string m_web_cgi_patterns    = "**.cgi$|**.pl$|**.php|**.py";
-  std::string m_web_cgi_environment = "";
-
-  std::string m_web_protect_uri                  = "";
-  std::string m_web_throttle                     = "";
-  bool m_web_enable_directory_listing            = true;
-  bool m_web_enable_keep_alive                   = false;
-  long m_web_keep_alive_timeout_ms               = 0;
-  std::string m_web_access_control_list          = "";
-  std::string m_web_extra_mime_types             = "";
-  int m_web_num_threads                          = 50;
-  std::string m_web_url_rewrite_patterns         = "";
-  std::string m_web_hide_file_patterns           = "";
-  long m_web_request_timeout_ms                  = 10000;
-  long m_web_linger_timeout_ms                   = 0;
-  bool m_web_decode_url                          = true;
-  std::string m_web_global_auth_file             = "";
-  std::string m_web_put_delete_auth_file         = "";
-  std::string m_web_ssi_patterns                 = "";
-  std::string m_web_access_control_allow_origin  = "*";
-  std::string m_web_access_control_allow_methods = "*";
-  std::string m_web_access_control_allow_headers = "*";
-  std::string m_web_error_pages                  = "";
-  long m_web_tcp_nodelay                         = 0;
-  std::string m_web_static_file_cache_control    = "";
-  long m_web_static_file_max_age                 = 3600;
-  long m_web_strict_transport_security_max_age   = 0;
-  bool m_web_allow_sendfile_call                 = true;
-  std::string m_web_additional_header            = "";
-  long m_web_max_request_size                    = 16384;
-  bool m_web_allow_index_script_resource         = false;
-
-  std::string m_web_duktape_script_patterns = "**.ssjs$";
-
-  std::string m_web_lua_preload_file             = "";
-  std::string m_web_lua_script_patterns          = "**.lua$";
-  std::string m_web_lua_server_page_patterns     = "**.lp$|**.lsp$";
-  std::string m_web_lua_websocket_patterns       = VSCPDB_CONFIG_DEFAULT_WEB_LUA_WEBSOCKET_PATTERN;
-  std::string m_web_lua_background_script        = "";
-  std::string m_web_lua_background_script_params = "";
+  m_web_cgi_interpreter = "";
+  m_web_cgi_patterns    = "**.cgi$|**.pl$|**.php|**.py";
+  m_web_cgi_environment = "";
+
+  m_web_protect_uri                       = "";
+  m_web_throttle                          = "";
+  m_web_enable_directory_listing          = true;
+  m_web_enable_keep_alive                 = false;
+  m_web_keep_alive_timeout_ms             = 0;
+  m_web_access_control_list               = "";
+  m_web_extra_mime_types                  = "";
+  m_web_num_threads                       = 50;
+  m_web_url_rewrite_patterns              = "";
+  m_web_hide_file_patterns                = "";
+  m_web_request_timeout_ms                = 10000;
+  m_web_linger_timeout_ms                 = 0;
+  m_web_decode_url                        = true;
+  m_web_global_auth_file                  = "";
+  m_web_put_delete_auth_file              = "";
+  m_web_ssi_patterns                      = "";
+  m_web_access_control_allow_origin       = "*";
+  m_web_access_control_allow_methods      = "*";
+  m_web_access_control_allow_headers      = "*";
+  m_web_error_pages                       = "";
+  m_web_tcp_nodelay                       = 0;
+  m_web_static_file_cache_control         = "";
+  m_web_static_file_max_age               = 3600;
+  m_web_strict_transport_security_max_age = 0;
+  m_web_allow_sendfile_call               = true;
+  m_web_additional_header                 = "";
+  m_web_max_request_size                  = 16384;
+  m_web_allow_index_script_resource       = false;
+
+  m_web_bEnableCompression    = true;
+  m_web_compression_threshold = WEB_COMPRESSION_DEFAULT_THRESHOLD;
+  m_web_compression_level     = WEB_COMPRESSION_DEFAULT_LEVEL;
+
+  m_web_duktape_script_patterns = "**.ssjs$";
+
+  m_web_lua_preload_file             = "";
+  m_web_lua_script_patterns          = "**.lua$";
+  m_web_lua_server_page_patterns     = "**.lp$|**.lsp$";
+  m_web_lua_websocket_patterns       = VSCPDB_CONFIG_DEFAULT_WEB_LUA_WEBSOCKET_PATTERN;
+  m_web_lua_background_script        = "";
+  m_web_lua_background_script_params = "";
 
   m_web_run_as_user    = "";
   m_web_case_sensitive = false;
@@ -201,9 +224,15 @@ CWebObj::CWebObj()
   m_bEnableWebsockets              = true;
   m_websocket_document_root        = VSCPDB_CONFIG_DEFAULT_WEBSOCKET_DOCUMENT_ROOT;
   m_websocket_timeout_ms           = 10000;
-  bool bEnable_websocket_ping_pong = true;
+  m_websocket_fanout_threads       = 0;
+  bEnable_websocket_ping_pong      = true;
+
+  m_bEnableRestApi      = true;
+  m_rest_token_lifetime = REST_DEFAULT_TOKEN_LIFETIME;
+
+  m_bKeyFromFile = false;
 
-  m_bEnableRestApi = true;
+  m_bEnableMetrics = true;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -214,12 +243,20 @@ CWebObj::~CWebObj()
 {
   close();
 
-  sem_destroy(&m_semSendQueue);
   sem_destroy(&m_semReceiveQueue);
 
   // pthread_mutex_destroy(&m_mutexSendQueue);
   pthread_mutex_destroy(&m_mutexReceiveQueue);
 
+  pthread_cond_destroy(&m_condHousekeeping);
+  pthread_mutex_destroy(&m_mutexHousekeeping);
+
+  pthread_mutex_destroy(&m_mutex_websrvSession);
+  pthread_mutex_destroy(&m_mutex_restSession);
+  pthread_mutex_destroy(&m_mutex_websocketSession);
+  pthread_mutex_destroy(&m_mutex_UserList);
+  pthread_mutex_destroy(&m_mutex_clientList);
+
   // Shutdown logger in a nice way
   spdlog::drop_all();
   spdlog::shutdown();
@@ -246,6 +283,26 @@ CWebObj::open(std::string &path, const cguid &guid)
     return false;
   }
 
+  // Websocket sessions are handed to the fan-out threads as they connect
+  if (!m_fanout.start(this, m_websocket_fanout_threads)) {
+    spdlog::get("logger")->error("Unable to start websocket fan-out threads.");
+    return false;
+  }
+
+  // Live tail for the log page
+  if (m_bFileLogEnable && m_bEnableMetrics && m_bEnableWebsockets) {
+    if (!m_logTail.start(m_path_to_log_file)) {
+      m_logger->error("Unable to start log tail thread.");
+    }
+  }
+
+  // Event monitor for the monitor page
+  if (m_bEnableMetrics && m_bEnableWebsockets && m_monitor.isEnabled()) {
+    if (!m_monitor.start()) {
+      m_logger->error("Unable to start event monitor thread.");
+    }
+  }
+
   // Start the web server
   try {
     start_webserver(this);
@@ -256,15 +313,11 @@ CWebObj::open(std::string &path, const cguid &guid)
   }
 
   // start the workerthread
-  if (pthread_create(&m_pthreadSend, NULL, workerThreadSend, this)) {
-    spdlog::get("logger")->error("Unable to start send worker thread.");
-    return false;
-  }
-
   if (pthread_create(&m_pthreadReceive, NULL, workerThreadReceive, this)) {
     spdlog::get("logger")->error("Unable to start receive worker thread.");
     return false;
   }
+  m_bReceiveThread = true;
 
   return true;
 }
@@ -281,8 +334,23 @@ CWebObj::close(void)
     return;
   }
 
-  m_bQuit = true; // terminate the thread
-  sleep(1);       // Give the thread some time to terminate
+  // Tell the worker threads to terminate and wake them up
+  pthread_mutex_lock(&m_mutexHousekeeping);
+  m_bQuit = true;
+  pthread_cond_signal(&m_condHousekeeping);
+  pthread_mutex_unlock(&m_mutexHousekeeping);
+
+  m_fanout.stop();
+  m_logTail.stop();
+  m_monitor.stop();
+  m_jsPool.clear();
+  m_luaPool.clear();
+  m_clientSignal.notify(); // Release scripts waiting for events
+
+  if (m_bReceiveThread) {
+    pthread_join(m_pthreadReceive, NULL);
+    m_bReceiveThread = false;
+  }
 }
 
 // ----------------------------------------------------------------------------
@@ -296,13 +364,17 @@ CWebObj::eventToReceiveQueue(vscpEvent *pev)
 {
   if (nullptr != pev) {
     if (vscp_doLevel2Filter(pev, &m_filterIn)) {
+      m_monitor.record(pev, WEBMONITOR_DIR_IN);
       pthread_mutex_lock(&m_mutexReceiveQueue);
       m_receiveList.push_back(pev);
+      m_memory.m_receiveQueue.addEvent(pev);
       sem_post(&m_semReceiveQueue);
       pthread_mutex_unlock(&m_mutexReceiveQueue);
+      m_metrics.m_ingressEvents.inc();
     }
     else {
-      spdlog::get("logger")->debug("Receive event filtered away.");
+      m_metrics.m_ingressFiltered.inc();
+      m_logger->debug("Receive event filtered away.");
       vscp_deleteEvent_v2(&pev);
     }
   }
@@ -328,13 +400,17 @@ CWebObj::eventExToReceiveQueue(vscpEventEx &ex)
   }
   if (NULL != pev) {
     if (vscp_doLevel2Filter(pev, &m_filterIn)) {
+      m_monitor.record(pev, WEBMONITOR_DIR_IN);
       pthread_mutex_lock(&m_mutexReceiveQueue);
       m_receiveList.push_back(pev);
+      m_memory.m_receiveQueue.addEvent(pev);
       sem_post(&m_semReceiveQueue);
       pthread_mutex_unlock(&m_mutexReceiveQueue);
+      m_metrics.m_ingressEvents.inc();
     }
     else {
-      spdlog::get("logger")->debug("Receive event filtered away.");
+      m_metrics.m_ingressFiltered.inc();
+      m_logger->debug("Receive event filtered away.");
       vscp_deleteEvent(pev);
     }
   }
@@ -346,23 +422,391 @@ CWebObj::eventExToReceiveQueue(vscpEventEx &ex)
 }
 
 //////////////////////////////////////////////////////////////////////
-// addEvent2SendQueue
+// queueEventToClients
 //
 
 bool
-CWebObj::addEvent2SendQueue(const vscpEvent *pEvent)
+CWebObj::queueEventToClients(const vscpEvent *pEvent, bool bMakeRoom, const struct timespec *pIngress)
+{
+  std::deque<CClientItem *> targets;
+  size_t evbytes       = CWebFlowControl::eventBytes(pEvent);
+  size_t totalEvents   = 0;
+  size_t totalBytes    = 0;
+  size_t clientMaxSize = m_flowControl.m_clientMaxEvents;
+  size_t globalMaxSize = m_flowControl.m_globalMaxEvents;
+
+  // Only check bytes when a byte budget can be reached before the
+  // event budget is. Bytes are running counts, the queues are not walked.
+  const size_t maxEventBytes = sizeof(vscpEvent) + VSCP_LEVEL2_MAXDATA;
+  bool bClientBytes          = m_flowControl.isCountingClientBytes();
+  bool bGlobalBytes          = m_flowControl.m_globalMaxBytes &&
+                               (!globalMaxSize || ((globalMaxSize * maxEventBytes) > m_flowControl.m_globalMaxBytes));
+  if (bGlobalBytes) {
+    totalBytes = m_memory.m_clientQueues.getBytes();
+  }
+
+  // Find receivers and check the budgets
+  bool bFits = true;
+  std::deque<CClientItem *>::iterator it;
+  for (it = m_clientList.m_itemList.begin(); it != m_clientList.m_itemList.end(); ++it) {
+
+    CClientItem *pClientItem = *it;
+    if (NULL == pClientItem) {
+      continue;
+    }
+
+    pthread_mutex_lock(&pClientItem->m_mutexClientInputQueue);
+    size_t cnt   = pClientItem->m_clientInputQueue.size();
+    bool bTarget = pClientItem->m_bOpen && vscp_doLevel2Filter(pEvent, &pClientItem->m_filter);
+    pthread_mutex_unlock(&pClientItem->m_mutexClientInputQueue);
+
+    totalEvents += cnt;
+
+    // Clients that are not open get nothing
+    if (!bTarget) {
+      continue;
+    }
+
+    size_t bytes = bClientBytes ? m_flowControl.getClientBytes(pClientItem) : 0;
+
+    targets.push_back(pClientItem);
+
+    if (clientMaxSize && ((cnt + 1) > clientMaxSize)) {
+      bFits = false;
+    }
+
+    if (bClientBytes && ((bytes + evbytes) > m_flowControl.m_clientMaxBytes)) {
+      bFits = false;
+    }
+  }
+
+  if (targets.empty()) {
+    return true;
+  }
+
+  if (globalMaxSize && ((totalEvents + targets.size()) > globalMaxSize)) {
+    bFits = false;
+  }
+
+  if (bGlobalBytes && ((totalBytes + targets.size() * evbytes) > m_flowControl.m_globalMaxBytes)) {
+    bFits = false;
+  }
+
+  if (!bFits && !bMakeRoom) {
+    return false;
+  }
+
+  if (!bFits) {
+
+    uint64_t dropped = 0;
+
+    // Make room in each receiving queue
+    for (it = targets.begin(); it != targets.end(); ++it) {
+
+      CClientItem *pClientItem = *it;
+      pthread_mutex_lock(&pClientItem->m_mutexClientInputQueue);
+      std::deque<vscpEvent *> &queue = pClientItem->m_clientInputQueue;
+      size_t bytes                   = bClientBytes ? m_flowControl.getClientBytes(pClientItem) : 0;
+      while (!queue.empty() && ((clientMaxSize && ((queue.size() + 1) > clientMaxSize)) ||
+                                (bClientBytes && ((bytes + evbytes) > m_flowControl.m_clientMaxBytes)))) {
+        vscpEvent *pOld = queue.front();
+        queue.pop_front();
+        size_t oldbytes = CWebFlowControl::eventBytes(pOld);
+        m_memory.m_clientQueues.sub(oldbytes);
+        m_flowControl.subClientBytes(pClientItem, oldbytes);
+        m_trace.forgetIngress(pOld);
+        bytes -= std::min(bytes, oldbytes);
+        totalBytes -= std::min(totalBytes, oldbytes);
+        totalEvents--;
+        vscp_deleteEvent_v2(&pOld);
+        dropped++;
+      }
+      pthread_mutex_unlock(&pClientItem->m_mutexClientInputQueue);
+    }
+
+    // Make room in all queues together, taking from the longest queue.
+    // Consumers drain the queues meanwhile so the totals are read again
+    // from the queue accounting for each round.
+    while (true) {
+
+      totalEvents = (size_t) m_memory.m_clientQueues.getItems();
+      totalBytes  = (size_t) m_memory.m_clientQueues.getBytes();
+      if (!(globalMaxSize && ((totalEvents + targets.size()) > globalMaxSize)) &&
+          !(bGlobalBytes && ((totalBytes + targets.size() * evbytes) > m_flowControl.m_globalMaxBytes))) {
+        break;
+      }
+
+      CClientItem *pLongest = NULL;
+      size_t longest        = 0;
+      for (it = m_clientList.m_itemList.begin(); it != m_clientList.m_itemList.end(); ++it) {
+        if (NULL == *it) {
+          continue;
+        }
+        pthread_mutex_lock(&(*it)->m_mutexClientInputQueue);
+        size_t cnt = (*it)->m_clientInputQueue.size();
+        pthread_mutex_unlock(&(*it)->m_mutexClientInputQueue);
+        if (cnt > longest) {
+          pLongest = *it;
+          longest  = cnt;
+        }
+      }
+
+      if (NULL == pLongest) {
+        break; // All queues are empty
+      }
+
+      pthread_mutex_lock(&pLongest->m_mutexClientInputQueue);
+      if (!pLongest->m_clientInputQueue.empty()) {
+        vscpEvent *pOld = pLongest->m_clientInputQueue.front();
+        pLongest->m_clientInputQueue.pop_front();
+        size_t oldbytes = CWebFlowControl::eventBytes(pOld);
+        m_memory.m_clientQueues.sub(oldbytes);
+        m_flowControl.subClientBytes(pLongest, oldbytes);
+        m_trace.forgetIngress(pOld);
+        vscp_deleteEvent_v2(&pOld);
+        dropped++;
+      }
+      pthread_mutex_unlock(&pLongest->m_mutexClientInputQueue);
+    }
+
+    m_metrics.m_flowDropped.inc(dropped);
+  }
+
+  // Give each receiver its own copy
+  for (it = targets.begin(); it != targets.end(); ++it) {
+
+    vscpEvent *pNewEvent = new vscpEvent;
+    if (NULL == pNewEvent) {
+      continue;
+    }
+
+    pNewEvent->pdata = NULL;
+    if (!vscp_copyEvent(pNewEvent, pEvent)) {
+      vscp_deleteEvent_v2(&pNewEvent);
+      continue;
+    }
+
+    if (NULL != pIngress) {
+      m_trace.stampIngress(pNewEvent, *pIngress);
+    }
+
+    pthread_mutex_lock(&(*it)->m_mutexClientInputQueue);
+    (*it)->m_clientInputQueue.push_back(pNewEvent);
+    m_memory.m_clientQueues.addEvent(pNewEvent);
+    m_flowControl.addClientBytes(*it, evbytes);
+    pthread_mutex_unlock(&(*it)->m_mutexClientInputQueue);
+  }
+
+  return true;
+}
+
+//////////////////////////////////////////////////////////////////////
+// releaseClientQueue
+//
+
+void
+CWebObj::releaseClientQueue(CClientItem *pClientItem)
+{
+  if (NULL == pClientItem) {
+    return;
+  }
+
+  pthread_mutex_lock(&pClientItem->m_mutexClientInputQueue);
+  m_memory.m_clientQueues.subEvents(pClientItem->m_clientInputQueue);
+  m_trace.forgetIngress(pClientItem->m_clientInputQueue);
+  m_flowControl.clearClientBytes(pClientItem);
+  pthread_mutex_unlock(&pClientItem->m_mutexClientInputQueue);
+}
+
+//////////////////////////////////////////////////////////////////////
+// addScriptClient
+//
+
+CClientItem *
+CWebObj::addScriptClient(uint8_t type, const std::string &name)
 {
-  // pthread_mutex_lock(&m_mutexSendQueue);
-  // m_sendList.push_back((vscpEvent*)pEvent);
-  // sem_post(&m_semSendQueue);
-  // pthread_mutex_lock(&m_mutexSendQueue);
+  CClientItem *pClientItem = new CClientItem();
+  vscp_clearVSCPFilter(&pClientItem->m_filter);
+  pClientItem->m_bOpen = false;
+  pClientItem->m_type  = type;
+  pClientItem->setDeviceName(name);
 
   pthread_mutex_lock(&m_mutex_clientList);
-  m_clientList.sendEventAllClients(pEvent);
+  pthread_mutex_lock(&m_clientList.m_mutexItemList);
+  bool bAdded = m_clientList.addClient(pClientItem);
+  pthread_mutex_unlock(&m_clientList.m_mutexItemList);
   pthread_mutex_unlock(&m_mutex_clientList);
-  sem_post(&m_semSendQueue); // Signal that event is available
 
-  return true;
+  if (!bAdded) {
+    delete pClientItem;
+    return NULL;
+  }
+
+  pClientItem->m_bOpen = true;
+
+  return pClientItem;
+}
+
+//////////////////////////////////////////////////////////////////////
+// removeScriptClient
+//
+
+void
+CWebObj::removeScriptClient(CClientItem *pClientItem)
+{
+  if (NULL == pClientItem) {
+    return;
+  }
+
+  pClientItem->m_bOpen = false;
+
+  pthread_mutex_lock(&m_mutex_clientList);
+  pthread_mutex_lock(&m_clientList.m_mutexItemList);
+  releaseClientQueue(pClientItem);
+  m_clientList.removeClient(pClientItem);
+  pthread_mutex_unlock(&m_clientList.m_mutexItemList);
+  pthread_mutex_unlock(&m_mutex_clientList);
+}
+
+//////////////////////////////////////////////////////////////////////
+// getClientEvents
+//
+
+size_t
+CWebObj::getClientEvents(CClientItem *pClientItem,
+                         std::deque<vscpEvent *> &events,
+                         size_t max,
+                         uint32_t timeout)
+{
+  if ((NULL == pClientItem) || !max) {
+    return 0;
+  }
+
+  struct timespec start = webmetrics_now();
+  size_t cnt            = 0;
+
+  for (;;) {
+
+    // Taken before the queue is checked so a notify in between is seen
+    uint64_t seq = m_clientSignal.get();
+
+    pthread_mutex_lock(&pClientItem->m_mutexClientInputQueue);
+    std::deque<vscpEvent *> &queue = pClientItem->m_clientInputQueue;
+    while (pClientItem->m_bOpen && !queue.empty() && (cnt < max)) {
+      vscpEvent *pEvent = queue.front();
+      queue.pop_front();
+      m_memory.m_clientQueues.subEvent(pEvent);
+      m_flowControl.subClientBytes(pClientItem, CWebFlowControl::eventBytes(pEvent));
+      m_trace.forgetIngress(pEvent);
+
+      if (NULL == pEvent) {
+        continue;
+      }
+
+      // The filter may have changed after the event was queued
+      if (!vscp_doLevel2Filter(pEvent, &pClientItem->m_filter)) {
+        vscp_deleteEvent_v2(&pEvent);
+        continue;
+      }
+
+      events.push_back(pEvent);
+      cnt++;
+    }
+    pthread_mutex_unlock(&pClientItem->m_mutexClientInputQueue);
+
+    if (cnt || m_bQuit || !pClientItem->m_bOpen) {
+      break;
+    }
+
+    struct timespec now = webmetrics_now();
+    int64_t elapsed     = (int64_t)(now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+    if (elapsed >= (int64_t) timeout) {
+      break;
+    }
+
+    m_clientSignal.wait(seq, (uint32_t)(timeout - elapsed));
+  }
+
+  // Queue has room again
+  if (cnt) {
+    m_flowControl.notify();
+  }
+
+  return cnt;
+}
+
+//////////////////////////////////////////////////////////////////////
+// addEvent2SendQueue
+//
+
+int
+CWebObj::addEvent2SendQueue(const vscpEvent *pEvent, unsigned long timeout)
+{
+  if (NULL == pEvent) {
+    return CANAL_ERROR_PARAMETER;
+  }
+
+  // Sampled events are stamped for latency tracing when they are
+  // copied to the client queues
+  struct timespec ingress;
+  bool bTrace = m_trace.sample();
+  if (bTrace) {
+    ingress = webmetrics_now();
+  }
+
+  bool bMakeRoom = (WEBFLOW_POLICY_DROP_OLDEST == m_flowControl.m_policy);
+  if (!timeout) {
+    timeout = m_flowControl.m_blockTimeout;
+  }
+
+  struct timespec start = webmetrics_now();
+  bool bWaited          = false;
+  bool bQueued;
+
+  for (;;) {
+
+    pthread_mutex_lock(&m_mutex_clientList);
+    pthread_mutex_lock(&m_clientList.m_mutexItemList);
+    bQueued = queueEventToClients(pEvent, bMakeRoom, bTrace ? &ingress : NULL);
+    pthread_mutex_unlock(&m_clientList.m_mutexItemList);
+    pthread_mutex_unlock(&m_mutex_clientList);
+
+    if (bQueued || (WEBFLOW_POLICY_BLOCK != m_flowControl.m_policy)) {
+      break;
+    }
+
+    // Block policy: wait for consumers to make room
+    struct timespec now = webmetrics_now();
+    int64_t elapsed     = (int64_t)(now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+    if (elapsed >= (int64_t) timeout) {
+      break;
+    }
+
+    if (!bWaited) {
+      bWaited = true;
+      m_metrics.m_flowBlocked.inc();
+    }
+
+    m_flowControl.wait((uint32_t)(timeout - elapsed));
+  }
+
+  if (!bQueued) {
+    m_metrics.m_flowRejected.inc();
+    return CANAL_ERROR_FIFO_FULL;
+  }
+
+  m_metrics.m_fanoutEvents.inc();
+  m_monitor.record(pEvent, WEBMONITOR_DIR_OUT);
+
+  if (bTrace) {
+    m_trace.m_stageEnqueue.recordSince(ingress);
+    m_trace.markPost();
+  }
+
+  m_fanout.wakeup();       // Signal that events are available
+  m_clientSignal.notify(); // Wake scripts waiting for events
+
+  return CANAL_ERROR_SUCCESS;
 }
 
 // ----------------------------------------------------------------------------
@@ -624,6 +1068,27 @@ CWebObj::doLoadConfig(void)
       spdlog::error("Failed to read LOGGING 'file-max-files' Defaults will be used.");
     }
 
+    // Logging: async-queue-size
+    if (j.contains("async-queue-size") && j["async-queue-size"].is_number_unsigned()) {
+      m_log_queue_size = j["async-queue-size"].get<size_t>();
+    }
+
+    // Logging: async-overflow
+    if (j.contains("async-overflow") && j["async-overflow"].is_string()) {
+      std::string str = j["async-overflow"].get<std::string>();
+      vscp_trim(str);
+      vscp_makeLower(str);
+      if ("block" == str) {
+        m_bLogBlockOnOverflow = true;
+      }
+      else if ("overrun" == str) {
+        m_bLogBlockOnOverflow = false;
+      }
+      else {
+        spdlog::error("Invalid LOGGING 'async-overflow' value '{}'. Defaults will be used.", str);
+      }
+    }
+
   } // Logging
   else {
     spdlog::error("No logging has been setup.");
@@ -659,15 +1124,39 @@ CWebObj::doLoadConfig(void)
     rotating_file_sink->set_level(spdlog::level::off);
   }
 
+  // Bounded queue for the log thread. When it is full the oldest messages
+  // are dropped unless blocking is requested, so a slow sink never stalls
+  // the event paths.
+  spdlog::init_thread_pool(m_log_queue_size ? m_log_queue_size : 1, 1, []() {
+    CWebThreadSettings::setName("wsrv-log");
+  });
+
   std::vector<spdlog::sink_ptr> sinks{ console_sink, rotating_file_sink };
   auto logger = std::make_shared<spdlog::async_logger>("logger",
                                                        sinks.begin(),
                                                        sinks.end(),
                                                        spdlog::thread_pool(),
-                                                       spdlog::async_overflow_policy::block);
-  // The separate sub loggers will handle trace levels
-  logger->set_level(spdlog::level::trace);
+                                                       m_bLogBlockOnOverflow
+                                                         ? spdlog::async_overflow_policy::block
+                                                         : spdlog::async_overflow_policy::overrun_oldest);
+
+  // The logger level is the lowest enabled sink level so messages no
+  // sink wants are dropped before they are formatted and queued.
+  spdlog::level::level_enum level = spdlog::level::off;
+  if (m_bConsoleLogEnable) {
+    level = std::min(level, m_consoleLogLevel);
+  }
+  if (m_bFileLogEnable) {
+    level = std::min(level, m_fileLogLevel);
+  }
+  logger->set_level(level);
+
+  spdlog::drop("logger");
   spdlog::register_logger(logger);
+  m_logger = logger;
+
+  m_threadsEvent.setLogger(logger);
+  m_threadsHttp.setLogger(logger);
 
   // ------------------------------------------------------------------------
 
@@ -697,6 +1186,7 @@ CWebObj::doLoadConfig(void)
                    m_j_config["key-file"].get<std::string>());
     }
     else {
+      m_bKeyFromFile = true;
       spdlog::debug("key-file {} read successfully", m_j_config["key-file"].get<std::string>());
     }
   }
@@ -712,6 +1202,8 @@ CWebObj::doLoadConfig(void)
         spdlog::critical("Failed to load users from file 'user-path'='{}'. Terminating!", m_pathUsers);
         return false;
       }
+      // Cached verifications are for the old user list
+      m_credentialCache.clear();
     }
     catch (const std::exception &ex) {
       spdlog::error("Failed to read 'path-users' Error='{}'", ex.what());
@@ -724,6 +1216,27 @@ CWebObj::doLoadConfig(void)
     spdlog::warn("Failed to read 'path-users' Defaults will be used.");
   }
 
+  // Credential cache
+  if (m_j_config.contains("auth-cache") && m_j_config["auth-cache"].is_object()) {
+
+    json j = m_j_config["auth-cache"];
+
+    uint32_t ttl      = CREDCACHE_DEFAULT_TTL;
+    size_t maxEntries = CREDCACHE_DEFAULT_MAX_ENTRIES;
+
+    // ttl-s
+    if (j.contains("ttl-s") && j["ttl-s"].is_number_unsigned()) {
+      ttl = j["ttl-s"].get<uint32_t>();
+    }
+
+    // max-entries
+    if (j.contains("max-entries") && j["max-entries"].is_number_unsigned()) {
+      maxEntries = j["max-entries"].get<size_t>();
+    }
+
+    m_credentialCache.setParameters(ttl, maxEntries);
+  }
+
   // Filter
   if (m_j_config.contains("filter") && m_j_config["filter"].is_object()) {
 
@@ -949,6 +1462,14 @@ CWebObj::doLoadConfig(void)
       m_enable_auth_domain_check = j["enable-auth-domain-check"].get<bool>();
     }
 
+    // admin-user : "admin"
+    // The only user that can open the admin pages below /vscp/. Must be
+    // a user in the user file.
+
+    if (j.contains("admin-user") && j["admin-user"].is_string()) {
+      m_admin_user = j["admin-user"].get<std::string>();
+    }
+
     // access-log-file : ""
     // Path to a file for access logs. Either full path, or relative to the
     // current working directory. If absent (default), then accesses are not
@@ -1773,6 +2294,28 @@ CWebObj::doLoadConfig(void)
 
     } // CGI
 
+    // Compression
+    if (j.contains("compression") && j["compression"].is_object()) {
+
+      json jj = j["compression"];
+
+      // enable
+      if (jj.contains("enable") && jj["enable"].is_boolean()) {
+        m_web_bEnableCompression = jj["enable"].get<bool>();
+      }
+
+      // threshold
+      if (jj.contains("threshold") && jj["threshold"].is_number()) {
+        m_web_compression_threshold = jj["threshold"].get<size_t>();
+      }
+
+      // level
+      if (jj.contains("level") && jj["level"].is_number()) {
+        m_web_compression_level = jj["level"].get<int>();
+      }
+
+    } // Compression
+
     // Duktape
     if (j.contains("duktape") && j["duktape"].is_object()) {
 
@@ -1830,8 +2373,88 @@ CWebObj::doLoadConfig(void)
       m_bEnableRestApi = j["enable"].get<bool>();
     }
 
+    // token-lifetime-s
+    if (j.contains("token-lifetime-s") && j["token-lifetime-s"].is_number()) {
+      m_rest_token_lifetime = j["token-lifetime-s"].get<long>();
+    }
+
   } // restapi
 
+  //*************************************************************************
+  //                               Metrics
+  //*************************************************************************
+
+  if (m_j_config.contains("metrics") && m_j_config["metrics"].is_object()) {
+
+    json j = m_j_config["metrics"];
+
+    // enable
+    if (j.contains("enable") && j["enable"].is_boolean()) {
+      m_bEnableMetrics = j["enable"].get<bool>();
+    }
+
+    // trace
+    if (j.contains("trace") && j["trace"].is_object()) {
+
+      json jj = j["trace"];
+
+      bool bEnable        = false;
+      uint32_t sampleRate = WEB_TRACE_DEFAULT_SAMPLE_RATE;
+
+      // enable
+      if (jj.contains("enable") && jj["enable"].is_boolean()) {
+        bEnable = jj["enable"].get<bool>();
+      }
+
+      // sample-rate
+      if (jj.contains("sample-rate") && jj["sample-rate"].is_number_unsigned()) {
+        sampleRate = jj["sample-rate"].get<uint32_t>();
+      }
+
+      m_trace.setParameters(bEnable, sampleRate);
+    }
+
+    // monitor
+    if (j.contains("monitor") && j["monitor"].is_object()) {
+
+      json jj = j["monitor"];
+
+      bool bEnable        = true;
+      uint32_t bufferSize = WEBMONITOR_DEFAULT_BUFFER_SIZE;
+      uint32_t frameRate  = WEBMONITOR_DEFAULT_FRAME_RATE;
+      uint32_t sampleRate = WEBMONITOR_DEFAULT_SAMPLE_RATE;
+      uint32_t maxViewers = WEBMONITOR_DEFAULT_MAX_VIEWERS;
+
+      // enable
+      if (jj.contains("enable") && jj["enable"].is_boolean()) {
+        bEnable = jj["enable"].get<bool>();
+      }
+
+      // buffer-size
+      if (jj.contains("buffer-size") && jj["buffer-size"].is_number_unsigned()) {
+        bufferSize = jj["buffer-size"].get<uint32_t>();
+      }
+
+      // frame-rate
+      if (jj.contains("frame-rate") && jj["frame-rate"].is_number_unsigned()) {
+        frameRate = jj["frame-rate"].get<uint32_t>();
+      }
+
+      // sample-rate
+      if (jj.contains("sample-rate") && jj["sample-rate"].is_number_unsigned()) {
+        sampleRate = jj["sample-rate"].get<uint32_t>();
+      }
+
+      // max-viewers
+      if (jj.contains("max-viewers") && jj["max-viewers"].is_number_unsigned()) {
+        maxViewers = jj["max-viewers"].get<uint32_t>();
+      }
+
+      m_monitor.setParameters(bEnable, bufferSize, frameRate, sampleRate, maxViewers);
+    }
+
+  } // metrics
+
   //*************************************************************************
   //                             Websockets
   //*************************************************************************
@@ -1860,11 +2483,104 @@ CWebObj::doLoadConfig(void)
       bEnable_websocket_ping_pong = j["enable-ping-pong"].get<bool>();
     }
 
+    // fanout-threads : 0,
+    if (j.contains("fanout-threads") && j["fanout-threads"].is_number_integer()) {
+      m_websocket_fanout_threads = j["fanout-threads"].get<int>();
+    }
+
   } // websocket
 
+  // Thread placement and scheduling
+  if (m_j_config.contains("threads") && m_j_config["threads"].is_object()) {
+
+    json j = m_j_config["threads"];
+
+    // event : { ... }   - fan-out and housekeeping threads
+    if (j.contains("event") && j["event"].is_object()) {
+      doLoadThreadSettings(m_threadsEvent, j["event"], "event");
+    }
+
+    // http : { ... }    - web server threads
+    if (j.contains("http") && j["http"].is_object()) {
+      doLoadThreadSettings(m_threadsHttp, j["http"], "http");
+    }
+
+  } // threads
+
+  // Client queue budgets
+  if (m_j_config.contains("backpressure") && m_j_config["backpressure"].is_object()) {
+
+    json j = m_j_config["backpressure"];
+
+    // policy : "drop-oldest",
+    if (j.contains("policy") && j["policy"].is_string()) {
+      if (!m_flowControl.setPolicy(j["policy"].get<std::string>())) {
+        spdlog::get("logger")->error("Invalid 'backpressure.policy' = '{}'. Defaults will be used.",
+                                     j["policy"].get<std::string>());
+      }
+    }
+
+    // block-timeout-ms : 100,
+    if (j.contains("block-timeout-ms") && j["block-timeout-ms"].is_number_unsigned()) {
+      m_flowControl.m_blockTimeout = j["block-timeout-ms"].get<uint32_t>();
+    }
+
+    // client-max-events : 1024,
+    if (j.contains("client-max-events") && j["client-max-events"].is_number_unsigned()) {
+      m_flowControl.m_clientMaxEvents = j["client-max-events"].get<uint32_t>();
+    }
+
+    // client-max-bytes : 1048576,
+    if (j.contains("client-max-bytes") && j["client-max-bytes"].is_number_unsigned()) {
+      m_flowControl.m_clientMaxBytes = j["client-max-bytes"].get<size_t>();
+    }
+
+    // global-max-events : 65536,
+    if (j.contains("global-max-events") && j["global-max-events"].is_number_unsigned()) {
+      m_flowControl.m_globalMaxEvents = j["global-max-events"].get<uint32_t>();
+    }
+
+    // global-max-bytes : 67108864
+    if (j.contains("global-max-bytes") && j["global-max-bytes"].is_number_unsigned()) {
+      m_flowControl.m_globalMaxBytes = j["global-max-bytes"].get<size_t>();
+    }
+
+  } // backpressure
+
   return true;
 }
 
+//////////////////////////////////////////////////////////////////////
+// doLoadThreadSettings
+//
+
+void
+CWebObj::doLoadThreadSettings(CWebThreadSettings &settings, json &j, const char *group)
+{
+  // cpus : "0-1",
+  if (j.contains("cpus") && j["cpus"].is_string()) {
+    if (!settings.setCpus(j["cpus"].get<std::string>())) {
+      spdlog::get("logger")->error("Invalid 'threads.{}.cpus' = '{}'. Ignored.",
+                                   group,
+                                   j["cpus"].get<std::string>());
+    }
+  }
+
+  // policy : "other",
+  if (j.contains("policy") && j["policy"].is_string()) {
+    if (!settings.setPolicy(j["policy"].get<std::string>())) {
+      spdlog::get("logger")->error("Invalid 'threads.{}.policy' = '{}'. Ignored.",
+                                   group,
+                                   j["policy"].get<std::string>());
+    }
+  }
+
+  // priority : 0
+  if (j.contains("priority") && j["priority"].is_number_integer()) {
+    settings.setPriority(j["priority"].get<int>());
+  }
+}
+
 // int depth_hlo_parser = 0;
 
 // void
@@ -2298,78 +3014,56 @@ CWebObj::doLoadConfig(void)
 // }
 
 //////////////////////////////////////////////////////////////////////
-// Send worker thread
+// Receive worker thread
 //
-// The task here is top deliver outgoing events to each clients queue
+// Incoming events are put straight on the receive queue by the web
+// handlers and fetched by the host with VSCPRead so there is nothing
+// to move here. The thread does housekeeping instead. It sleeps on a
+// condition variable and wakes up every VSCP_WS_HOUSEKEEPING_INTERVAL
+// seconds or when close() signals it.
 //
 
 void *
-workerThreadSend(void *pData)
+workerThreadReceive(void *pData)
 {
-  spdlog::get("logger")->debug("Starting transmitt worker thread");
+  spdlog::get("logger")->debug("Starting receive worker thread");
 
   CWebObj *pObj = (CWebObj *) pData;
   if (NULL == pObj) {
     return NULL;
   }
 
+  pObj->m_threadsEvent.apply("wsrv-housekeep");
+
   // Work until the end
+  pthread_mutex_lock(&pObj->m_mutexHousekeeping);
   while (!pObj->m_bQuit) {
 
-    if ((-1 == vscp_sem_wait(&pObj->m_semSendQueue, 500)) && errno == ETIMEDOUT) {
-      continue;
-    }
-
-    // // Check if there is event(s) to send
-    // if (pObj->m_sendList.size()) {
-
-    //   // Yes there are data to send
-    //   pthread_mutex_lock(&pObj->m_mutexSendQueue);
-    //   vscpEvent *pEvent = pObj->m_sendList.front();
-    //   pObj->m_sendList.pop_front();
-    //   pthread_mutex_unlock(&pObj->m_mutexSendQueue);
-
-    //   if (nullptr == pEvent) {
-    //     spdlog::get("logger")->error("NULL event in send queue.");
-    //     continue;
-    //   }
-
-    // Send event to all open ws1 and ws2 websockets
-    websock_post_outgoingEvent(pObj);
-
-    // Yes there is data to send
-    // Send it out to the remote server
-    //   pthread_mutex_lock(&pObj->m_mutex_clientList);
-    //   pObj->m_clientList.sendEventAllClients(pEvent);
-    //   pthread_mutex_unlock(&pObj->m_mutex_clientList);
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += VSCP_WS_HOUSEKEEPING_INTERVAL;
 
-    //   vscp_deleteEvent_v2(&pEvent);
-    // }
-  }
+    int rv = 0;
+    while (!pObj->m_bQuit && (ETIMEDOUT != rv)) {
+      rv = pthread_cond_timedwait(&pObj->m_condHousekeeping, &pObj->m_mutexHousekeeping, &ts);
+    }
 
-  spdlog::get("logger")->debug("Ending transmitt worker thread");
+    if (pObj->m_bQuit) {
+      break;
+    }
 
-  return NULL;
-}
+    pthread_mutex_unlock(&pObj->m_mutexHousekeeping);
 
-//////////////////////////////////////////////////////////////////////
-// Receive worker thread
-//
+    // Remove REST and web sessions that has been idle too long
+    restsrv_expire_sessions(NULL, pObj);
+    websrv_expire_sessions(NULL, pObj);
 
-void *
-workerThreadReceive(void *pData)
-{
-  spdlog::get("logger")->debug("Starting receive worker thread");
+    // Traced copies that were lost without being delivered or freed
+    pObj->m_trace.prune();
 
-  CWebObj *pObj = (CWebObj *) pData;
-  if (NULL == pObj) {
-    return NULL;
-  }
-
-  // Work until the end
-  while (!pObj->m_bQuit) {
-    usleep(5000);
+    pthread_mutex_lock(&pObj->m_mutexHousekeeping);
   }
+  pthread_mutex_unlock(&pObj->m_mutexHousekeeping);
 
   spdlog::get("logger")->debug("Ending receive worker thread");
 
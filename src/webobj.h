@@ -27,6 +27,7 @@
 #define _POSIX
 
 #include <list>
+#include <memory>
 #include <string>
 
 #include <pthread.h>
@@ -38,9 +39,20 @@
 #include <canal.h>
 #include <canal_macro.h>
 #include <clientlist.h>
+#include <credcache.h>
 #include <guid.h>
 #include <userlist.h>
 #include <vscp.h>
+#include <webfanout.h>
+#include <webflow.h>
+#include <webjs.h>
+#include <weblog.h>
+#include <weblua.h>
+#include <webmemory.h>
+#include <webmetrics.h>
+#include <webmonitor.h>
+#include <webthread.h>
+#include <webtrace.h>
 
 #include <json.hpp> // Needs C++11  -std=c++11
 
@@ -57,6 +69,9 @@ using json = nlohmann::json;
 #define VSCP_LEVEL2_DLL_WS_OBJ_MUTEX "___VSCP__DLL_L2WEBSRV_OBJ_MUTEX____"
 #define VSCP_WS_LIST_MAX_MSG         2048
 
+// Seconds between housekeeping runs (session expiry) in the receive thread
+#define VSCP_WS_HOUSEKEEPING_INTERVAL 60
+
 // Module Local HLO op's
 #define HLO_OP_LOCAL_CONNECT    HLO_OP_USER_DEFINED + 0
 #define HLO_OP_LOCAL_DISCONNECT HLO_OP_USER_DEFINED + 1
@@ -113,6 +128,14 @@ public:
   */
   bool doLoadConfig(void);
 
+  /*!
+    Load CPU affinity and scheduling for a group of threads
+    @param settings Settings to fill in
+    @param j JSON object with cpus, policy and priority
+    @param group Group name for error messages
+  */
+  void doLoadThreadSettings(CWebThreadSettings &settings, json &j, const char *group);
+
   /*!
     Save configuration if allowed to do so
   */
@@ -139,9 +162,70 @@ public:
   bool eventExToReceiveQueue(vscpEventEx &ex);
 
   /*!
-      Add event to send queue
+      Add event to the queues of all clients it passes the filter for
+
+      @param pEvent Event to send
+      @param timeout Max time (ms) to wait for room with the block
+              policy. Zero uses the configured block timeout.
+      @return CANAL_ERROR_SUCCESS or CANAL_ERROR_FIFO_FULL if the
+              event did not fit and the policy refused it.
+  */
+  int addEvent2SendQueue(const vscpEvent *pEvent, unsigned long timeout = 0);
+
+  /*!
+      Copy event to the queues of the clients it passes the filter for.
+      Client list must be locked by the caller.
+
+      @param pEvent Event to send
+      @param bMakeRoom Drop the oldest queued events if the budgets
+              are exceeded. If false nothing is queued in that case.
+      @param pIngress Ingress time of a traced event, NULL if the
+              event is not traced.
+      @return true if the event was queued.
+  */
+  bool queueEventToClients(const vscpEvent *pEvent, bool bMakeRoom, const struct timespec *pIngress);
+
+  /*!
+      Remove the events still queued for a client from the memory
+      accounting. Call before the client is removed from the client list.
+
+      @param pClientItem Client that goes away
+  */
+  void releaseClientQueue(CClientItem *pClientItem);
+
+  /*!
+      Create a client for a script and add it to the client list.
+      The fan-out copies events that pass its filter to its queue,
+      so the script never reads the driver receive queue.
+
+      @param type Client type (CLIENT_ITEM_INTERFACE_TYPE_CLIENT_xxx)
+      @param name Device name of the client
+      @return Open client or NULL on failure
+  */
+  CClientItem *addScriptClient(uint8_t type, const std::string &name);
+
+  /*!
+      Close a script client and remove it from the client list
+
+      @param pClientItem Client from addScriptClient. Deleted.
+  */
+  void removeScriptClient(CClientItem *pClientItem);
+
+  /*!
+      Take events from a client queue for a script. Waits for events
+      if the queue is empty.
+
+      @param pClientItem Client the script reads from
+      @param events Events are appended here. The caller owns them.
+      @param max Max number of events to take
+      @param timeout Max time to wait for the first event in
+              milliseconds. Zero does not wait.
+      @return Number of events taken
   */
-  bool addEvent2SendQueue(const vscpEvent *pEvent);
+  size_t getClientEvents(CClientItem *pClientItem,
+                         std::deque<vscpEvent *> &events,
+                         size_t max,
+                         uint32_t timeout);
 
   /*!
     Send event to MQTT broker
@@ -171,6 +255,9 @@ public:
                              0xe2, 0x2f, 0x9f, 0xfa, 0x0e, 0x7f, 0x72, 0xdf, 0x06, 0xeb, 0xe4,
                              0x45, 0x63, 0xed, 0xf4, 0xa1, 0x07, 0x3c, 0xab, 0xc7, 0xd4 };
 
+  // True if the key above has been read from the key file
+  bool m_bKeyFromFile;
+
   /////////////////////////////////////////////////////////
   //                      Logging
   /////////////////////////////////////////////////////////
@@ -186,6 +273,15 @@ public:
   uint32_t m_max_log_size;                  // Max size for logfile before rotating occures
   uint16_t m_max_log_files;                 // Max log files to keep
 
+  size_t m_log_queue_size;          // Max messages waiting for the log thread
+  bool m_bLogBlockOnOverflow;       // Block (true) or drop oldest (false) when full
+
+  /// The driver logger. Use this on hot paths instead of a registry lookup.
+  std::shared_ptr<spdlog::logger> m_logger;
+
+  /// Live tail of the log file for the admin log page
+  CWebLogTail m_logTail;
+
   // ------------------------------------------------------------------------
 
   // Path to configuration file
@@ -200,9 +296,19 @@ public:
   // TCP/IP link response timeout
   uint32_t m_responseTimeout;
 
-  /// Worker threads
-  pthread_t m_pthreadSend;
+  /// Worker thread
   pthread_t m_pthreadReceive;
+  bool m_bReceiveThread; // True if the receive thread has been started
+
+  /// Affinity and scheduling for the event threads (fan-out, housekeeping)
+  CWebThreadSettings m_threadsEvent;
+
+  /// Affinity and scheduling for the web server threads
+  CWebThreadSettings m_threadsHttp;
+
+  /// Wakes the receive thread for housekeeping or shutdown
+  pthread_mutex_t m_mutexHousekeeping;
+  pthread_cond_t m_condHousekeeping;
 
   //*****************************************************
   //               webserver interface
@@ -229,6 +335,9 @@ public:
 
   bool m_enable_auth_domain_check;
 
+  // User that has access to the admin pages below /vscp/
+  std::string m_admin_user;
+
   std::string m_web_ssl_certificate;
   std::string m_web_ssl_certificate_chain;
   bool m_web_ssl_verify_peer;
@@ -274,6 +383,11 @@ public:
   long m_web_max_request_size;
   bool m_web_allow_index_script_resource;
 
+  // Response compression (gzip/deflate)
+  bool m_web_bEnableCompression;
+  size_t m_web_compression_threshold; // Smaller responses are sent as is
+  int m_web_compression_level;        // zlib level 1-9
+
   std::string m_web_duktape_script_patterns; // *
 
   std::string m_web_lua_preload_file;
@@ -306,6 +420,9 @@ public:
   // Enable REST API
   bool m_bEnableRestApi;
 
+  // Lifetime in seconds for signed REST bearer tokens. Zero disables tokens.
+  long m_rest_token_lifetime;
+
 
   //**************************************************************************
   //                              WEBSOCKETS
@@ -315,6 +432,10 @@ public:
   std::string m_websocket_document_root;
   long m_websocket_timeout_ms;
   bool bEnable_websocket_ping_pong;
+  int m_websocket_fanout_threads; // Zero for one per CPU
+
+  /// Threads that deliver outgoing events to websocket sessions
+  CWebFanout m_fanout;
 
   // * * Websockets * *
 
@@ -338,6 +459,35 @@ public:
   // Mutex for users
   pthread_mutex_t m_mutex_UserList;
 
+  /// Successful credential verifications (protecting mutex in object)
+  CCredentialCache m_credentialCache;
+
+
+  //**************************************************************************
+  //                                METRICS
+  //**************************************************************************
+
+  /// Enable the metrics endpoint
+  bool m_bEnableMetrics;
+
+  /// Counters and latencies (lock free)
+  CWebMetrics m_metrics;
+
+  /// Sampled event latency tracing
+  CWebTrace m_trace;
+
+  /// Memory used by queues and sessions
+  CWebMemory m_memory;
+
+  /// Sampled live view of events for the admin pages
+  CWebMonitor m_monitor;
+
+  /// Duktape heaps and compiled scripts for JavaScript workers
+  CWebJsPool m_jsPool;
+
+  /// Lua states for Lua workers
+  CWebLuaPool m_luaPool;
+
 
   //**************************************************************************
   //                                CLIENTS
@@ -349,6 +499,12 @@ public:
   // Mutex for client queue
   pthread_mutex_t m_mutex_clientList;
 
+  /// Budgets and policy for the client queues
+  CWebFlowControl m_flowControl;
+
+  /// Signalled when events are put in the client queues
+  CWebEventSignal m_clientSignal;
+
 
   //**************************************************************************
   //                                SESSIONS
@@ -364,9 +520,8 @@ public:
   std::list<vscpEvent *> m_receiveList; // Data from client
 
   /*!
-      Event object to indicate that there is an event in the output queue
+      Event object to indicate that there is an event in the input queue
    */
-  sem_t m_semSendQueue;    // Semaphore for Data out to client
   sem_t m_semReceiveQueue; // Semaphore for data in from client
 
   // Mutex to protect the output queue
@@ -0,0 +1,212 @@
+// webrender.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <string.h>
+
+#include "webrender.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// CWebTemplate
+//
+
+CWebTemplate::CWebTemplate(void)
+{
+  m_nFields   = 0;
+  m_bCompiled = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// compile
+//
+
+bool
+CWebTemplate::compile(const std::string &tmpl, const char *const *fields)
+{
+  m_text.clear();
+  m_segments.clear();
+  m_bCompiled = false;
+
+  m_nFields = 0;
+  while ((NULL != fields) && (NULL != fields[m_nFields])) {
+    m_nFields++;
+  }
+
+  m_text.reserve(tmpl.length());
+
+  size_t pos = 0;
+  while (pos < tmpl.length()) {
+
+    size_t start = tmpl.find("{{", pos);
+    if (std::string::npos == start) {
+      start = tmpl.length();
+    }
+
+    // Static slice up to the field
+    if (start > pos) {
+      segment seg;
+      seg.m_offset  = m_text.length();
+      seg.m_len     = start - pos;
+      seg.m_field   = -1;
+      seg.m_bEscape = false;
+      m_text.append(tmpl, pos, start - pos);
+      m_segments.push_back(seg);
+    }
+
+    if (start >= tmpl.length()) {
+      break;
+    }
+
+    // {{{name}}} is inserted as is, {{name}} is escaped
+    bool bRaw       = (0 == tmpl.compare(start, 3, "{{{"));
+    const char *end = bRaw ? "}}}" : "}}";
+    size_t namepos  = start + (bRaw ? 3 : 2);
+    size_t stop     = tmpl.find(end, namepos);
+    if (std::string::npos == stop) {
+      return false;
+    }
+
+    std::string name = tmpl.substr(namepos, stop - namepos);
+    size_t idx;
+    for (idx = 0; idx < m_nFields; idx++) {
+      if (name == fields[idx]) {
+        break;
+      }
+    }
+
+    if (idx >= m_nFields) {
+      return false;
+    }
+
+    segment seg;
+    seg.m_offset  = 0;
+    seg.m_len     = 0;
+    seg.m_field   = (int) idx;
+    seg.m_bEscape = !bRaw;
+    m_segments.push_back(seg);
+
+    pos = stop + strlen(end);
+  }
+
+  m_bCompiled = true;
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// render
+//
+
+bool
+CWebTemplate::render(CWebBuffer &buf, const std::string *values) const
+{
+  if (!m_bCompiled) {
+    return false;
+  }
+
+  // Size the buffer once. Escaping may grow a value but that is rare
+  // for the fields used on the admin pages.
+  size_t size = buf.size() + m_text.length();
+  for (size_t i = 0; (NULL != values) && (i < m_nFields); i++) {
+    size += values[i].length();
+  }
+
+  if (!buf.reserve(size)) {
+    return false;
+  }
+
+  std::vector<segment>::const_iterator it;
+  for (it = m_segments.begin(); it != m_segments.end(); ++it) {
+
+    bool rv;
+    if (it->m_field < 0) {
+      rv = buf.append(m_text.data() + it->m_offset, it->m_len);
+    }
+    else if (NULL == values) {
+      rv = true;
+    }
+    else if (it->m_bEscape) {
+      const std::string &value = values[it->m_field];
+      rv = webrender_appendEscaped(buf, value.data(), value.length());
+    }
+    else {
+      const std::string &value = values[it->m_field];
+      rv = buf.append(value.data(), value.length());
+    }
+
+    if (!rv) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// webrender_appendEscaped
+//
+
+bool
+webrender_appendEscaped(CWebBuffer &buf, const char *pstr, size_t len)
+{
+  size_t start = 0;
+
+  if (NULL == pstr) {
+    return true;
+  }
+
+  for (size_t i = 0; i < len; i++) {
+
+    const char *pesc;
+    switch (pstr[i]) {
+      case '&':
+        pesc = "&amp;";
+        break;
+      case '<':
+        pesc = "&lt;";
+        break;
+      case '>':
+        pesc = "&gt;";
+        break;
+      case '"':
+        pesc = "&quot;";
+        break;
+      case '\'':
+        pesc = "&#39;";
+        break;
+      default:
+        continue;
+    }
+
+    // Copy the run of plain characters before it in one go
+    if (!buf.append(pstr + start, i - start) || !buf.append(pesc)) {
+      return false;
+    }
+    start = i + 1;
+  }
+
+  return buf.append(pstr + start, len - start);
+}
@@ -0,0 +1,103 @@
+// webrender.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(WEBRENDER_H__INCLUDED_)
+#define WEBRENDER_H__INCLUDED_
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include <webbuf.h>
+
+/*!
+  Page template that is compiled once and rendered many times.
+
+  Fields are written as {{name}} (HTML escaped) or {{{name}}} (inserted
+  as is). Compiling splits the template into static slices and field
+  references, so rendering is a series of memcpy's into one buffer that
+  is sized up front. There is no formatting at render time.
+*/
+
+class CWebTemplate {
+
+public:
+  CWebTemplate(void);
+
+  /*!
+    Compile a template
+    @param tmpl Template text
+    @param fields NULL terminated list of field names. The index of a
+            name in this list is the index of its value when rendering.
+    @return true on success, false if the template refers to a field
+            that is not in the list or has an unterminated field.
+  */
+  bool compile(const std::string &tmpl, const char *const *fields);
+
+  /*!
+    Render template
+    @param buf Buffer the result is appended to
+    @param values Field values, in the order of the field list
+            given to compile.
+    @return true on success, false on allocation failure.
+  */
+  bool render(CWebBuffer &buf, const std::string *values) const;
+
+  /*!
+    True if the template has been compiled
+  */
+  bool isCompiled(void) const { return m_bCompiled; };
+
+private:
+  struct segment {
+    size_t m_offset; // Offset in m_text for static slices
+    size_t m_len;    // Length of static slice
+    int m_field;     // Field index or -1 for a static slice
+    bool m_bEscape;  // HTML escape the field value
+  };
+
+  /// Static text of all slices
+  std::string m_text;
+
+  /// Slices and fields in output order
+  std::vector<segment> m_segments;
+
+  /// Number of fields in the field list
+  size_t m_nFields;
+
+  bool m_bCompiled;
+};
+
+/*!
+  Append text with the HTML special characters escaped
+*/
+bool
+webrender_appendEscaped(CWebBuffer &buf, const char *pstr, size_t len);
+
+#endif
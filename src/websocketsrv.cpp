@@ -32,6 +32,7 @@
 
 #define _POSIX
 
+#include <deque>
 #include <fstream>
 #include <iostream>
 #include <map>
@@ -150,6 +151,7 @@ CWebsockSession::CWebsockSession(void)
   m_version      = 0;
   lastActiveTime = 0;
   m_pClientItem  = NULL;
+  m_fanoutShard  = -1;
 };
 
 CWebsockSession::~CWebsockSession(void)
@@ -238,15 +240,26 @@ websock_authentication(struct mg_connection *conn,
   tokens.pop_front();
   vscp_trim(strPassword);
 
-  // Check if user is valid
+  // Check if user is valid. What is needed from the user item is
+  // copied while the user list is locked as a reload of the
+  // configuration can free it.
+  std::string strPasswordHash;
+  vscpEventFilter userFilter;
+  pthread_mutex_lock(&pSession->m_pParent->m_mutex_UserList);
   CUserItem *pUserItem = pSession->m_pParent->m_userList.getUser(strUser);
+  if (nullptr != pUserItem) {
+    bValidHost      = pUserItem->isAllowedToConnect(inet_addr(reqinfo->remote_addr));
+    strPasswordHash = pUserItem->getPassword();
+    memcpy(&userFilter, pUserItem->getUserFilter(), sizeof(vscpEventFilter));
+  }
+  pthread_mutex_unlock(&pSession->m_pParent->m_mutex_UserList);
+
   if (nullptr == pUserItem) {
     spdlog::get("logger")->error("[ws] Authentication: CUserItem allocation problem ");
     return false;
   }
 
   // Check if remote ip is valid
-  bValidHost = pUserItem->isAllowedToConnect(inet_addr(reqinfo->remote_addr));
 
   if (!bValidHost) {
     // Log valid login
@@ -256,14 +269,33 @@ websock_authentication(struct mg_connection *conn,
     return false;
   }
 
+  // A recent successful verification of the same credentials saves
+  // the expensive password check
   std::string combined_credentials = strUser + ":" + strPassword;
-  if (!vscp_isPasswordValid(pUserItem->getPassword(), combined_credentials)) {
-    spdlog::get("logger")->error("[ws] Authentication: User {} at host "
-                                 "[{}] gave wrong password.",
-                                 (const char *) strUser.c_str(),
-                                 reqinfo->remote_addr);
-    return false;
+  CCredentialCache &cache = pSession->m_pParent->m_credentialCache;
+  CWebMetrics &metrics    = pSession->m_pParent->m_metrics;
+  if (!cache.isValid(strUser, combined_credentials, strPasswordHash)) {
+
+    struct timespec start = webmetrics_now();
+    bool bValid           = vscp_isPasswordValid(strPasswordHash, combined_credentials);
+    metrics.m_authLatency.recordSince(start);
+
+    if (!bValid) {
+      metrics.m_authFailure.inc();
+      spdlog::get("logger")->error("[ws] Authentication: User {} at host "
+                                   "[{}] gave wrong password.",
+                                   (const char *) strUser.c_str(),
+                                   reqinfo->remote_addr);
+      return false;
+    }
+
+    cache.add(strUser, combined_credentials, strPasswordHash);
   }
+  else {
+    metrics.m_authCacheHits.inc();
+  }
+
+  metrics.m_authSuccess.inc();
 
   pSession->m_pClientItem->bAuthenticated = true;
 
@@ -271,7 +303,7 @@ websock_authentication(struct mg_connection *conn,
   pSession->m_pClientItem->m_pUserItem = pUserItem;
 
   // Copy in the user filter
-  memcpy(&pSession->m_pClientItem->m_filter, pUserItem->getUserFilter(), sizeof(vscpEventFilter));
+  memcpy(&pSession->m_pClientItem->m_filter, &userFilter, sizeof(vscpEventFilter));
 
   // Log valid login
   spdlog::get("logger")->info("[ws] Authentication: Host [{}] "
@@ -372,6 +404,10 @@ websock_new_session(const struct mg_connection *conn, void *cbdata)
   pthread_mutex_lock(&pSession->m_pParent->m_mutex_websocketSession);
   pSession->m_pParent->m_websocketSessions.push_back(pSession);
   pthread_mutex_unlock(&pSession->m_pParent->m_mutex_websocketSession);
+  pSession->m_pParent->m_memory.m_websockSessions.add(sizeof(CWebsockSession) + sizeof(CClientItem));
+
+  // Hand the session to a fan-out thread
+  pSession->m_pParent->m_fanout.addSession(pSession);
 
   // Use the session object as user data
   mg_set_user_connection_data(pSession->m_conn, (void *) pSession);
@@ -405,91 +441,137 @@ websock_receiveEvent(struct mg_connection *conn, CWebsockSession *pSession, vscp
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// websock_post_outgoingEvent
+// websock_releaseConcatenated
+//
+// Free the buffer used to put together a fragmented message
 //
 
-void
-websock_post_outgoingEvent(CWebObj *pObj)
+static void
+websock_releaseConcatenated(CWebObj *pObj, CWebsockSession *pSession)
 {
-  // Must be valid pointer
-  if (nullptr == pObj) {
-    spdlog::get("logger")->error("[ws] websock_post_outgoingEvent: Object pointer == NULL");
+  if (pSession->m_strConcatenated.empty()) {
     return;
   }
 
-  pthread_mutex_lock(&pObj->m_mutex_websocketSession);
+  pObj->m_memory.m_reassembly.sub(pSession->m_strConcatenated.size());
+  std::string().swap(pSession->m_strConcatenated);
+}
 
-  std::list<CWebsockSession *>::iterator iter;
-  for (iter = pObj->m_websocketSessions.begin(); iter != pObj->m_websocketSessions.end(); ++iter) {
+///////////////////////////////////////////////////////////////////////////////
+// websock_post_sessionEvents
+//
+// Called from the fan-out thread that owns the session. All events
+// waiting in the client queue are taken in one lock operation.
+//
 
-    CWebsockSession *pSession = *iter;
-    if (nullptr == pSession) {
-      spdlog::get("logger")->error("[ws] websock_post_outgoingEvent: Session pointer == NULL");
-      continue;
-    }
+size_t
+websock_post_sessionEvents(CWebObj *pObj, CWebsockSession *pSession)
+{
+  size_t nWritten = 0;
+
+  if ((nullptr == pObj) || (nullptr == pSession)) {
+    return 0;
+  }
+
+  // Should be a client item... hmm.... client disconnected
+  if (nullptr == pSession->m_pClientItem) {
+    pObj->m_logger->error("[ws] websock_post_sessionEvents: Client item == NULL");
+    return 0;
+  }
+
+  // Must be connected
+  if (pSession->m_conn_state < WEBSOCK_CONN_STATE_CONNECTED) {
+    return 0;
+  }
+
+  // Must have valid connection object
+  if (nullptr == pSession->m_conn) {
+    return 0;
+  }
+
+  // Must be something to send
+  if (!pSession->m_pClientItem->m_bOpen || pSession->m_pClientItem->m_clientInputQueue.empty()) {
+    return 0;
+  }
+
+  std::deque<vscpEvent *> events;
+  pthread_mutex_lock(&pSession->m_pClientItem->m_mutexClientInputQueue);
+  events.swap(pSession->m_pClientItem->m_clientInputQueue);
+  pObj->m_flowControl.clearClientBytes(pSession->m_pClientItem);
+  pthread_mutex_unlock(&pSession->m_pClientItem->m_mutexClientInputQueue);
+  pObj->m_memory.m_clientQueues.subEvents(events);
+
+  // User must be authorized to receive events
+  bool bAllowed = (nullptr != pSession->m_pClientItem->m_pUserItem) &&
+                  (pSession->m_pClientItem->m_pUserItem->getUserRights() & VSCP_USER_RIGHT_ALLOW_RCV_EVENT);
 
-    // Should be a client item... hmm.... client disconnected
-    if (nullptr == pSession->m_pClientItem) {
-      spdlog::get("logger")->error("[ws] websock_post_outgoingEvent: Client item == NULL");
+  for (std::deque<vscpEvent *>::iterator it = events.begin(); it != events.end(); ++it) {
+
+    vscpEvent *pEvent = *it;
+    if (NULL == pEvent) {
       continue;
     }
 
-    // Must be connected
-    if (pSession->m_conn_state < WEBSOCK_CONN_STATE_CONNECTED) {
-      continue;
+    // Sampled events are timed through each stage
+    struct timespec ingress, stage;
+    bool bTraced = pObj->m_trace.getIngress(pEvent, ingress);
+    if (bTraced) {
+      stage = webmetrics_now();
     }
 
-    // Must have valid connection object
-    if (nullptr == pSession->m_conn) {
-      continue;
+    // Run event through filter
+    bool bPass = bAllowed && vscp_doLevel2Filter(pEvent, &pSession->m_pClientItem->m_filter);
+    if (bTraced) {
+      pObj->m_trace.m_stageFilter.recordSince(stage);
     }
 
-    // Must be something to send
-    if (pSession->m_pClientItem->m_bOpen && pSession->m_pClientItem->m_clientInputQueue.size()) {
+    if (bPass) {
 
-      vscpEvent *pEvent;
-      pthread_mutex_lock(&pSession->m_pClientItem->m_mutexClientInputQueue);
-      pEvent = pSession->m_pClientItem->m_clientInputQueue.front();
-      pSession->m_pClientItem->m_clientInputQueue.pop_front();
-      pthread_mutex_unlock(&pSession->m_pClientItem->m_mutexClientInputQueue);
-
-      if (NULL != pEvent) {
-        // Run event through filter
-        if (vscp_doLevel2Filter(pEvent, &pSession->m_pClientItem->m_filter)) {
+      std::string str;
+      bool bWrite = false;
 
-          // User must be authorized to receive events
-          if (!(pSession->m_pClientItem->m_pUserItem->getUserRights() & VSCP_USER_RIGHT_ALLOW_RCV_EVENT)) {
-            continue;
-          }
+      if (bTraced) {
+        stage = webmetrics_now();
+      }
 
-          if (WS_TYPE_1 == pSession->m_wstypes) {
-            std::string str;
-            if (vscp_convertEventToString(str, pEvent)) {
-              spdlog::get("logger")->debug("[ws] Received ws event {}", str);
+      if (WS_TYPE_1 == pSession->m_wstypes) {
+        if (vscp_convertEventToString(str, pEvent)) {
+          pObj->m_logger->debug("[ws] Received ws event {}", str);
+          str    = ("E;") + str;
+          bWrite = true;
+        }
+      }
+      else if (WS_TYPE_2 == pSession->m_wstypes) {
+        std::string strEvent;
+        vscp_convertEventToJSON(strEvent, pEvent);
+        str    = vscp_str_format(WS2_EVENT, strEvent.c_str());
+        bWrite = true;
+      }
 
-              // Write it out
-              str = ("E;") + str;
-              mg_websocket_write(pSession->m_conn, MG_WEBSOCKET_OPCODE_TEXT, (const char *) str.c_str(), str.length());
-            }
-          }
-          else if (WS_TYPE_2 == pSession->m_wstypes) {
-            std::string strEvent;
-            vscp_convertEventToJSON(strEvent, pEvent);
-            std::string str = vscp_str_format(WS2_EVENT, strEvent.c_str());
-            mg_websocket_write(pSession->m_conn, MG_WEBSOCKET_OPCODE_TEXT, (const char *) str.c_str(), str.length());
-          }
-        } // filter
+      if (bWrite) {
 
-        // Remove the event
-        vscp_deleteEvent_v2(&pEvent);
+        if (bTraced) {
+          pObj->m_trace.m_stageSerialize.recordSince(stage);
+          stage = webmetrics_now();
+        }
 
-      } // Valid pEvent pointer
+        // Write it out
+        mg_websocket_write(pSession->m_conn, MG_WEBSOCKET_OPCODE_TEXT, (const char *) str.c_str(), str.length());
+        pObj->m_metrics.m_fanoutWebsockWrites.inc();
+        nWritten++;
 
-    } // events available
+        if (bTraced) {
+          pObj->m_trace.m_stageWrite.recordSince(stage);
+          pObj->m_trace.m_endToEnd.recordSince(ingress);
+        }
+      }
+    } // filter
 
-  } // for
+    // Remove the event
+    vscp_deleteEvent_v2(&pEvent);
+  }
 
-  pthread_mutex_unlock(&pObj->m_mutex_websocketSession);
+  return nWritten;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -569,11 +651,25 @@ ws1_closeHandler(const struct mg_connection *conn, void *cbdata)
   // Record activity
   pSession->lastActiveTime = time(NULL);
 
+  // Fan-out thread must be done with the session before it goes away
+  pSession->m_pParent->m_fanout.removeSession(pSession);
+
   pSession->m_conn_state = WEBSOCK_CONN_STATE_NULL;
   pSession->m_conn       = NULL;
+
+  // Both list locks so queueEventToClients can not push to the client
+  // between the release of its queue and its removal
+  pthread_mutex_lock(&pSession->m_pParent->m_mutex_clientList);
+  pthread_mutex_lock(&pSession->m_pParent->m_clientList.m_mutexItemList);
+  pSession->m_pParent->releaseClientQueue(pSession->m_pClientItem);
   pSession->m_pParent->m_clientList.removeClient(pSession->m_pClientItem);
+  pthread_mutex_unlock(&pSession->m_pParent->m_clientList.m_mutexItemList);
+  pthread_mutex_unlock(&pSession->m_pParent->m_mutex_clientList);
   pSession->m_pClientItem = NULL;
 
+  websock_releaseConcatenated(pSession->m_pParent, pSession);
+  pSession->m_pParent->m_memory.m_websockSessions.sub(sizeof(CWebsockSession) + sizeof(CClientItem));
+
   pthread_mutex_lock(&pSession->m_pParent->m_mutex_websocketSession);
   // Remove session
   pSession->m_pParent->m_websocketSessions.remove(pSession);
@@ -662,27 +758,37 @@ ws1_dataHandler(struct mg_connection *conn, int bits, char *data, size_t len, vo
   switch (((unsigned char) bits) & 0x0F) {
 
     case MG_WEBSOCKET_OPCODE_CONTINUATION:
-      spdlog::get("logger")->debug("[ws1] opcode = Continuation");
+      pObj->m_logger->debug("[ws1] opcode = Continuation");
 
       // Save and concatenate mesage
+      if (len) {
+        pObj->m_memory.m_reassembly.add(len, pSession->m_strConcatenated.empty() ? 1 : 0);
+      }
       pSession->m_strConcatenated += std::string(data, len);
 
       // if last process is
       if (1 & bits) {
+        bool bOk = true;
         try {
-          if (!ws1_message(conn, pSession, pSession->m_strConcatenated, cbdata)) {
-            return WEB_ERROR;
-          }
+          bOk = ws1_message(conn, pSession, pSession->m_strConcatenated, cbdata);
         }
         catch (...) {
-          spdlog::get("logger")->error("[ws1] Exception occurred ws1_message concat");
+          pObj->m_logger->error("[ws1] Exception occurred ws1_message concat");
+        }
+
+        // Message is complete - no need to keep the buffer
+        websock_releaseConcatenated(pObj, pSession);
+        if (!bOk) {
+          return WEB_ERROR;
         }
       }
       break;
 
     // https://developer.mozilla.org/en-US/docs/Web/API/WebSockets_API/Writing_WebSocket_servers
     case MG_WEBSOCKET_OPCODE_TEXT:
-      spdlog::get("logger")->debug("[ws1] opcode = text[{}]", strWsPkt);
+      if (pObj->m_logger->should_log(spdlog::level::debug)) {
+        pObj->m_logger->debug("[ws1] opcode = text[{}]", std::string(data, len));
+      }
       if (1 & bits) {
         try {
           strWsPkt = std::string(data, len);
@@ -691,30 +797,34 @@ ws1_dataHandler(struct mg_connection *conn, int bits, char *data, size_t len, vo
           }
         }
         catch (...) {
-          spdlog::get("logger")->error("[ws1] Exception occurred ws1_message");
+          pObj->m_logger->error("[ws1] Exception occurred ws1_message");
         }
       }
       else {
         // Store first part
+        websock_releaseConcatenated(pObj, pSession);
         pSession->m_strConcatenated = std::string(data, len);
+        if (len) {
+          pObj->m_memory.m_reassembly.add(len);
+        }
       }
       break;
 
     case MG_WEBSOCKET_OPCODE_BINARY:
-      spdlog::get("logger")->debug("[ws1] opcode = BINARY");
+      pObj->m_logger->debug("[ws1] opcode = BINARY");
       break;
 
     case MG_WEBSOCKET_OPCODE_CONNECTION_CLOSE:
-      spdlog::get("logger")->debug("[ws1] opcode = Connection close");
+      pObj->m_logger->debug("[ws1] opcode = Connection close");
       break;
 
     case MG_WEBSOCKET_OPCODE_PING:
-      spdlog::get("logger")->debug("[ws1] Ping received/Pong sent,");
+      pObj->m_logger->debug("[ws1] Ping received/Pong sent,");
       mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_PONG, NULL, 0);
       break;
 
     case MG_WEBSOCKET_OPCODE_PONG:
-      spdlog::get("logger")->debug("[ws1] Pong received/Ping sent,");
+      pObj->m_logger->debug("[ws1] Pong received/Ping sent,");
       mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_PING, NULL, 0);
       break;
 
@@ -760,7 +870,7 @@ ws1_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
         ws1_command(conn, pSession, strWsPkt, cbdata);
       }
       catch (...) {
-        spdlog::get("logger")->error("[ws1] Exception occurred ws1_command");
+        pObj->m_logger->error("[ws1] Exception occurred ws1_command");
         str = vscp_str_format(("-;C;%d;%s"), (int) WEBSOCK_ERROR_GENERAL, WEBSOCK_STR_ERROR_GENERAL);
         mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, (const char *) str.c_str(), str.length());
       }
@@ -777,7 +887,7 @@ ws1_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
         str = vscp_str_format(("-;%d;%s"), (int) WEBSOCK_ERROR_NOT_AUTHORIZED, WEBSOCK_STR_ERROR_NOT_AUTHORIZED);
         mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, (const char *) str.c_str(), str.length());
 
-        spdlog::get("logger")->error("[ws1] User [{}] is not authorized.\n",
+        pObj->m_logger->error("[ws1] User [{}] is not authorized.\n",
                                      pSession->m_pClientItem->m_pUserItem->getUserName().c_str());
 
         return true;
@@ -792,7 +902,7 @@ ws1_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
 
         mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, (const char *) str.c_str(), str.length());
 
-        spdlog::get("logger")->error("[ws1] User [{}] is not "
+        pObj->m_logger->error("[ws1] User [{}] is not "
                                      "allowed to send events.",
                                      pSession->m_pClientItem->m_pUserItem->getUserName());
 
@@ -820,7 +930,7 @@ ws1_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
 
             mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, (const char *) str.c_str(), str.length());
 
-            spdlog::get("logger")->error("[ws1] User [{}] is not "
+            pObj->m_logger->error("[ws1] User [{}] is not "
                                          "allowed to send events.",
                                          pSession->m_pClientItem->m_pUserItem->getUserName());
 
@@ -836,7 +946,7 @@ ws1_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
                                   WEBSOCK_ERROR_NOT_ALLOWED_TO_SEND_EVENT);
             mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, (const char *) str.c_str(), str.length());
 
-            spdlog::get("logger")->error("[ws1] User [{}] is not "
+            pObj->m_logger->error("[ws1] User [{}] is not "
                                          "authorized to send CLASS1.PROTOCOL events.",
                                          pSession->m_pClientItem->m_pUserItem->getUserName());
 
@@ -852,7 +962,7 @@ ws1_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
                                   WEBSOCK_ERROR_NOT_ALLOWED_TO_SEND_EVENT);
             mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, (const char *) str.c_str(), str.length());
 
-            spdlog::get("logger")->error("[ws1] User [{}] is not "
+            pObj->m_logger->error("[ws1] User [{}] is not "
                                          "authorized to send CLASS2.PROTOCOL events.",
                                          pSession->m_pClientItem->m_pUserItem->getUserName());
 
@@ -868,7 +978,7 @@ ws1_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
                                   WEBSOCK_ERROR_NOT_ALLOWED_TO_SEND_EVENT);
             mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, (const char *) str.c_str(), str.length());
 
-            spdlog::get("logger")->error("[ws1] User [{}] is not "
+            pObj->m_logger->error("[ws1] User [{}] is not "
                                          "authorized to send CLASS2.HLO events.",
                                          pSession->m_pClientItem->m_pUserItem->getUserName());
 
@@ -884,7 +994,7 @@ ws1_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
 
             mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, (const char *) str.c_str(), str.length());
 
-            spdlog::get("logger")->error("[ws1] User [{}] is not allowed to "
+            pObj->m_logger->error("[ws1] User [{}] is not allowed to "
                                          "send event class={} type={}.",
                                          pSession->m_pClientItem->m_pUserItem->getUserName(),
                                          ex.vscp_class,
@@ -896,7 +1006,7 @@ ws1_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
           ex.obid = pSession->m_pClientItem->m_clientID;
           if (websock_receiveEvent(conn, pSession, ex)) {
             mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, "+;EVENT", 7);
-            spdlog::get("logger")->debug("[ws1] Received ws1 event {}", strWsPkt);
+            pObj->m_logger->debug("[ws1] Received ws1 event {}", strWsPkt);
           }
           else {
             str = vscp_str_format(("-;%d;%s"), (int) WEBSOCK_ERROR_TX_BUFFER_FULL, WEBSOCK_STR_ERROR_TX_BUFFER_FULL);
@@ -905,7 +1015,7 @@ ws1_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
         }
       }
       catch (...) {
-        spdlog::get("logger")->error("[ws1] Exception occurred send event");
+        pObj->m_logger->error("[ws1] Exception occurred send event");
         str = vscp_str_format(("-;E;%d;%s"), (int) WEBSOCK_ERROR_GENERAL, WEBSOCK_STR_ERROR_GENERAL);
         mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, (const char *) str.c_str(), str.length());
       }
@@ -1146,6 +1256,8 @@ ws1_command(struct mg_connection *conn, CWebsockSession *pSession, std::string &
 
     std::deque<vscpEvent *>::iterator it;
     pthread_mutex_lock(&pSession->m_pClientItem->m_mutexClientInputQueue);
+    pSession->m_pParent->m_memory.m_clientQueues.subEvents(pSession->m_pClientItem->m_clientInputQueue);
+    pSession->m_pParent->m_trace.forgetIngress(pSession->m_pClientItem->m_clientInputQueue);
 
     for (it = pSession->m_pClientItem->m_clientInputQueue.begin();
          it != pSession->m_pClientItem->m_clientInputQueue.end();
@@ -1156,6 +1268,7 @@ ws1_command(struct mg_connection *conn, CWebsockSession *pSession, std::string &
     }
 
     pSession->m_pClientItem->m_clientInputQueue.clear();
+    pSession->m_pParent->m_flowControl.clearClientBytes(pSession->m_pClientItem);
     pthread_mutex_unlock(&pSession->m_pClientItem->m_mutexClientInputQueue);
 
     mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, "+;CLRQ", 6);
@@ -1332,11 +1445,25 @@ ws2_closeHandler(const struct mg_connection *conn, void *cbdata)
   // Record activity
   pSession->lastActiveTime = time(NULL);
 
+  // Fan-out thread must be done with the session before it goes away
+  pSession->m_pParent->m_fanout.removeSession(pSession);
+
   pSession->m_conn_state = WEBSOCK_CONN_STATE_NULL;
   pSession->m_conn       = NULL;
+
+  // Both list locks so queueEventToClients can not push to the client
+  // between the release of its queue and its removal
+  pthread_mutex_lock(&pSession->m_pParent->m_mutex_clientList);
+  pthread_mutex_lock(&pSession->m_pParent->m_clientList.m_mutexItemList);
+  pSession->m_pParent->releaseClientQueue(pSession->m_pClientItem);
   pSession->m_pParent->m_clientList.removeClient(pSession->m_pClientItem);
+  pthread_mutex_unlock(&pSession->m_pParent->m_clientList.m_mutexItemList);
+  pthread_mutex_unlock(&pSession->m_pParent->m_mutex_clientList);
   pSession->m_pClientItem = NULL;
 
+  websock_releaseConcatenated(pSession->m_pParent, pSession);
+  pSession->m_pParent->m_memory.m_websockSessions.sub(sizeof(CWebsockSession) + sizeof(CClientItem));
+
   pthread_mutex_lock(&pSession->m_pParent->m_mutex_websocketSession);
   pSession->m_pParent->m_websocketSessions.remove(pSession);
   delete pSession;
@@ -1437,20 +1564,28 @@ ws2_dataHandler(struct mg_connection *conn, int bits, char *data, size_t len, vo
 
     case MG_WEBSOCKET_OPCODE_CONTINUATION:
 
-      spdlog::get("logger")->debug("[ws2] opcode = Continuation");
+      pObj->m_logger->debug("[ws2] opcode = Continuation");
 
       // Save and concatenate mesage
+      if (len) {
+        pObj->m_memory.m_reassembly.add(len, pSession->m_strConcatenated.empty() ? 1 : 0);
+      }
       pSession->m_strConcatenated += std::string(data, len);
 
       // if last process is
       if (1 & bits) {
+        bool bOk = true;
         try {
-          if (!ws2_message(conn, pSession, pSession->m_strConcatenated, cbdata)) {
-            return WEB_ERROR;
-          }
+          bOk = ws2_message(conn, pSession, pSession->m_strConcatenated, cbdata);
         }
         catch (...) {
-          spdlog::get("logger")->error("[ws2] Exception occurred ws2_message concat");
+          pObj->m_logger->error("[ws2] Exception occurred ws2_message concat");
+        }
+
+        // Message is complete - no need to keep the buffer
+        websock_releaseConcatenated(pObj, pSession);
+        if (!bOk) {
+          return WEB_ERROR;
         }
       }
       break;
@@ -1458,7 +1593,9 @@ ws2_dataHandler(struct mg_connection *conn, int bits, char *data, size_t len, vo
     // https://developer.mozilla.org/en-US/docs/Web/API/WebSockets_API/Writing_WebSocket_servers
     case MG_WEBSOCKET_OPCODE_TEXT:
 
-      spdlog::get("logger")->debug("[ws2] opcode = Text [{}]", strWsPkt);
+      if (pObj->m_logger->should_log(spdlog::level::debug)) {
+        pObj->m_logger->debug("[ws2] opcode = Text [{}]", std::string(data, len));
+      }
 
       if (1 & bits) {
         try {
@@ -1468,30 +1605,34 @@ ws2_dataHandler(struct mg_connection *conn, int bits, char *data, size_t len, vo
           }
         }
         catch (...) {
-          spdlog::get("logger")->error("[ws2] Exception occurred ws2_message");
+          pObj->m_logger->error("[ws2] Exception occurred ws2_message");
         }
       }
       else {
         // Store first part
+        websock_releaseConcatenated(pObj, pSession);
         pSession->m_strConcatenated = std::string(data, len);
+        if (len) {
+          pObj->m_memory.m_reassembly.add(len);
+        }
       }
       break;
 
     case MG_WEBSOCKET_OPCODE_BINARY:
-      spdlog::get("logger")->debug("[ws2] opcode = BINARY");
+      pObj->m_logger->debug("[ws2] opcode = BINARY");
       break;
 
     case MG_WEBSOCKET_OPCODE_CONNECTION_CLOSE:
-      spdlog::get("logger")->debug("[ws2] Connection close");
+      pObj->m_logger->debug("[ws2] Connection close");
       break;
 
     case MG_WEBSOCKET_OPCODE_PING:
-      spdlog::get("logger")->debug("[ws2] Ping received/Pong sent,");
+      pObj->m_logger->debug("[ws2] Ping received/Pong sent,");
       mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_PONG, data, len);
       break;
 
     case MG_WEBSOCKET_OPCODE_PONG:
-      spdlog::get("logger")->debug("[ws2] Pong received/Ping sent,");
+      pObj->m_logger->debug("[ws2] Pong received/Ping sent,");
       mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_PING, data, len);
       break;
 
@@ -1570,7 +1711,7 @@ ws2_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
           mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, str.c_str(), str.length());
 
           // No arg found
-          spdlog::get("logger")->error("[ws2] Failed to parse ws2 websocket command object {}", strWsPkt.c_str());
+          pObj->m_logger->error("[ws2] Failed to parse ws2 websocket command object {}", strWsPkt.c_str());
           return false;
         }
         catch (...) {
@@ -1580,7 +1721,7 @@ ws2_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
                                             WEBSOCK_STR_ERROR_PARSE_FORMAT);
           mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, str.c_str(), str.length());
 
-          spdlog::get("logger")->error("[ws2] Failed to parse ws2 websocket command object {}", strWsPkt.c_str());
+          pObj->m_logger->error("[ws2] Failed to parse ws2 websocket command object {}", strWsPkt.c_str());
 
           return false;
         }
@@ -1604,7 +1745,7 @@ ws2_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
 
                 mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, (const char *) str.c_str(), str.length());
 
-                spdlog::get("logger")->error("[ws2] User [{}] is not allowed to login.",
+                pObj->m_logger->error("[ws2] User [{}] is not allowed to login.",
                                              pSession->m_pClientItem->m_pUserItem->getUserName());
                 return false; // 'false' - Drop connection
               }
@@ -1626,7 +1767,7 @@ ws2_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
                                                     WEBSOCK_STR_ERROR_NOT_ALLOWED_TO_DO_THAT);
                   mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, str.c_str(), str.length());
 
-                  spdlog::get("logger")->error("[ws2] User [{}] is not "
+                  pObj->m_logger->error("[ws2] User [{}] is not "
                                                "allowed to send events.",
                                                pSession->m_pClientItem->m_pUserItem->getUserName());
 
@@ -1645,7 +1786,7 @@ ws2_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
                                                     WEBSOCK_STR_ERROR_NOT_ALLOWED_TO_DO_THAT);
                   mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, str.c_str(), str.length());
 
-                  spdlog::get("logger")->error("[ws2] User [{}] is not "
+                  pObj->m_logger->error("[ws2] User [{}] is not "
                                                "authorized to send CLASS1.PROTOCOL "
                                                "events.",
                                                pSession->m_pClientItem->m_pUserItem->getUserName());
@@ -1664,7 +1805,7 @@ ws2_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
                                                     WEBSOCK_STR_ERROR_NOT_ALLOWED_TO_DO_THAT);
                   mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, str.c_str(), str.length());
 
-                  spdlog::get("logger")->error("[ws2] User [{}] is not "
+                  pObj->m_logger->error("[ws2] User [{}] is not "
                                                "authorized to send CLASS2.PROTOCOL "
                                                "events.",
                                                pSession->m_pClientItem->m_pUserItem->getUserName());
@@ -1682,7 +1823,7 @@ ws2_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
                                                     WEBSOCK_STR_ERROR_NOT_ALLOWED_TO_DO_THAT);
                   mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, str.c_str(), str.length());
 
-                  spdlog::get("logger")->error("[ws2] User [{}] is not "
+                  pObj->m_logger->error("[ws2] User [{}] is not "
                                                "authorized to send CLASS2.HLO "
                                                "events.",
                                                pSession->m_pClientItem->m_pUserItem->getUserName());
@@ -1700,7 +1841,7 @@ ws2_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
                                                     WEBSOCK_STR_ERROR_NOT_ALLOWED_TO_DO_THAT);
                   mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, str.c_str(), str.length());
 
-                  spdlog::get("logger")->error("ws2] User [{}] is not allowed to "
+                  pObj->m_logger->error("ws2] User [{}] is not allowed to "
                                                "send event class={} type={}.",
                                                pSession->m_pClientItem->m_pUserItem->getUserName(),
                                                ex.vscp_class,
@@ -1715,7 +1856,7 @@ ws2_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
                   str = vscp_str_format(WS2_POSITIVE_RESPONSE, "EVENT", "null");
                   mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, str.c_str(), str.length());
 
-                  spdlog::get("logger")->error("[ws2] Sent ws2 event {}", strWsPkt);
+                  pObj->m_logger->debug("[ws2] Sent ws2 event {}", strWsPkt);
                 }
                 else {
 
@@ -1724,7 +1865,7 @@ ws2_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
                                         (int) WEBSOCK_ERROR_TX_BUFFER_FULL,
                                         WEBSOCK_STR_ERROR_TX_BUFFER_FULL);
                   mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, (const char *) str.c_str(), str.length());
-                  spdlog::get("logger")->error("[ws2] Transmission buffer is full {}", strWsPkt);
+                  pObj->m_logger->error("[ws2] Transmission buffer is full {}", strWsPkt);
 
                   return true; // 'true' leave connection open
                 }
@@ -1737,7 +1878,7 @@ ws2_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
             vscp_str_format(WS2_NEGATIVE_RESPONSE, "EVENT", WEBSOCK_ERROR_PARSE_FORMAT, WEBSOCK_STR_ERROR_PARSE_FORMAT);
           mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, str.c_str(), str.length());
 
-          spdlog::get("logger")->error("[ws2] Failed to parse ws2 websocket event object {}", strWsPkt);
+          pObj->m_logger->error("[ws2] Failed to parse ws2 websocket event object {}", strWsPkt);
 
           return true; // 'true' leave connection open
         }
@@ -1759,7 +1900,7 @@ ws2_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
             vscp_str_format(WS2_NEGATIVE_RESPONSE, "EVENT", WEBSOCK_ERROR_PARSE_FORMAT, WEBSOCK_STR_ERROR_PARSE_FORMAT);
           mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, str.c_str(), str.length());
 
-          spdlog::get("logger")->error("[ws2] Failed to parse ws2 websocket + response object {}", strWsPkt);
+          pObj->m_logger->error("[ws2] Failed to parse ws2 websocket + response object {}", strWsPkt);
           return true; // 'true' leave connection open
         }
       }
@@ -1780,7 +1921,7 @@ ws2_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
             vscp_str_format(WS2_NEGATIVE_RESPONSE, "EVENT", WEBSOCK_ERROR_PARSE_FORMAT, WEBSOCK_STR_ERROR_PARSE_FORMAT);
           mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, str.c_str(), str.length());
 
-          spdlog::get("logger")->error("[ws2] Failed to parse ws2 websocket - response object {}", strWsPkt);
+          pObj->m_logger->error("[ws2] Failed to parse ws2 websocket - response object {}", strWsPkt);
           return true; // 'true' leave connection open
         }
       }
@@ -1801,7 +1942,7 @@ ws2_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
             vscp_str_format(WS2_NEGATIVE_RESPONSE, "EVENT", WEBSOCK_ERROR_PARSE_FORMAT, WEBSOCK_STR_ERROR_PARSE_FORMAT);
           mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, str.c_str(), str.length());
 
-          spdlog::get("logger")->error("[ws2] Failed to parse ws2 websocket variable object {}", strWsPkt);
+          pObj->m_logger->error("[ws2] Failed to parse ws2 websocket variable object {}", strWsPkt);
           return true; // 'true' leave connection open
         }
       }
@@ -1812,7 +1953,7 @@ ws2_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
         mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, str.c_str(), str.length());
 
         // This is a type we do not recognize
-        spdlog::get("logger")->error("[ws2] Unknown ws2 websocket type {}", strWsPkt);
+        pObj->m_logger->error("[ws2] Unknown ws2 websocket type {}", strWsPkt);
         return true; // 'true' leave connection open
       }
     }
@@ -1822,7 +1963,7 @@ ws2_message(struct mg_connection *conn, CWebsockSession *pSession, std::string &
       vscp_str_format(WS2_NEGATIVE_RESPONSE, "EVENT", WEBSOCK_ERROR_UNKNOWN_TYPE, WEBSOCK_STR_ERROR_UNKNOWN_TYPE);
     mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_TEXT, str.c_str(), str.length());
 
-    spdlog::get("logger")->error("[ws2] Failed to parse ws2 websocket command {}", strWsPkt);
+    pObj->m_logger->error("[ws2] Failed to parse ws2 websocket command {}", strWsPkt);
     return true; // 'true' leave connection open
   }
 
@@ -2063,6 +2204,8 @@ ws2_command(struct mg_connection *conn, CWebsockSession *pSession, std::string &
 
     std::deque<vscpEvent *>::iterator it;
     pthread_mutex_lock(&pSession->m_pClientItem->m_mutexClientInputQueue);
+    pSession->m_pParent->m_memory.m_clientQueues.subEvents(pSession->m_pClientItem->m_clientInputQueue);
+    pSession->m_pParent->m_trace.forgetIngress(pSession->m_pClientItem->m_clientInputQueue);
 
     for (it = pSession->m_pClientItem->m_clientInputQueue.begin();
          it != pSession->m_pClientItem->m_clientInputQueue.end();
@@ -2073,6 +2216,7 @@ ws2_command(struct mg_connection *conn, CWebsockSession *pSession, std::string &
     }
 
     pSession->m_pClientItem->m_clientInputQueue.clear();
+    pSession->m_pParent->m_flowControl.clearClientBytes(pSession->m_pClientItem);
     pthread_mutex_unlock(&pSession->m_pClientItem->m_mutexClientInputQueue);
 
     std::string str = vscp_str_format(WS2_POSITIVE_RESPONSE, strCmd.c_str(), "null");
@@ -140,6 +140,9 @@ public:
 
   // Owner of this session
   CWebObj* m_pParent;
+
+  // Fan-out shard that delivers events to this session (-1 if none)
+  int m_fanoutShard;
 };
 
 #define WS2_COMMAND                                                            \
@@ -212,7 +215,13 @@ public:
 
 // Public functions
 
-void
-websock_post_outgoingEvent(CWebObj *pObj);
+/*!
+  Deliver all queued events for one session
+  @param pObj Driver object
+  @param pSession Session to deliver to
+  @return Number of events written to the websocket
+*/
+size_t
+websock_post_sessionEvents(CWebObj *pObj, CWebsockSession *pSession);
 
 #endif
\ No newline at end of file
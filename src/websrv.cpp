@@ -32,6 +32,10 @@
 
 #define _POSIX
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
+
 #include <arpa/inet.h>
 #include <errno.h>
 #include <linux/if_ether.h>
@@ -59,6 +63,7 @@
 #include <expat.h>
 #include <json.hpp>
 #include <lua.h>
+#include <lua_vscp_func.h>
 
 #include <openssl/crypto.h>
 #include <openssl/opensslv.h>
@@ -88,12 +93,16 @@
 #include <vscpmd5.h>
 #include <webdefs.h>
 
+#include "webcompress.h"
+#include "weblog.h"
+#include "webrender.h"
 #include "websrv.h"
 
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include <json.hpp> // Needs C++11  -std=c++11
 #include <mustache.hpp>
@@ -158,7 +167,7 @@ websrv_sendheader(struct mg_connection* conn,
   mg_printf(conn,
             "HTTP/1.1 %d OK\r\n"
             "Content-Type: %s\r\n"
-            "Date: %s\r"
+            "Date: %s\r\n"
             "Cache-Control: no-cache\r\n"
             "Cache-Control: no-store\r\n"
             "Cache-Control: must-revalidate\r\n\r\n",
@@ -191,7 +200,7 @@ websrv_sendSetCookieHeader(struct mg_connection* conn,
   mg_printf(conn,
             "HTTP/1.1 %d OK\r\n"
             "Content-Type: %s\r\n"
-            "Date: %s\r"
+            "Date: %s\r\n"
             "Set-Cookie: sessionid=%s; http-only; path=/\r\n"
             "Cache-Control: no-cache\r\n"
             "Cache-Control: no-store\r\n"
@@ -202,6 +211,688 @@ websrv_sendSetCookieHeader(struct mg_connection* conn,
             psid);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// websrv_sendBuffer
+//
+// Send a complete response. The header carries Content-Length so the
+// connection can be kept alive, and header and body go out in one
+// write. If psid is set a session cookie is set as well.
+//
+
+void
+websrv_sendBuffer(struct mg_connection* conn,
+                  int returncode,
+                  const char* pcontent,
+                  const CWebBuffer& buf,
+                  const char* psid)
+{
+  char date[64];
+  char cookie[80];
+  char encoding[80];
+  time_t curtime = time(NULL);
+  vscp_getTimeString(date, sizeof(date), &curtime);
+
+  // Check pointers
+  if ((NULL == conn) || (NULL == pcontent)) {
+    return;
+  }
+
+  // Optional session cookie
+  cookie[0] = '\0';
+  if (NULL != psid) {
+    snprintf(cookie,
+             sizeof(cookie),
+             "Set-Cookie: sessionid=%s; http-only; path=/\r\n",
+             psid);
+  }
+
+  // Compress the body if the client accepts it and it is
+  // large enough to be worth the effort
+  const CWebBuffer* pbody = &buf;
+  CWebBuffer compressed(buf.size() / 3 + 64);
+  encoding[0] = '\0';
+
+  int enc = websrv_getContentEncoding(conn, buf.size());
+  if (WEB_ENCODING_IDENTITY != enc) {
+    CWebObj* pObj = (CWebObj*)mg_get_user_data(mg_get_context(conn));
+    if (webcompress_buffer(buf.data(),
+                           buf.size(),
+                           compressed,
+                           enc,
+                           pObj->m_web_compression_level)) {
+      pbody = &compressed;
+      snprintf(encoding,
+               sizeof(encoding),
+               "Content-Encoding: %s\r\nVary: Accept-Encoding\r\n",
+               webcompress_getEncodingName(enc));
+    }
+  }
+
+  // Header and body go out together in one write
+  CWebBuffer response(pbody->size() + 512);
+  response.appendf("HTTP/1.1 %d OK\r\n"
+                   "Content-Type: %s\r\n"
+                   "Content-Length: %zu\r\n"
+                   "%s"
+                   "Date: %s\r\n"
+                   "%s"
+                   "Cache-Control: no-cache\r\n"
+                   "Cache-Control: no-store\r\n"
+                   "Cache-Control: must-revalidate\r\n\r\n",
+                   returncode,
+                   pcontent,
+                   pbody->size(),
+                   encoding,
+                   date,
+                   cookie);
+  response.append(pbody->data(), pbody->size());
+
+  mg_write(conn, response.data(), response.size());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// websrv_sendChunkedHeader
+//
+// Send header for a response that is streamed with mg_send_chunk. The
+// response must be ended with a zero length chunk.
+//
+
+void
+websrv_sendChunkedHeader(struct mg_connection* conn,
+                         int returncode,
+                         const char* pcontent,
+                         int encoding)
+{
+  char date[64];
+  char contentencoding[80];
+  time_t curtime = time(NULL);
+  vscp_getTimeString(date, sizeof(date), &curtime);
+
+  // Check pointers
+  if ((NULL == conn) || (NULL == pcontent)) {
+    return;
+  }
+
+  contentencoding[0] = '\0';
+  if (WEB_ENCODING_IDENTITY != encoding) {
+    snprintf(contentencoding,
+             sizeof(contentencoding),
+             "Content-Encoding: %s\r\nVary: Accept-Encoding\r\n",
+             webcompress_getEncodingName(encoding));
+  }
+
+  mg_printf(conn,
+            "HTTP/1.1 %d OK\r\n"
+            "Content-Type: %s\r\n"
+            "Transfer-Encoding: chunked\r\n"
+            "%s"
+            "Date: %s\r\n"
+            "Cache-Control: no-cache\r\n"
+            "Cache-Control: no-store\r\n"
+            "Cache-Control: must-revalidate\r\n\r\n",
+            returncode,
+            pcontent,
+            contentencoding,
+            date);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// websrv_getContentEncoding
+//
+
+int
+websrv_getContentEncoding(struct mg_connection* conn, size_t size)
+{
+  if (NULL == conn) {
+    return WEB_ENCODING_IDENTITY;
+  }
+
+  CWebObj* pObj = (CWebObj*)mg_get_user_data(mg_get_context(conn));
+  if ((NULL == pObj) || !pObj->m_web_bEnableCompression) {
+    return WEB_ENCODING_IDENTITY;
+  }
+
+  // Small responses are not worth compressing
+  if (size < pObj->m_web_compression_threshold) {
+    return WEB_ENCODING_IDENTITY;
+  }
+
+  return webcompress_negotiate(mg_get_header(conn, "Accept-Encoding"));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// websrv_sendFile
+//
+// Stream a file with chunked transfer encoding, compressed on the fly
+// if the client accepts it.
+//
+
+bool
+websrv_sendFile(struct mg_connection* conn,
+                int returncode,
+                const char* pcontent,
+                const std::string& path)
+{
+  char wrkbuf[8192];
+  CWebBuffer out(sizeof(wrkbuf));
+  CWebCompressor compressor;
+  bool bOK = true;
+
+  // Check pointers
+  if ((NULL == conn) || (NULL == pcontent)) {
+    return false;
+  }
+
+  std::ifstream file(path.c_str(), std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+
+  // Size is unknown for the threshold check - use file size
+  file.seekg(0, std::ios::end);
+  size_t size = (size_t)file.tellg();
+  file.seekg(0, std::ios::beg);
+
+  CWebObj* pObj = (CWebObj*)mg_get_user_data(mg_get_context(conn));
+  int enc       = websrv_getContentEncoding(conn, size);
+  if ((WEB_ENCODING_IDENTITY != enc) &&
+      !compressor.init(enc, pObj->m_web_compression_level)) {
+    enc = WEB_ENCODING_IDENTITY;
+  }
+
+  websrv_sendChunkedHeader(conn, returncode, pcontent, enc);
+
+  while (file.read(wrkbuf, sizeof(wrkbuf)) || file.gcount()) {
+
+    if (WEB_ENCODING_IDENTITY == enc) {
+      mg_send_chunk(conn, wrkbuf, (unsigned int)file.gcount());
+      continue;
+    }
+
+    out.clear();
+    if (!compressor.compress(wrkbuf, (size_t)file.gcount(), out)) {
+      bOK = false;
+      break;
+    }
+    if (out.size()) {
+      mg_send_chunk(conn, out.data(), (unsigned int)out.size());
+    }
+  }
+
+  file.close();
+
+  if (bOK && (WEB_ENCODING_IDENTITY != enc)) {
+    out.clear();
+    bOK = compressor.finish(out);
+    if (bOK && out.size()) {
+      mg_send_chunk(conn, out.data(), (unsigned int)out.size());
+    }
+  }
+
+  // The header is already sent so an error reply is not possible. Close
+  // the connection without the last chunk so the client sees the
+  // response as truncated.
+  if (!bOK) {
+    spdlog::get("logger")->error("Failed to compress {} - connection closed.",
+                                 path);
+    mg_close_connection(conn);
+    return true;
+  }
+
+  // Last chunk
+  mg_send_chunk(conn, "", 0);
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+//                              Static assets
+//-----------------------------------------------------------------------------
+
+// Embedded assets used by the admin pages. Pages link to the versioned
+// URI, which has a hash of the content in the name, so the asset can be
+// cached for good. Compressed copies are made once at startup so it
+// does not have to be done per request.
+struct websrv_asset {
+  const char* m_uri;           // Unversioned URI
+  const char* m_mimetype;
+  std::string m_uri_versioned; // URI with content hash
+  std::string m_hash;          // Hash of uncompressed content (hex)
+  std::string m_data;          // Uncompressed content
+  std::string m_data_gzip;     // gzip compressed content
+  std::string m_data_deflate;  // deflate compressed content
+};
+
+static websrv_asset websrv_assets[] = {
+  { WEB_ASSET_URI_COMMON_CSS, "text/css", "", "", "", "", "" },
+  { WEB_ASSET_URI_COMMON_JS, "application/javascript", "", "", "", "", "" },
+};
+
+static pthread_once_t websrv_assets_once = PTHREAD_ONCE_INIT;
+
+// Links to the versioned assets for a page head
+static std::string websrv_assetLinks;
+
+///////////////////////////////////////////////////////////////////////////////
+// websrv_hashAsset
+//
+// 64-bit FNV-1a hash of the content as hex
+//
+
+static std::string
+websrv_hashAsset(const std::string& data)
+{
+  char hex[17];
+  uint64_t hash = 0xcbf29ce484222325ULL;
+
+  for (size_t i = 0; i < data.length(); i++) {
+    hash ^= (uint8_t)data[i];
+    hash *= 0x100000001b3ULL;
+  }
+
+  snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+  return std::string(hex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// websrv_initAssets
+//
+
+static void
+websrv_initAssets(void)
+{
+  // CSS
+  websrv_assets[0].m_data = WEB_COMMON_CSS;
+
+  // The JS blob is stored with script tags for inlining
+  std::string js    = WEB_COMMON_JS;
+  size_t start      = js.find('>');
+  size_t end        = js.rfind("</script>");
+  websrv_assets[1].m_data = ((std::string::npos != start) && (std::string::npos != end) && (end > start))
+                              ? js.substr(start + 1, end - start - 1)
+                              : js;
+
+  for (size_t i = 0; i < sizeof(websrv_assets) / sizeof(websrv_asset); i++) {
+
+    websrv_asset* pAsset = &websrv_assets[i];
+
+    // common.css -> common.<hash>.css
+    pAsset->m_hash          = websrv_hashAsset(pAsset->m_data);
+    std::string uri         = pAsset->m_uri;
+    size_t dot              = uri.rfind('.');
+    pAsset->m_uri_versioned = uri.substr(0, dot) + "." + pAsset->m_hash + uri.substr(dot);
+
+    CWebBuffer buf;
+    if (webcompress_buffer(pAsset->m_data.c_str(), pAsset->m_data.length(), buf, WEB_ENCODING_GZIP, 9)) {
+      pAsset->m_data_gzip.assign(buf.data(), buf.size());
+    }
+
+    buf.clear();
+    if (webcompress_buffer(pAsset->m_data.c_str(), pAsset->m_data.length(), buf, WEB_ENCODING_DEFLATE, 9)) {
+      pAsset->m_data_deflate.assign(buf.data(), buf.size());
+    }
+  }
+
+  websrv_assetLinks = "<link rel=\"stylesheet\" type=\"text/css\" href=\"" + websrv_assets[0].m_uri_versioned +
+                      "\"><script type=\"text/javascript\" src=\"" + websrv_assets[1].m_uri_versioned +
+                      "\"></script>";
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// websrv_writeAssetLinks
+//
+// Write the links to the common CSS and JavaScript into a page head
+//
+
+static void
+websrv_writeAssetLinks(struct mg_connection* conn)
+{
+  pthread_once(&websrv_assets_once, websrv_initAssets);
+  mg_write(conn, websrv_assetLinks.data(), websrv_assetLinks.length());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// websrv_matchETag
+//
+// Check if an If-None-Match header holds the etag
+//
+
+static bool
+websrv_matchETag(const char* pIfNoneMatch, const std::string& etag)
+{
+  if (NULL == pIfNoneMatch) {
+    return false;
+  }
+
+  std::string str = pIfNoneMatch;
+  vscp_trim(str);
+  if ("*" == str) {
+    return true;
+  }
+
+  return (std::string::npos != str.find(etag));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// websrv_assetHandler
+//
+
+static int
+websrv_assetHandler(struct mg_connection* conn, void* cbdata)
+{
+  char date[64];
+  char cache[80];
+  time_t curtime = time(NULL);
+  vscp_getTimeString(date, sizeof(date), &curtime);
+
+  CWebObj* pObj = (CWebObj*)cbdata;
+  if (NULL == pObj) {
+    return WEB_ERROR;
+  }
+
+  const struct mg_request_info* reqinfo = mg_get_request_info(conn);
+  if (NULL == reqinfo) {
+    return WEB_ERROR;
+  }
+
+  for (size_t i = 0; i < sizeof(websrv_assets) / sizeof(websrv_asset); i++) {
+
+    websrv_asset* pAsset = &websrv_assets[i];
+    bool bVersioned      = (pAsset->m_uri_versioned == reqinfo->local_uri);
+    if (!bVersioned && (0 != strcmp(reqinfo->local_uri, pAsset->m_uri))) {
+      continue;
+    }
+
+    // Use a compressed copy if the client accepts it. Each
+    // representation has its own strong etag.
+    const std::string* pdata = &pAsset->m_data;
+    const char* pencoding    = NULL;
+    if (pObj->m_web_bEnableCompression) {
+      int enc = webcompress_negotiate(mg_get_header(conn, "Accept-Encoding"));
+      if ((WEB_ENCODING_GZIP == enc) && !pAsset->m_data_gzip.empty()) {
+        pdata = &pAsset->m_data_gzip;
+      }
+      else if ((WEB_ENCODING_DEFLATE == enc) && !pAsset->m_data_deflate.empty()) {
+        pdata = &pAsset->m_data_deflate;
+      }
+      if (pdata != &pAsset->m_data) {
+        pencoding = webcompress_getEncodingName(enc);
+      }
+    }
+
+    std::string etag = "\"" + pAsset->m_hash;
+    if (NULL != pencoding) {
+      etag += "-";
+      etag += pencoding;
+    }
+    etag += "\"";
+
+    // The versioned URI never changes content
+    if (bVersioned) {
+      snprintf(cache, sizeof(cache), "public, max-age=%d, immutable", WEB_ASSET_IMMUTABLE_MAX_AGE);
+    }
+    else {
+      snprintf(cache, sizeof(cache), "public, max-age=%ld", pObj->m_web_static_file_max_age);
+    }
+
+    // Client already has it
+    if (websrv_matchETag(mg_get_header(conn, "If-None-Match"), etag)) {
+      mg_printf(conn,
+                "HTTP/1.1 304 Not Modified\r\n"
+                "ETag: %s\r\n"
+                "Vary: Accept-Encoding\r\n"
+                "Date: %s\r\n"
+                "Cache-Control: %s\r\n\r\n",
+                etag.c_str(),
+                date,
+                cache);
+      return 304;
+    }
+
+    mg_printf(conn,
+              "HTTP/1.1 200 OK\r\n"
+              "Content-Type: %s\r\n"
+              "Content-Length: %zu\r\n"
+              "%s%s%s"
+              "ETag: %s\r\n"
+              "Vary: Accept-Encoding\r\n"
+              "Date: %s\r\n"
+              "Cache-Control: %s\r\n\r\n",
+              pAsset->m_mimetype,
+              pdata->length(),
+              (NULL != pencoding) ? "Content-Encoding: " : "",
+              (NULL != pencoding) ? pencoding : "",
+              (NULL != pencoding) ? "\r\n" : "",
+              etag.c_str(),
+              date,
+              cache);
+
+    if (0 != strcmp(reqinfo->request_method, "HEAD")) {
+      mg_write(conn, pdata->c_str(), pdata->length());
+    }
+
+    return 200;
+  }
+
+  mg_send_http_error(conn, 404, "%s", "Not found");
+  return 404;
+}
+
+//-----------------------------------------------------------------------------
+//                           Admin page templates
+//-----------------------------------------------------------------------------
+
+// Templates for the admin pages are compiled once from the fragments in
+// web_template.h. A page is rendered into one buffer and sent with a
+// single write and a Content-Length.
+
+static const char* websrv_pageHeadFields[] = { "title", "assets", "head", NULL };
+static const char* websrv_ifRowFields[] = { "id", "type", "guid1", "guid2", "name", "started", NULL };
+static const char* websrv_logFields[] = { "lines", "level", "match", NULL };
+
+enum { WEBSRV_HEAD_TITLE = 0, WEBSRV_HEAD_ASSETS, WEBSRV_HEAD_HEAD, WEBSRV_HEAD_FIELDS };
+enum {
+  WEBSRV_IFROW_ID = 0,
+  WEBSRV_IFROW_TYPE,
+  WEBSRV_IFROW_GUID1,
+  WEBSRV_IFROW_GUID2,
+  WEBSRV_IFROW_NAME,
+  WEBSRV_IFROW_STARTED,
+  WEBSRV_IFROW_FIELDS
+};
+enum { WEBSRV_LOG_LINES = 0, WEBSRV_LOG_LEVEL, WEBSRV_LOG_MATCH, WEBSRV_LOG_FIELDS };
+
+static CWebTemplate websrv_tmplPageHead;  // Head, assets and menu
+static CWebTemplate websrv_tmplIfRow;     // Interface list row
+static CWebTemplate websrv_tmplLogFilter; // Log filter form
+static std::string websrv_pageEnd;        // Footer
+static std::string websrv_ifListLegend;   // Interface list text and type legend
+
+static pthread_once_t websrv_pages_once = PTHREAD_ONCE_INIT;
+
+///////////////////////////////////////////////////////////////////////////////
+// websrv_initPages
+//
+
+static void
+websrv_initPages(void)
+{
+  pthread_once(&websrv_assets_once, websrv_initAssets);
+
+  // The page head fragment takes the title as a printf argument
+  std::string head = WEB_COMMON_HEAD;
+  size_t pos       = head.find("%s");
+  if (std::string::npos != pos) {
+    head.replace(pos, 2, "{{title}}");
+  }
+  head += "{{{assets}}}{{{head}}}";
+  head += WEB_COMMON_HEAD_END_BODY_START;
+  head += WEB_COMMON_MENU;
+  if (!websrv_tmplPageHead.compile(head, websrv_pageHeadFields)) {
+    spdlog::get("logger")->error("Failed to compile page head template.");
+  }
+
+  if (!websrv_tmplIfRow.compile(WEB_IFLIST_ROW, websrv_ifRowFields)) {
+    spdlog::get("logger")->error("Failed to compile interface list template.");
+  }
+
+  if (!websrv_tmplLogFilter.compile(WEB_LOGLIST_FILTER, websrv_logFields)) {
+    spdlog::get("logger")->error("Failed to compile log filter template.");
+  }
+
+  CWebBuffer buf;
+  buf.appendf(WEB_COMMON_END, COPYRIGHT_HTML);
+  websrv_pageEnd.assign(buf.data(), buf.size());
+
+  buf.clear();
+  buf.append("<br>All interfaces on the VSCP server is listed here. "
+             "This is drivers as well as clients connected to one of the VSCP servers "
+             "interfaces. It is possible to see events coming in on a on a "
+             "specific interface and send events on just one of the interfaces. "
+             "This is mostly used on the driver interfaces but is possible on "
+             "all interfaces<br>");
+  buf.append("<br><b>Interface Types</b><br>");
+  buf.appendf("%d - Unknown (you should not see this).<br>", (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_NONE);
+  buf.appendf("%d - Internal daemon client.<br>", (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_INTERNAL);
+  buf.appendf("%d - Level I (CANAL) Driver.<br>", (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_DRIVER_LEVEL1);
+  buf.appendf("%d - Level II Driver.<br>", (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_DRIVER_LEVEL2);
+  buf.appendf("%d - TCP/IP Client.<br>", (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_TCPIP);
+  buf.appendf("%d - UDP Client.<br>", (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_UDP);
+  buf.appendf("%d - Web Server Client.<br>", (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_WEB);
+  buf.appendf("%d - WebSocket Client.<br>", (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_WEBSOCKET);
+  buf.appendf("%d - REST Client.<br>", (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_REST);
+  buf.appendf("%d - Multicast.<br>", (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_MULTICAST);
+  buf.appendf("%d - Multicast Client.<br>", (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_MULTICAST_CH);
+  buf.appendf("%d - MQTT Client.<br>", (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_MQTT);
+  buf.appendf("%d - COAP Client.<br>", (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_COAP);
+  buf.appendf("%d - Discovery.<br>", (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_DISCOVERY);
+  buf.appendf("%d - Javascript Client.<br>", (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_JAVASCRIPT);
+  buf.appendf("%d - Lua Client.<br>", (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_LUA);
+  websrv_ifListLegend.assign(buf.data(), buf.size());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// websrv_renderPageHead
+//
+// Page head with assets and navigation menu
+//
+
+static void
+websrv_renderPageHead(CWebBuffer& buf, const char* title, const char* head = "")
+{
+  pthread_once(&websrv_pages_once, websrv_initPages);
+
+  std::string values[WEBSRV_HEAD_FIELDS];
+  values[WEBSRV_HEAD_TITLE]  = title;
+  values[WEBSRV_HEAD_ASSETS] = websrv_assetLinks;
+  values[WEBSRV_HEAD_HEAD]   = head;
+  websrv_tmplPageHead.render(buf, values);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// websrv_sendPage
+//
+// Add footer and send a rendered page
+//
+
+static int
+websrv_sendPage(struct mg_connection* conn, CWebBuffer& buf)
+{
+  buf.append(websrv_pageEnd);
+  websrv_sendBuffer(conn, 200, "text/html; charset=utf-8", buf);
+  return WEB_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// websrv_metricsHandler
+//
+// Counters, latencies and queue depths in Prometheus text format
+//
+
+static int
+websrv_metricsHandler(struct mg_connection* conn, void* cbdata)
+{
+  CWebBuffer buf(8192);
+  size_t depth;
+
+  CWebObj* pObj = (CWebObj*)cbdata;
+  if (NULL == pObj) {
+    return WEB_ERROR;
+  }
+
+  pObj->m_metrics.render(buf);
+  if (pObj->m_trace.isEnabled()) {
+    pObj->m_trace.render(buf);
+  }
+  pObj->m_memory.render(buf);
+
+  // Receive queue
+  pthread_mutex_lock(&pObj->m_mutexReceiveQueue);
+  depth = pObj->m_receiveList.size();
+  pthread_mutex_unlock(&pObj->m_mutexReceiveQueue);
+  webmetrics_renderGauge(buf,
+                         "vscp_websrv_receive_queue_depth",
+                         "Events waiting in the receive queue.",
+                         depth);
+
+  // Client input queues
+  size_t nClients = 0;
+  size_t total    = 0;
+  size_t maxdepth = 0;
+  pthread_mutex_lock(&pObj->m_clientList.m_mutexItemList);
+  std::deque<CClientItem*>::iterator it;
+  for (it = pObj->m_clientList.m_itemList.begin();
+       it != pObj->m_clientList.m_itemList.end();
+       ++it) {
+    CClientItem* pItem = *it;
+    pthread_mutex_lock(&pItem->m_mutexClientInputQueue);
+    depth = pItem->m_clientInputQueue.size();
+    pthread_mutex_unlock(&pItem->m_mutexClientInputQueue);
+    total += depth;
+    maxdepth = std::max(maxdepth, depth);
+    nClients++;
+  }
+  pthread_mutex_unlock(&pObj->m_clientList.m_mutexItemList);
+  webmetrics_renderGauge(buf, "vscp_websrv_clients", "Connected clients.", nClients);
+  webmetrics_renderGauge(buf,
+                         "vscp_websrv_client_queue_depth",
+                         "Events waiting in all client input queues.",
+                         total);
+  webmetrics_renderGauge(buf,
+                         "vscp_websrv_client_queue_depth_max",
+                         "Events waiting in the fullest client input queue.",
+                         maxdepth);
+
+  // Sessions
+  pthread_mutex_lock(&pObj->m_mutex_websocketSession);
+  depth = pObj->m_websocketSessions.size();
+  pthread_mutex_unlock(&pObj->m_mutex_websocketSession);
+  webmetrics_renderGauge(buf,
+                         "vscp_websrv_websocket_sessions",
+                         "Active websocket sessions.",
+                         depth);
+  webmetrics_renderGauge(buf,
+                         "vscp_websrv_fanout_threads",
+                         "Threads delivering events to websocket sessions.",
+                         pObj->m_fanout.getThreadCount());
+
+  pthread_mutex_lock(&pObj->m_mutex_restSession);
+  depth = pObj->m_rest_sessions.size();
+  pthread_mutex_unlock(&pObj->m_mutex_restSession);
+  webmetrics_renderGauge(buf,
+                         "vscp_websrv_rest_sessions",
+                         "Active REST sessions.",
+                         depth);
+
+  webmetrics_renderGauge(buf,
+                         "vscp_websrv_auth_cache_entries",
+                         "Entries in the credential cache.",
+                         pObj->m_credentialCache.size());
+
+  websrv_sendBuffer(conn, 200, WEB_METRICS_MIME_TYPE, buf);
+  return 200;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // web_skip_quoted
 //
@@ -585,6 +1276,7 @@ websrv_add_session(struct mg_connection* conn, void* cbdata)
   pthread_mutex_lock(&pObj->m_mutex_websrvSession);
   pObj->m_web_sessions.push_back(pSession);
   pthread_mutex_unlock(&pObj->m_mutex_websrvSession);
+  pObj->m_memory.m_webSessions.add(sizeof(struct websrv_session) + sizeof(CClientItem));
 
   return pSession;
 }
@@ -642,6 +1334,15 @@ websrv_expire_sessions(struct mg_connection* conn, void* cbdata)
     struct websrv_session* pSession = *it;
     if ((now - pSession->lastActiveTime) > (60 * 60)) {
       it = pObj->m_web_sessions.erase(it);
+      if (NULL != pSession->m_pClientItem) {
+        pthread_mutex_lock(&pObj->m_mutex_clientList);
+        pthread_mutex_lock(&pObj->m_clientList.m_mutexItemList);
+        pObj->releaseClientQueue(pSession->m_pClientItem);
+        pObj->m_clientList.removeClient(pSession->m_pClientItem);
+        pthread_mutex_unlock(&pObj->m_clientList.m_mutexItemList);
+        pthread_mutex_unlock(&pObj->m_mutex_clientList);
+      }
+      pObj->m_memory.m_webSessions.sub(sizeof(struct websrv_session) + sizeof(CClientItem));
       delete pSession;
     }
     else {
@@ -652,19 +1353,36 @@ websrv_expire_sessions(struct mg_connection* conn, void* cbdata)
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// check_admin_authorization
+// websrv_sendBasicAuthRequest
 //
-// Only the admin user has access to /vscp/....
+// 401 with a Basic challenge. check_admin_authorization reads Basic
+// credentials so a Digest challenge would never validate.
+//
+
+static void
+websrv_sendBasicAuthRequest(struct mg_connection* conn)
+{
+  mg_printf(conn,
+            "HTTP/1.1 401 Unauthorized\r\n"
+            "WWW-Authenticate: Basic realm=\"vscp\"\r\n"
+            "Content-Length: 0\r\n"
+            "Connection: close\r\n\r\n");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// websrv_checkAdmin
+//
+// Checks the Basic credentials of a request against the configured admin
+// user. Returns 200 if they are the admin user's, 403 for any other valid
+// user and 401 otherwise. A recent successful check of the same
+// credentials saves the expensive password verification.
 //
 
 static int
-check_admin_authorization(struct mg_connection* conn, void* cbdata)
+websrv_checkAdmin(const struct mg_connection* conn, CWebObj* pObj)
 {
   const char* auth_header;
   char buf[8192];
-  CUserItem* pUserItem = NULL;
-  bool bValidHost;
-  struct mg_context* ctx;
   const struct mg_request_info* reqinfo;
   char decoded[2048];
   size_t len;
@@ -673,56 +1391,25 @@ check_admin_authorization(struct mg_connection* conn, void* cbdata)
   memset(decoded, 0, sizeof(decoded));
 
   // Check pointers
-  if (!conn || !(ctx = mg_get_context(conn)) ||
-      !(reqinfo = mg_get_request_info(conn))) {
-    spdlog::get("logger")->error(
-      " check_admin_authorization: Pointers are invalid.");
-    return WEB_ERROR;
-  }
-
-  CWebObj* pObj = (CWebObj*)cbdata;
-  if (NULL == pObj) {
-    return WEB_ERROR;
+  if (!conn || !pObj || !(reqinfo = mg_get_request_info(conn))) {
+    spdlog::get("logger")->error(" websrv_checkAdmin: Pointers are invalid.");
+    return 401;
   }
 
-  // // Get admin user
-  // if (NULL ==
-  //     (pUserItem = m_userList.getUser(pObj->m_admin_user.c_str()))) {
-  //     spdlog::get("logger")->error(
-  //            " check_admin_authorization: Admin user [{}] i not "
-  //            "available.",
-  //            m_admin_user.c_str());
-  //     //mg_send_basic_access_authentication_request(conn, NULL);  // 1.13
-  //     mg_send_digest_access_authentication_request(conn, NULL);
-  //     return 401;
-  // }
-
   if ((NULL == (auth_header = mg_get_header(conn, "Authorization"))) ||
       (vscp_strncasecmp(auth_header, "Basic ", 6) != 0)) {
-    spdlog::get("logger")->error(
-      " check_admin_authorization: Authorization header or "
-      "digest missing for admin log in.");
-    // mg_send_basic_access_authentication_request(conn, NULL); 1.13
-    mg_send_digest_access_authentication_request(conn, NULL);
+    spdlog::get("logger")->debug(
+      " websrv_checkAdmin: Authorization header missing for admin log in.");
     return 401;
   }
 
-  // Make modifiable copy of the auth header (after "Digest")
+  // Make modifiable copy of the auth header (after "Basic ")
   (void)vscp_strlcpy(buf, auth_header + 6, sizeof(buf));
 
-  const struct mg_request_info* pri = mg_get_request_info(conn);
-  if (NULL == pri) {
-    spdlog::get("logger")->error(
-      " check_admin_authorization: Failed to to get request info.");
-    return WEB_ERROR;
-  }
-
   if (-1 == vscp_base64_decode((const unsigned char*)((const char*)buf),
                                strlen(buf) + 1,
                                decoded,
                                &len)) {
-    // mg_send_basic_access_authentication_request(conn, NULL); 1.13
-    mg_send_digest_access_authentication_request(conn, NULL);
     return 401;
   }
 
@@ -743,39 +1430,106 @@ check_admin_authorization(struct mg_connection* conn, void* cbdata)
     tokens.pop_front();
   }
 
+  // The password hash is copied while the user list is locked as a
+  // reload of the configuration can free the user item
+  bool bValidHost = false;
+  std::string strPasswordHash;
   pthread_mutex_lock(&pObj->m_mutex_UserList);
-  pUserItem = pObj->m_userList.validateUser(strUser, strPassword);
+  CUserItem* pUserItem = pObj->m_userList.getUser(strUser);
+  if (NULL != pUserItem) {
+    bValidHost =
+      (1 == pUserItem->isAllowedToConnect(inet_addr(reqinfo->remote_addr)));
+    strPasswordHash = pUserItem->getPassword();
+  }
   pthread_mutex_unlock(&pObj->m_mutex_UserList);
 
   if (NULL == pUserItem) {
-    // Password is not correct
     spdlog::get("logger")->error(
       " Use on host [{}] NOT "
       "allowed connect. User [{}]. Wrong user/password",
       (const char*)reqinfo->remote_addr,
-      (const char*)pUserItem->getUserName().c_str());
-    // mg_send_basic_access_authentication_request(conn, NULL); 1.13
-    mg_send_digest_access_authentication_request(conn, NULL);
+      strUser);
     return 401;
   }
 
-  // Check if remote ip is valid
-  pthread_mutex_lock(&pObj->m_mutex_UserList);
-  bValidHost =
-    (1 == pUserItem->isAllowedToConnect(inet_addr(reqinfo->remote_addr)));
-  pthread_mutex_unlock(&pObj->m_mutex_UserList);
   if (!bValidHost) {
     // Host is not allowed to connect
     spdlog::get("logger")->error(" Host [{}] "
                                  "NOT allowed to connect. User [{}]",
                                  (const char*)reqinfo->remote_addr,
-                                 (const char*)pUserItem->getUserName().c_str());
-    // mg_send_basic_access_authentication_request(conn, NULL); 1.13
-    mg_send_digest_access_authentication_request(conn, NULL);
+                                 strUser);
     return 401;
   }
 
-  return WEB_OK;
+  if (!pObj->m_credentialCache.isValid(strUser, strPassword, strPasswordHash)) {
+
+    struct timespec start = webmetrics_now();
+    pthread_mutex_lock(&pObj->m_mutex_UserList);
+    bool bValid = (NULL != pObj->m_userList.validateUser(strUser, strPassword));
+    pthread_mutex_unlock(&pObj->m_mutex_UserList);
+    pObj->m_metrics.m_authLatency.recordSince(start);
+
+    if (!bValid) {
+      pObj->m_metrics.m_authFailure.inc();
+      spdlog::get("logger")->error(
+        " Use on host [{}] NOT "
+        "allowed connect. User [{}]. Wrong user/password",
+        (const char*)reqinfo->remote_addr,
+        strUser);
+      return 401;
+    }
+
+    pObj->m_credentialCache.add(strUser, strPassword, strPasswordHash);
+  }
+  else {
+    pObj->m_metrics.m_authCacheHits.inc();
+  }
+
+  pObj->m_metrics.m_authSuccess.inc();
+
+  // Only the admin user has access
+  if (strUser != pObj->m_admin_user) {
+    spdlog::get("logger")->error(" User [{}] on host [{}] is not the admin "
+                                 "user. Admin pages are NOT allowed.",
+                                 strUser,
+                                 (const char*)reqinfo->remote_addr);
+    return 403;
+  }
+
+  return 200;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// check_admin_authorization
+//
+// Only the admin user has access to /vscp/....
+//
+// Used as a civetweb auth handler. Returns WEB_OK to let the request
+// through and WEB_ERROR (after a 401 challenge or a 403 is sent) to stop
+// it.
+//
+
+static int
+check_admin_authorization(struct mg_connection* conn, void* cbdata)
+{
+  switch (websrv_checkAdmin(conn, (CWebObj*)cbdata)) {
+
+    case 200:
+      return WEB_OK;
+
+    case 403:
+      mg_printf(conn,
+                "HTTP/1.1 403 Forbidden\r\n"
+                "Content-Length: 0\r\n"
+                "Connection: close\r\n\r\n");
+      return WEB_ERROR;
+
+    default:
+      if (NULL != conn) {
+        websrv_sendBasicAuthRequest(conn);
+      }
+      return WEB_ERROR;
+  }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -815,6 +1569,63 @@ log_access(const struct mg_connection* conn, const char* message)
   return WEB_OK;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// init_thread
+//
+// Called by each web server thread when it starts. Names the thread and
+// applies the configured http thread placement and scheduling.
+//
+
+static void*
+init_thread(const struct mg_context* ctx, int thread_type)
+{
+  static std::atomic<int> nWorkers(0);
+  char name[16];
+
+  CWebObj* pObj = (CWebObj*)mg_get_user_data(ctx);
+  if (NULL == pObj) {
+    return NULL;
+  }
+
+  switch (thread_type) {
+    case 0:
+      strcpy(name, "wsrv-http-main");
+      break;
+    case 1:
+      snprintf(name, sizeof(name), "wsrv-http-%d", nWorkers++);
+      break;
+    default:
+      strcpy(name, "wsrv-http-misc");
+      break;
+  }
+
+  pObj->m_threadsHttp.apply(name);
+
+  return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// init_lua
+//
+// Called for every Lua state civetweb creates (server pages, scripts and
+// websockets). Adds the vscp.* functions and runs the precompiled preload
+// file.
+//
+
+static void
+init_lua(const struct mg_connection* conn, void* lua_context, unsigned context_flags)
+{
+  (void)context_flags;
+
+  CWebObj* pObj = (CWebObj*)mg_get_user_data(mg_get_context(conn));
+  if ((NULL == pObj) || (NULL == lua_context)) {
+    return;
+  }
+
+  lua_vscp_openlib((struct lua_State*)lua_context, pObj);
+  lua_vscp_runPreload((struct lua_State*)lua_context);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // vscp_mainPage
 //
@@ -832,41 +1643,24 @@ vscp_mainpage(struct mg_connection* conn, void* cbdata)
     return WEB_ERROR;
   }
 
-  mg_printf(conn,
-            "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n"
-            "Content-Type: text/html; charset=utf-8\r\n"
-            "Connection: close\r\n\r\n");
-
-  mg_printf(conn, WEB_COMMON_HEAD, "VSCP - Control");
-  mg_printf(conn, WEB_STYLE_START);
-  mg_write(conn, WEB_COMMON_CSS, strlen(WEB_COMMON_CSS)); // CSS style Code
-  mg_printf(conn, WEB_STYLE_END);
-  mg_write(conn,
-           WEB_COMMON_JS,
-           strlen(WEB_COMMON_JS)); // Common Javascript code
-
-  mg_printf(conn, WEB_COMMON_HEAD_END_BODY_START);
-  // Insert server url into navigation menu
-  mg_printf(conn, WEB_COMMON_MENU);
+  CWebBuffer buf;
+  websrv_renderPageHead(buf, "VSCP - Control");
 
-  mg_printf(conn, "<span align=\"center\">");
-  mg_printf(
-    conn,
+  buf.appendf("<span align=\"center\">");
+  buf.appendf(
     "<h4> Welcome to the VSCP server local admin control interface.</h4>");
-  mg_printf(conn, "</span>");
-  mg_printf(conn, "<span style=\"text-indent:50px;\"><p>");
-  mg_printf(conn,
-            "<img src=\"http://vscp.org/images/vscp_logo.png\" width=\"100\">");
-  mg_printf(conn, "</p></span>");
-  mg_printf(conn, "<span style=\"text-indent:50px;\"><p>");
-  mg_printf(conn, " <b>Version:</b> ");
-  mg_printf(conn, DISPLAY_VERSION);
-  mg_printf(conn, "</p><p>");
-  mg_printf(conn, COPYRIGHT_HTML);
-  mg_printf(conn, "</p></span>");
-
-  mg_printf(conn, WEB_COMMON_END, COPYRIGHT_HTML); // Common end code
-  return 1;
+  buf.appendf("</span>");
+  buf.appendf("<span style=\"text-indent:50px;\"><p>");
+  buf.appendf("<img src=\"http://vscp.org/images/vscp_logo.png\" width=\"100\">");
+  buf.appendf("</p></span>");
+  buf.appendf("<span style=\"text-indent:50px;\"><p>");
+  buf.appendf(" <b>Version:</b> ");
+  buf.appendf(DISPLAY_VERSION);
+  buf.appendf("</p><p>");
+  buf.appendf(COPYRIGHT_HTML);
+  buf.appendf("</p></span>");
+
+  return websrv_sendPage(conn, buf);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -899,12 +1693,7 @@ vscp_password(struct mg_connection* conn, void* cbdata)
             "Connection: close\r\n\r\n");
 
   mg_printf(conn, WEB_COMMON_HEAD, "Password key generation");
-  mg_printf(conn, WEB_STYLE_START);
-  mg_write(conn, WEB_COMMON_CSS, strlen(WEB_COMMON_CSS)); // CSS style Code
-  mg_printf(conn, WEB_STYLE_END);
-  mg_write(conn,
-           WEB_COMMON_JS,
-           strlen(WEB_COMMON_JS)); // Common Javascript code
+  websrv_writeAssetLinks(conn); // Common CSS and JavaScript
   mg_printf(conn, "<style>table, th, td { border: 0px solid black;}</style>");
 
   mg_printf(conn, WEB_COMMON_HEAD_END_BODY_START);
@@ -1004,12 +1793,7 @@ vscp_restart(struct mg_connection* conn, void* cbdata)
             "Connection: close\r\n\r\n");
 
   mg_printf(conn, WEB_COMMON_HEAD, "VSCP Server restart");
-  mg_printf(conn, WEB_STYLE_START);
-  mg_write(conn, WEB_COMMON_CSS, strlen(WEB_COMMON_CSS)); // CSS style Code
-  mg_printf(conn, WEB_STYLE_END);
-  mg_write(conn,
-           WEB_COMMON_JS,
-           strlen(WEB_COMMON_JS)); // Common JavaScript code
+  websrv_writeAssetLinks(conn); // Common CSS and JavaScript
   mg_printf(conn, "<style>table, th, td { border: 0px solid black;}</style>");
 
   mg_printf(conn, WEB_COMMON_HEAD_END_BODY_START);
@@ -1061,184 +1845,557 @@ vscp_restart(struct mg_connection* conn, void* cbdata)
     // sleep(1);
     // fprintf(stderr, "websrv: Shutdown in progress 3.\n");
 
-    mg_printf(conn, "<table>");
-    mg_printf(conn, "</td><tr>");
-    mg_printf(conn,
-              "<tr><td><b>VSCP Server will now be restarted... </b></td><td>");
-    mg_printf(conn, "</td><tr>");
-    mg_printf(conn, "</td><tr>");
-    mg_printf(conn, "<tr><td><b>This may take a while... </b></td><td>");
-    mg_printf(conn, "</td><tr>");
-    mg_printf(conn, "</table>");
+    mg_printf(conn, "<table>");
+    mg_printf(conn, "</td><tr>");
+    mg_printf(conn,
+              "<tr><td><b>VSCP Server will now be restarted... </b></td><td>");
+    mg_printf(conn, "</td><tr>");
+    mg_printf(conn, "</td><tr>");
+    mg_printf(conn, "<tr><td><b>This may take a while... </b></td><td>");
+    mg_printf(conn, "</td><tr>");
+    mg_printf(conn, "</table>");
+  }
+
+  return WEB_OK;
+}
+
+// Fields of a client needed by the interface list. Copied while the
+// client list is locked so the page is rendered without holding it.
+struct websrv_ifinfo {
+  uint32_t m_clientID;
+  uint8_t m_type;
+  cguid m_guid;
+  std::string m_strDeviceName;
+  vscpdatetime m_dtutc;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// websrv_getQueryNumber
+//
+// Get an unsigned numerical query variable
+//
+
+static size_t
+websrv_getQueryNumber(const struct mg_request_info* reqinfo,
+                      const char* name,
+                      size_t defval)
+{
+  char buf[32];
+
+  if ((NULL == reqinfo) || (NULL == reqinfo->query_string)) {
+    return defval;
+  }
+
+  if (mg_get_var(reqinfo->query_string,
+                 strlen(reqinfo->query_string),
+                 name,
+                 buf,
+                 sizeof(buf)) <= 0) {
+    return defval;
+  }
+
+  char* pend;
+  unsigned long val = strtoul(buf, &pend, 0);
+  if ((pend == buf) || ('-' == buf[0])) {
+    return defval;
+  }
+
+  return (size_t)val;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// vscp_interface
+//
+// List of interfaces. Query variables
+//    offset - First interface to list (default 0)
+//    count  - Number of interfaces to list (default WEB_IFLIST_PAGE_SIZE)
+//    format - "json" for a JSON list instead of the HTML page
+//
+
+static int
+vscp_interface(struct mg_connection* conn, void* cbdata)
+{
+  // Check pointer
+  if (NULL == conn) {
+    return WEB_ERROR;
+  }
+
+  CWebObj* pObj = (CWebObj*)cbdata;
+  if (NULL == pObj) {
+    return WEB_ERROR;
+  }
+
+  const struct mg_request_info* reqinfo = mg_get_request_info(conn);
+  if (NULL == reqinfo) {
+    return WEB_ERROR;
+  }
+
+  size_t offset = websrv_getQueryNumber(reqinfo, "offset", 0);
+  size_t count  = websrv_getQueryNumber(reqinfo, "count", WEB_IFLIST_PAGE_SIZE);
+  if (!count || (count > WEB_IFLIST_MAX_PAGE_SIZE)) {
+    count = WEB_IFLIST_MAX_PAGE_SIZE;
+  }
+
+  bool bJSON = false;
+  char format[16];
+  if ((NULL != reqinfo->query_string) &&
+      (mg_get_var(reqinfo->query_string,
+                  strlen(reqinfo->query_string),
+                  "format",
+                  format,
+                  sizeof(format)) > 0)) {
+    bJSON = (0 == strcasecmp(format, "json"));
+  }
+
+  // Copy the requested page of the interface list. Room is
+  // allocated before the lock is taken.
+  std::vector<websrv_ifinfo> ifs;
+  ifs.reserve(std::min(count, (size_t)WEB_IFLIST_PAGE_SIZE));
+  size_t total;
+
+  pthread_mutex_lock(&pObj->m_clientList.m_mutexItemList);
+  total = pObj->m_clientList.m_itemList.size();
+  for (size_t i = offset; (i < total) && (ifs.size() < count); i++) {
+    CClientItem* pItem = pObj->m_clientList.m_itemList[i];
+    ifs.push_back(websrv_ifinfo());
+    websrv_ifinfo* pInfo   = &ifs.back();
+    pInfo->m_clientID      = pItem->m_clientID;
+    pInfo->m_type          = pItem->m_type;
+    pInfo->m_guid          = pItem->m_guid;
+    pInfo->m_strDeviceName = pItem->m_strDeviceName;
+    pInfo->m_dtutc         = pItem->m_dtutc;
+  }
+  pthread_mutex_unlock(&pObj->m_clientList.m_mutexItemList);
+
+  std::string strGUID;
+  std::string values[WEBSRV_IFROW_FIELDS];
+  json jlist = json::array();
+
+  CWebBuffer buf(16384);
+  if (!bJSON) {
+    websrv_renderPageHead(buf, "VSCP - Control");
+    buf.append(WEB_IFLIST_BODY_START);
+    buf.append(WEB_IFLIST_TR_HEAD);
+  }
+
+  for (size_t i = 0; i < ifs.size(); i++) {
+
+    websrv_ifinfo* pInfo = &ifs[i];
+    pInfo->m_guid.toString(strGUID);
+
+    // Interface name
+    size_t pos;
+    values[WEBSRV_IFROW_NAME].clear();
+    if (std::string::npos != (pos = pInfo->m_strDeviceName.find("|"))) {
+      values[WEBSRV_IFROW_NAME] = vscp_str_left(pInfo->m_strDeviceName, pos);
+      vscp_trim(values[WEBSRV_IFROW_NAME]);
+    }
+
+    // Start date
+    values[WEBSRV_IFROW_STARTED] = pInfo->m_dtutc.getISODateTime();
+
+    if (bJSON) {
+      json j;
+      j["id"]      = pInfo->m_clientID;
+      j["type"]    = pInfo->m_type;
+      j["guid"]    = strGUID;
+      j["name"]    = values[WEBSRV_IFROW_NAME];
+      j["started"] = values[WEBSRV_IFROW_STARTED];
+      jlist.push_back(j);
+      continue;
+    }
+
+    values[WEBSRV_IFROW_ID]    = std::to_string(pInfo->m_clientID);
+    values[WEBSRV_IFROW_TYPE]  = std::to_string(pInfo->m_type);
+    values[WEBSRV_IFROW_GUID1] = strGUID.substr(0, 24);
+    values[WEBSRV_IFROW_GUID2] = strGUID.substr(24);
+
+    websrv_tmplIfRow.render(buf, values);
+  }
+
+  if (bJSON) {
+    json jrsp;
+    jrsp["total"]      = total;
+    jrsp["offset"]     = offset;
+    jrsp["count"]      = ifs.size();
+    jrsp["interfaces"] = jlist;
+    buf.append(jrsp.dump());
+    websrv_sendBuffer(conn, 200, "application/json; charset=utf-8", buf);
+    return WEB_OK;
+  }
+
+  buf.append(WEB_IFLIST_TABLE_END);
+
+  // Page navigation
+  if (total > ifs.size()) {
+    buf.appendf("<br>Interface %zu - %zu of %zu ",
+                ifs.empty() ? 0 : (offset + 1),
+                offset + ifs.size(),
+                total);
+    if (offset) {
+      buf.appendf("<a href=\"%s?offset=%zu&count=%zu\">Previous</a> ",
+                  WEB_IFLIST_URI,
+                  (offset > count) ? (offset - count) : 0,
+                  count);
+    }
+    if ((offset + ifs.size()) < total) {
+      buf.appendf("<a href=\"%s?offset=%zu&count=%zu\">Next</a>",
+                  WEB_IFLIST_URI,
+                  offset + count,
+                  count);
+    }
+    buf.append("<br>");
+  }
+
+  // Description and interface types
+  buf.append(websrv_ifListLegend);
+
+  return websrv_sendPage(conn, buf);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// vscp_interface
+//
+
+static int
+vscp_interface_info(struct mg_connection* conn, void* cbdata)
+{
+  // Check pointer
+  if (NULL == conn) {
+    return WEB_ERROR;
+  }
+
+  CWebObj* pObj = (CWebObj*)cbdata;
+  if (NULL == pObj) {
+    return WEB_ERROR;
+  }
+
+  mg_printf(conn,
+            "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n"
+            "Content-Type: text/html; charset=utf-8\r\n"
+            "Connection: close\r\n\r\n");
+
+  mg_printf(conn, WEB_COMMON_HEAD, "VSCP - Interface information");
+  websrv_writeAssetLinks(conn); // Common CSS and JavaScript
+
+  mg_printf(conn, WEB_COMMON_HEAD_END_BODY_START);
+  // Insert server url into navigation menu
+  mg_printf(conn, WEB_COMMON_MENU);
+
+  mg_printf(conn,
+            "<h4>There is no extra information about this interface.</h4>");
+
+  mg_printf(conn, WEB_COMMON_END, COPYRIGHT_HTML); // Common end code
+
+  return WEB_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// websrv_getLogFilter
+//
+// Log filter from the query variables level and match
+//
+
+static bool
+websrv_getLogFilter(const struct mg_request_info* reqinfo,
+                    CWebLogFilter& filter,
+                    std::string& level,
+                    std::string& match)
+{
+  char buf[256];
+
+  level.clear();
+  match.clear();
+
+  if ((NULL == reqinfo) || (NULL == reqinfo->query_string)) {
+    return true;
+  }
+
+  if (mg_get_var(reqinfo->query_string,
+                 strlen(reqinfo->query_string),
+                 "level",
+                 buf,
+                 sizeof(buf)) > 0) {
+    level = buf;
+    vscp_trim(level);
+    int lvl = CWebLogFilter::getLevelFromName(level);
+    if (WEBLOG_LEVEL_UNKNOWN != lvl) {
+      filter.setLevel(lvl);
+    }
+  }
+
+  if (mg_get_var(reqinfo->query_string,
+                 strlen(reqinfo->query_string),
+                 "match",
+                 buf,
+                 sizeof(buf)) > 0) {
+    match = buf;
+    if (!filter.setMatch(match)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// vscp_log
+//
+// Lines from the driver log file. Query variables
+//    lines  - Number of lines (default WEBLOG_DEFAULT_LINES)
+//    before - Show the lines before this byte offset (default end of file)
+//    offset - Show the lines from this byte offset instead
+//    level  - Lowest level to show (trace, debug, info, warning, error, critical)
+//    match  - Text lines must contain
+//    format - "json" for a JSON list instead of the HTML page
+//
+
+static int
+vscp_log(struct mg_connection* conn, void* cbdata)
+{
+  // Check pointer
+  if (NULL == conn) {
+    return WEB_ERROR;
+  }
+
+  CWebObj* pObj = (CWebObj*)cbdata;
+  if (NULL == pObj) {
+    return WEB_ERROR;
+  }
+
+  const struct mg_request_info* reqinfo = mg_get_request_info(conn);
+  if (NULL == reqinfo) {
+    return WEB_ERROR;
+  }
+
+  size_t lines = websrv_getQueryNumber(reqinfo, "lines", WEBLOG_DEFAULT_LINES);
+  if (!lines || (lines > WEBLOG_MAX_LINES)) {
+    lines = WEBLOG_MAX_LINES;
+  }
+
+  bool bJSON = false;
+  char format[16];
+  if ((NULL != reqinfo->query_string) &&
+      (mg_get_var(reqinfo->query_string,
+                  strlen(reqinfo->query_string),
+                  "format",
+                  format,
+                  sizeof(format)) > 0)) {
+    bJSON = (0 == strcasecmp(format, "json"));
+  }
+
+  CWebLogFilter filter;
+  std::string strLevel;
+  std::string strMatch;
+  if (!websrv_getLogFilter(reqinfo, filter, strLevel, strMatch)) {
+    mg_send_http_error(conn, 400, "%s", "Match string too long");
+    return 400;
+  }
+
+  // Read from an offset and forward, or back from the end
+  weblog_page page;
+  bool rv;
+  size_t offset = websrv_getQueryNumber(reqinfo, "offset", SIZE_MAX);
+  if (SIZE_MAX != offset) {
+    rv = weblog_readForward(pObj->m_path_to_log_file, filter, offset, lines, page);
+  }
+  else {
+    size_t before = websrv_getQueryNumber(reqinfo, "before", SIZE_MAX);
+    uint64_t end  = (SIZE_MAX == before) ? UINT64_MAX : before;
+    rv            = weblog_readTail(pObj->m_path_to_log_file, filter, end, lines, page);
+  }
+
+  if (!rv) {
+    mg_send_http_error(conn, 404, "%s", "Unable to read log file");
+    return 404;
+  }
+
+  CWebBuffer buf(16384);
+
+  if (bJSON) {
+    json jrsp;
+    jrsp["file-size"]  = page.m_fileSize;
+    jrsp["start"]      = page.m_start;
+    jrsp["end"]        = page.m_end;
+    jrsp["scan-limit"] = page.m_bScanLimit;
+    jrsp["lines"]      = json::array();
+    for (std::deque<weblog_line>::iterator it = page.m_lines.begin(); it != page.m_lines.end(); ++it) {
+      json j;
+      j["offset"] = it->m_offset;
+      j["level"]  = it->m_level;
+      j["text"]   = it->m_text;
+      jrsp["lines"].push_back(j);
+    }
+    buf.append(jrsp.dump());
+    websrv_sendBuffer(conn, 200, "application/json; charset=utf-8", buf);
+    return WEB_OK;
+  }
+
+  websrv_renderPageHead(buf, "VSCP - Log", WEB_LOGLIST_LIVE_SCRIPT);
+
+  std::string values[WEBSRV_LOG_FIELDS];
+  values[WEBSRV_LOG_LINES] = std::to_string(lines);
+  values[WEBSRV_LOG_LEVEL] = strLevel;
+  values[WEBSRV_LOG_MATCH] = strMatch;
+
+  buf.append(WEB_LOGLIST_BODY_START);
+  websrv_tmplLogFilter.render(buf, values);
+  buf.append(WEB_LOGLIST_TR_HEAD);
+
+  for (std::deque<weblog_line>::iterator it = page.m_lines.begin(); it != page.m_lines.end(); ++it) {
+    buf.append("<tr><td>");
+    webrender_appendEscaped(buf, it->m_text.c_str(), it->m_text.length());
+    buf.append("</td></tr>");
+  }
+
+  buf.append(WEB_LOGLIST_TABLE_END);
+
+  // Page navigation. Filter is kept.
+  char level[64];
+  char match[3 * 256];
+  mg_url_encode(strLevel.c_str(), level, sizeof(level));
+  mg_url_encode(strMatch.c_str(), match, sizeof(match));
+
+  if (page.m_bScanLimit) {
+    buf.appendf("<br>Search stopped after %d bytes.", WEBLOG_MAX_SCAN);
+  }
+
+  buf.append("<br>");
+  if (page.m_start > 0) {
+    buf.appendf("<a href=\"%s?before=%llu&lines=%zu&level=%s&match=%s\">Older</a> ",
+                WEB_LOG_URI,
+                (unsigned long long)page.m_start,
+                lines,
+                level,
+                match);
   }
 
-  return WEB_OK;
+  if (page.m_end < page.m_fileSize) {
+    buf.appendf("<a href=\"%s?offset=%llu&lines=%zu&level=%s&match=%s\">Newer</a> ",
+                WEB_LOG_URI,
+                (unsigned long long)page.m_end,
+                lines,
+                level,
+                match);
+  }
+
+  buf.appendf("<a href=\"%s?lines=%zu&level=%s&match=%s\">Latest</a><br>",
+              WEB_LOG_URI,
+              lines,
+              level,
+              match);
+
+  return websrv_sendPage(conn, buf);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// vscp_interface
+// vscp_logws_connectHandler
 //
 
 static int
-vscp_interface(struct mg_connection* conn, void* cbdata)
+vscp_logws_connectHandler(const struct mg_connection* conn, void* cbdata)
 {
-  // Check pointer
-  if (NULL == conn) {
-    return WEB_ERROR;
-  }
-
   CWebObj* pObj = (CWebObj*)cbdata;
-  if (NULL == pObj) {
-    return WEB_ERROR;
+  if ((NULL == conn) || (NULL == pObj)) {
+    return 1; // Reject
   }
 
-  mg_printf(conn,
-            "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n"
-            "Content-Type: text/html; charset=utf-8\r\n"
-            "Connection: close\r\n\r\n");
-
-  mg_printf(conn, WEB_COMMON_HEAD, "VSCP - Control");
-  mg_printf(conn, WEB_STYLE_START);
-  mg_write(conn, WEB_COMMON_CSS, strlen(WEB_COMMON_CSS)); // CSS style Code
-  mg_printf(conn, WEB_STYLE_END);
-  mg_write(conn,
-           WEB_COMMON_JS,
-           strlen(WEB_COMMON_JS)); // Common Javascript code
-
-  mg_printf(conn, WEB_COMMON_HEAD_END_BODY_START);
-  // Insert server url into navigation menu
-  mg_printf(conn, WEB_COMMON_MENU);
+  // The auth handler has checked the upgrade request already. Checked
+  // again here so the log never reaches a websocket without it.
+  if (200 != websrv_checkAdmin(conn, pObj)) {
+    return 1;
+  }
 
-  mg_printf(conn, WEB_IFLIST_BODY_START);
-  mg_printf(conn, WEB_IFLIST_TR_HEAD);
+  // Check the filter before the connection is upgraded
+  CWebLogFilter filter;
+  std::string strLevel;
+  std::string strMatch;
+  if (!websrv_getLogFilter(mg_get_request_info(conn), filter, strLevel, strMatch)) {
+    return 1;
+  }
 
-  std::string strGUID;
-  std::string strBuf;
+  // Room for one more
+  if (pObj->m_logTail.getSubscriberCount() >= WEBLOG_TAIL_MAX_SESSIONS) {
+    spdlog::get("logger")->warn("Log live tail rejected. Too many sessions.");
+    return 1;
+  }
 
-  // Display Interface List
-  pthread_mutex_lock(&pObj->m_clientList.m_mutexItemList);
-  std::deque<CClientItem*>::iterator it;
-  for (it = pObj->m_clientList.m_itemList.begin();
-       it != pObj->m_clientList.m_itemList.end();
-       ++it) {
+  return 0;
+}
 
-    CClientItem* pItem = *it;
-    pItem->m_guid.toString(strGUID);
+///////////////////////////////////////////////////////////////////////////////
+// vscp_logws_readyHandler
+//
 
-    mg_printf(conn, WEB_IFLIST_TR);
+static void
+vscp_logws_readyHandler(struct mg_connection* conn, void* cbdata)
+{
+  CWebObj* pObj = (CWebObj*)cbdata;
+  if ((NULL == conn) || (NULL == pObj)) {
+    return;
+  }
 
-    // Client id
-    mg_printf(conn, WEB_IFLIST_TD_CENTERED);
-    mg_printf(conn, "%d", pItem->m_clientID);
-    mg_printf(conn, "</td>");
+  CWebLogFilter filter;
+  std::string strLevel;
+  std::string strMatch;
+  websrv_getLogFilter(mg_get_request_info(conn), filter, strLevel, strMatch);
 
-    // Interface type
-    mg_printf(conn, WEB_IFLIST_TD_CENTERED);
-    mg_printf(conn, "%d", pItem->m_type);
-    mg_printf(conn, "</td>");
+  if (!pObj->m_logTail.subscribe(conn, filter)) {
+    mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_CONNECTION_CLOSE, NULL, 0);
+  }
+}
 
-    // GUID
-    mg_printf(conn, WEB_IFLIST_TD_GUID);
-    mg_printf(conn, "%s", (const char*)strGUID.substr(0, 24).c_str());
-    mg_printf(conn, "<br>");
-    mg_printf(conn, "%s", (const char*)strGUID.substr(24).c_str());
-    mg_printf(conn, "</td>");
+///////////////////////////////////////////////////////////////////////////////
+// vscp_feedws_dataHandler
+//
+// Websockets that only feed the client (log tail and event monitor).
+// Nothing is expected from the client.
+//
 
-    // Interface name
-    mg_printf(conn, "<td>");
+static int
+vscp_feedws_dataHandler(struct mg_connection* conn, int bits, char* data, size_t len, void* cbdata)
+{
+  (void)data;
+  (void)len;
+  (void)cbdata;
 
-    size_t pos;
-    std::string strDeviceName;
-    if (std::string::npos != (pos = pItem->m_strDeviceName.find("|"))) {
-      strDeviceName = vscp_str_left(pItem->m_strDeviceName, pos);
-      vscp_trim(strDeviceName);
-    }
+  switch (bits & 0x0f) {
 
-    mg_printf(conn, "%s", (const char*)strDeviceName.c_str());
-    mg_printf(conn, "</td>");
+    case MG_WEBSOCKET_OPCODE_CONNECTION_CLOSE:
+      return 0; // Close
 
-    // Start date
-    mg_printf(conn, "<td>");
-    mg_printf(conn, "%s", pItem->m_dtutc.getISODateTime().c_str());
-    mg_printf(conn, "</td>");
+    case MG_WEBSOCKET_OPCODE_PING:
+      mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_PONG, NULL, 0);
+      break;
 
-    mg_printf(conn, "</tr>");
+    default:
+      break;
   }
 
-  pthread_mutex_unlock(&pObj->m_clientList.m_mutexItemList);
-
-  mg_printf(conn, WEB_IFLIST_TABLE_END);
-
-  mg_printf(
-    conn,
-    "<br>All interfaces on the VSCP server is listed here. "
-    "This is drivers as well as clients connected to one of the VSCP servers "
-    "interfaces. It is possible to see events coming in on a on a "
-    "specific interface and send events on just one of the interfaces. "
-    "This is mostly used on the driver interfaces but is possible on "
-    "all interfaces<br>");
+  return 1;
+}
 
-  mg_printf(conn, "<br><b>Interface Types</b><br>");
-  mg_printf(conn,
-            "%d - Unknown (you should not see this).<br>",
-            (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_NONE);
-  mg_printf(conn,
-            "%d - Internal daemon client.<br>",
-            (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_INTERNAL);
-  mg_printf(conn,
-            "%d - Level I (CANAL) Driver.<br>",
-            (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_DRIVER_LEVEL1);
-  mg_printf(conn,
-            "%d - Level II Driver.<br>",
-            (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_DRIVER_LEVEL2);
-  mg_printf(conn,
-            "%d - TCP/IP Client.<br>",
-            (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_TCPIP);
-  mg_printf(conn,
-            "%d - UDP Client.<br>",
-            (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_UDP);
-  mg_printf(conn,
-            "%d - Web Server Client.<br>",
-            (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_WEB);
-  mg_printf(conn,
-            "%d - WebSocket Client.<br>",
-            (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_WEBSOCKET);
-  mg_printf(conn,
-            "%d - REST Client.<br>",
-            (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_REST);
-  mg_printf(conn,
-            "%d - Multicast.<br>",
-            (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_MULTICAST);
-  mg_printf(conn,
-            "%d - Multicast Client.<br>",
-            (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_MULTICAST_CH);
-  mg_printf(conn,
-            "%d - MQTT Client.<br>",
-            (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_MQTT);
-  mg_printf(conn,
-            "%d - COAP Client.<br>",
-            (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_COAP);
-  mg_printf(conn,
-            "%d - Discovery.<br>",
-            (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_DISCOVERY);
-  mg_printf(conn,
-            "%d - Javascript Client.<br>",
-            (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_JAVASCRIPT);
-  mg_printf(conn,
-            "%d - Lua Client.<br>",
-            (uint8_t)CLIENT_ITEM_INTERFACE_TYPE_CLIENT_LUA);
+///////////////////////////////////////////////////////////////////////////////
+// vscp_logws_closeHandler
+//
 
-  mg_printf(conn, WEB_COMMON_END, COPYRIGHT_HTML); // Common end code
+static void
+vscp_logws_closeHandler(const struct mg_connection* conn, void* cbdata)
+{
+  CWebObj* pObj = (CWebObj*)cbdata;
+  if ((NULL == conn) || (NULL == pObj)) {
+    return;
+  }
 
-  return WEB_OK;
+  pObj->m_logTail.unsubscribe(conn);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// vscp_interface
+// vscp_memory
 //
 
 static int
-vscp_interface_info(struct mg_connection* conn, void* cbdata)
+vscp_memory(struct mg_connection* conn, void* cbdata)
 {
   // Check pointer
   if (NULL == conn) {
@@ -1250,37 +2407,44 @@ vscp_interface_info(struct mg_connection* conn, void* cbdata)
     return WEB_ERROR;
   }
 
-  mg_printf(conn,
-            "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n"
-            "Content-Type: text/html; charset=utf-8\r\n"
-            "Connection: close\r\n\r\n");
+  json memory;
+  pObj->m_memory.toJSON(memory);
 
-  mg_printf(conn, WEB_COMMON_HEAD, "VSCP - Interface information");
-  mg_printf(conn, WEB_STYLE_START);
-  mg_write(conn, WEB_COMMON_CSS, strlen(WEB_COMMON_CSS)); // CSS style Code
-  mg_printf(conn, WEB_STYLE_END);
-  mg_write(conn,
-           WEB_COMMON_JS,
-           strlen(WEB_COMMON_JS)); // Common Javascript code
+  CWebBuffer buf;
+  websrv_renderPageHead(buf, "VSCP - Memory");
 
-  mg_printf(conn, WEB_COMMON_HEAD_END_BODY_START);
-  // Insert server url into navigation menu
-  mg_printf(conn, WEB_COMMON_MENU);
+  buf.appendf(WEB_MEMORY_BODY_START);
+  buf.appendf(WEB_MEMORY_TR_HEAD);
 
-  mg_printf(conn,
-            "<h4>There is no extra information about this interface.</h4>");
+  for (json::iterator it = memory.begin(); it != memory.end(); ++it) {
+    if (!it.value().is_object()) {
+      continue;
+    }
+    buf.appendf(WEB_COMMON_TR_NON_CLICKABLE_ROW);
+    buf.appendf("<td>%s</td><td>%llu</td><td>%llu</td><td>%llu</td><td>%llu</td></tr>",
+                it.key().c_str(),
+                (unsigned long long) it.value()["bytes"].get<uint64_t>(),
+                (unsigned long long) it.value()["bytes-peak"].get<uint64_t>(),
+                (unsigned long long) it.value()["items"].get<uint64_t>(),
+                (unsigned long long) it.value()["items-peak"].get<uint64_t>());
+  }
 
-  mg_printf(conn, WEB_COMMON_END, COPYRIGHT_HTML); // Common end code
+  buf.appendf("<tr><td><b>Total</b></td><td><b>%llu</b></td><td></td><td></td><td></td></tr>",
+              (unsigned long long) memory["total-bytes"].get<uint64_t>());
 
-  return WEB_OK;
+  buf.appendf(WEB_MEMORY_TABLE_END);
+  return websrv_sendPage(conn, buf);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// vscp_log
+// vscp_client
+//
+// Live event monitor. Events are pushed to the page over the monitor
+// websocket.
 //
 
 static int
-vscp_log(struct mg_connection* conn, void* cbdata)
+vscp_client(struct mg_connection* conn, void* cbdata)
 {
   // Check pointer
   if (NULL == conn) {
@@ -1292,80 +2456,77 @@ vscp_log(struct mg_connection* conn, void* cbdata)
     return WEB_ERROR;
   }
 
-  mg_printf(conn,
-            "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n"
-            "Content-Type: text/html; charset=utf-8\r\n"
-            "Connection: close\r\n\r\n");
-
-  mg_printf(conn, WEB_COMMON_HEAD, "VSCP - Log");
-  mg_printf(conn, WEB_STYLE_START);
-  mg_write(conn, WEB_COMMON_CSS, strlen(WEB_COMMON_CSS)); // CSS style Code
-  mg_printf(conn, WEB_STYLE_END);
-  mg_write(conn,
-           WEB_COMMON_JS,
-           strlen(WEB_COMMON_JS)); // Common Javascript code
-
-  mg_printf(conn, WEB_COMMON_HEAD_END_BODY_START);
-  // Insert server url into navigation menu
-  mg_printf(conn, WEB_COMMON_MENU);
-
-  mg_printf(conn, WEB_LOGLIST_BODY_START);
-  mg_printf(conn, WEB_LOGLIST_TR_HEAD);
+  CWebBuffer buf;
+  websrv_renderPageHead(buf, "VSCP - Event monitor", WEB_MONITOR_SCRIPT);
 
-  std::string line;
-  std::ifstream logFile("/var/log/syslog"); // TODO: change path
-  while (!logFile.fail() && !logFile.eof() && getline(logFile, line)) {
-    if (std::string::npos != line.find("vscpd:")) {
-      mg_printf(conn, "<tr><td>%s</td></tr>", line.c_str());
-    }
+  buf.append(WEB_MONITOR_BODY_START);
+  if (!pObj->m_monitor.isEnabled()) {
+    buf.append("<b>The event monitor is disabled.</b>");
+  }
+  else {
+    buf.append(WEB_MONITOR_TABLES);
   }
 
-  mg_printf(conn, WEB_LOGLIST_TABLE_END);
-  mg_printf(conn, WEB_COMMON_END, COPYRIGHT_HTML); // Common end code
-
-  return WEB_OK;
+  return websrv_sendPage(conn, buf);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// vscp_client
+// vscp_monitorws_connectHandler
 //
 
 static int
-vscp_client(struct mg_connection* conn, void* cbdata)
+vscp_monitorws_connectHandler(const struct mg_connection* conn, void* cbdata)
 {
-  // char buf[80];
-  std::string str;
+  CWebObj* pObj = (CWebObj*)cbdata;
+  if ((NULL == conn) || (NULL == pObj)) {
+    return 1; // Reject
+  }
 
-  // Check pointer
-  if (NULL == conn) {
-    return WEB_ERROR;
+  // Every event on the bus is shown, so the upgrade is checked against
+  // the admin user here as well as in the auth handler
+  if (200 != websrv_checkAdmin(conn, pObj)) {
+    return 1;
   }
 
+  // Room for one more
+  if (pObj->m_monitor.getViewerCount() >= pObj->m_monitor.getMaxViewers()) {
+    spdlog::get("logger")->warn("Event monitor viewer rejected. Too many viewers.");
+    return 1;
+  }
+
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// vscp_monitorws_readyHandler
+//
+
+static void
+vscp_monitorws_readyHandler(struct mg_connection* conn, void* cbdata)
+{
   CWebObj* pObj = (CWebObj*)cbdata;
-  if (NULL == pObj) {
-    return WEB_ERROR;
+  if ((NULL == conn) || (NULL == pObj)) {
+    return;
   }
 
-  mg_printf(conn,
-            "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nConnection: "
-            "close\r\n\r\n");
+  if (!pObj->m_monitor.addViewer(conn)) {
+    mg_websocket_write(conn, MG_WEBSOCKET_OPCODE_CONNECTION_CLOSE, NULL, 0);
+  }
+}
 
-  mg_printf(conn, WEB_COMMON_HEAD, "VSCP - Session");
-  mg_printf(conn, WEB_STYLE_START);
-  mg_write(conn, WEB_COMMON_CSS, sizeof(WEB_COMMON_CSS)); // CSS style Code
-  mg_printf(conn, WEB_STYLE_END);
-  mg_write(conn,
-           WEB_COMMON_JS,
-           sizeof(WEB_COMMON_JS)); // Common JavaScript code
-  mg_printf(conn, "<meta http-equiv=\"refresh\" content=\"5;url=/vscp");
-  mg_printf(conn, "\">");
-  mg_printf(conn, WEB_COMMON_HEAD_END_BODY_START);
+///////////////////////////////////////////////////////////////////////////////
+// vscp_monitorws_closeHandler
+//
 
-  // navigation menu
-  mg_printf(conn, WEB_COMMON_MENU);
-  mg_printf(conn, "<b>Client functionality is not yet implemented!</b>");
+static void
+vscp_monitorws_closeHandler(const struct mg_connection* conn, void* cbdata)
+{
+  CWebObj* pObj = (CWebObj*)cbdata;
+  if ((NULL == conn) || (NULL == pObj)) {
+    return;
+  }
 
-  return WEB_OK;
+  pObj->m_monitor.removeViewer(conn);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1386,585 +2547,514 @@ vscp_configure_list(struct mg_connection* conn, void* cbdata)
   if (NULL == pObj)
     return WEB_ERROR;
 
-  mg_printf(conn,
-            "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n"
-            "Content-Type: text/html; charset=utf-8\r\n"
-            "Connection: close\r\n\r\n");
-
-  mg_printf(conn, WEB_COMMON_HEAD, "vscpd - Configuration");
-  mg_printf(conn, WEB_STYLE_START);
-  mg_write(conn, WEB_COMMON_CSS, sizeof(WEB_COMMON_CSS)); // CSS style Code
-  mg_printf(conn, WEB_STYLE_END);
-  mg_write(conn,
-           WEB_COMMON_JS,
-           sizeof(WEB_COMMON_JS)); // Common JavaScript code
-  mg_printf(conn, WEB_COMMON_HEAD_END_BODY_START);
-
-  // navigation menu
-  mg_printf(conn, WEB_COMMON_MENU);
+  CWebBuffer buf(32768);
+  websrv_renderPageHead(buf, "vscpd - Configuration");
 
-  mg_printf(conn, "<br><br><br>");
-  mg_printf(conn, "<h1 id=\"header\">VSCP - Current configuration</h1>");
-  mg_printf(conn, "<br>");
+  buf.appendf("<br><br><br>");
+  buf.appendf("<h1 id=\"header\">VSCP - Current configuration</h1>");
+  buf.appendf("<br>");
 
   // * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
 
-  mg_printf(conn, "<h4 id=\"header\" >&nbsp;Server</h4> ");
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>VSCP Server version:</b> ");
-  mg_printf(conn, DISPLAY_VERSION);
-  mg_printf(conn, "<br>");
+  buf.appendf("<h4 id=\"header\" >&nbsp;Server</h4> ");
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>VSCP Server version:</b> ");
+  buf.appendf(DISPLAY_VERSION);
+  buf.appendf("<br>");
 
 #ifdef NDEBUG
-  mg_printf(conn, "Build is release ");
+  buf.appendf("Build is release ");
 #else
-  mg_printf(conn, " - Build is debug ");
+  buf.appendf(" - Build is debug ");
 #endif
 
-  mg_printf(conn, "<br> ");
+  buf.appendf("<br> ");
 
   // * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
 
-  mg_printf(conn,
-            "&nbsp;&nbsp;&nbsp;&nbsp;<b>OpenSSL version:</b> %s <br>",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>OpenSSL version:</b> %s <br>",
             SSLeay_version(SSLEAY_VERSION));
-  mg_printf(conn,
-            "&nbsp;&nbsp;&nbsp;&nbsp;<b>SQLite version:</b> %s <br>",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>SQLite version:</b> %s <br>",
             SQLITE_VERSION);
-  mg_printf(conn,
-            "&nbsp;&nbsp;&nbsp;&nbsp;<b>Duktape version:</b> %s <br>",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Duktape version:</b> %s <br>",
             DUK_GIT_DESCRIBE);
-  mg_printf(conn,
-            "&nbsp;&nbsp;&nbsp;&nbsp;<b>Civetweb version:</b> %s <br>",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Civetweb version:</b> %s <br>",
             CIVETWEB_VERSION);
-  mg_printf(conn,
-            "&nbsp;&nbsp;&nbsp;&nbsp;<b>Lua version:</b> %s <br>",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Lua version:</b> %s <br>",
             LUA_COPYRIGHT);
-  mg_printf(
-    conn,
+  buf.appendf(
     "&nbsp;&nbsp;&nbsp;&nbsp;<b>nlohmann-json version:</b> %d.%d.%d <br>",
     NLOHMANN_JSON_VERSION_MAJOR,
     NLOHMANN_JSON_VERSION_MINOR,
     NLOHMANN_JSON_VERSION_PATCH);
 
-  mg_printf(conn, "<hr>");
+  buf.appendf("<hr>");
 
   // * * * * * * * * * * * * * * * * * * * * * * * * * * * ** * * * * *
 
-  mg_printf(conn, "<h4 id=\"header\" >&nbsp;Web server</h4> ");
+  buf.appendf("<h4 id=\"header\" >&nbsp;Web server</h4> ");
 
-  mg_printf(conn,
-            "&nbsp;&nbsp;&nbsp;&nbsp;<b>Web server functionality </b>is ");
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Web server functionality </b>is ");
   if (pObj->m_bEnableWebServer) {
-    mg_printf(conn, "enabled.<br>");
+    buf.appendf("enabled.<br>");
   }
   else {
-    mg_printf(conn, "disabled.<br>");
+    buf.appendf("disabled.<br>");
   }
 
-  mg_printf(conn,
-            "&nbsp;&nbsp;&nbsp;&nbsp;<b>Listening port(s)/interface(s):</b>");
-  mg_printf(conn, "%s", (const char*)pObj->m_web_listening_ports.c_str());
-  mg_printf(conn, "<br>");
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Listening port(s)/interface(s):</b>");
+  buf.appendf("%s", (const char*)pObj->m_web_listening_ports.c_str());
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Rootfolder:</b> ");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Rootfolder:</b> ");
+  buf.appendf("%s",
             (const char*)std::string(pObj->m_web_document_root).c_str());
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Authdomain:</b> ");
-  mg_printf(
-    conn,
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Authdomain:</b> ");
+  buf.appendf(
     "%s",
     (const char*)std::string(pObj->m_web_authentication_domain).c_str());
   if (pObj->m_enable_auth_domain_check) {
-    mg_printf(conn, " [will be checked].");
+    buf.appendf(" [will be checked].");
   }
   else {
-    mg_printf(conn, " [will not be checked].");
+    buf.appendf(" [will not be checked].");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Index files:</b> ");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Index files:</b> ");
+  buf.appendf("%s",
             (const char*)std::string(pObj->m_web_index_files).c_str());
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>SSL certificat:</b> ");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>SSL certificat:</b> ");
+  buf.appendf("%s",
             (const char*)std::string(pObj->m_web_ssl_certificate).c_str());
   if (!pObj->m_web_ssl_certificate.length()) {
-    mg_printf(conn, "%s", "Not defined (probably should be).");
+    buf.appendf("%s", "Not defined (probably should be).");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>SSL certificat chain:</b>");
-  mg_printf(
-    conn,
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>SSL certificat chain:</b>");
+  buf.appendf(
     "%s",
     (const char*)std::string(pObj->m_web_ssl_certificate_chain).c_str());
   if (!pObj->m_web_ssl_certificate_chain.length()) {
-    mg_printf(conn, "%s", "Not defined (default).");
+    buf.appendf("%s", "Not defined (default).");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>SSL verify peer:</b> ");
-  mg_printf(conn, "%s", pObj->m_web_ssl_verify_peer ? "true" : "false");
-  mg_printf(conn, "<br>");
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>SSL verify peer:</b> ");
+  buf.appendf("%s", pObj->m_web_ssl_verify_peer ? "true" : "false");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>SSL CA path:</b> ");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>SSL CA path:</b> ");
+  buf.appendf("%s",
             (const char*)std::string(pObj->m_web_ssl_ca_path).c_str());
   if (!pObj->m_web_ssl_ca_path.length()) {
-    mg_printf(conn, "%s", "Not defined (default).");
+    buf.appendf("%s", "Not defined (default).");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>SSL CA file:</b> ");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>SSL CA file:</b> ");
+  buf.appendf("%s",
             (const char*)std::string(pObj->m_web_ssl_ca_file).c_str());
   if (!pObj->m_web_ssl_ca_file.length()) {
-    mg_printf(conn, "%s", "Not defined (default).");
+    buf.appendf("%s", "Not defined (default).");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>SSL verify depth:</b> ");
-  mg_printf(conn, "%d", (int)pObj->m_web_ssl_verify_depth);
-  mg_printf(conn, "<br>");
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>SSL verify depth:</b> ");
+  buf.appendf("%d", (int)pObj->m_web_ssl_verify_depth);
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>SSL verify paths:</b> ");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>SSL verify paths:</b> ");
+  buf.appendf("%s",
             pObj->m_web_ssl_default_verify_paths ? "true" : "false");
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>SSL cipher list:</b> ");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>SSL cipher list:</b> ");
+  buf.appendf("%s",
             (const char*)std::string(pObj->m_web_ssl_cipher_list).c_str());
   if (!pObj->m_web_ssl_cipher_list.length()) {
-    mg_printf(conn, "%s", "Not defined (default).");
+    buf.appendf("%s", "Not defined (default).");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>SSL protocol version:</b>");
-  mg_printf(conn, "%d", (int)pObj->m_web_ssl_protocol_version);
-  mg_printf(conn, "<br>");
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>SSL protocol version:</b>");
+  buf.appendf("%d", (int)pObj->m_web_ssl_protocol_version);
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>SSL short trust:</b> ");
-  mg_printf(conn, "%s", pObj->m_web_ssl_short_trust ? "true" : "false");
-  mg_printf(conn, "<br>");
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>SSL short trust:</b> ");
+  buf.appendf("%s", pObj->m_web_ssl_short_trust ? "true" : "false");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>CGI interpreter:</b> ");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>CGI interpreter:</b> ");
+  buf.appendf("%s",
             (const char*)std::string(pObj->m_web_cgi_interpreter).c_str());
   if (!pObj->m_web_cgi_interpreter.length()) {
-    mg_printf(conn, "%s", "Not defined (default).");
+    buf.appendf("%s", "Not defined (default).");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>CGI patterns:</b> ");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>CGI patterns:</b> ");
+  buf.appendf("%s",
             (const char*)std::string(pObj->m_web_cgi_patterns).c_str());
   if (!pObj->m_web_cgi_patterns.length()) {
-    mg_printf(conn, "%s", "Not defined (probably should be defined).");
+    buf.appendf("%s", "Not defined (probably should be defined).");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>CGI environment:</b> ");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>CGI environment:</b> ");
+  buf.appendf("%s",
             (const char*)std::string(pObj->m_web_cgi_environment).c_str());
   if (!pObj->m_web_cgi_environment.length()) {
-    mg_printf(conn, "%s", "Not defined (default).");
+    buf.appendf("%s", "Not defined (default).");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Protect URI:</b> ");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Protect URI:</b> ");
+  buf.appendf("%s",
             (const char*)std::string(pObj->m_web_protect_uri).c_str());
   if (!pObj->m_web_protect_uri.length()) {
-    mg_printf(conn, "%s", "Not defined (default).");
+    buf.appendf("%s", "Not defined (default).");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Trottle:</b> ");
-  mg_printf(conn, "%s", (const char*)std::string(pObj->m_web_throttle).c_str());
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Trottle:</b> ");
+  buf.appendf("%s", (const char*)std::string(pObj->m_web_throttle).c_str());
   if (!pObj->m_web_throttle.length()) {
-    mg_printf(conn, "%s", "Not defined (default).");
+    buf.appendf("%s", "Not defined (default).");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Enable directory listings:</b>");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Enable directory listings:</b>");
+  buf.appendf("%s",
             pObj->m_web_enable_directory_listing ? "true" : "false");
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Enable keep alive:</b>");
-  mg_printf(conn, "%s", pObj->m_web_enable_keep_alive ? "true" : "false");
-  mg_printf(conn, "<br>");
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Enable keep alive:</b>");
+  buf.appendf("%s", pObj->m_web_enable_keep_alive ? "true" : "false");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Keep alive timeout in ms:</b>");
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Keep alive timeout in ms:</b>");
   if (-1 == pObj->m_web_keep_alive_timeout_ms) {
-    mg_printf(conn, "%ld", (long)pObj->m_web_keep_alive_timeout_ms);
+    buf.appendf("%ld", (long)pObj->m_web_keep_alive_timeout_ms);
   }
   else {
-    mg_printf(conn, "%s", "Not defined (Default: 500) ).");
+    buf.appendf("%s", "Not defined (Default: 500) ).");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Access control list (ACL):</b>");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Access control list (ACL):</b>");
+  buf.appendf("%s",
             (const char*)std::string(pObj->m_web_access_control_list).c_str());
   if (!pObj->m_web_access_control_list.length()) {
-    mg_printf(conn, "%s", "Not defined (default).");
+    buf.appendf("%s", "Not defined (default).");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>ExtraMimeTypes:</b> ");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>ExtraMimeTypes:</b> ");
+  buf.appendf("%s",
             (const char*)std::string(pObj->m_web_extra_mime_types).c_str());
   if (0 == pObj->m_web_extra_mime_types.length()) {
-    mg_printf(conn, "Set to default.");
+    buf.appendf("Set to default.");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Number of threads:</b>");
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Number of threads:</b>");
   if (-1 == pObj->m_web_num_threads) {
-    mg_printf(conn, "%d", (int)pObj->m_web_num_threads);
+    buf.appendf("%d", (int)pObj->m_web_num_threads);
   }
   else {
-    mg_printf(conn, "%s", "Not defined (Default: 50) ).");
+    buf.appendf("%s", "Not defined (Default: 50) ).");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>HiddenFilePatterns:</b>");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>HiddenFilePatterns:</b>");
+  buf.appendf("%s",
             (const char*)std::string(pObj->m_web_hide_file_patterns).c_str());
   if (0 == pObj->m_web_hide_file_patterns.length()) {
-    mg_printf(conn, "Set to default.");
+    buf.appendf("Set to default.");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>URL Rewrites:</b> ");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>URL Rewrites:</b> ");
+  buf.appendf("%s",
             (const char*)std::string(pObj->m_web_url_rewrite_patterns).c_str());
   if (0 == pObj->m_web_url_rewrite_patterns.length()) {
-    mg_printf(conn, "Set to default.");
+    buf.appendf("Set to default.");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Hide file patterns:</b>");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Hide file patterns:</b>");
+  buf.appendf("%s",
             (const char*)std::string(pObj->m_web_hide_file_patterns).c_str());
   if (0 == pObj->m_web_hide_file_patterns.length()) {
-    mg_printf(conn, "Set to default.");
+    buf.appendf("Set to default.");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Request timeout:</b> ");
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Request timeout:</b> ");
   if (-1 == pObj->m_web_request_timeout_ms) {
-    mg_printf(conn, "%ld", (long)pObj->m_web_request_timeout_ms);
+    buf.appendf("%ld", (long)pObj->m_web_request_timeout_ms);
   }
   else {
-    mg_printf(conn, "%s", "Not defined (Default: 30000) ).");
+    buf.appendf("%s", "Not defined (Default: 30000) ).");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Linger timeout:</b> ");
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Linger timeout:</b> ");
   if (-1 == pObj->m_web_linger_timeout_ms) {
-    mg_printf(conn, "%ld", (long)pObj->m_web_linger_timeout_ms);
+    buf.appendf("%ld", (long)pObj->m_web_linger_timeout_ms);
   }
   else {
-    mg_printf(conn, "%s", "Not set.");
+    buf.appendf("%s", "Not set.");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Enable decode URL:</b>");
-  mg_printf(conn, " %s ", pObj->m_web_decode_url ? " true " : "false");
-  mg_printf(conn, "<br>");
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Enable decode URL:</b>");
+  buf.appendf(" %s ", pObj->m_web_decode_url ? " true " : "false");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Path to global auth file:</b>");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Path to global auth file:</b>");
+  buf.appendf("%s",
             (const char*)std::string(pObj->m_web_global_auth_file).c_str());
   if (0 == pObj->m_web_global_auth_file.length()) {
-    mg_printf(conn, "Set to default.");
+    buf.appendf("Set to default.");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Put delete auth file:</b>");
-  mg_printf(
-    conn,
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Put delete auth file:</b>");
+  buf.appendf(
     "%s",
     (const char*)std::string(pObj->m_web_put_delete_auth_file).c_str());
   if (0 == pObj->m_web_put_delete_auth_file.length()) {
-    mg_printf(conn, "Set to default.");
+    buf.appendf("Set to default.");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>SSI patterns:</b> ");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>SSI patterns:</b> ");
+  buf.appendf("%s",
             (const char*)std::string(pObj->m_web_ssi_patterns).c_str());
   if (0 == pObj->m_web_ssi_patterns.length()) {
-    mg_printf(conn, "Set to default.");
+    buf.appendf("Set to default.");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn,
-            "&nbsp;&nbsp;&nbsp;&nbsp;<b>Access control allow origin:</b>");
-  mg_printf(
-    conn,
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Access control allow origin:</b>");
+  buf.appendf(
     "%s",
     (const char*)std::string(pObj->m_web_access_control_allow_origin).c_str());
   if (0 == pObj->m_web_access_control_allow_origin.length()) {
-    mg_printf(conn, "Set to default.");
+    buf.appendf("Set to default.");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn,
-            "&nbsp;&nbsp;&nbsp;&nbsp;<b>Access control allow methods:</b>");
-  mg_printf(
-    conn,
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Access control allow methods:</b>");
+  buf.appendf(
     "%s",
     (const char*)std::string(pObj->m_web_access_control_allow_methods).c_str());
   if (0 == pObj->m_web_access_control_allow_methods.length()) {
-    mg_printf(conn, "Set to default.");
+    buf.appendf("Set to default.");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn,
-            "&nbsp;&nbsp;&nbsp;&nbsp;<b>Access control allowheaders:</b>");
-  mg_printf(
-    conn,
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Access control allowheaders:</b>");
+  buf.appendf(
     "%s",
     (const char*)std::string(pObj->m_web_access_control_allow_headers).c_str());
   if (0 == pObj->m_web_access_control_allow_headers.length()) {
-    mg_printf(conn, "Set to default.");
+    buf.appendf("Set to default.");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Path to error pages:</b>");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Path to error pages:</b>");
+  buf.appendf("%s",
             (const char*)std::string(pObj->m_web_error_pages).c_str());
   if (0 == pObj->m_web_error_pages.length()) {
-    mg_printf(conn, "Set to default.");
+    buf.appendf("Set to default.");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn,
-            "&nbsp;&nbsp;&nbsp;&nbsp;<b>Enable TCP_NODELAY socket option:</b>");
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Enable TCP_NODELAY socket option:</b>");
   if (-1 == pObj->m_web_tcp_nodelay) {
-    mg_printf(conn, "%ld", (long)pObj->m_web_tcp_nodelay);
+    buf.appendf("%ld", (long)pObj->m_web_tcp_nodelay);
   }
   else {
-    mg_printf(conn, "%s", "Not set.");
+    buf.appendf("%s", "Not set.");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn,
-            "&nbsp;&nbsp;&nbsp;&nbsp;<b>Static file max age(seconds):</b>");
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Static file max age(seconds):</b>");
   if (-1 == pObj->m_web_static_file_max_age) {
-    mg_printf(conn, "%ld", (long)pObj->m_web_static_file_max_age);
+    buf.appendf("%ld", (long)pObj->m_web_static_file_max_age);
   }
   else {
-    mg_printf(conn, "%s", "Not set.");
+    buf.appendf("%s", "Not set.");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn,
-            "&nbsp;&nbsp;&nbsp;&nbsp;<b>Strict transport security max age"
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Strict transport security max age"
             "(seconds):</b> ");
   if (-1 == pObj->m_web_strict_transport_security_max_age) {
-    mg_printf(conn, "%ld", (long)pObj->m_web_strict_transport_security_max_age);
+    buf.appendf("%ld", (long)pObj->m_web_strict_transport_security_max_age);
   }
   else {
-    mg_printf(conn, "%s", "Not set.");
+    buf.appendf("%s", "Not set.");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Allow sendfile call:</b>");
-  mg_printf(conn, "%s", pObj->m_web_allow_sendfile_call ? "true" : "false");
-  mg_printf(conn, "<br>");
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Allow sendfile call:</b>");
+  buf.appendf("%s", pObj->m_web_allow_sendfile_call ? "true" : "false");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Additional headers:</b>");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Additional headers:</b>");
+  buf.appendf("%s",
             (const char*)std::string(pObj->m_web_additional_header).c_str());
   if (0 == pObj->m_web_additional_header.length()) {
-    mg_printf(conn, "Set to default.");
+    buf.appendf("Set to default.");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Max request size:</b> ");
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Max request size:</b> ");
   if (-1 == pObj->m_web_max_request_size) {
-    mg_printf(conn, "%ld", (long)pObj->m_web_max_request_size);
+    buf.appendf("%ld", (long)pObj->m_web_max_request_size);
   }
   else {
-    mg_printf(conn, "%s", "Not set.");
+    buf.appendf("%s", "Not set.");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn,
-            "&nbsp;&nbsp;&nbsp;&nbsp;<b>Allow index script resource:</b>");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Allow index script resource:</b>");
+  buf.appendf("%s",
             pObj->m_web_allow_index_script_resource ? "true" : "false");
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Duktape script patters:</b>");
-  mg_printf(
-    conn,
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Duktape script patters:</b>");
+  buf.appendf(
     "%s",
     (const char*)std::string(pObj->m_web_duktape_script_patterns).c_str());
   if (0 == pObj->m_web_duktape_script_patterns.length()) {
-    mg_printf(conn, "Not set.");
+    buf.appendf("Not set.");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Lua preload file:</b> ");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Lua preload file:</b> ");
+  buf.appendf("%s",
             (const char*)std::string(pObj->m_web_lua_preload_file).c_str());
   if (0 == pObj->m_web_lua_preload_file.length()) {
-    mg_printf(conn, "Not set.");
+    buf.appendf("Not set.");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Lua script patterns:</b>");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Lua script patterns:</b>");
+  buf.appendf("%s",
             (const char*)std::string(pObj->m_web_lua_script_patterns).c_str());
   if (0 == pObj->m_web_lua_script_patterns.length()) {
-    mg_printf(conn, "Not set.");
+    buf.appendf("Not set.");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Lua server page patterns:</b>");
-  mg_printf(
-    conn,
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Lua server page patterns:</b>");
+  buf.appendf(
     "%s",
     (const char*)std::string(pObj->m_web_lua_server_page_patterns).c_str());
   if (0 == pObj->m_web_lua_server_page_patterns.length()) {
-    mg_printf(conn, "Not set.");
+    buf.appendf("Not set.");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Lua websocketpatterns:</b>");
-  mg_printf(
-    conn,
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Lua websocketpatterns:</b>");
+  buf.appendf(
     "%s",
     (const char*)std::string(pObj->m_web_lua_websocket_patterns).c_str());
   if (0 == pObj->m_web_lua_websocket_patterns.length()) {
-    mg_printf(conn, "Not set.");
+    buf.appendf("Not set.");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Lua background script:</b>");
-  mg_printf(
-    conn,
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Lua background script:</b>");
+  buf.appendf(
     "%s",
     (const char*)std::string(pObj->m_web_lua_background_script).c_str());
   if (0 == pObj->m_web_lua_background_script.length()) {
-    mg_printf(conn, "Not set.");
+    buf.appendf("Not set.");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn,
-            "&nbsp;&nbsp;&nbsp;&nbsp;<b>Lua background script parameters:</b>");
-  mg_printf(
-    conn,
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Lua background script parameters:</b>");
+  buf.appendf(
     "%s",
     (const char*)std::string(pObj->m_web_lua_background_script_params).c_str());
   if (0 == pObj->m_web_lua_background_script_params.length()) {
-    mg_printf(conn, "Not set.");
+    buf.appendf("Not set.");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "<hr>");
+  buf.appendf("<hr>");
 
   // * * * * * * * * * * * * * * * * * * * * * * * * * * * ** * * * * *
 
-  mg_printf(conn, "<h4 id=\"header\" >&nbsp;Websockets</h4> ");
+  buf.appendf("<h4 id=\"header\" >&nbsp;Websockets</h4> ");
 
-  mg_printf(conn,
-            "&nbsp;&nbsp;&nbsp;&nbsp;<b>Web sockets functionality </b> is ");
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Web sockets functionality </b> is ");
   if (pObj->m_bEnableWebServer && pObj->m_bEnableWebsockets) {
-    mg_printf(conn, "enabled.<br>");
+    buf.appendf("enabled.<br>");
   }
   else {
-    mg_printf(conn, "disabled.<br>");
+    buf.appendf("disabled.<br>");
   }
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Websocket document root:</b>");
-  mg_printf(conn,
-            "%s",
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Websocket document root:</b>");
+  buf.appendf("%s",
             (const char*)std::string(pObj->m_websocket_document_root).c_str());
   if (0 == pObj->m_websocket_document_root.length()) {
-    mg_printf(conn, "Not set == Same as web root folder");
+    buf.appendf("Not set == Same as web root folder");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Websocket timeout (ms):</b>");
-  mg_printf(conn, "%ld", pObj->m_websocket_timeout_ms);
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Websocket timeout (ms):</b>");
+  buf.appendf("%ld", pObj->m_websocket_timeout_ms);
   if (0 == pObj->m_websocket_timeout_ms) {
-    mg_printf(conn, "Set to default: 30000");
+    buf.appendf("Set to default: 30000");
   }
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn,
-            "&nbsp;&nbsp;&nbsp;&nbsp;<b>Web sockets ping-pong functionality "
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Web sockets ping-pong functionality "
             "</b> is ");
   if (pObj->m_bEnableWebServer && pObj->bEnable_websocket_ping_pong) {
-    mg_printf(conn, "enabled.<br>");
+    buf.appendf("enabled.<br>");
   }
   else {
-    mg_printf(conn, "disabled.<br>");
+    buf.appendf("disabled.<br>");
   }
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>Websocket lua pattern:</b>");
-  mg_printf(
-    conn,
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>Websocket lua pattern:</b>");
+  buf.appendf(
     "%s",
     (const char*)std::string(pObj->m_web_lua_websocket_patterns).c_str());
-  mg_printf(conn, "<br>");
+  buf.appendf("<br>");
 
-  mg_printf(conn, "<hr>");
+  buf.appendf("<hr>");
 
   // * * * * * * * * * * * * * * * * * * * * * * * * * * * ** * * * * *
 
-  mg_printf(conn, "<h4 id=\"header\" >&nbsp;REST API</h4> ");
+  buf.appendf("<h4 id=\"header\" >&nbsp;REST API</h4> ");
 
-  mg_printf(conn, "&nbsp;&nbsp;&nbsp;&nbsp;<b>REST API functionality </b> is ");
+  buf.appendf("&nbsp;&nbsp;&nbsp;&nbsp;<b>REST API functionality </b> is ");
   if (pObj->m_bEnableWebServer && pObj->m_bEnableRestApi) {
-    mg_printf(conn, "enabled.<br>");
+    buf.appendf("enabled.<br>");
   }
   else {
-    mg_printf(conn, "disabled.<br>");
+    buf.appendf("disabled.<br>");
   }
 
-  mg_printf(conn, "<br>");
-  mg_printf(conn, "<hr>");
-
-  mg_printf(conn, "<br>");
-  mg_printf(conn, WEB_COMMON_END, COPYRIGHT_HTML); // Common end code
+  buf.appendf("<br>");
+  buf.appendf("<hr>");
 
-  return WEB_OK;
+  buf.appendf("<br>");
+  return websrv_sendPage(conn, buf);
 }
 
 #ifdef WEB_EXAMPLES
@@ -3478,7 +4568,11 @@ start_webserver(void* cbdata)
                                pObj->m_web_duktape_script_patterns);   
   }
 
-  if (pObj->m_web_lua_preload_file.length()) {
+  // The preload file is compiled once and run from init_lua. Civetweb
+  // only gets it if it can't be compiled, so the error is reported
+  // for each page as before.
+  if (pObj->m_web_lua_preload_file.length() &&
+      !lua_vscp_compilePreload(pObj->m_web_lua_preload_file)) {
     web_options[pos++] =
       vscp_strdup(VSCPDB_CONFIG_NAME_WEB_LUA_PRELOAD_FILE + 4);
     web_options[pos++] =
@@ -3586,6 +4680,8 @@ start_webserver(void* cbdata)
   callbacks.init_ssl    = init_ssl;
   callbacks.log_message = log_message;
   callbacks.log_access  = log_access;
+  callbacks.init_thread = init_thread;
+  callbacks.init_lua    = init_lua;
 
   // Start server
   pObj->m_web_ctx = mg_start(&callbacks, cbdata, (const char**)web_options);
@@ -3716,6 +4812,87 @@ start_webserver(void* cbdata)
                            cbdata);
   }
 
+  // Static assets for the admin pages
+  pthread_once(&websrv_assets_once, websrv_initAssets);
+  mg_set_request_handler(pObj->m_web_ctx,
+                         WEB_ASSET_URI_PREFIX,
+                         websrv_assetHandler,
+                         cbdata);
+
+  // Interface list, admin only as it shows the GUID and name of every
+  // client
+  mg_set_auth_handler(pObj->m_web_ctx,
+                      WEB_IFLIST_URI,
+                      check_admin_authorization,
+                      cbdata);
+  mg_set_request_handler(pObj->m_web_ctx,
+                         WEB_IFLIST_URI,
+                         vscp_interface,
+                         cbdata);
+
+  // Memory use, admin only
+  mg_set_auth_handler(pObj->m_web_ctx,
+                      WEB_MEMORY_URI,
+                      check_admin_authorization,
+                      cbdata);
+  mg_set_request_handler(pObj->m_web_ctx,
+                         WEB_MEMORY_URI,
+                         vscp_memory,
+                         cbdata);
+
+  // Metrics
+  if (pObj->m_bEnableMetrics) {
+    mg_set_request_handler(pObj->m_web_ctx,
+                           WEB_METRICS_URI,
+                           websrv_metricsHandler,
+                           cbdata);
+    // The log can hold credentials and addresses, admin only
+    mg_set_auth_handler(pObj->m_web_ctx,
+                        WEB_LOG_URI,
+                        check_admin_authorization,
+                        cbdata);
+    mg_set_request_handler(pObj->m_web_ctx,
+                           WEB_LOG_URI,
+                           vscp_log,
+                           cbdata);
+    mg_set_auth_handler(pObj->m_web_ctx,
+                        WEB_MONITOR_URI,
+                        check_admin_authorization,
+                        cbdata);
+    mg_set_request_handler(pObj->m_web_ctx,
+                           WEB_MONITOR_URI,
+                           vscp_client,
+                           cbdata);
+  }
+
+  // Live tail of the log file
+  if (pObj->m_bEnableMetrics && pObj->m_bEnableWebsockets) {
+    mg_set_auth_handler(pObj->m_web_ctx,
+                        WEB_LOG_WS_URI,
+                        check_admin_authorization,
+                        cbdata);
+    mg_set_websocket_handler(pObj->m_web_ctx,
+                             WEB_LOG_WS_URI,
+                             vscp_logws_connectHandler,
+                             vscp_logws_readyHandler,
+                             vscp_feedws_dataHandler,
+                             vscp_logws_closeHandler,
+                             cbdata);
+
+    // Live event monitor
+    mg_set_auth_handler(pObj->m_web_ctx,
+                        WEB_MONITOR_WS_URI,
+                        check_admin_authorization,
+                        cbdata);
+    mg_set_websocket_handler(pObj->m_web_ctx,
+                             WEB_MONITOR_WS_URI,
+                             vscp_monitorws_connectHandler,
+                             vscp_monitorws_readyHandler,
+                             vscp_feedws_dataHandler,
+                             vscp_monitorws_closeHandler,
+                             cbdata);
+  }
+
   return 1;
 }
 
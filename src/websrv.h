@@ -31,6 +31,7 @@
 
 #include <clientlist.h>
 #include <userlist.h>
+#include <webbuf.h>
 //#include <websocket.h>
 
 #include <map>
@@ -39,6 +40,30 @@
 #define WEB_ERROR 0 // Page was not served
 #define WEB_OK    1 // Page served 1-999
 
+// Embedded static assets
+#define WEB_ASSET_URI_PREFIX     "/vscp/assets/"
+#define WEB_ASSET_URI_COMMON_CSS WEB_ASSET_URI_PREFIX "common.css"
+#define WEB_ASSET_URI_COMMON_JS  WEB_ASSET_URI_PREFIX "common.js"
+
+// Max age for assets served from their versioned URI (one year)
+#define WEB_ASSET_IMMUTABLE_MAX_AGE 31536000
+
+// Admin page with memory use of queues and sessions
+#define WEB_MEMORY_URI "/vscp/memory"
+
+// Admin page with the interface list and its page sizes
+#define WEB_IFLIST_URI           "/vscp/interfaces"
+#define WEB_IFLIST_PAGE_SIZE     100
+#define WEB_IFLIST_MAX_PAGE_SIZE 1000
+
+// Admin page with the log file and the websocket for its live tail
+#define WEB_LOG_URI    "/vscp/log"
+#define WEB_LOG_WS_URI "/vscp/log-live"
+
+// Admin page with the live event monitor and its websocket
+#define WEB_MONITOR_URI    "/vscp/monitor"
+#define WEB_MONITOR_WS_URI "/vscp/monitor-live"
+
 /*!
  * Init the webserver sub system
  */
@@ -68,6 +93,58 @@ websrv_sendSetCookieHeader(struct mg_connection* conn,
                            const char* pcontent,
                            const char* psid);
 
+/*!
+ * Send header with Content-Length followed by the buffer content.
+ * If psid is non NULL the 'sessionid' cookie is set.
+ */
+void
+websrv_sendBuffer(struct mg_connection* conn,
+                  int returncode,
+                  const char* pcontent,
+                  const CWebBuffer& buf,
+                  const char* psid = NULL);
+
+/*!
+ * Send header for a chunked response. Body is sent with
+ * mg_send_chunk and terminated with a zero length chunk.
+ * encoding is one of WEB_ENCODING_xxx (webcompress.h)
+ */
+void
+websrv_sendChunkedHeader(struct mg_connection* conn,
+                         int returncode,
+                         const char* pcontent,
+                         int encoding = 0);
+
+/*!
+ * Get content encoding to use for a response of size bytes.
+ * Depends on compression settings and the Accept-Encoding
+ * header of the request.
+ * @return WEB_ENCODING_xxx (webcompress.h)
+ */
+int
+websrv_getContentEncoding(struct mg_connection* conn, size_t size);
+
+/*!
+ * Stream a file as a chunked response, compressed if the
+ * client accepts it.
+ * @return false if the file could not be opened. Nothing has
+ *         been sent in that case. If compression fails after the
+ *         header has been sent the connection is closed and true
+ *         is returned as nothing more can be sent.
+ */
+bool
+websrv_sendFile(struct mg_connection* conn,
+                int returncode,
+                const char* pcontent,
+                const std::string& path);
+
+/*!
+ * Remove web sessions that have been idle for more than an hour.
+ * conn is not used and can be NULL. cbdata is the CWebObj.
+ */
+void
+websrv_expire_sessions(struct mg_connection* conn, void* cbdata);
+
 ////////////////////////////////////////////////////////////////////////////////
 //                           ws1  Websocket handlers
 ////////////////////////////////////////////////////////////////////////////////
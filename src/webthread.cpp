@@ -0,0 +1,183 @@
+// webthread.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "webthread.h"
+
+#include <spdlog/spdlog.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// CWebThreadSettings
+//
+
+CWebThreadSettings::CWebThreadSettings(void)
+{
+  CPU_ZERO(&m_cpuset);
+  m_bAffinity = false;
+  m_policy    = SCHED_OTHER;
+  m_bSched    = false;
+  m_priority  = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setCpus
+//
+
+bool
+CWebThreadSettings::setCpus(const std::string &cpus)
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+
+  const char *p = cpus.c_str();
+  while (*p) {
+
+    while (' ' == *p || ',' == *p) {
+      p++;
+    }
+
+    if (!*p) {
+      break;
+    }
+
+    char *pend;
+    long first = strtol(p, &pend, 10);
+    if ((pend == p) || (first < 0) || (first >= CPU_SETSIZE)) {
+      return false;
+    }
+
+    long last = first;
+    p         = pend;
+    if ('-' == *p) {
+      p++;
+      last = strtol(p, &pend, 10);
+      if ((pend == p) || (last < first) || (last >= CPU_SETSIZE)) {
+        return false;
+      }
+      p = pend;
+    }
+
+    for (long cpu = first; cpu <= last; cpu++) {
+      CPU_SET(cpu, &set);
+    }
+
+    while (' ' == *p) {
+      p++;
+    }
+
+    if (*p && (',' != *p)) {
+      return false;
+    }
+  }
+
+  m_cpuset    = set;
+  m_bAffinity = (CPU_COUNT(&set) > 0);
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setPolicy
+//
+
+bool
+CWebThreadSettings::setPolicy(const std::string &policy)
+{
+  if (policy.empty() || ("other" == policy)) {
+    m_policy = SCHED_OTHER;
+  }
+  else if ("batch" == policy) {
+    m_policy = SCHED_BATCH;
+  }
+  else if ("idle" == policy) {
+    m_policy = SCHED_IDLE;
+  }
+  else if ("fifo" == policy) {
+    m_policy = SCHED_FIFO;
+  }
+  else if ("rr" == policy) {
+    m_policy = SCHED_RR;
+  }
+  else {
+    return false;
+  }
+
+  m_bSched = !policy.empty();
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setName
+//
+
+void
+CWebThreadSettings::setName(const char *name)
+{
+  char buf[16]; // Linux limit including terminating null
+
+  if (NULL == name) {
+    return;
+  }
+
+  strncpy(buf, name, sizeof(buf) - 1);
+  buf[sizeof(buf) - 1] = '\0';
+  pthread_setname_np(pthread_self(), buf);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// apply
+//
+
+void
+CWebThreadSettings::apply(const char *name) const
+{
+  int rv;
+
+  setName(name);
+
+  if (m_bAffinity) {
+    if ((0 != (rv = pthread_setaffinity_np(pthread_self(), sizeof(m_cpuset), &m_cpuset))) && m_logger) {
+      m_logger->warn("Failed to set CPU affinity for thread {}: {}", name, strerror(rv));
+    }
+  }
+
+  if (m_bSched) {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    if ((SCHED_FIFO == m_policy) || (SCHED_RR == m_policy)) {
+      param.sched_priority = m_priority;
+    }
+    if ((0 != (rv = pthread_setschedparam(pthread_self(), m_policy, &param))) && m_logger) {
+      m_logger->warn("Failed to set scheduling for thread {}: {}", name, strerror(rv));
+    }
+  }
+}
@@ -0,0 +1,112 @@
+// webthread.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(WEBTHREAD_H__INCLUDED_)
+#define WEBTHREAD_H__INCLUDED_
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <memory>
+#include <string>
+
+namespace spdlog {
+class logger;
+}
+
+/*!
+  CPU affinity and scheduling for a group of threads.
+
+  Settings are applied by each thread to itself when it starts. With
+  nothing set the thread is left as it is, floating over all CPUs with
+  the default scheduler.
+*/
+
+class CWebThreadSettings {
+
+public:
+  CWebThreadSettings(void);
+
+  /*!
+    Set CPUs the threads may run on
+    @param cpus Comma separated list of CPU numbers and ranges,
+                for example "2,3" or "0-1,4". Empty for all CPUs.
+    @return true on success, false if the list is invalid.
+  */
+  bool setCpus(const std::string &cpus);
+
+  /*!
+    Set scheduling policy
+    @param policy "other", "batch", "idle", "fifo" or "rr"
+    @return true on success, false for an unknown policy.
+  */
+  bool setPolicy(const std::string &policy);
+
+  /*!
+    Set scheduling priority. Used for "fifo" and "rr" (1-99).
+  */
+  void setPriority(int priority) { m_priority = priority; };
+
+  /*!
+    Name the calling thread and apply affinity and scheduling to it.
+    Failures are logged, the thread keeps running with what it has.
+    @param name Thread name. Truncated to 15 characters.
+  */
+  void apply(const char *name) const;
+
+  /*!
+    Name the calling thread without changing anything else
+  */
+  static void setName(const char *name);
+
+  /*!
+    Set logger for apply failures
+  */
+  void setLogger(std::shared_ptr<spdlog::logger> logger) { m_logger = logger; };
+
+private:
+  /// CPUs to run on
+  cpu_set_t m_cpuset;
+
+  /// True if m_cpuset should be applied
+  bool m_bAffinity;
+
+  /// Scheduling policy (SCHED_xxx)
+  int m_policy;
+
+  /// True if policy/priority should be applied
+  bool m_bSched;
+
+  /// Scheduling priority
+  int m_priority;
+
+  /// Driver logger, NULL until the configuration is loaded
+  std::shared_ptr<spdlog::logger> m_logger;
+};
+
+#endif
@@ -0,0 +1,318 @@
+// webtrace.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <stdio.h>
+
+#include "webtrace.h"
+
+// Time as nanoseconds
+#define WEB_TRACE_NS(ts) ((int64_t)(ts).tv_sec * 1000000000 + (ts).tv_nsec)
+
+///////////////////////////////////////////////////////////////////////////////
+// CWebTrace
+//
+
+CWebTrace::CWebTrace(void)
+{
+  m_bEnable    = false;
+  m_sampleRate = WEB_TRACE_DEFAULT_SAMPLE_RATE;
+  m_cntSample.store(0);
+  m_postTime.store(0);
+  m_cntInflight.store(0);
+
+  pthread_mutex_init(&m_mutex, NULL);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ~CWebTrace
+//
+
+CWebTrace::~CWebTrace()
+{
+  pthread_mutex_destroy(&m_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// setParameters
+//
+
+void
+CWebTrace::setParameters(bool bEnable, uint32_t sampleRate)
+{
+  m_bEnable    = bEnable;
+  m_sampleRate = sampleRate ? sampleRate : 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sample
+//
+
+bool
+CWebTrace::sample(void)
+{
+  if (!m_bEnable) {
+    return false;
+  }
+
+  return (0 == (m_cntSample.fetch_add(1, std::memory_order_relaxed) % m_sampleRate));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getFingerprint
+//
+// FNV-1a over the fields that are kept when an event is copied to a
+// client queue.
+//
+
+uint64_t
+CWebTrace::getFingerprint(const vscpEvent *pEvent)
+{
+  uint64_t hash = 14695981039346656037ULL;
+
+#define WEB_TRACE_HASH(p, n)                                                   \
+  for (size_t i = 0; i < (n); i++) {                                           \
+    hash ^= ((const uint8_t *) (p))[i];                                        \
+    hash *= 1099511628211ULL;                                                  \
+  }
+
+  WEB_TRACE_HASH(&pEvent->head, sizeof(pEvent->head));
+  WEB_TRACE_HASH(&pEvent->timestamp, sizeof(pEvent->timestamp));
+  WEB_TRACE_HASH(&pEvent->vscp_class, sizeof(pEvent->vscp_class));
+  WEB_TRACE_HASH(&pEvent->vscp_type, sizeof(pEvent->vscp_type));
+  WEB_TRACE_HASH(pEvent->GUID, sizeof(pEvent->GUID));
+  WEB_TRACE_HASH(&pEvent->sizeData, sizeof(pEvent->sizeData));
+  if (NULL != pEvent->pdata) {
+    WEB_TRACE_HASH(pEvent->pdata, pEvent->sizeData);
+  }
+
+#undef WEB_TRACE_HASH
+
+  return hash;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// stampIngress
+//
+
+void
+CWebTrace::stampIngress(const vscpEvent *pEvent, const struct timespec &ingress)
+{
+  if (!m_bEnable || (NULL == pEvent)) {
+    return;
+  }
+
+  inflight entry;
+  entry.m_ingress     = ingress;
+  entry.m_fingerprint = getFingerprint(pEvent);
+
+  pthread_mutex_lock(&m_mutex);
+
+  if (m_inflight.size() >= WEB_TRACE_MAX_INFLIGHT) {
+    pruneLocked(ingress);
+  }
+
+  if (m_inflight.size() < WEB_TRACE_MAX_INFLIGHT) {
+    m_inflight[pEvent] = entry;
+  }
+
+  m_cntInflight.store(m_inflight.size(), std::memory_order_relaxed);
+
+  pthread_mutex_unlock(&m_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// getIngress
+//
+
+bool
+CWebTrace::getIngress(const vscpEvent *pEvent, struct timespec &ingress)
+{
+  bool rv = false;
+
+  // Nothing traced is queued, don't bother
+  if (!m_bEnable || (NULL == pEvent) || !m_cntInflight.load(std::memory_order_relaxed)) {
+    return false;
+  }
+
+  pthread_mutex_lock(&m_mutex);
+
+  // Each copy is delivered once, so the stamp is taken out here
+  std::map<const vscpEvent *, inflight>::iterator it = m_inflight.find(pEvent);
+  if (it != m_inflight.end()) {
+    if (it->second.m_fingerprint == getFingerprint(pEvent)) {
+      ingress = it->second.m_ingress;
+      rv      = true;
+    }
+    m_inflight.erase(it);
+    m_cntInflight.store(m_inflight.size(), std::memory_order_relaxed);
+  }
+
+  pthread_mutex_unlock(&m_mutex);
+
+  return rv;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// forgetIngress
+//
+
+void
+CWebTrace::forgetIngress(const vscpEvent *pEvent)
+{
+  if (!m_bEnable || (NULL == pEvent) || !m_cntInflight.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  pthread_mutex_lock(&m_mutex);
+  m_inflight.erase(pEvent);
+  m_cntInflight.store(m_inflight.size(), std::memory_order_relaxed);
+  pthread_mutex_unlock(&m_mutex);
+}
+
+void
+CWebTrace::forgetIngress(const std::deque<vscpEvent *> &events)
+{
+  if (!m_bEnable || events.empty() || !m_cntInflight.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  pthread_mutex_lock(&m_mutex);
+  for (std::deque<vscpEvent *>::const_iterator it = events.begin(); it != events.end(); ++it) {
+    m_inflight.erase(*it);
+  }
+  m_cntInflight.store(m_inflight.size(), std::memory_order_relaxed);
+  pthread_mutex_unlock(&m_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// prune
+//
+
+void
+CWebTrace::prune(void)
+{
+  if (!m_cntInflight.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  struct timespec now = webmetrics_now();
+
+  pthread_mutex_lock(&m_mutex);
+  pruneLocked(now);
+  m_cntInflight.store(m_inflight.size(), std::memory_order_relaxed);
+  pthread_mutex_unlock(&m_mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pruneLocked
+//
+
+void
+CWebTrace::pruneLocked(const struct timespec &now)
+{
+  std::map<const vscpEvent *, inflight>::iterator it = m_inflight.begin();
+  while (it != m_inflight.end()) {
+    if ((now.tv_sec - it->second.m_ingress.tv_sec) > WEB_TRACE_MAX_AGE) {
+      m_inflight.erase(it++);
+    }
+    else {
+      ++it;
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// markPost
+//
+
+void
+CWebTrace::markPost(void)
+{
+  struct timespec now = webmetrics_now();
+  m_postTime.store(WEB_TRACE_NS(now), std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// markWakeup
+//
+
+void
+CWebTrace::markWakeup(void)
+{
+  int64_t post = m_postTime.exchange(0, std::memory_order_relaxed);
+  if (!post) {
+    return;
+  }
+
+  struct timespec now = webmetrics_now();
+  int64_t us          = (WEB_TRACE_NS(now) - post) / 1000;
+  m_stageWakeup.record((us > 0) ? (uint64_t) us : 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// render
+//
+
+void
+CWebTrace::render(CWebBuffer &buf) const
+{
+  static const double quantiles[] = { 0.5, 0.9, 0.99 };
+
+  struct {
+    const char *m_name;
+    const char *m_help;
+    const CWebMetricHistogram *m_phist;
+  } stages[] = {
+    { "enqueue", "ingress until the event is in all client queues", &m_stageEnqueue },
+    { "wakeup", "send thread signalled until it runs", &m_stageWakeup },
+    { "filter", "client filter", &m_stageFilter },
+    { "serialize", "event to string/JSON", &m_stageSerialize },
+    { "write", "websocket write", &m_stageWrite },
+    { "end_to_end", "ingress until websocket write completed", &m_endToEnd },
+  };
+
+  for (size_t i = 0; i < sizeof(stages) / sizeof(stages[0]); i++) {
+
+    char name[128];
+    char help[128];
+
+    snprintf(name, sizeof(name), "vscp_websrv_trace_%s_duration_seconds", stages[i].m_name);
+    snprintf(help, sizeof(help), "Traced events, %s.", stages[i].m_help);
+    stages[i].m_phist->render(buf, name, help);
+
+    // Percentiles for those who don't have Prometheus to calculate them
+    snprintf(name, sizeof(name), "vscp_websrv_trace_%s_quantile_seconds", stages[i].m_name);
+    buf.appendf("# HELP %s Traced events, %s (upper bucket bound).\n# TYPE %s gauge\n",
+                name,
+                stages[i].m_help,
+                name);
+    for (size_t j = 0; j < sizeof(quantiles) / sizeof(quantiles[0]); j++) {
+      buf.appendf("%s{quantile=\"%g\"} %g\n", name, quantiles[j], stages[i].m_phist->percentile(quantiles[j]));
+    }
+  }
+}
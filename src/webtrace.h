@@ -0,0 +1,208 @@
+// webtrace.h
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#if !defined(WEBTRACE_H__INCLUDED_)
+#define WEBTRACE_H__INCLUDED_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <atomic>
+#include <deque>
+#include <map>
+
+#include <vscp.h>
+#include <webbuf.h>
+#include <webmetrics.h>
+
+// Default is to trace one event out of this many
+#define WEB_TRACE_DEFAULT_SAMPLE_RATE 100
+
+// Max number of events traced at the same time
+#define WEB_TRACE_MAX_INFLIGHT 1024
+
+// Seconds before a traced event that was never delivered or freed is
+// forgotten by prune()
+#define WEB_TRACE_MAX_AGE 10
+
+/*!
+  Sampled latency tracing of events from ingress to websocket delivery.
+
+  A sampled event gets a monotonic ingress stamp when it enters the
+  driver and timings are recorded for each stage on its way out:
+  enqueue to the client queues, send thread wakeup, filter,
+  serialize and websocket write. Stage timings are kept in histograms
+  that are exported on the metrics endpoint.
+
+  vscpEvent is shared with other VSCP code, so the stamp can't travel
+  in the event itself. It is instead held in a small table keyed on
+  the copy queued for each client and taken out when that copy is
+  delivered or freed. The table size is kept in an atomic, so deliveries
+  skip the lock while no traced event is queued.
+*/
+
+class CWebTrace {
+
+public:
+  CWebTrace(void);
+  ~CWebTrace();
+
+  /*!
+    Set trace parameters
+    @param bEnable True to enable tracing
+    @param sampleRate Trace one event out of this many
+  */
+  void setParameters(bool bEnable, uint32_t sampleRate);
+
+  /*!
+    True if tracing is enabled
+  */
+  bool isEnabled(void) const { return m_bEnable; };
+
+  /*!
+    Decide if the next incoming event should be traced
+    @return true if it should be traced.
+  */
+  bool sample(void);
+
+  /*!
+    Stamp the copy of a traced event queued for a client. Call before
+    the copy is put in the client queue.
+    @param pEvent Queued copy
+    @param ingress Time the event entered the driver
+  */
+  void stampIngress(const vscpEvent *pEvent, const struct timespec &ingress);
+
+  /*!
+    Get ingress time for a delivered event and forget the stamp
+    @param pEvent Event taken from a client queue
+    @param ingress Set to the ingress time if found
+    @return true if the event is traced.
+  */
+  bool getIngress(const vscpEvent *pEvent, struct timespec &ingress);
+
+  /*!
+    Forget the stamp of a queued copy that is freed without going to a
+    websocket (REST read, script read, drop-oldest, CLRQ, client removal).
+    Must be called before the copy is freed.
+    @param pEvent Event taken from a client queue
+  */
+  void forgetIngress(const vscpEvent *pEvent);
+
+  /*!
+    Forget the stamps of a batch of queued copies
+    @param events Events taken from a client queue
+  */
+  void forgetIngress(const std::deque<vscpEvent *> &events);
+
+  /*!
+    Forget stamps older than WEB_TRACE_MAX_AGE seconds. Called by the
+    housekeeping thread for copies that were lost without a forget.
+  */
+  void prune(void);
+
+  /*!
+    Mark that the send thread has been signalled for a traced event
+  */
+  void markPost(void);
+
+  /*!
+    Called by the send thread when it wakes up. Records the
+    wakeup latency if a traced event was signalled.
+  */
+  void markWakeup(void);
+
+  /*!
+    Write stage histograms and percentiles in Prometheus text format
+  */
+  void render(CWebBuffer &buf) const;
+
+  /// Ingress until the event is in all client queues
+  CWebMetricHistogram m_stageEnqueue;
+
+  /// Semaphore post until the send thread runs
+  CWebMetricHistogram m_stageWakeup;
+
+  /// Client filter
+  CWebMetricHistogram m_stageFilter;
+
+  /// Event to string/JSON
+  CWebMetricHistogram m_stageSerialize;
+
+  /// mg_websocket_write
+  CWebMetricHistogram m_stageWrite;
+
+  /// Ingress until the websocket write has completed
+  CWebMetricHistogram m_endToEnd;
+
+private:
+  // Disable copy
+  CWebTrace(const CWebTrace &);
+  CWebTrace &operator=(const CWebTrace &);
+
+  /*!
+    Calculate a fingerprint for an event
+  */
+  static uint64_t getFingerprint(const vscpEvent *pEvent);
+
+  /*!
+    Forget stamps older than WEB_TRACE_MAX_AGE. m_mutex must be held.
+    @param now Current monotonic time
+  */
+  void pruneLocked(const struct timespec &now);
+
+  /// True if tracing is enabled
+  bool m_bEnable;
+
+  /// Trace one event out of this many
+  uint32_t m_sampleRate;
+
+  /// Event counter for sampling
+  std::atomic<uint32_t> m_cntSample;
+
+  /// Monotonic time in ns for last post of a traced event (0 = none)
+  std::atomic<int64_t> m_postTime;
+
+  /// Number of entries in m_inflight (checked without lock)
+  std::atomic<size_t> m_cntInflight;
+
+  /// Protects m_inflight
+  pthread_mutex_t m_mutex;
+
+  /// Traced copy waiting in a client queue
+  struct inflight {
+    struct timespec m_ingress;
+    uint64_t m_fingerprint; // Catches a freed copy whose address is reused
+  };
+
+  /// queued copy -> ingress time
+  std::map<const vscpEvent *, inflight> m_inflight;
+};
+
+#endif
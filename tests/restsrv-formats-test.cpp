@@ -0,0 +1,207 @@
+// restsrv-formats-test.cpp
+//
+// This file is part of the VSCP (https://www.vscp.org)
+//
+// The MIT License (MIT)
+//
+// Copyright © 2000-2021 Ake Hedman, the VSCP project
+// <akhe@vscp.org>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//
+// Round trip test for the binary REST formats. A READEVENT reply is
+// built the same way as restsrv_doReceiveEvent does it, encoded in CBOR
+// and MessagePack, decoded again and the event fields are compared with
+// vscp_convertEventToJSON for the same event.
+//
+// Returns zero if all checks pass.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <restsrv.h>
+#include <vscp.h>
+#include <vscphelper.h>
+#include <webbuf.h>
+
+#include <json.hpp> // Needs C++11  -std=c++11
+
+using json = nlohmann::json;
+
+///////////////////////////////////////////////////////////////////////////////
+// test_initEvent
+//
+
+static void
+test_initEvent(vscpEvent &ev, std::vector<uint8_t> &data, uint16_t size)
+{
+  data.resize(size);
+  for (uint16_t i = 0; i < size; i++) {
+    data[i] = (uint8_t) i;
+  }
+
+  memset(&ev, 0, sizeof(ev));
+  ev.head       = VSCP_PRIORITY_HIGH | VSCP_HEADER16_DUMB;
+  ev.vscp_class = 1040;
+  ev.vscp_type  = 6;
+  ev.obid       = 0x11223344;
+  ev.timestamp  = 0xFEDCBA98;
+  ev.year       = 2021;
+  ev.month      = 6;
+  ev.day        = 15;
+  ev.hour       = 12;
+  ev.minute     = 30;
+  ev.second     = 15;
+  for (int i = 0; i < 16; i++) {
+    ev.GUID[i] = (uint8_t) (0xF0 + i);
+  }
+  ev.sizeData = size;
+  ev.pdata    = size ? data.data() : NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// test_checkEvent
+//
+// Compare a decoded READEVENT event object with the ws2 JSON form of
+// the same event. The date is left out as the two use different forms.
+//
+
+static bool
+test_checkEvent(const char *name, const json &ev, const json &ref, uint16_t size)
+{
+  bool rv = true;
+
+  struct {
+    const char *m_rest;
+    const char *m_ref;
+  } fields[] = {
+    { "head", "vscpHead" },           { "vscpclass", "vscpClass" }, { "vscptype", "vscpType" },
+    { "obid", "vscpObId" },           { "guid", "vscpGuid" },       { "timestamp", "vscpTimeStamp" },
+    { "data", "vscpData" },
+  };
+
+  for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+    if (!ev.contains(fields[i].m_rest) || !ref.contains(fields[i].m_ref) ||
+        (ev[fields[i].m_rest] != ref[fields[i].m_ref])) {
+      printf("  %s: '%s' does not match '%s'\n", name, fields[i].m_rest, fields[i].m_ref);
+      rv = false;
+    }
+  }
+
+  if (!ev.contains("sizedata") || (ev["sizedata"] != size) || (ev["data"].size() != size)) {
+    printf("  %s: size of data is wrong\n", name);
+    rv = false;
+  }
+
+  return rv;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// test_roundTrip
+//
+// Encode a READEVENT reply with one event in format, decode it and
+// check it. Returns false on a mismatch.
+//
+
+static bool
+test_roundTrip(const char *name, int format, uint16_t size)
+{
+  vscpEvent ev;
+  std::vector<uint8_t> data;
+  test_initEvent(ev, data, size);
+
+  std::string str;
+  if (!vscp_convertEventToJSON(str, &ev)) {
+    printf("  %s: vscp_convertEventToJSON failed\n", name);
+    return false;
+  }
+
+  json ref = json::parse(str);
+
+  json output;
+  json event;
+  restsrv_getEventJSON(event, &ev);
+  output["success"] = true;
+  output["event"].push_back(event);
+  output["count"]    = 1;
+  output["filtered"] = 0;
+  output["errors"]   = 0;
+
+  CWebBuffer buf;
+  restsrv_appendJSON(buf, format, output);
+
+  const uint8_t *p = (const uint8_t *) buf.data();
+  std::vector<uint8_t> v(p, p + buf.size());
+
+  json decoded;
+  try {
+    decoded = (REST_FORMAT_CBOR == format) ? json::from_cbor(v) : json::from_msgpack(v);
+  }
+  catch (json::exception &e) {
+    printf("  %s: decode failed: %s\n", name, e.what());
+    return false;
+  }
+
+  if (decoded != output) {
+    printf("  %s: decoded reply differs from the encoded one\n", name);
+    return false;
+  }
+
+  if (!decoded.contains("event") || (1 != decoded["event"].size()) || (1 != decoded["count"])) {
+    printf("  %s: event array is wrong\n", name);
+    return false;
+  }
+
+  return test_checkEvent(name, decoded["event"][0], ref, size);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// main
+//
+
+int
+main(void)
+{
+  struct {
+    const char *m_name;
+    int m_format;
+    uint16_t m_size;
+  } tests[] = {
+    { "cbor/empty", REST_FORMAT_CBOR, 0 },
+    { "cbor/512", REST_FORMAT_CBOR, 512 },
+    { "msgpack/empty", REST_FORMAT_MSGPACK, 0 },
+    { "msgpack/512", REST_FORMAT_MSGPACK, 512 },
+  };
+
+  int failed = 0;
+  for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+    bool ok = test_roundTrip(tests[i].m_name, tests[i].m_format, tests[i].m_size);
+    printf("%-20s %s\n", tests[i].m_name, ok ? "ok" : "FAILED");
+    if (!ok) {
+      failed++;
+    }
+  }
+
+  return failed ? 1 : 0;
+}